@@ -26,12 +26,19 @@
 #import "AGPipeline.h"
 #import "AGPipeConfig.h"
 #import "AGNSMutableArray+Paging.h"
+#import "AGBatchRequest.h"
 #import "AGMultipart.h"
+#import "AGResponseCache.h"
+#import "AGRetryPolicy.h"
+#import "AGCircuitBreaker.h"
+#import "AGRequestScheduler.h"
+#import "AGSerializer.h"
 
 #pragma mark - DataManager
 #import "AGStore.h"
 #import "AGDataManager.h"
 #import "AGStoreConfig.h"
+#import "AGKeyRotation.h"
 
 #pragma mark - Security
 
@@ -0,0 +1,93 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+extern NSString * const AGCircuitBreakerErrorDomain;
+
+typedef NS_ENUM(NSInteger, AGCircuitBreakerState) {
+    AGCircuitBreakerStateClosed,    // requests go through
+    AGCircuitBreakerStateOpen,      // requests fail fast
+    AGCircuitBreakerStateHalfOpen   // a trial request is under way
+};
+
+/**
+ Stops sending requests to a host that keeps failing: after failureThreshold consecutive failures,
+ the breaker opens and requests fail immediately, with an AGCircuitBreakerErrorDomain error, for
+ resetTimeout seconds. A single trial request is then let through: its success closes the breaker,
+ its failure opens it again.
+
+ The breakers are shared per host and settings, between all the pipes (see AGRetryPolicy).
+ */
+@interface AGCircuitBreaker : NSObject
+
+/**
+ * Returns the breaker shared by the requests to a host with the given settings, created if there
+ * is none yet. Requests to the same host with other settings get a breaker of their own.
+ *
+ * @param host The host.
+ * @param failureThreshold The number of consecutive failures that opens the breaker.
+ * @param resetTimeout How long the breaker stays open.
+ *
+ * @return the AGCircuitBreaker of the host.
+ */
++ (instancetype)breakerForHost:(NSString *)host
+              failureThreshold:(NSUInteger)failureThreshold
+                  resetTimeout:(NSTimeInterval)resetTimeout;
+
+- (instancetype)initWithFailureThreshold:(NSUInteger)failureThreshold
+                            resetTimeout:(NSTimeInterval)resetTimeout;
+
+/**
+ * The number of consecutive failures that opens the breaker.
+ */
+@property (nonatomic, readonly) NSUInteger failureThreshold;
+
+/**
+ * How long the breaker stays open, in seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval resetTimeout;
+
+/**
+ * The current state of the breaker.
+ */
+@property (nonatomic, readonly) AGCircuitBreakerState state;
+
+/**
+ * Returns whether a request may be sent, i.e. if the breaker is closed, or if it has been open for
+ * resetTimeout and the request is the trial one.
+ *
+ * @return YES if the request may be sent, NO if it should fail fast.
+ */
+- (BOOL)allowRequest;
+
+/**
+ * Records the success of a request, closing the breaker.
+ */
+- (void)recordSuccess;
+
+/**
+ * Records the failure of a request, opening the breaker once failureThreshold is reached.
+ */
+- (void)recordFailure;
+
+/**
+ * Closes the breaker, forgetting the failures so far.
+ */
+- (void)reset;
+
+@end
@@ -0,0 +1,109 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGCircuitBreaker.h"
+
+NSString * const AGCircuitBreakerErrorDomain = @"AGCircuitBreakerErrorDomain";
+
+@implementation AGCircuitBreaker {
+    NSUInteger _failures;
+    NSDate *_openedAt;
+}
+
++ (instancetype)breakerForHost:(NSString *)host
+              failureThreshold:(NSUInteger)failureThreshold
+                  resetTimeout:(NSTimeInterval)resetTimeout {
+    static NSMutableDictionary *breakers;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        breakers = [[NSMutableDictionary alloc] init];
+    });
+
+    // a breaker per configuration, so that each policy gets the settings it asked for
+    NSString *key = [NSString stringWithFormat:@"%@|%lu|%f", [host lowercaseString] ?: @"",
+                     (unsigned long) failureThreshold, resetTimeout];
+
+    @synchronized(breakers) {
+        AGCircuitBreaker *breaker = breakers[key];
+
+        if (!breaker) {
+            breaker = [[[self class] alloc] initWithFailureThreshold:failureThreshold resetTimeout:resetTimeout];
+            breakers[key] = breaker;
+        }
+
+        return breaker;
+    }
+}
+
+- (instancetype)initWithFailureThreshold:(NSUInteger)failureThreshold
+                            resetTimeout:(NSTimeInterval)resetTimeout {
+    self = [super init];
+    if (self) {
+        _failureThreshold = failureThreshold;
+        _resetTimeout = resetTimeout;
+        _state = AGCircuitBreakerStateClosed;
+    }
+    return self;
+}
+
+- (BOOL)allowRequest {
+    @synchronized(self) {
+        switch (_state) {
+            case AGCircuitBreakerStateClosed:
+                return YES;
+
+            case AGCircuitBreakerStateOpen:
+            case AGCircuitBreakerStateHalfOpen:
+                // let a single trial request through once the timeout is over, and another
+                // one if the trial never completed (e.g. it was cancelled)
+                if (-[_openedAt timeIntervalSinceNow] >= _resetTimeout) {
+                    _state = AGCircuitBreakerStateHalfOpen;
+                    _openedAt = [NSDate date];
+                    return YES;
+                }
+                return NO;
+        }
+    }
+
+    return NO;
+}
+
+- (void)recordSuccess {
+    [self reset];
+}
+
+- (void)recordFailure {
+    @synchronized(self) {
+        _failures++;
+
+        if (_state == AGCircuitBreakerStateHalfOpen || _failures >= _failureThreshold) {
+            _state = AGCircuitBreakerStateOpen;
+            _openedAt = [NSDate date];
+        }
+    }
+}
+
+- (void)reset {
+    @synchronized(self) {
+        _failures = 0;
+        _openedAt = nil;
+        _state = AGCircuitBreakerStateClosed;
+    }
+}
+
+@end
@@ -19,7 +19,30 @@
 #import "AFNetworking.h"
 #import "AGAuthenticationModuleAdapter.h"
 #import "AGAuthzModuleAdapter.h"
+#import "AGResponseCache.h"
+#import "AGRetryPolicy.h"
+#import "AGRequestScheduler.h"
+#import "AGSerializer.h"
 
+/**
+ * The HTTP client of the pipes. GET requests for a resource that is being requested already (same URL,
+ * parameters and auth/authz tokens) don't go out again: the callers share the response of the request
+ * under way, and the task returned.
+ *
+ * With a responseCache, GET requests are sent conditionally, and answered with the cached response
+ * when the server replies 304 (Not Modified).
+ *
+ * Large collections can be read with a streamed GET, which parses the response as it is received.
+ *
+ * PATCH requests are sent as JSON merge patches (RFC 7396), with the "application/merge-patch+json" content type.
+ *
+ * Bodies are JSON, unless a serializer is set (e.g. AGMessagePackSerializer): responses are then parsed
+ * according to their Content-Type, so that JSON responses of servers that don't support the format
+ * are still understood.
+ *
+ * With a retryPolicy, failed requests are sent again (streamed GETs excepted, since their records
+ * may have been delivered already), and requests to a failing host fail fast (see AGCircuitBreaker).
+ */
 @interface AGHttpClient : AFHTTPSessionManager
 
 + (instancetype)clientFor:(NSURL *)url;
@@ -30,4 +53,78 @@
                                     authModule:(id<AGAuthenticationModuleAdapter>) authModule
                                    authzModule:(id<AGAuthzModuleAdapter>)authzModule;
 
+/**
+ * The size, in bytes, from which request bodies are sent gzip compressed (with "Content-Encoding: gzip"),
+ * or 0 (the default) to send them as is. Multipart bodies are compressed as they are sent.
+ */
+@property (nonatomic, assign) NSUInteger requestCompressionThreshold;
+
+/**
+ * The serializer of the request bodies, whose format is preferred for the responses (see the Accept
+ * header), or nil (the default) for JSON.
+ */
+@property (nonatomic, strong) id<AGSerializer> serializer;
+
+/**
+ * The policy deciding whether, and when, failed requests are sent again, or nil (the default)
+ * to fail them right away.
+ */
+@property (nonatomic, strong) AGRetryPolicy *retryPolicy;
+
+/**
+ * Drops the retries that wait for their delay, their failure blocks are invoked with an
+ * NSURLErrorCancelled error. Running tasks are not affected.
+ */
+- (void)cancelPendingRetries;
+
+/**
+ * The scheduler deciding when the requests go out, possibly shared with other clients, or nil
+ * (the default) to send them right away.
+ */
+@property (nonatomic, strong) AGRequestScheduler *scheduler;
+
+/**
+ * The priority class of the requests with the scheduler, defaults to AGRequestPriorityDefault.
+ */
+@property (nonatomic, assign) AGRequestPriority priority;
+
+/**
+ * The cache of the responses to GET requests, or nil (the default) to always transfer them.
+ */
+@property (nonatomic, strong) AGResponseCache *responseCache;
+
+/**
+ * Reads a (large) JSON array, parsing the response as it is received instead of buffering it: the
+ * records are handed to the records block in batches, as soon as batchSize of them are complete, so
+ * the first ones are available early and memory use doesn't grow with the size of the response. A
+ * response that is not an array is delivered as a single record.
+ *
+ * Streamed requests are neither shared with identical requests under way nor cached.
+ *
+ * @param URLString The URL string used to create the request URL.
+ * @param parameters The parameters to be encoded in the query string.
+ * @param batchSize The (maximum) number of records per batch, 0 defaults to 100.
+ * @param records A block object invoked, on the main queue, with each batch of records.
+ * @param success A block object to be executed after the last batch, once the response is complete.
+ * @param failure A block object to be executed when the request fails, or its response can't be parsed.
+ *
+ * @return the NSURLSessionDataTask of the request.
+ */
+- (NSURLSessionDataTask *)GET:(NSString *)URLString
+                   parameters:(NSDictionary *)parameters
+                    batchSize:(NSUInteger)batchSize
+                      records:(void (^)(NSArray *records))records
+                      success:(void (^)(NSURLSessionDataTask *task))success
+                      failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure;
+
+/**
+ * Returns the headers of the response to a task, i.e. those of the cached response if the
+ * task was answered from the responseCache.
+ *
+ * @param task The task.
+ *
+ * @return an NSDictionary of the response headers.
+ */
+- (NSDictionary *)responseHeadersForTask:(NSURLSessionTask *)task;
+
 @end
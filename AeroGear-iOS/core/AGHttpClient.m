@@ -15,8 +15,134 @@
  * limitations under the License.
  */
 
+#import <objc/runtime.h>
 #import "AGHttpClient.h"
 #import "AGMultipart.h"
+#import "AGNSStream+IO.h"
+#import "AGJsonArrayParser.h"
+#import "AGCircuitBreaker.h"
+#import <zlib.h>
+
+static char const * const AGCachedHeadersKey = "AGCachedHeadersKey";
+
+// the error of the body stream of a task, that failed it
+static char const * const AGBodyStreamErrorKey = "AGBodyStreamErrorKey";
+
+// creates the task of an attempt of a request, with the given completion handler
+typedef NSURLSessionDataTask *(^AGTaskFactory)(void (^completionHandler)(NSURLResponse *response, id responseObject, NSError *error));
+
+// the outcome of a request, once it succeeded or can't be retried anymore
+typedef void (^AGTaskCompletionHandler)(NSURLSessionDataTask *task, NSURLResponse *response, id responseObject, NSError *error);
+
+// the size of the buffers used to compress streamed bodies
+static const NSUInteger kGzipBufferSize = 16 * 1024;
+
+// the number of records per batch of a streamed response, if none is given
+static const NSUInteger kDefaultBatchSize = 100;
+
+#pragma mark - compression helpers
+
+// deflate with a gzip header and trailer
+static BOOL AGGzipInit(z_stream *stream) {
+    memset(stream, 0, sizeof(*stream));
+
+    return deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+static NSData *AGGzipData(NSData *data) {
+    z_stream stream;
+
+    if (!AGGzipInit(&stream))
+        return nil;
+
+    NSMutableData *compressed = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)[data length])];
+
+    stream.next_in = (Bytef *)[data bytes];
+    stream.avail_in = (uInt)[data length];
+    stream.next_out = [compressed mutableBytes];
+    stream.avail_out = (uInt)[compressed length];
+
+    BOOL success = (deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    [compressed setLength:stream.total_out];
+
+    deflateEnd(&stream);
+
+    return success ? compressed : nil;
+}
+
+// fails a task whose body can't be produced; to be called before its body stream is closed,
+// so that the session never takes the end of the stream for the end of the body
+static void AGFailBodyStream(NSURLSessionTask *task, NSError *error) {
+    objc_setAssociatedObject(task, AGBodyStreamErrorKey, error, OBJC_ASSOCIATION_RETAIN);
+    [task cancel];
+}
+
+// compresses the source as it is read by the returned stream, on a background queue,
+// so that large bodies are neither held in memory nor buffered twice. A failure to read
+// or compress the source fails the task: ending the stream instead would send a truncated body.
+static NSInputStream *AGGzipStream(NSInputStream *source, NSURLSessionTask *task) {
+    CFReadStreamRef readStream;
+    CFWriteStreamRef writeStream;
+
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &readStream, &writeStream, kGzipBufferSize);
+
+    NSInputStream *input = CFBridgingRelease(readStream);
+    NSOutputStream *output = CFBridgingRelease(writeStream);
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [output open];
+        [source open];
+
+        z_stream stream;
+        BOOL initialized = AGGzipInit(&stream);
+
+        uint8_t *buffer = initialized ? malloc(2 * kGzipBufferSize) : NULL;
+        uint8_t *compressed = buffer ? buffer + kGzipBufferSize : NULL;
+        int flush = Z_NO_FLUSH;
+
+        BOOL success = (buffer != NULL);
+
+        if (!success)
+            AGFailBodyStream(task, [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM
+                                                   userInfo:@{NSLocalizedDescriptionKey: @"can't compress the request body"}]);
+
+        // the writes block until the body is sent, and fail once the task is over
+        while (success && flush != Z_FINISH) {
+            NSInteger length = [source read:buffer maxLength:kGzipBufferSize];
+
+            if (length < 0) {
+                AGFailBodyStream(task, [source streamError] ?: [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO
+                                                                               userInfo:@{NSLocalizedDescriptionKey: @"can't read the request body"}]);
+                break;
+            }
+
+            flush = (length == 0) ? Z_FINISH : Z_NO_FLUSH;
+
+            stream.next_in = buffer;
+            stream.avail_in = (uInt)length;
+
+            do {
+                stream.next_out = compressed;
+                stream.avail_out = (uInt)kGzipBufferSize;
+
+                deflate(&stream, flush);
+
+                NSUInteger produced = kGzipBufferSize - stream.avail_out;
+                success = (produced == 0) || [output writeAllBytes:compressed length:produced error:nil];
+            } while (success && stream.avail_out == 0);
+        }
+
+        if (initialized)
+            deflateEnd(&stream);
+
+        free(buffer);
+
+        [source close];
+        [output close];
+    });
+
+    return input;
+}
 
 @interface AGRequestSerializer : AFJSONRequestSerializer
 
@@ -24,6 +150,14 @@
     @property (nonatomic, strong) id<AGAuthenticationModuleAdapter> authModule;
     @property (nonatomic, strong) id<AGAuthzModuleAdapter> authzModule;
 
+    // the size from which bodies are compressed, 0 to disable
+    @property (nonatomic, assign) NSUInteger compressionThreshold;
+
+    // the serializer of the bodies, nil for JSON
+    @property (nonatomic, strong) id<AGSerializer> serializer;
+
+    - (NSSet *)credentialHeaders;
+
 @end
 
 @implementation AGRequestSerializer
@@ -34,15 +168,59 @@
     return serializer;
 }
 
+// the (lowercased) names of the headers holding credentials
+- (NSSet *)credentialHeaders {
+    NSMutableSet *names = [NSMutableSet setWithObjects:@"authorization", @"proxy-authorization", @"cookie", nil];
+
+    for (NSString *name in [self.authModule authTokens])
+        [names addObject:[name lowercaseString]];
+
+    for (NSString *name in [self.authzModule accessTokens])
+        [names addObject:[name lowercaseString]];
+
+    return names;
+}
+
 #pragma mark - AGRequestSerializer
 
 - (NSURLRequest *)requestBySerializingRequest:(NSURLRequest *)request
                                withParameters:(id)parameters
                                         error:(NSError *__autoreleasing *)error {
 
+    // the parameters go in the body, in the format of the serializer
+    BOOL serializesBody = self.serializer && parameters &&
+            ![self.HTTPMethodsEncodingParametersInURI containsObject:[request.HTTPMethod uppercaseString]];
+
     // call base json serialization
     NSMutableURLRequest *mutableRequest = (NSMutableURLRequest *)[super requestBySerializingRequest:request
-                                                                                     withParameters:parameters error:error];
+                                                                                     withParameters:serializesBody ? nil : parameters error:error];
+
+    if (serializesBody) {
+        NSData *body = [self.serializer dataWithObject:parameters error:error];
+
+        if (!body)
+            return nil;
+
+        [mutableRequest setValue:self.serializer.contentType forHTTPHeaderField:@"Content-Type"];
+        mutableRequest.HTTPBody = body;
+    }
+
+    // the JSON bodies of PATCH requests are JSON merge patches
+    if ([mutableRequest.HTTPMethod isEqualToString:@"PATCH"] && mutableRequest.HTTPBody &&
+            [[mutableRequest valueForHTTPHeaderField:@"Content-Type"] hasPrefix:@"application/json"])
+        [mutableRequest setValue:@"application/merge-patch+json" forHTTPHeaderField:@"Content-Type"];
+
+    // compress large bodies, if they shrink
+    NSData *body = mutableRequest.HTTPBody;
+
+    if (self.compressionThreshold > 0 && [body length] >= self.compressionThreshold) {
+        NSData *compressed = AGGzipData(body);
+
+        if (compressed && [compressed length] < [body length]) {
+            mutableRequest.HTTPBody = compressed;
+            [mutableRequest setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+        }
+    }
     // finally apply auth/autz (if any) on request
     NSDictionary *headers;
 
@@ -64,8 +242,192 @@
 
 @end
 
+// parses the responses with the serializer if they are in its format, as JSON otherwise
+@interface AGResponseSerializer : AFJSONResponseSerializer
+
+    // the serializer of the bodies, nil for JSON
+    @property (nonatomic, strong) id<AGSerializer> serializer;
+
+@end
+
+@implementation AGResponseSerializer
+
+- (void)setSerializer:(id<AGSerializer>)serializer {
+    _serializer = serializer;
+
+    NSMutableSet *acceptableContentTypes = [[[AGJsonSerializer serializer] acceptableContentTypes] mutableCopy];
+
+    if (serializer)
+        [acceptableContentTypes unionSet:serializer.acceptableContentTypes];
+
+    self.acceptableContentTypes = acceptableContentTypes;
+}
+
+- (BOOL)canParseResponse:(NSURLResponse *)response {
+    return self.serializer && [self.serializer.acceptableContentTypes containsObject:[response MIMEType]];
+}
+
+#pragma mark - AFURLResponseSerialization
+
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error {
+
+    if (![self canParseResponse:response])
+        return [super responseObjectForResponse:response data:data error:error];
 
-@implementation AGHttpClient
+    NSError *validationError;
+
+    // like the JSON serializer, keep the body of error responses
+    if (![self validateResponse:(NSHTTPURLResponse *)response data:data error:&validationError] &&
+            [validationError code] == NSURLErrorCannotDecodeContentData) {
+        if (error)
+            *error = validationError;
+
+        return nil;
+    }
+
+    NSError *serializationError;
+    id responseObject = [data length] > 0 ? [self.serializer objectWithData:data error:&serializationError] : nil;
+
+    if (error)
+        *error = validationError ?: serializationError;
+
+    return responseObject;
+}
+
+@end
+
+// the callbacks of the callers waiting for the same GET request
+@interface AGInFlightRequest : NSObject
+
+    @property (nonatomic, strong) NSURLSessionDataTask *task;
+    @property (nonatomic, readonly) NSMutableArray *successBlocks;
+    @property (nonatomic, readonly) NSMutableArray *failureBlocks;
+
+@end
+
+@implementation AGInFlightRequest
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _successBlocks = [[NSMutableArray alloc] init];
+        _failureBlocks = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)addSuccess:(void (^)(NSURLSessionDataTask *task, id responseObject))success
+           failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure {
+    if (success)
+        [_successBlocks addObject:[success copy]];
+
+    if (failure)
+        [_failureBlocks addObject:[failure copy]];
+}
+
+@end
+
+// the state of a GET request whose response is parsed as it is received
+@interface AGStreamedResponse : NSObject
+
+    @property (nonatomic, readonly) NSError *error;
+
+    // set if the response is in a format that can't be parsed as it is received
+    @property (nonatomic, assign) BOOL buffered;
+
+@end
+
+@implementation AGStreamedResponse {
+    AGJsonArrayParser *_parser;
+    NSMutableArray *_batch;
+    NSUInteger _batchSize;
+
+    dispatch_queue_t _queue;
+    void (^_recordsBlock)(NSArray *records);
+}
+
+- (instancetype)initWithBatchSize:(NSUInteger)batchSize
+                            queue:(dispatch_queue_t)queue
+                          records:(void (^)(NSArray *records))records {
+    self = [super init];
+    if (self) {
+        _batchSize = batchSize > 0 ? batchSize : kDefaultBatchSize;
+        _batch = [[NSMutableArray alloc] initWithCapacity:_batchSize];
+        _queue = queue;
+        _recordsBlock = [records copy];
+
+        __weak AGStreamedResponse *weakSelf = self;
+
+        _parser = [[AGJsonArrayParser alloc] initWithOptions:0 recordBlock:^(id record, BOOL *stop) {
+            [weakSelf addRecord:record];
+        }];
+    }
+    return self;
+}
+
+- (void)appendData:(NSData *)data {
+    NSError *error;
+
+    if (!_error && ![_parser appendData:data error:&error])
+        _error = error;
+}
+
+- (void)finish {
+    NSError *error;
+
+    if (!_buffered && !_error && ![_parser finish:&error])
+        _error = error;
+
+    [self flush];
+}
+
+// hands the records of a buffered response over right away, being on the queue of the batches already
+- (void)deliverResponseObject:(id)responseObject {
+    NSArray *records = [responseObject isKindOfClass:[NSArray class]] ? responseObject : @[responseObject];
+
+    for (NSUInteger location = 0; location < [records count] && _recordsBlock; location += _batchSize) {
+        _recordsBlock([records subarrayWithRange:NSMakeRange(location, MIN(_batchSize, [records count] - location))]);
+    }
+}
+
+- (void)addRecord:(id)record {
+    [_batch addObject:record];
+
+    if ([_batch count] >= _batchSize)
+        [self flush];
+}
+
+// hands the pending records over, ahead of the completion of the task
+- (void)flush {
+    if ([_batch count] == 0)
+        return;
+
+    NSArray *batch = [_batch copy];
+    [_batch removeAllObjects];
+
+    if (_recordsBlock) {
+        void (^recordsBlock)(NSArray *) = _recordsBlock;
+
+        dispatch_async(_queue, ^{
+            recordsBlock(batch);
+        });
+    }
+}
+
+@end
+
+@implementation AGHttpClient {
+    // coalescing key -> AGInFlightRequest
+    NSMutableDictionary *_inFlightRequests;
+
+    // task identifier -> AGStreamedResponse
+    NSMutableDictionary *_streamedResponses;
+
+    // bumped to drop the retries waiting for their delay
+    NSUInteger _retryGeneration;
+}
 
 + (instancetype)clientFor:(NSURL *)url {
     return [[[self class] alloc] initWithBaseURL:url timeout:60 sessionConfiguration:nil authModule:nil authzModule:nil];
@@ -101,8 +463,8 @@
     serializer.authzModule = authzModule;
 
     self.requestSerializer = serializer;
-    // apply json response serializer
-    self.responseSerializer = [AFJSONResponseSerializer serializer];
+    // apply AG response serializer, parsing json unless a serializer is set
+    self.responseSerializer = [AGResponseSerializer serializer];
 
     // set the timeout interval
     self.requestSerializer.timeoutInterval = interval;
@@ -110,11 +472,205 @@
     // Accept HTTP Header; see http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.1
     [self.requestSerializer setValue:@"application/json" forHTTPHeaderField:@"Accept"];
 
+    _priority = AGRequestPriorityDefault;
+
+    _inFlightRequests = [[NSMutableDictionary alloc] init];
+    _streamedResponses = [[NSMutableDictionary alloc] init];
+
+    // streamed bodies (i.e. multipart uploads) are read from a copy of the request body
+    // stream, compressed on the fly if the request was marked so (see compressStreamedRequest:)
+    [self setTaskNeedNewBodyStreamBlock:^NSInputStream *(NSURLSession *session, NSURLSessionTask *task) {
+        NSURLRequest *originalRequest = task.originalRequest;
+
+        if (![originalRequest.HTTPBodyStream conformsToProtocol:@protocol(NSCopying)])
+            return nil;
+
+        NSInputStream *stream = [originalRequest.HTTPBodyStream copy];
+
+        if ([[originalRequest valueForHTTPHeaderField:@"Content-Encoding"] isEqualToString:@"gzip"])
+            return AGGzipStream(stream, task);
+
+        return stream;
+    }];
+
     return (self);
 }
 
+- (NSUInteger)requestCompressionThreshold {
+    return ((AGRequestSerializer *) self.requestSerializer).compressionThreshold;
+}
+
+- (void)setRequestCompressionThreshold:(NSUInteger)requestCompressionThreshold {
+    ((AGRequestSerializer *) self.requestSerializer).compressionThreshold = requestCompressionThreshold;
+}
+
+- (id<AGSerializer>)serializer {
+    return ((AGRequestSerializer *) self.requestSerializer).serializer;
+}
+
+- (void)setSerializer:(id<AGSerializer>)serializer {
+    ((AGRequestSerializer *) self.requestSerializer).serializer = serializer;
+    ((AGResponseSerializer *) self.responseSerializer).serializer = serializer;
+
+    // prefer the format of the serializer, falling back to json
+    NSString *accept = @"application/json";
+
+    if (serializer && ![serializer.contentType isEqualToString:accept])
+        accept = [NSString stringWithFormat:@"%@, application/json;q=0.5", serializer.contentType];
+
+    [self.requestSerializer setValue:accept forHTTPHeaderField:@"Accept"];
+}
+
 #pragma mark - AFHTTPSessionManager override
 
+// override to share a single request between the callers asking for the same resource at once
+- (NSURLSessionDataTask *)GET:(NSString *)URLString
+                   parameters:(NSDictionary *)parameters
+                      success:(void (^)(NSURLSessionDataTask *task, id responseObject))success
+                      failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure {
+
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"GET"
+                                                                   URLString:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString]
+                                                                  parameters:parameters error:nil];
+
+    NSString *key = [self coalescingKeyForRequest:request];
+    AGInFlightRequest *inFlightRequest;
+
+    // only transfer the response if it changed since it was cached
+    AGResponseCache *responseCache = self.responseCache;
+    NSString *cacheKey = responseCache ? [self cacheKeyForRequest:request] : nil;
+    NSURLRequest *unconditionalRequest = [request copy];
+
+    [[responseCache validatorsForKey:cacheKey] enumerateKeysAndObjectsUsingBlock:^(id name, id value, BOOL *stop) {
+        [request setValue:value forHTTPHeaderField:name];
+    }];
+
+    @synchronized(_inFlightRequests) {
+        inFlightRequest = _inFlightRequests[key];
+
+        // attach to the request under way
+        if (inFlightRequest) {
+            [inFlightRequest addSuccess:success failure:failure];
+            return inFlightRequest.task;
+        }
+
+        inFlightRequest = [[AGInFlightRequest alloc] init];
+        [inFlightRequest addSuccess:success failure:failure];
+
+        // the completion handler keeps the callbacks until the task completes
+        AGInFlightRequest *completedRequest = inFlightRequest;
+
+        AGTaskCompletionHandler completionHandler = ^(NSURLSessionDataTask *task, NSURLResponse *response, id responseObject, NSError *error) {
+            // callers arriving from now on issue a new request
+            @synchronized(_inFlightRequests) {
+                [_inFlightRequests removeObjectForKey:key];
+            }
+
+            // the task of the last attempt
+            completedRequest.task = task;
+
+            if (responseCache && [response isKindOfClass:[NSHTTPURLResponse class]]) {
+                NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *) response;
+
+                if (httpResponse.statusCode == 304) {
+                    // not modified, serve the cached response
+                    NSDictionary *headers;
+                    id cachedObject = [responseCache responseForKey:cacheKey headers:&headers];
+
+                    if (cachedObject) {
+                        responseObject = cachedObject;
+                        error = nil;
+
+                        objc_setAssociatedObject(completedRequest.task, AGCachedHeadersKey, headers, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+                    }
+                } else if (!error) {
+                    [responseCache cacheResponse:responseObject headers:[httpResponse allHeaderFields] forKey:cacheKey];
+                }
+            }
+
+            // the (immutable) parsed response is shared between the callers
+            if (error) {
+                for (void (^failureBlock)(NSURLSessionDataTask *, NSError *) in completedRequest.failureBlocks)
+                    failureBlock(completedRequest.task, error);
+            } else {
+                for (void (^successBlock)(NSURLSessionDataTask *, id) in completedRequest.successBlocks)
+                    successBlock(completedRequest.task, responseObject);
+            }
+        };
+
+        inFlightRequest.task = [self resumeTaskForRequest:request factory:^NSURLSessionDataTask *(void (^completionHandler)(NSURLResponse *, id, NSError *)) {
+            return [self dataTaskWithRequest:request completionHandler:completionHandler];
+        } completionHandler:^(NSURLSessionDataTask *task, NSURLResponse *response, id responseObject, NSError *error) {
+            // the cached response is gone (e.g. evicted) since the request went out, ask for the whole response
+            if (responseCache && [(NSHTTPURLResponse *) response statusCode] == 304 && ![responseCache responseForKey:cacheKey headers:NULL]) {
+                completedRequest.task = [self resumeTaskForRequest:unconditionalRequest factory:^NSURLSessionDataTask *(void (^completionHandler)(NSURLResponse *, id, NSError *)) {
+                    return [self dataTaskWithRequest:unconditionalRequest completionHandler:completionHandler];
+                } completionHandler:completionHandler];
+                return;
+            }
+
+            completionHandler(task, response, responseObject, error);
+        }];
+
+        // no task if the request failed fast (see AGCircuitBreaker)
+        if (inFlightRequest.task)
+            _inFlightRequests[key] = inFlightRequest;
+    }
+
+    return inFlightRequest.task;
+}
+
+- (NSURLSessionDataTask *)GET:(NSString *)URLString
+                   parameters:(NSDictionary *)parameters
+                    batchSize:(NSUInteger)batchSize
+                      records:(void (^)(NSArray *records))records
+                      success:(void (^)(NSURLSessionDataTask *task))success
+                      failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure {
+
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"GET"
+                                                                   URLString:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString]
+                                                                  parameters:parameters error:nil];
+
+    // the batches are delivered on the queue of the completion handler, hence before it runs
+    AGStreamedResponse *streamedResponse = [[AGStreamedResponse alloc] initWithBatchSize:batchSize
+                                                                                   queue:self.completionQueue ?: dispatch_get_main_queue()
+                                                                                 records:records];
+    __block NSURLSessionDataTask *task;
+
+    task = [self dataTaskWithRequest:request completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        NSInteger statusCode = [(NSHTTPURLResponse *) response statusCode];
+
+        // the (empty) buffered body may fail the response serializer, not the request itself
+        if (statusCode >= 200 && statusCode < 300 && [error.domain isEqualToString:AFNetworkingErrorDomain])
+            error = nil;
+
+        if (!error)
+            error = streamedResponse.error;
+
+        // a response in the format of the serializer is parsed once complete
+        if (!error && streamedResponse.buffered && responseObject)
+            [streamedResponse deliverResponseObject:responseObject];
+
+        if (error) {
+            if (failure) {
+                failure(task, error);
+            }
+        } else {
+            if (success) {
+                success(task);
+            }
+        }
+    }];
+
+    @synchronized(_streamedResponses) {
+        _streamedResponses[@(task.taskIdentifier)] = streamedResponse;
+    }
+
+    [self resumeTask:task];
+
+    return task;
+}
+
 // override to construct a multipart request if required by the params passed in
 - (NSURLSessionDataTask *)POST:(NSString *)URLString
                     parameters:(NSDictionary *)parameters
@@ -134,17 +690,85 @@
     return [self processRequestWithMethod:@"PUT" URLString:URLString parameters:parameters success:success failure:failure];
 }
 
+// override to apply the retry policy
+- (NSURLSessionDataTask *)PATCH:(NSString *)URLString
+                     parameters:(NSDictionary *)parameters
+                        success:(void (^)(NSURLSessionDataTask *task, id responseObject))success
+                        failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure {
+
+    return [self processRequestWithMethod:@"PATCH" URLString:URLString parameters:parameters success:success failure:failure];
+}
+
+// override to apply the retry policy
+- (NSURLSessionDataTask *)DELETE:(NSString *)URLString
+                      parameters:(NSDictionary *)parameters
+                         success:(void (^)(NSURLSessionDataTask *task, id responseObject))success
+                         failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure {
+
+    return [self processRequestWithMethod:@"DELETE" URLString:URLString parameters:parameters success:success failure:failure];
+}
+
+- (void)cancelPendingRetries {
+    @synchronized(self) {
+        _retryGeneration++;
+    }
+}
+
+#pragma mark - NSURLSessionDataDelegate override
+
+// the responses of streamed requests are parsed as they are received, instead of being buffered
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    AGStreamedResponse *streamedResponse = [self streamedResponseForTask:dataTask remove:NO];
+    NSInteger statusCode = [(NSHTTPURLResponse *) dataTask.response statusCode];
+
+    // responses in the format of the serializer are buffered
+    if ([(AGResponseSerializer *) self.responseSerializer canParseResponse:dataTask.response])
+        streamedResponse.buffered = YES;
+
+    // error responses are buffered, for the failure block
+    if (streamedResponse && !streamedResponse.buffered && statusCode >= 200 && statusCode < 300) {
+        [streamedResponse appendData:data];
+        return;
+    }
+
+    [super URLSession:session dataTask:dataTask didReceiveData:data];
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    // let the next request go
+    [self.scheduler taskDidComplete:task];
+
+    AGStreamedResponse *streamedResponse = [self streamedResponseForTask:task remove:YES];
+
+    // deliver the last records, ahead of the completion handler
+    if (!error)
+        [streamedResponse finish];
+
+    [super URLSession:session task:task didCompleteWithError:error];
+}
+
 #pragma mark - utility methods
 
+- (AGStreamedResponse *)streamedResponseForTask:(NSURLSessionTask *)task remove:(BOOL)remove {
+    @synchronized(_streamedResponses) {
+        AGStreamedResponse *streamedResponse = _streamedResponses[@(task.taskIdentifier)];
+
+        if (remove)
+            [_streamedResponses removeObjectForKey:@(task.taskIdentifier)];
+
+        return streamedResponse;
+    }
+}
+
 - (NSURLSessionDataTask *)processRequestWithMethod:(NSString *)method
                                          URLString:(NSString *)URLString
                                         parameters:(NSDictionary *)parameters
                                            success:(void (^)(NSURLSessionDataTask *task, id responseObject))success
                                            failure:(void (^)(NSURLSessionDataTask *task, NSError *error))failure {
-    __block NSURLSessionDataTask *task;
+    NSMutableURLRequest *request;
 
     // let's define up-front the completion callback since it's common
-    id completionCallback = ^(NSURLResponse * __unused response, id responseObject, NSError *error) {
+    AGTaskCompletionHandler completionCallback = ^(NSURLSessionDataTask *task, NSURLResponse * __unused response, id responseObject, NSError *error) {
         if (error) {
             if (failure) {
                 failure(task, error);
@@ -159,9 +783,9 @@
     if ([self hasMultipartData:parameters]) {
         NSError *error = nil;
 
-        NSMutableURLRequest *request = [self multipartFormRequestWithMethod:method
-                                                                       path:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString]
-                                                                 parameters:parameters error:&error];
+        request = [self multipartFormRequestWithMethod:method
+                                                  path:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString]
+                                            parameters:parameters error:&error];
 
         // if there was an error during multipart processing
         // or in the construction of request
@@ -170,22 +794,158 @@
             return nil;
         }
 
-        task = [self uploadTaskWithStreamedRequest:request progress:nil completionHandler:completionCallback];
+        [self compressStreamedRequest:request];
+
+        // each attempt reads the body from a copy of the stream (see setTaskNeedNewBodyStreamBlock:)
+        return [self resumeTaskForRequest:request factory:^NSURLSessionDataTask *(void (^completionHandler)(NSURLResponse *, id, NSError *)) {
+            return [self uploadTaskWithStreamedRequest:request progress:nil completionHandler:completionHandler];
+        } completionHandler:completionCallback];
+    }
+
+    NSError *error = nil;
+
+    request = [self.requestSerializer requestWithMethod:method
+                                              URLString:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString]
+                                             parameters:parameters error:&error];
+
+    // the parameters can't be serialized
+    if (!request) {
+        if (failure) {
+            failure(nil, error);
+        }
+        return nil;
+    }
+
+    return [self resumeTaskForRequest:request factory:^NSURLSessionDataTask *(void (^completionHandler)(NSURLResponse *, id, NSError *)) {
+        return [self dataTaskWithRequest:request completionHandler:completionHandler];
+    } completionHandler:completionCallback];
+}
+
+// sends a request, sending it again as long as the retry policy allows
+- (NSURLSessionDataTask *)resumeTaskForRequest:(NSURLRequest *)request
+                                       factory:(AGTaskFactory)factory
+                             completionHandler:(AGTaskCompletionHandler)completionHandler {
 
-    } else {
+    AGRetryPolicy *retryPolicy = self.retryPolicy;
+    NSDate *deadline = retryPolicy.deadline > 0 ? [NSDate dateWithTimeIntervalSinceNow:retryPolicy.deadline] : nil;
 
-        NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:method
-                                                                       URLString:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString]
-                                                                      parameters:parameters error:nil];
+    NSUInteger generation;
 
-        task = [self dataTaskWithRequest:request completionHandler:completionCallback];
+    @synchronized(self) {
+        generation = _retryGeneration;
     }
 
-    [task resume];
+    return [self resumeRetry:0 ofRequest:request retryPolicy:retryPolicy deadline:deadline generation:generation
+                     factory:factory completionHandler:completionHandler];
+}
+
+- (NSURLSessionDataTask *)resumeRetry:(NSUInteger)retry
+                            ofRequest:(NSURLRequest *)request
+                          retryPolicy:(AGRetryPolicy *)retryPolicy
+                             deadline:(NSDate *)deadline
+                           generation:(NSUInteger)generation
+                              factory:(AGTaskFactory)factory
+                    completionHandler:(AGTaskCompletionHandler)completionHandler {
+
+    dispatch_queue_t queue = self.completionQueue ?: dispatch_get_main_queue();
+
+    AGCircuitBreaker *circuitBreaker = nil;
+
+    if (retryPolicy.circuitBreakerThreshold > 0) {
+        circuitBreaker = [AGCircuitBreaker breakerForHost:request.URL.host
+                                         failureThreshold:retryPolicy.circuitBreakerThreshold
+                                             resetTimeout:retryPolicy.circuitBreakerResetTimeout];
+    }
+
+    // fail fast, the host keeps failing
+    if (circuitBreaker && ![circuitBreaker allowRequest]) {
+        NSError *error = [NSError errorWithDomain:AGCircuitBreakerErrorDomain
+                                             code:0
+                                         userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"too many failures of %@, request not sent", request.URL.host],
+                                                    NSURLErrorFailingURLErrorKey: request.URL}];
+        dispatch_async(queue, ^{
+            completionHandler(nil, nil, nil, error);
+        });
+
+        return nil;
+    }
+
+    __block NSURLSessionDataTask *task;
+
+    task = factory(^(NSURLResponse *response, id responseObject, NSError *error) {
+        NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? [(NSHTTPURLResponse *) response statusCode] : 0;
+        BOOL cancelled = [error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled;
+
+        // cancelled because its body couldn't be read, which isn't the host's fault
+        NSError *bodyStreamError = cancelled ? objc_getAssociatedObject(task, AGBodyStreamErrorKey) : nil;
+
+        if (bodyStreamError)
+            error = bodyStreamError;
+
+        if (!cancelled) {
+            // transport errors and server errors count against the host
+            if (error && (statusCode == 0 || statusCode >= 500))
+                [circuitBreaker recordFailure];
+            else
+                [circuitBreaker recordSuccess];
+        }
+
+        if (error && !cancelled && retry < retryPolicy.maxRetries
+                && [retryPolicy shouldRetryRequest:request response:response error:error]) {
+
+            NSTimeInterval delay = [retryPolicy delayForRetry:retry + 1 response:response];
+
+            if (!deadline || [deadline timeIntervalSinceNow] > delay) {
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (delay * NSEC_PER_SEC)), queue, ^{
+                    BOOL retryCancelled;
+
+                    @synchronized(self) {
+                        retryCancelled = (generation != _retryGeneration);
+                    }
+
+                    if (retryCancelled) {
+                        completionHandler(task, response, nil, [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]);
+                        return;
+                    }
+
+                    [self resumeRetry:retry + 1 ofRequest:request retryPolicy:retryPolicy deadline:deadline generation:generation
+                              factory:factory completionHandler:completionHandler];
+                });
+
+                return;
+            }
+        }
+
+        completionHandler(task, response, responseObject, error);
+    });
+
+    [self resumeTask:task];
 
     return task;
 }
 
+// starts a task, when the scheduler (if any) lets it
+- (void)resumeTask:(NSURLSessionTask *)task {
+    AGRequestScheduler *scheduler = self.scheduler;
+
+    if (scheduler)
+        [scheduler scheduleTask:task priority:self.priority owner:self];
+    else
+        [task resume];
+}
+
+// marks a large streamed request to be compressed as it is sent, its compressed length is unknown
+- (void)compressStreamedRequest:(NSMutableURLRequest *)request {
+    NSUInteger threshold = self.requestCompressionThreshold;
+    long long length = [[request valueForHTTPHeaderField:@"Content-Length"] longLongValue];
+
+    if (threshold == 0 || length < (long long) threshold)
+        return;
+
+    [request setValue:nil forHTTPHeaderField:@"Content-Length"];
+    [request setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+}
+
 // construct a multi-part request
 - (NSMutableURLRequest *)multipartFormRequestWithMethod:(NSString *)method
                                                    path:(NSString *)path
@@ -258,10 +1018,46 @@
     return req;
 }
 
+- (NSDictionary *)responseHeadersForTask:(NSURLSessionTask *)task {
+    NSDictionary *cachedHeaders = objc_getAssociatedObject(task, AGCachedHeadersKey);
+
+    if (cachedHeaders)
+        return cachedHeaders;
+
+    return [(NSHTTPURLResponse *) [task response] allHeaderFields];
+}
+
+// requests to the same URL, with the same headers (incl. the auth/authz tokens), get the same response
+- (NSString *)coalescingKeyForRequest:(NSURLRequest *)request {
+    return [self keyForRequest:request excludingHeaders:nil];
+}
+
+// the credentials stay out of the keys of the cache, which may be saved to a store
+- (NSString *)cacheKeyForRequest:(NSURLRequest *)request {
+    return [self keyForRequest:request excludingHeaders:[(AGRequestSerializer *) self.requestSerializer credentialHeaders]];
+}
+
+- (NSString *)keyForRequest:(NSURLRequest *)request excludingHeaders:(NSSet *)excludedHeaders {
+    NSMutableString *key = [NSMutableString stringWithFormat:@"%@ %@", request.HTTPMethod, [request.URL absoluteString]];
+
+    NSDictionary *headers = [request allHTTPHeaderFields];
+
+    for (NSString *name in [[headers allKeys] sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)]) {
+        if (![excludedHeaders containsObject:[name lowercaseString]])
+            [key appendFormat:@"\n%@: %@", [name lowercaseString], headers[name]];
+    }
+
+    return key;
+}
+
 // check if any file objects(if any) are embedded in the params
 - (BOOL)hasMultipartData:(NSDictionary *)parameters {
     __block BOOL hasMultipart = NO;
 
+    // e.g. the JSON array of a bulk save
+    if (![parameters isKindOfClass:[NSDictionary class]])
+        return NO;
+
     [[parameters allValues] enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
         if ([obj conformsToProtocol:@protocol(AGMultipart)] ||
                 [obj isKindOfClass:[NSURL class]]) { // TODO: deprecated
@@ -0,0 +1,92 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The priority classes of the requests.
+ */
+typedef NS_ENUM(NSInteger, AGRequestPriority) {
+    AGRequestPriorityBackground,        // bulk traffic, e.g. a background sync
+    AGRequestPriorityDefault,
+    AGRequestPriorityUserInteractive    // requests the user is waiting for
+};
+
+/**
+ Decides when the requests of several pipes go out, so that bulk traffic doesn't delay the requests
+ the user is waiting for. An AGPipeline shares its scheduler between all of its pipes.
+
+ Requests are queued by priority class, and started as long as fewer than maxConcurrentRequests
+ (in total) and maxConcurrentRequestsPerHost (to their host) are running. Queued requests of a higher
+ class always start first; within a class, the pipes take turns (fair queueing), each pipe's requests
+ starting in the order they were issued.
+
+    AGPipeline *pipeline = [AGPipeline pipelineWithBaseURL:baseURL];
+    pipeline.scheduler.maxConcurrentRequests = 4;
+
+    id<AGPipe> sync = [pipeline pipe:^(id<AGPipeConfig> config) {
+        [config setName:@"projects"];
+        [config setPriority:AGRequestPriorityBackground];
+    }];
+ */
+@interface AGRequestScheduler : NSObject
+
+/**
+ * Creates a scheduler with the default limits.
+ *
+ * @return the newly created AGRequestScheduler object.
+ */
++ (instancetype)scheduler;
+
+/**
+ * The maximum number of requests running at once, defaults to 8.
+ */
+@property (nonatomic, assign) NSUInteger maxConcurrentRequests;
+
+/**
+ * The maximum number of requests running at once to the same host, defaults to 4.
+ */
+@property (nonatomic, assign) NSUInteger maxConcurrentRequestsPerHost;
+
+/**
+ * The number of requests running.
+ */
+@property (nonatomic, readonly) NSUInteger runningCount;
+
+/**
+ * The number of requests waiting to start.
+ */
+@property (nonatomic, readonly) NSUInteger queuedCount;
+
+/**
+ * Resumes a (suspended) task as soon as the limits and the requests of higher priority allow.
+ *
+ * @param task The task of the request.
+ * @param priority The priority class of the request.
+ * @param owner The object issuing the request (i.e. the HTTP client of a pipe), that takes turns
+ * with the other owners of requests of the same priority.
+ */
+- (void)scheduleTask:(NSURLSessionTask *)task priority:(AGRequestPriority)priority owner:(id)owner;
+
+/**
+ * Releases the slot of a completed (or cancelled) task, starting the next request(s) if any.
+ *
+ * @param task The task that completed.
+ */
+- (void)taskDidComplete:(NSURLSessionTask *)task;
+
+@end
@@ -0,0 +1,223 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGRequestScheduler.h"
+
+// the number of priority classes
+static const NSUInteger kPriorityCount = AGRequestPriorityUserInteractive + 1;
+
+// the requests of an owner, in a priority class
+@interface AGScheduledQueue : NSObject
+
+    @property (nonatomic, readonly) id ownerKey;
+    @property (nonatomic, readonly) NSMutableArray *tasks;
+
+    // when the owner's last request started, in turns
+    @property (nonatomic, assign) NSUInteger lastTurn;
+
+@end
+
+@implementation AGScheduledQueue
+
+- (instancetype)initWithOwnerKey:(id)ownerKey {
+    self = [super init];
+    if (self) {
+        _ownerKey = ownerKey;
+        _tasks = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+@end
+
+@implementation AGRequestScheduler {
+    // per priority class, the queues of the owners
+    NSArray *_queues;
+    NSUInteger _turn;
+
+    NSMutableSet *_runningTasks;
+    // host -> number of running requests
+    NSCountedSet *_runningHosts;
+}
+
++ (instancetype)scheduler {
+    return [[[self class] alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        // default values:
+        _maxConcurrentRequests = 8;
+        _maxConcurrentRequestsPerHost = 4;
+
+        NSMutableArray *queues = [NSMutableArray array];
+
+        for (NSUInteger priority = 0; priority < kPriorityCount; priority++)
+            [queues addObject:[NSMutableArray array]];
+
+        _queues = [queues copy];
+
+        _runningTasks = [[NSMutableSet alloc] init];
+        _runningHosts = [[NSCountedSet alloc] init];
+    }
+    return self;
+}
+
+- (void)setMaxConcurrentRequests:(NSUInteger)maxConcurrentRequests {
+    @synchronized(self) {
+        _maxConcurrentRequests = maxConcurrentRequests;
+    }
+
+    [self startTasks];
+}
+
+- (void)setMaxConcurrentRequestsPerHost:(NSUInteger)maxConcurrentRequestsPerHost {
+    @synchronized(self) {
+        _maxConcurrentRequestsPerHost = maxConcurrentRequestsPerHost;
+    }
+
+    [self startTasks];
+}
+
+- (NSUInteger)runningCount {
+    @synchronized(self) {
+        return [_runningTasks count];
+    }
+}
+
+- (NSUInteger)queuedCount {
+    @synchronized(self) {
+        NSUInteger count = 0;
+
+        for (NSArray *queues in _queues) {
+            for (AGScheduledQueue *queue in queues)
+                count += [queue.tasks count];
+        }
+
+        return count;
+    }
+}
+
+- (void)scheduleTask:(NSURLSessionTask *)task priority:(AGRequestPriority)priority owner:(id)owner {
+    if (!task)
+        return;
+
+    NSMutableArray *queues = _queues[MIN((NSUInteger) MAX(priority, 0), kPriorityCount - 1)];
+    id ownerKey = [NSValue valueWithNonretainedObject:owner];
+
+    @synchronized(self) {
+        AGScheduledQueue *ownerQueue = nil;
+
+        for (AGScheduledQueue *queue in queues) {
+            if ([queue.ownerKey isEqual:ownerKey]) {
+                ownerQueue = queue;
+                break;
+            }
+        }
+
+        // a newcomer takes its turn before the owners served already
+        if (!ownerQueue) {
+            ownerQueue = [[AGScheduledQueue alloc] initWithOwnerKey:ownerKey];
+            [queues addObject:ownerQueue];
+        }
+
+        [ownerQueue.tasks addObject:task];
+    }
+
+    [self startTasks];
+}
+
+- (void)taskDidComplete:(NSURLSessionTask *)task {
+    @synchronized(self) {
+        if ([_runningTasks containsObject:task]) {
+            [_runningTasks removeObject:task];
+            [_runningHosts removeObject:[self hostOfTask:task]];
+        } else {
+            // cancelled before it started
+            [self removeQueuedTask:task];
+        }
+    }
+
+    [self startTasks];
+}
+
+#pragma mark - private helper methods
+
+// starts the queued tasks the limits allow, in order
+- (void)startTasks {
+    NSMutableArray *tasks = [NSMutableArray array];
+
+    @synchronized(self) {
+        NSURLSessionTask *task;
+
+        while ([_runningTasks count] < _maxConcurrentRequests && (task = [self dequeueTask])) {
+            [_runningTasks addObject:task];
+            [_runningHosts addObject:[self hostOfTask:task]];
+
+            [tasks addObject:task];
+        }
+    }
+
+    for (NSURLSessionTask *task in tasks)
+        [task resume];
+}
+
+// the first task, by priority class then by turn, whose host is below its limit
+- (NSURLSessionTask *)dequeueTask {
+    for (NSInteger priority = kPriorityCount - 1; priority >= 0; priority--) {
+        NSMutableArray *queues = _queues[priority];
+
+        // the owner served the longest ago goes first
+        NSArray *turns = [queues sortedArrayUsingComparator:^NSComparisonResult(AGScheduledQueue *queue, AGScheduledQueue *other) {
+            return [@(queue.lastTurn) compare:@(other.lastTurn)];
+        }];
+
+        for (AGScheduledQueue *queue in turns) {
+            for (NSURLSessionTask *task in queue.tasks) {
+                if ([_runningHosts countForObject:[self hostOfTask:task]] >= _maxConcurrentRequestsPerHost)
+                    continue;
+
+                [queue.tasks removeObjectIdenticalTo:task];
+                queue.lastTurn = ++_turn;
+
+                // forget the owners with nothing queued, but the one just served
+                for (AGScheduledQueue *other in turns) {
+                    if (other != queue && [other.tasks count] == 0)
+                        [queues removeObjectIdenticalTo:other];
+                }
+
+                return task;
+            }
+        }
+    }
+
+    return nil;
+}
+
+- (void)removeQueuedTask:(NSURLSessionTask *)task {
+    for (NSMutableArray *queues in _queues) {
+        for (AGScheduledQueue *queue in queues)
+            [queue.tasks removeObjectIdenticalTo:task];
+    }
+}
+
+- (NSString *)hostOfTask:(NSURLSessionTask *)task {
+    return [task.originalRequest.URL.host lowercaseString] ?: @"";
+}
+
+@end
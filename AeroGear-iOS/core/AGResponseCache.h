@@ -0,0 +1,103 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "AGStore.h"
+
+/**
+ Keeps the parsed responses of GET requests along with their validators (ETag and Last-Modified
+ headers), so that AGHttpClient can send conditional requests and serve the kept response when
+ the server answers 304 (Not Modified), without transferring nor parsing the body again.
+
+ Responses are kept in memory, and optionally in an AGStore so that they outlive the application.
+ Responses without validators, or marked "Cache-Control: no-store", are not kept. Responses are kept under a
+ SHA-256 digest of their key, up to maxEntries of them.
+
+ ## Caching the responses of a pipe
+
+    AGResponseCache *cache = [AGResponseCache cacheWithStore:[dataManager store:^(id<AGStoreConfig> config) {
+        [config setName:@"responses"];
+        [config setType:@"PLIST"];
+    }]];
+
+    id<AGPipe> projects = [pipeline pipe:^(id<AGPipeConfig> config) {
+        [config setName:@"projects"];
+        [config setResponseCache:cache];
+    }];
+
+ *NOTE:* The store must accept string record ids under the "id" field, i.e. be a "MEMORY", "PLIST" or
+ "ENCRYPTED_PLIST" store with the default recordId. Use an encrypted store for sensitive responses.
+ */
+@interface AGResponseCache : NSObject
+
+/**
+ * Creates a cache that keeps the responses in memory.
+ *
+ * @return the newly created AGResponseCache object.
+ */
++ (instancetype)cache;
+
+/**
+ * Creates a cache that keeps the responses in memory and in the given store.
+ *
+ * @param store The store the responses are saved to, and read from on start.
+ *
+ * @return the newly created AGResponseCache object.
+ */
++ (instancetype)cacheWithStore:(id<AGStore>)store;
+
+- (instancetype)initWithStore:(id<AGStore>)store;
+
+/**
+ * The maximum number of responses kept, the least recently used ones are forgotten first. Defaults to 256.
+ */
+@property (nonatomic, assign) NSUInteger maxEntries;
+
+/**
+ * Returns the conditional request headers (If-None-Match, If-Modified-Since) to send for a request.
+ *
+ * @param key The key of the request, i.e. its URL and the headers it varies on.
+ *
+ * @return an NSDictionary of headers, or nil if no response is kept for the request.
+ */
+- (NSDictionary *)validatorsForKey:(NSString *)key;
+
+/**
+ * Returns the response kept for a request.
+ *
+ * @param key The key of the request.
+ * @param headers On return, the headers of the response kept.
+ *
+ * @return the parsed response, or nil if none is kept for the request.
+ */
+- (id)responseForKey:(NSString *)key headers:(NSDictionary **)headers;
+
+/**
+ * Keeps the response of a request if it has validators, otherwise forgets the one kept so far.
+ *
+ * @param responseObject The parsed response.
+ * @param headers The headers of the response.
+ * @param key The key of the request.
+ */
+- (void)cacheResponse:(id)responseObject headers:(NSDictionary *)headers forKey:(NSString *)key;
+
+/**
+ * Forgets all the responses, e.g. when the user logs out.
+ */
+- (void)removeAllResponses;
+
+@end
@@ -0,0 +1,227 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGResponseCache.h"
+#import <CommonCrypto/CommonDigest.h>
+
+// the fields of the records saved to the store
+static NSString *const kIdField = @"id";
+static NSString *const kResponseField = @"response";
+static NSString *const kHeadersField = @"headers";
+
+// the default maximum number of responses kept
+static const NSUInteger kDefaultMaxEntries = 256;
+
+@implementation AGResponseCache {
+    id<AGStore> _store;
+    
+    // id -> record, the records read or cached so far
+    NSMutableDictionary *_entries;
+
+    // the ids of the responses kept (in memory or in the store), least recently used first
+    NSMutableArray *_usage;
+}
+
+@synthesize maxEntries = _maxEntries;
+
++ (instancetype)cache {
+    return [[[self class] alloc] initWithStore:nil];
+}
+
++ (instancetype)cacheWithStore:(id<AGStore>)store {
+    return [[[self class] alloc] initWithStore:store];
+}
+
+- (instancetype)init {
+    return [self initWithStore:nil];
+}
+
+- (instancetype)initWithStore:(id<AGStore>)store {
+    self = [super init];
+    if (self) {
+        _store = store;
+        _entries = [[NSMutableDictionary alloc] init];
+        _usage = [[NSMutableArray alloc] init];
+        _maxEntries = kDefaultMaxEntries;
+
+        for (NSDictionary *record in [_store readAll]) {
+            NSString *identifier = record[kIdField];
+
+            // records of earlier versions, keyed by the request itself (incl. its credentials)
+            if ([identifier length] != CC_SHA256_DIGEST_LENGTH * 2) {
+                [_store remove:record error:nil];
+                continue;
+            }
+
+            [_usage addObject:identifier];
+        }
+
+        [self evict];
+    }
+    
+    return self;
+}
+
+- (void)setMaxEntries:(NSUInteger)maxEntries {
+    @synchronized(self) {
+        _maxEntries = maxEntries;
+        [self evict];
+    }
+}
+
+- (NSDictionary *)validatorsForKey:(NSString *)key {
+    NSDictionary *headers = [self entryForKey:key][kHeadersField];
+    
+    if (!headers)
+        return nil;
+    
+    NSMutableDictionary *validators = [NSMutableDictionary dictionary];
+    
+    NSString *etag = [self valueOfHeader:@"ETag" in:headers];
+    NSString *lastModified = [self valueOfHeader:@"Last-Modified" in:headers];
+    
+    if (etag)
+        validators[@"If-None-Match"] = etag;
+    
+    if (lastModified)
+        validators[@"If-Modified-Since"] = lastModified;
+    
+    return [validators count] > 0 ? validators : nil;
+}
+
+- (id)responseForKey:(NSString *)key headers:(NSDictionary **)headers {
+    NSDictionary *entry = [self entryForKey:key];
+    
+    if (headers)
+        *headers = entry[kHeadersField];
+    
+    return entry[kResponseField];
+}
+
+- (void)cacheResponse:(id)responseObject headers:(NSDictionary *)headers forKey:(NSString *)key {
+    if (!key)
+        return;
+
+    BOOL cacheable = responseObject
+            && ([self valueOfHeader:@"ETag" in:headers] || [self valueOfHeader:@"Last-Modified" in:headers])
+            && [[self valueOfHeader:@"Cache-Control" in:headers] rangeOfString:@"no-store" options:NSCaseInsensitiveSearch].location == NSNotFound;
+
+    NSString *identifier = [self identifierForKey:key];
+    
+    @synchronized(self) {
+        if (!cacheable) {
+            if ([_usage containsObject:identifier])
+                [self removeEntry:identifier];
+
+            return;
+        }
+        
+        NSMutableDictionary *entry = [@{kIdField: identifier, kResponseField: responseObject, kHeadersField: headers} mutableCopy];
+        
+        _entries[identifier] = entry;
+
+        [_usage removeObject:identifier];
+        [_usage addObject:identifier];
+        
+        // responses that can't be saved (e.g. holding nulls) are kept in memory only
+        [_store save:entry error:nil];
+
+        [self evict];
+    }
+}
+
+- (void)removeAllResponses {
+    @synchronized(self) {
+        [_entries removeAllObjects];
+        [_usage removeAllObjects];
+        [_store reset:nil];
+    }
+}
+
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
+- (NSDictionary *)entryForKey:(NSString *)key {
+    if (!key)
+        return nil;
+
+    NSString *identifier = [self identifierForKey:key];
+
+    @synchronized(self) {
+        if (![_usage containsObject:identifier])
+            return nil;
+
+        NSDictionary *entry = _entries[identifier];
+        
+        // read back from the store on first use
+        if (!entry && _store) {
+            entry = [_store read:identifier];
+            
+            if (entry)
+                _entries[identifier] = entry;
+        }
+
+        // most recently used
+        [_usage removeObject:identifier];
+
+        if (entry)
+            [_usage addObject:identifier];
+        
+        return entry;
+    }
+}
+
+// forgets the least recently used responses over the limit
+- (void)evict {
+    while ([_usage count] > _maxEntries) {
+        [self removeEntry:_usage[0]];
+    }
+}
+
+- (void)removeEntry:(NSString *)identifier {
+    [_usage removeObject:identifier];
+    [_entries removeObjectForKey:identifier];
+    [_store remove:@{kIdField: identifier} error:nil];
+}
+
+// the keys hold the URLs of the requests, only their digests are saved
+- (NSString *)identifierForKey:(NSString *)key {
+    NSData *data = [key dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+
+    CC_SHA256([data bytes], (CC_LONG) [data length], digest);
+
+    NSMutableString *identifier = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+
+    for (NSUInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++)
+        [identifier appendFormat:@"%02x", digest[i]];
+
+    return identifier;
+}
+
+// header names are case-insensitive
+- (NSString *)valueOfHeader:(NSString *)name in:(NSDictionary *)headers {
+    for (NSString *header in headers) {
+        if ([header caseInsensitiveCompare:name] == NSOrderedSame)
+            return headers[header];
+    }
+    
+    return nil;
+}
+
+@end
@@ -0,0 +1,120 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ Decides whether, and when, a failed request of a pipe is sent again.
+
+ Requests failing with a transient transport error (e.g. a timeout or a dropped connection) or a
+ retryable status code (e.g. 503) are retried up to maxRetries times. The delay before each attempt
+ grows exponentially from baseDelay up to maxDelay, and is randomized ("full jitter") so that the
+ clients of a struggling server don't retry all at once. A Retry-After header of the response takes
+ precedence over the computed delay, up to maxDelay.
+
+ Only idempotent requests (GET, HEAD, PUT, DELETE, OPTIONS) are retried by default. A POST or PATCH
+ is retried only if it carries an "Idempotency-Key" header, or if retryNonIdempotentRequests is set.
+
+ Consecutive failures of the requests to a host also trip the circuit breaker of that host, shared
+ by the policies with the same circuit breaker settings, see AGCircuitBreaker: while it is open, requests fail fast, without reaching the server.
+
+    AGRetryPolicy *policy = [AGRetryPolicy policy];
+    policy.maxRetries = 5;
+    policy.deadline = 30;
+
+    id<AGPipe> projects = [pipeline pipe:^(id<AGPipeConfig> config) {
+        [config setName:@"projects"];
+        [config setRetryPolicy:policy];
+    }];
+ */
+@interface AGRetryPolicy : NSObject
+
+/**
+ * Creates a policy with the default settings.
+ *
+ * @return the newly created AGRetryPolicy object.
+ */
++ (instancetype)policy;
+
+/**
+ * The maximum number of retries of a request, defaults to 3.
+ */
+@property (nonatomic, assign) NSUInteger maxRetries;
+
+/**
+ * The upper bound of the delay before the first retry, doubled for each subsequent one.
+ * Defaults to 0.5 seconds.
+ */
+@property (nonatomic, assign) NSTimeInterval baseDelay;
+
+/**
+ * The maximum delay between two attempts, Retry-After headers included, defaults to 30 seconds.
+ */
+@property (nonatomic, assign) NSTimeInterval maxDelay;
+
+/**
+ * The time, from the first attempt, after which a request is no longer retried. Defaults to 0,
+ * i.e. only maxRetries bounds the retries.
+ */
+@property (nonatomic, assign) NSTimeInterval deadline;
+
+/**
+ * Whether POST and PATCH requests without an "Idempotency-Key" header are retried, defaults to NO.
+ */
+@property (nonatomic, assign) BOOL retryNonIdempotentRequests;
+
+/**
+ * The HTTP status codes that are retried, defaults to 408, 429, 500, 502, 503 and 504.
+ */
+@property (nonatomic, copy) NSIndexSet *retryableStatusCodes;
+
+/**
+ * The number of consecutive failures (transport errors and 5xx responses) of the requests to a host
+ * that opens its circuit breaker, defaults to 5. 0 disables the circuit breaker.
+ */
+@property (nonatomic, assign) NSUInteger circuitBreakerThreshold;
+
+/**
+ * How long the circuit breaker of a host stays open, before a trial request is let through.
+ * Defaults to 30 seconds.
+ */
+@property (nonatomic, assign) NSTimeInterval circuitBreakerResetTimeout;
+
+/**
+ * Returns whether a failed attempt of a request may be retried, regardless of the number of
+ * retries so far.
+ *
+ * @param request The request.
+ * @param response The response received, if any.
+ * @param error The error of the attempt.
+ *
+ * @return YES if the request can be retried, otherwise NO.
+ */
+- (BOOL)shouldRetryRequest:(NSURLRequest *)request response:(NSURLResponse *)response error:(NSError *)error;
+
+/**
+ * Returns the delay before a retry: the one asked by the Retry-After header of the response if any,
+ * otherwise a random delay within the exponential backoff bound of the retry, at most maxDelay.
+ *
+ * @param retry The number of the retry, starting at 1.
+ * @param response The response of the failed attempt, if any.
+ *
+ * @return the delay, in seconds.
+ */
+- (NSTimeInterval)delayForRetry:(NSUInteger)retry response:(NSURLResponse *)response;
+
+@end
@@ -0,0 +1,135 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGRetryPolicy.h"
+
+@implementation AGRetryPolicy
+
++ (instancetype)policy {
+    return [[[self class] alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        // default values:
+        _maxRetries = 3;
+        _baseDelay = 0.5;
+        _maxDelay = 30;
+
+        NSMutableIndexSet *statusCodes = [NSMutableIndexSet indexSet];
+        [statusCodes addIndex:408];
+        [statusCodes addIndex:429];
+        [statusCodes addIndex:500];
+        [statusCodes addIndexesInRange:NSMakeRange(502, 3)];
+        _retryableStatusCodes = [statusCodes copy];
+
+        _circuitBreakerThreshold = 5;
+        _circuitBreakerResetTimeout = 30;
+    }
+    return self;
+}
+
+- (BOOL)shouldRetryRequest:(NSURLRequest *)request response:(NSURLResponse *)response error:(NSError *)error {
+    if (![self isIdempotentRequest:request])
+        return NO;
+
+    NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? [(NSHTTPURLResponse *) response statusCode] : 0;
+
+    if (statusCode > 0)
+        return [self.retryableStatusCodes containsIndex:statusCode];
+
+    return [self isTransientError:error];
+}
+
+- (NSTimeInterval)delayForRetry:(NSUInteger)retry response:(NSURLResponse *)response {
+    NSTimeInterval retryAfter = [self retryAfterOfResponse:response];
+
+    // honoured, but never beyond the delay the application is ready to wait
+    if (retryAfter >= 0)
+        return MIN(retryAfter, self.maxDelay);
+
+    // full jitter: a random delay up to the (capped) exponential bound
+    NSTimeInterval bound = MIN(self.maxDelay, self.baseDelay * pow(2, MAX(retry, 1) - 1));
+
+    return bound * ((double) arc4random() / UINT32_MAX);
+}
+
+#pragma mark - private helper methods
+
+- (BOOL)isIdempotentRequest:(NSURLRequest *)request {
+    NSString *method = [request.HTTPMethod uppercaseString] ?: @"GET";
+
+    if ([@[@"GET", @"HEAD", @"PUT", @"DELETE", @"OPTIONS"] containsObject:method])
+        return YES;
+
+    return self.retryNonIdempotentRequests || [request valueForHTTPHeaderField:@"Idempotency-Key"] != nil;
+}
+
+- (BOOL)isTransientError:(NSError *)error {
+    if (![error.domain isEqualToString:NSURLErrorDomain])
+        return NO;
+
+    switch (error.code) {
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorNotConnectedToInternet:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+// the delay asked by the server, in seconds or as an HTTP date, or -1 if none
+- (NSTimeInterval)retryAfterOfResponse:(NSURLResponse *)response {
+    if (![response isKindOfClass:[NSHTTPURLResponse class]])
+        return -1;
+
+    NSString *retryAfter = nil;
+    NSDictionary *headers = [(NSHTTPURLResponse *) response allHeaderFields];
+
+    for (NSString *name in headers) {
+        if ([name caseInsensitiveCompare:@"Retry-After"] == NSOrderedSame)
+            retryAfter = [headers[name] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    }
+
+    if ([retryAfter length] == 0)
+        return -1;
+
+    NSScanner *scanner = [NSScanner scannerWithString:retryAfter];
+    NSInteger seconds;
+
+    if ([scanner scanInteger:&seconds] && [scanner isAtEnd])
+        return MAX(seconds, 0);
+
+    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+    formatter.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
+    formatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"GMT"];
+    formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
+
+    NSDate *date = [formatter dateFromString:retryAfter];
+
+    if (!date)
+        return -1;
+
+    return MAX([date timeIntervalSinceNow], 0);
+}
+
+@end
@@ -0,0 +1,81 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The error domain of the serializers.
+ */
+extern NSString * const AGSerializerErrorDomain;
+
+/**
+ * A protocol that the serializers of the request and response bodies must implement, e.g. to
+ * exchange a compact binary format with the server instead of JSON.
+ */
+@protocol AGSerializer <NSObject>
+
+/**
+ * The MIME type of the serialized bodies, sent in the Content-Type header of the requests.
+ */
+@property (nonatomic, readonly, copy) NSString *contentType;
+
+/**
+ * The MIME types of the responses the serializer can parse.
+ */
+@property (nonatomic, readonly, copy) NSSet *acceptableContentTypes;
+
+/**
+ * Serializes an object, made of NSDictionary, NSArray, NSString, NSNumber and NSNull objects.
+ *
+ * @param object The object to serialize.
+ * @param error On return, the error that occurred, if any.
+ *
+ * @return the serialized NSData, or nil if the object can't be serialized.
+ */
+- (NSData *)dataWithObject:(id)object error:(NSError **)error;
+
+/**
+ * Parses serialized data.
+ *
+ * @param data The data to parse.
+ * @param error On return, the error that occurred, if any.
+ *
+ * @return the (immutable) object parsed, or nil if the data is malformed.
+ */
+- (id)objectWithData:(NSData *)data error:(NSError **)error;
+
+@end
+
+/**
+ * The JSON serializer, the default of the pipes.
+ */
+@interface AGJsonSerializer : NSObject <AGSerializer>
+
++ (instancetype)serializer;
+
+@end
+
+/**
+ * A MessagePack (http://msgpack.org) serializer, with the "application/x-msgpack" content type.
+ * NSData objects are serialized as MessagePack binaries, and parsed back as NSData; extension
+ * types are not supported.
+ */
+@interface AGMessagePackSerializer : NSObject <AGSerializer>
+
++ (instancetype)serializer;
+
+@end
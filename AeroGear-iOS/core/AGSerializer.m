@@ -0,0 +1,439 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGSerializer.h"
+
+NSString * const AGSerializerErrorDomain = @"AGSerializerErrorDomain";
+
+// guards the parser against (malicious) deeply nested data
+static const NSUInteger kMaxNestingDepth = 512;
+
+static id AGSerializerFailure(NSString *description, NSError **error) {
+    if (error) {
+        *error = [NSError errorWithDomain:AGSerializerErrorDomain
+                                     code:0
+                                 userInfo:@{NSLocalizedDescriptionKey: description}];
+    }
+
+    return nil;
+}
+
+@implementation AGJsonSerializer
+
++ (instancetype)serializer {
+    return [[self alloc] init];
+}
+
+- (NSString *)contentType {
+    return @"application/json";
+}
+
+- (NSSet *)acceptableContentTypes {
+    return [NSSet setWithObjects:@"application/json", @"text/json", @"text/javascript", nil];
+}
+
+- (NSData *)dataWithObject:(id)object error:(NSError **)error {
+    // NSJSONSerialization raises on the objects it can't serialize
+    if (![NSJSONSerialization isValidJSONObject:object])
+        return AGSerializerFailure(@"object can't be serialized to JSON", error);
+
+    return [NSJSONSerialization dataWithJSONObject:object options:0 error:error];
+}
+
+- (id)objectWithData:(NSData *)data error:(NSError **)error {
+    return [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+}
+
+@end
+
+#pragma mark - MessagePack writing
+
+static void AGAppendByte(NSMutableData *data, uint8_t byte) {
+    [data appendBytes:&byte length:1];
+}
+
+static void AGAppendBigEndian(NSMutableData *data, uint64_t value, NSUInteger size) {
+    uint8_t bytes[8];
+
+    for (NSUInteger i = 0; i < size; i++)
+        bytes[i] = (uint8_t) (value >> (8 * (size - 1 - i)));
+
+    [data appendBytes:bytes length:size];
+}
+
+// the header of a string, binary, array or map, with its fix, 8, 16 and 32 bits variants (0 if none)
+static BOOL AGAppendHeader(NSMutableData *data, NSUInteger length,
+                           uint8_t fixCode, NSUInteger fixLimit, uint8_t code8, uint8_t code16, uint8_t code32) {
+    if (length < fixLimit) {
+        AGAppendByte(data, fixCode | (uint8_t) length);
+    } else if (code8 && length <= UINT8_MAX) {
+        AGAppendByte(data, code8);
+        AGAppendBigEndian(data, length, 1);
+    } else if (length <= UINT16_MAX) {
+        AGAppendByte(data, code16);
+        AGAppendBigEndian(data, length, 2);
+    } else if (length <= UINT32_MAX) {
+        AGAppendByte(data, code32);
+        AGAppendBigEndian(data, length, 4);
+    } else {
+        return NO;
+    }
+
+    return YES;
+}
+
+static void AGAppendUnsigned(NSMutableData *data, uint64_t value) {
+    if (value <= 0x7f) {
+        AGAppendByte(data, (uint8_t) value);
+    } else if (value <= UINT8_MAX) {
+        AGAppendByte(data, 0xcc);
+        AGAppendBigEndian(data, value, 1);
+    } else if (value <= UINT16_MAX) {
+        AGAppendByte(data, 0xcd);
+        AGAppendBigEndian(data, value, 2);
+    } else if (value <= UINT32_MAX) {
+        AGAppendByte(data, 0xce);
+        AGAppendBigEndian(data, value, 4);
+    } else {
+        AGAppendByte(data, 0xcf);
+        AGAppendBigEndian(data, value, 8);
+    }
+}
+
+static void AGAppendNumber(NSMutableData *data, NSNumber *number) {
+    if (CFGetTypeID((__bridge CFTypeRef) number) == CFBooleanGetTypeID()) {
+        AGAppendByte(data, [number boolValue] ? 0xc3 : 0xc2);
+        return;
+    }
+
+    const char *type = [number objCType];
+
+    if (type[0] == 'f') {
+        CFSwappedFloat32 value = CFConvertFloat32HostToSwapped([number floatValue]);
+        AGAppendByte(data, 0xca);
+        [data appendBytes:&value.v length:4];
+    } else if (type[0] == 'd') {
+        CFSwappedFloat64 value = CFConvertFloat64HostToSwapped([number doubleValue]);
+        AGAppendByte(data, 0xcb);
+        [data appendBytes:&value.v length:8];
+    } else if (type[0] == 'Q' || type[0] == 'L' || type[0] == 'I') {
+        AGAppendUnsigned(data, [number unsignedLongLongValue]);
+    } else {
+        long long value = [number longLongValue];
+
+        if (value >= 0) {
+            AGAppendUnsigned(data, (uint64_t) value);
+        } else if (value >= -32) {
+            AGAppendByte(data, (uint8_t) value);
+        } else if (value >= INT8_MIN) {
+            AGAppendByte(data, 0xd0);
+            AGAppendBigEndian(data, (uint64_t) value, 1);
+        } else if (value >= INT16_MIN) {
+            AGAppendByte(data, 0xd1);
+            AGAppendBigEndian(data, (uint64_t) value, 2);
+        } else if (value >= INT32_MIN) {
+            AGAppendByte(data, 0xd2);
+            AGAppendBigEndian(data, (uint64_t) value, 4);
+        } else {
+            AGAppendByte(data, 0xd3);
+            AGAppendBigEndian(data, (uint64_t) value, 8);
+        }
+    }
+}
+
+static BOOL AGAppendObject(NSMutableData *data, id object, NSError **error) {
+    if (object == [NSNull null]) {
+        AGAppendByte(data, 0xc0);
+    } else if ([object isKindOfClass:[NSNumber class]]) {
+        AGAppendNumber(data, object);
+    } else if ([object isKindOfClass:[NSString class]]) {
+        NSData *string = [object dataUsingEncoding:NSUTF8StringEncoding];
+
+        if (!AGAppendHeader(data, [string length], 0xa0, 32, 0xd9, 0xda, 0xdb)) {
+            AGSerializerFailure(@"string too long", error);
+            return NO;
+        }
+
+        [data appendData:string];
+    } else if ([object isKindOfClass:[NSData class]]) {
+        if (!AGAppendHeader(data, [object length], 0, 0, 0xc4, 0xc5, 0xc6)) {
+            AGSerializerFailure(@"binary too long", error);
+            return NO;
+        }
+
+        [data appendData:object];
+    } else if ([object isKindOfClass:[NSArray class]]) {
+        if (!AGAppendHeader(data, [object count], 0x90, 16, 0, 0xdc, 0xdd)) {
+            AGSerializerFailure(@"array too long", error);
+            return NO;
+        }
+
+        for (id value in object) {
+            if (!AGAppendObject(data, value, error))
+                return NO;
+        }
+    } else if ([object isKindOfClass:[NSDictionary class]]) {
+        if (!AGAppendHeader(data, [object count], 0x80, 16, 0, 0xde, 0xdf)) {
+            AGSerializerFailure(@"map too long", error);
+            return NO;
+        }
+
+        for (id key in object) {
+            if (!AGAppendObject(data, key, error) || !AGAppendObject(data, object[key], error))
+                return NO;
+        }
+    } else {
+        AGSerializerFailure([NSString stringWithFormat:@"%@ can't be serialized to MessagePack", [object class]], error);
+        return NO;
+    }
+
+    return YES;
+}
+
+#pragma mark - MessagePack parsing
+
+typedef struct {
+    const uint8_t *bytes;
+    NSUInteger length;
+    NSUInteger offset;
+} AGMessagePackReader;
+
+static BOOL AGReadBytes(AGMessagePackReader *reader, NSUInteger count, const uint8_t **bytes) {
+    if (reader->length - reader->offset < count)
+        return NO;
+
+    *bytes = reader->bytes + reader->offset;
+    reader->offset += count;
+
+    return YES;
+}
+
+static BOOL AGReadBigEndian(AGMessagePackReader *reader, NSUInteger size, uint64_t *value) {
+    const uint8_t *bytes;
+
+    if (!AGReadBytes(reader, size, &bytes))
+        return NO;
+
+    *value = 0;
+
+    for (NSUInteger i = 0; i < size; i++)
+        *value = (*value << 8) | bytes[i];
+
+    return YES;
+}
+
+static id AGReadObject(AGMessagePackReader *reader, NSUInteger depth, NSError **error);
+
+static id AGReadString(AGMessagePackReader *reader, uint64_t length, NSError **error) {
+    const uint8_t *bytes;
+
+    if (!AGReadBytes(reader, (NSUInteger) length, &bytes))
+        return AGSerializerFailure(@"unexpected end of data", error);
+
+    NSString *string = [[NSString alloc] initWithBytes:bytes length:(NSUInteger) length encoding:NSUTF8StringEncoding];
+
+    if (!string)
+        return AGSerializerFailure(@"malformed UTF-8 string", error);
+
+    return string;
+}
+
+static id AGReadBinary(AGMessagePackReader *reader, uint64_t length, NSError **error) {
+    const uint8_t *bytes;
+
+    if (!AGReadBytes(reader, (NSUInteger) length, &bytes))
+        return AGSerializerFailure(@"unexpected end of data", error);
+
+    return [NSData dataWithBytes:bytes length:(NSUInteger) length];
+}
+
+static id AGReadArray(AGMessagePackReader *reader, uint64_t count, NSUInteger depth, NSError **error) {
+    // each element takes a byte at least
+    if (count > reader->length - reader->offset)
+        return AGSerializerFailure(@"unexpected end of data", error);
+
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:(NSUInteger) count];
+
+    for (uint64_t i = 0; i < count; i++) {
+        id value = AGReadObject(reader, depth + 1, error);
+
+        if (!value)
+            return nil;
+
+        [array addObject:value];
+    }
+
+    return [array copy];
+}
+
+static id AGReadMap(AGMessagePackReader *reader, uint64_t count, NSUInteger depth, NSError **error) {
+    // each entry takes two bytes at least
+    if (count > (reader->length - reader->offset) / 2)
+        return AGSerializerFailure(@"unexpected end of data", error);
+
+    NSMutableDictionary *map = [NSMutableDictionary dictionaryWithCapacity:(NSUInteger) count];
+
+    for (uint64_t i = 0; i < count; i++) {
+        id key = AGReadObject(reader, depth + 1, error);
+        id value = key ? AGReadObject(reader, depth + 1, error) : nil;
+
+        if (!value)
+            return nil;
+
+        map[key] = value;
+    }
+
+    return [map copy];
+}
+
+static id AGReadObject(AGMessagePackReader *reader, NSUInteger depth, NSError **error) {
+    const uint8_t *bytes;
+    uint64_t value;
+
+    if (depth > kMaxNestingDepth)
+        return AGSerializerFailure(@"data nested too deeply", error);
+
+    if (!AGReadBytes(reader, 1, &bytes))
+        return AGSerializerFailure(@"unexpected end of data", error);
+
+    uint8_t code = bytes[0];
+
+    // the fix variants
+    if (code <= 0x7f)
+        return @((long long) code);
+    if (code >= 0xe0)
+        return @((long long) (int8_t) code);
+    if ((code & 0xf0) == 0x80)
+        return AGReadMap(reader, code & 0x0f, depth, error);
+    if ((code & 0xf0) == 0x90)
+        return AGReadArray(reader, code & 0x0f, depth, error);
+    if ((code & 0xe0) == 0xa0)
+        return AGReadString(reader, code & 0x1f, error);
+
+    switch (code) {
+        case 0xc0:
+            return [NSNull null];
+        case 0xc2:
+            return @NO;
+        case 0xc3:
+            return @YES;
+        case 0xca: {
+            CFSwappedFloat32 swapped;
+
+            if (!AGReadBytes(reader, 4, &bytes))
+                break;
+
+            memcpy(&swapped.v, bytes, 4);
+            return @(CFConvertFloat32SwappedToHost(swapped));
+        }
+        case 0xcb: {
+            CFSwappedFloat64 swapped;
+
+            if (!AGReadBytes(reader, 8, &bytes))
+                break;
+
+            memcpy(&swapped.v, bytes, 8);
+            return @(CFConvertFloat64SwappedToHost(swapped));
+        }
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            if (!AGReadBigEndian(reader, 1 << (code - 0xcc), &value))
+                break;
+
+            return value <= LLONG_MAX ? @((long long) value) : @((unsigned long long) value);
+        case 0xd0:
+            if (!AGReadBigEndian(reader, 1, &value))
+                break;
+
+            return @((long long) (int8_t) value);
+        case 0xd1:
+            if (!AGReadBigEndian(reader, 2, &value))
+                break;
+
+            return @((long long) (int16_t) value);
+        case 0xd2:
+            if (!AGReadBigEndian(reader, 4, &value))
+                break;
+
+            return @((long long) (int32_t) value);
+        case 0xd3:
+            if (!AGReadBigEndian(reader, 8, &value))
+                break;
+
+            return @((long long) value);
+        case 0xc4: case 0xc5: case 0xc6:
+            if (!AGReadBigEndian(reader, 1 << (code - 0xc4), &value))
+                break;
+
+            return AGReadBinary(reader, value, error);
+        case 0xd9: case 0xda: case 0xdb:
+            if (!AGReadBigEndian(reader, 1 << (code - 0xd9), &value))
+                break;
+
+            return AGReadString(reader, value, error);
+        case 0xdc: case 0xdd:
+            if (!AGReadBigEndian(reader, code == 0xdc ? 2 : 4, &value))
+                break;
+
+            return AGReadArray(reader, value, depth, error);
+        case 0xde: case 0xdf:
+            if (!AGReadBigEndian(reader, code == 0xde ? 2 : 4, &value))
+                break;
+
+            return AGReadMap(reader, value, depth, error);
+        default:
+            // 0xc1 (never used) and the extension types
+            return AGSerializerFailure([NSString stringWithFormat:@"unsupported MessagePack type 0x%02x", code], error);
+    }
+
+    return AGSerializerFailure(@"unexpected end of data", error);
+}
+
+@implementation AGMessagePackSerializer
+
++ (instancetype)serializer {
+    return [[self alloc] init];
+}
+
+- (NSString *)contentType {
+    return @"application/x-msgpack";
+}
+
+- (NSSet *)acceptableContentTypes {
+    return [NSSet setWithObjects:@"application/x-msgpack", @"application/msgpack", nil];
+}
+
+- (NSData *)dataWithObject:(id)object error:(NSError **)error {
+    NSMutableData *data = [NSMutableData data];
+
+    if (!AGAppendObject(data, object, error))
+        return nil;
+
+    return data;
+}
+
+- (id)objectWithData:(NSData *)data error:(NSError **)error {
+    AGMessagePackReader reader = {[data bytes], [data length], 0};
+
+    id object = AGReadObject(&reader, 0, error);
+
+    if (object && reader.offset < reader.length)
+        return AGSerializerFailure(@"unexpected data after the object", error);
+
+    return object;
+}
+
+@end
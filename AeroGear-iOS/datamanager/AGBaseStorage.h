@@ -37,4 +37,75 @@
  */
 + (NSString *)getOrSetIdForData:(NSMutableDictionary *)data withIdentifier:(NSString *)identifier;
 
+/**
+ * Utility method to (atomically) write a file through an NSOutputStream. The
+ * block writes to a temporary file, which replaces the given file only if the
+ * block succeeds.
+ *
+ * @param url The URL of the file to write.
+ * @param block The block that writes the contents to the (opened) stream.
+ * @param error An error object containing details of why the write failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
++ (BOOL)writeToURL:(NSURL *)url
+        usingBlock:(BOOL (^)(NSOutputStream *stream, NSError **error))block
+             error:(NSError **)error;
+
+/**
+ * Utility method to read a file through an NSInputStream.
+ *
+ * @param url The URL of the file to read.
+ * @param block The block that reads the contents from the (opened) stream.
+ * @param error An error object containing details of why the read failed.
+ *
+ * @return YES if the file doesn't exist or the block succeeds, otherwise NO.
+ */
++ (BOOL)readFromURL:(NSURL *)url
+         usingBlock:(BOOL (^)(NSInputStream *stream, NSError **error))block
+              error:(NSError **)error;
+
+/**
+ * Utility method to apply a block to every object of an array concurrently.
+ * The objects are split into chunks which are processed across the
+ * available cores; the order of the results matches the order of the
+ * objects.
+ *
+ * Processing stops as soon as the block returns nil for one of the objects.
+ *
+ * @param objects The objects to process.
+ * @param block The block to apply to each object. It must be safe to call
+ *        it from multiple threads at once.
+ *
+ * @return an NSArray with the results, or nil if the block failed for
+ *         one of the objects.
+ */
++ (NSArray *)concurrentlyMapObjects:(NSArray *)objects usingBlock:(id (^)(id object))block;
+
+/**
+ * Utility method like concurrentlyMapObjects:usingBlock:, but the block is
+ * applied once per chunk of objects, so that per-call costs can be amortized
+ * over the chunk.
+ *
+ * @param objects The objects to process.
+ * @param block The block to apply to each chunk. It must return as many results
+ *        as objects in the chunk, and it must be safe to call it from multiple
+ *        threads at once.
+ *
+ * @return an NSArray with the results, or nil if the block failed for
+ *         one of the chunks.
+ */
++ (NSArray *)concurrentlyMapBatchesOfObjects:(NSArray *)objects usingBlock:(NSArray *(^)(NSArray *batch))block;
+
+/**
+ * Utility method to get the record fields a predicate depends on, i.e. the first
+ * component of each of its key paths.
+ *
+ * @param predicate The predicate to inspect.
+ *
+ * @return an NSSet with the names of the fields, or nil if the predicate may depend
+ *         on other parts of the record (e.g. it evaluates SELF, a block or a subquery).
+ */
++ (NSSet *)fieldsOfPredicate:(NSPredicate *)predicate;
+
 @end
@@ -16,10 +16,68 @@
  */
 
 #import "AGBaseStorage.h"
+#import <libkern/OSAtomic.h>
 
 // error domain for stores
 NSString * const AGStoreErrorDomain = @"AGStoreErrorDomain";
 
+// the number of objects processed by each unit of concurrent work. Chunking
+// keeps the dispatch overhead low compared to the (short) per-record work.
+static const NSUInteger kAGConcurrentChunkSize = 64;
+
+// collects the fields the expression reads, returns NO if they can't be told
+static BOOL AGCollectExpressionFields(NSExpression *expression, NSMutableSet *fields) {
+    switch (expression.expressionType) {
+        case NSConstantValueExpressionType:
+        case NSVariableExpressionType:
+            return YES;
+
+        case NSKeyPathExpressionType:
+            [fields addObject:[[expression.keyPath componentsSeparatedByString:@"."] firstObject]];
+            return YES;
+
+        case NSAggregateExpressionType:
+            for (id element in expression.collection) {
+                if ([element isKindOfClass:[NSExpression class]] && !AGCollectExpressionFields(element, fields))
+                    return NO;
+            }
+            return YES;
+
+        case NSFunctionExpressionType:
+            if (!AGCollectExpressionFields(expression.operand, fields))
+                return NO;
+
+            for (NSExpression *argument in expression.arguments) {
+                if (!AGCollectExpressionFields(argument, fields))
+                    return NO;
+            }
+            return YES;
+
+        default:
+            return NO;
+    }
+}
+
+static BOOL AGCollectPredicateFields(NSPredicate *predicate, NSMutableSet *fields) {
+    if ([predicate isKindOfClass:[NSCompoundPredicate class]]) {
+        for (NSPredicate *subpredicate in [(NSCompoundPredicate *)predicate subpredicates]) {
+            if (!AGCollectPredicateFields(subpredicate, fields))
+                return NO;
+        }
+        return YES;
+    }
+
+    if ([predicate isKindOfClass:[NSComparisonPredicate class]]) {
+        NSComparisonPredicate *comparison = (NSComparisonPredicate *)predicate;
+
+        return AGCollectExpressionFields(comparison.leftExpression, fields)
+                && AGCollectExpressionFields(comparison.rightExpression, fields);
+    }
+
+    // TRUEPREDICATE, FALSEPREDICATE and block predicates
+    return NO;
+}
+
 @implementation AGBaseStorage
 
 + (NSURL *)storeURLWithName:(NSString *)filename {
@@ -52,4 +110,171 @@ NSString * const AGStoreErrorDomain = @"AGStoreErrorDomain";
     return recordId;
 }
 
++ (BOOL)writeToURL:(NSURL *)url
+        usingBlock:(BOOL (^)(NSOutputStream *stream, NSError **error))block
+             error:(NSError **)error {
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSURL *tempURL = [url URLByAppendingPathExtension:@"tmp"];
+
+    NSOutputStream *stream = [NSOutputStream outputStreamWithURL:tempURL append:NO];
+    [stream open];
+
+    NSError *writeError;
+    BOOL success = block(stream, &writeError);
+
+    [stream close];
+
+    if (success) {
+        if ([fileManager fileExistsAtPath:[url path]]) {
+            success = [fileManager replaceItemAtURL:url withItemAtURL:tempURL
+                                     backupItemName:nil options:0 resultingItemURL:nil error:&writeError];
+        } else {
+            success = [fileManager moveItemAtURL:tempURL toURL:url error:&writeError];
+        }
+    }
+
+    if (!success) {
+        [fileManager removeItemAtURL:tempURL error:nil];
+
+        // since the underlying error is low level, construct an
+        // error object to inform client
+        if (error) {
+            NSMutableDictionary *userInfo = [@{NSLocalizedDescriptionKey: @"an error occurred during save!"} mutableCopy];
+            if (writeError)
+                userInfo[NSUnderlyingErrorKey] = writeError;
+
+            *error = [NSError errorWithDomain:AGStoreErrorDomain code:0 userInfo:userInfo];
+        }
+    }
+
+    return success;
+}
+
++ (BOOL)readFromURL:(NSURL *)url
+         usingBlock:(BOOL (^)(NSInputStream *stream, NSError **error))block
+              error:(NSError **)error {
+
+    if (![[NSFileManager defaultManager] fileExistsAtPath:[url path]])
+        return YES;
+
+    NSInputStream *stream = [NSInputStream inputStreamWithURL:url];
+    [stream open];
+
+    BOOL success = block(stream, error);
+
+    [stream close];
+
+    return success;
+}
+
++ (NSArray *)concurrentlyMapObjects:(NSArray *)objects usingBlock:(id (^)(id object))block {
+    NSUInteger count = [objects count];
+
+    if (count == 0)
+        return @[];
+
+    // not worth to dispatch for a single chunk
+    if (count <= kAGConcurrentChunkSize) {
+        NSMutableArray *results = [NSMutableArray arrayWithCapacity:count];
+
+        for (id object in objects) {
+            id result = block(object);
+            // fail fast
+            if (!result)
+                return nil;
+
+            [results addObject:result];
+        }
+
+        return results;
+    }
+
+    // each result is written to its own slot, so no locking is required
+    __strong id *results = (__strong id *)calloc(count, sizeof(id));
+    __block volatile int32_t failed = 0;
+
+    size_t chunks = (count + kAGConcurrentChunkSize - 1) / kAGConcurrentChunkSize;
+
+    dispatch_apply(chunks, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t chunk) {
+        NSUInteger start = chunk * kAGConcurrentChunkSize;
+        NSUInteger end = MIN(start + kAGConcurrentChunkSize, count);
+
+        for (NSUInteger i = start; i < end && !failed; i++) {
+            @autoreleasepool {
+                id result = block(objects[i]);
+
+                if (!result) {
+                    OSAtomicCompareAndSwap32Barrier(0, 1, &failed);
+                    break;
+                }
+
+                results[i] = result;
+            }
+        }
+    });
+
+    NSArray *retval = failed ? nil : [NSArray arrayWithObjects:results count:count];
+
+    // release the results before freeing the buffer
+    for (NSUInteger i = 0; i < count; i++)
+        results[i] = nil;
+    free(results);
+
+    return retval;
+}
+
++ (NSArray *)concurrentlyMapBatchesOfObjects:(NSArray *)objects usingBlock:(NSArray *(^)(NSArray *batch))block {
+    NSUInteger count = [objects count];
+
+    if (count == 0)
+        return @[];
+
+    // not worth to dispatch for a single chunk
+    if (count <= kAGConcurrentChunkSize)
+        return block(objects);
+
+    size_t chunks = (count + kAGConcurrentChunkSize - 1) / kAGConcurrentChunkSize;
+
+    // each chunk's results are written to their own slot, so no locking is required
+    __strong NSArray **results = (__strong NSArray **)calloc(chunks, sizeof(NSArray *));
+    __block volatile int32_t failed = 0;
+
+    dispatch_apply(chunks, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t chunk) {
+        if (failed)
+            return;
+
+        @autoreleasepool {
+            NSUInteger start = chunk * kAGConcurrentChunkSize;
+            NSArray *batch = [objects subarrayWithRange:NSMakeRange(start, MIN(kAGConcurrentChunkSize, count - start))];
+
+            NSArray *result = block(batch);
+
+            if ([result count] != [batch count]) {
+                OSAtomicCompareAndSwap32Barrier(0, 1, &failed);
+                return;
+            }
+
+            results[chunk] = result;
+        }
+    });
+
+    NSMutableArray *retval = failed ? nil : [NSMutableArray arrayWithCapacity:count];
+
+    // release the results before freeing the buffer
+    for (size_t i = 0; i < chunks; i++) {
+        [retval addObjectsFromArray:results[i]];
+        results[i] = nil;
+    }
+    free(results);
+
+    return retval;
+}
+
++ (NSSet *)fieldsOfPredicate:(NSPredicate *)predicate {
+    NSMutableSet *fields = [NSMutableSet set];
+
+    return AGCollectPredicateFields(predicate, fields) ? fields : nil;
+}
+
 @end
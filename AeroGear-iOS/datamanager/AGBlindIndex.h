@@ -0,0 +1,93 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "AGEncryptionService.h"
+
+/**
+ Computes the blind index tokens of records and uses them to narrow down the records
+ matching a predicate, so that encrypted stores don't have to decrypt every record.
+
+ A token is a keyed hash of a field value (see AGEncryptionService blindIndex:), stored
+ next to the encrypted record. Equality predicates on indexed fields are answered by
+ comparing tokens; the candidate records must still be decrypted and matched against the
+ predicate, since other conditions (or an unlikely token collision) may exclude them.
+ */
+@interface AGBlindIndex : NSObject
+
+/**
+ * The indexed fields.
+ */
+@property (nonatomic, readonly) NSArray *fields;
+
+/**
+ * Creates a new blind index.
+ *
+ * @param encryptionService The encryption service used to compute the tokens.
+ * @param fields The names of the indexed fields. None are indexed if the encryption
+ *        service doesn't implement blindIndex:.
+ *
+ * @return the newly created AGBlindIndex object.
+ */
+- (instancetype)initWithEncryptionService:(id<AGEncryptionService>)encryptionService fields:(NSArray *)fields;
+
+/**
+ * Computes the tokens of the indexed fields of a record. Fields that are missing, or have
+ * a value that can't be indexed (only strings, numbers and dates can), get an empty token,
+ * which never matches a lookup but records that the field has been indexed.
+ *
+ * @param record The record.
+ *
+ * @return an NSDictionary with the token (NSData) of each indexed field.
+ */
+- (NSDictionary *)tokensForRecord:(NSDictionary *)record;
+
+/**
+ * Checks whether tokens (e.g. read back from a file) cover all the indexed fields.
+ * Records saved before a field was indexed must not be ruled out by a lookup.
+ *
+ * @param tokens The tokens of a record.
+ *
+ * @return YES if there is a token for each indexed field, otherwise NO.
+ */
+- (BOOL)isComplete:(NSDictionary *)tokens;
+
+/**
+ * Computes the token of a field value.
+ *
+ * @param value The value.
+ *
+ * @return the token, or nil if the value can't be indexed.
+ */
+- (NSData *)tokenForValue:(id)value;
+
+/**
+ * Narrows down the records that may match the given predicate. Equality (==) and IN
+ * comparisons of indexed fields with constant values are looked up, and combined through
+ * AND and OR compound predicates.
+ *
+ * @param predicate The predicate.
+ * @param lookup The block that returns the ids of the records having the given token
+ *        for the given field.
+ *
+ * @return an NSSet with the ids of the candidate records, or nil if the index can't be
+ *         used for the predicate, in which case all records are candidates.
+ */
+- (NSSet *)candidatesForPredicate:(NSPredicate *)predicate
+                           lookup:(NSSet *(^)(NSString *field, NSData *token))lookup;
+
+@end
@@ -0,0 +1,195 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGBlindIndex.h"
+
+@implementation AGBlindIndex {
+    id<AGEncryptionService> _encryptionService;
+}
+
+@synthesize fields = _fields;
+
+- (instancetype)initWithEncryptionService:(id<AGEncryptionService>)encryptionService fields:(NSArray *)fields {
+    self = [super init];
+    if (self) {
+        _encryptionService = encryptionService;
+        // without tokens, nothing can be indexed and every record is a candidate
+        _fields = [encryptionService respondsToSelector:@selector(blindIndex:)] ? [fields copy] : @[];
+    }
+
+    return self;
+}
+
+- (NSDictionary *)tokensForRecord:(NSDictionary *)record {
+    NSMutableDictionary *tokens = [[NSMutableDictionary alloc] init];
+
+    for (NSString *field in _fields) {
+        NSData *token = [self tokenForValue:record[field]];
+
+        tokens[field] = token ?: [NSData data];
+    }
+
+    return tokens;
+}
+
+- (BOOL)isComplete:(NSDictionary *)tokens {
+    if (!tokens)
+        return NO;
+
+    for (NSString *field in _fields) {
+        if (!tokens[field])
+            return NO;
+    }
+
+    return YES;
+}
+
+- (NSData *)tokenForValue:(id)value {
+    NSString *canonical;
+
+    // values that are equal in a predicate share the same canonical form
+    if ([value isKindOfClass:[NSString class]]) {
+        canonical = [@"s:" stringByAppendingString:value];
+    } else if ([value isKindOfClass:[NSNumber class]]) {
+        canonical = [@"n:" stringByAppendingString:[value stringValue]];
+    } else if ([value isKindOfClass:[NSDate class]]) {
+        canonical = [NSString stringWithFormat:@"d:%.6f", [value timeIntervalSinceReferenceDate]];
+    } else {
+        return nil;
+    }
+
+    return [_encryptionService blindIndex:[canonical dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+- (NSSet *)candidatesForPredicate:(NSPredicate *)predicate
+                           lookup:(NSSet *(^)(NSString *field, NSData *token))lookup {
+
+    if ([predicate isKindOfClass:[NSCompoundPredicate class]]) {
+        NSCompoundPredicate *compound = (NSCompoundPredicate *)predicate;
+
+        switch (compound.compoundPredicateType) {
+            case NSAndPredicateType: {
+                // any indexed sub-predicate narrows down the candidates
+                NSMutableSet *candidates;
+
+                for (NSPredicate *subpredicate in compound.subpredicates) {
+                    NSSet *subcandidates = [self candidatesForPredicate:subpredicate lookup:lookup];
+
+                    if (!subcandidates)
+                        continue;
+
+                    if (candidates)
+                        [candidates intersectSet:subcandidates];
+                    else
+                        candidates = [subcandidates mutableCopy];
+                }
+
+                return candidates;
+            }
+            case NSOrPredicateType: {
+                // every sub-predicate must be indexed
+                NSMutableSet *candidates = [[NSMutableSet alloc] init];
+
+                for (NSPredicate *subpredicate in compound.subpredicates) {
+                    NSSet *subcandidates = [self candidatesForPredicate:subpredicate lookup:lookup];
+
+                    if (!subcandidates)
+                        return nil;
+
+                    [candidates unionSet:subcandidates];
+                }
+
+                return candidates;
+            }
+            default:
+                return nil;
+        }
+    }
+
+    if ([predicate isKindOfClass:[NSComparisonPredicate class]])
+        return [self candidatesForComparison:(NSComparisonPredicate *)predicate lookup:lookup];
+
+    return nil;
+}
+
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
+- (NSSet *)candidatesForComparison:(NSComparisonPredicate *)predicate
+                            lookup:(NSSet *(^)(NSString *field, NSData *token))lookup {
+
+    // case or diacritic insensitive comparisons can't be answered by a hash
+    if (predicate.options != 0 || predicate.comparisonPredicateModifier != NSDirectPredicateModifier)
+        return nil;
+
+    NSExpression *left = predicate.leftExpression;
+    NSExpression *right = predicate.rightExpression;
+
+    // allow both 'field == value' and 'value == field'
+    if (predicate.predicateOperatorType == NSEqualToPredicateOperatorType
+            && left.expressionType == NSConstantValueExpressionType) {
+        NSExpression *swap = left;
+        left = right;
+        right = swap;
+    }
+
+    if (left.expressionType != NSKeyPathExpressionType || right.expressionType != NSConstantValueExpressionType)
+        return nil;
+
+    NSString *field = left.keyPath;
+
+    if (![_fields containsObject:field])
+        return nil;
+
+    NSArray *values;
+
+    switch (predicate.predicateOperatorType) {
+        case NSEqualToPredicateOperatorType:
+            values = @[right.constantValue ?: [NSNull null]];
+            break;
+        case NSInPredicateOperatorType:
+            if ([right.constantValue isKindOfClass:[NSArray class]])
+                values = right.constantValue;
+            else if ([right.constantValue isKindOfClass:[NSSet class]])
+                values = [right.constantValue allObjects];
+            else
+                return nil;
+            break;
+        default:
+            return nil;
+    }
+
+    NSMutableSet *candidates = [[NSMutableSet alloc] init];
+
+    for (id value in values) {
+        NSData *token = [self tokenForValue:value];
+
+        // e.g. a comparison with nil, which matches records without a token
+        if (!token)
+            return nil;
+
+        NSSet *ids = lookup(field, token);
+
+        if (ids)
+            [candidates unionSet:ids];
+    }
+
+    return candidates;
+}
+
+@end
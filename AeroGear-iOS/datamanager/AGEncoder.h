@@ -56,8 +56,109 @@
  */
 - (BOOL)isValid:(id)plist;
 
+@optional
+
+/**
+ * Encodes each of the given property lists, as encode:error: would. The work is
+ * spread across the available cores.
+ *
+ * @param plists An array of valid property list objects to be encoded.
+ * @param error An error object containing details of why the encode failed.
+ *
+ * @return An NSArray holding the encoded NSData objects, in the same order, or nil
+ *         if any of them couldn't be encoded.
+ */
+- (NSArray *)encodeAll:(NSArray *)plists error:(NSError **)error;
+
+/**
+ * Decodes each of the given data objects, as decode:error: would. The work is
+ * spread across the available cores.
+ *
+ * @param data An array of the data objects to be decoded.
+ * @param error An error object containing details of why the decode failed.
+ *
+ * @return An NSArray holding the decoded property lists, in the same order, or nil
+ *         if any of them couldn't be decoded.
+ */
+- (NSArray *)decodeAll:(NSArray *)data error:(NSError **)error;
+
+/**
+ * Creates and returns the dictionary of the fields stored in plaintext next to encrypted
+ * ones (see AGEncryptedPListEncoder), so that nothing has to be decrypted.
+ *
+ * @param data The data object to be decoded.
+ * @param error An error object containing details of why the decode failed.
+ *
+ * @return The plaintext fields, or nil if the data isn't stored that way (e.g. the
+ *         encoder doesn't encrypt, or encrypts whole property lists).
+ */
+- (id)decodeUnencrypted:(NSData *)data error:(NSError **)error;
+
+/**
+ * Writes the given records to the stream one at a time, so that the complete serialized
+ * form of the collection never has to be held in memory.
+ *
+ * @param records A collection (e.g. NSArray) of valid property list objects.
+ * @param stream An opened NSOutputStream the records will be written to.
+ * @param error An error object containing details of why the encode failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)encodeRecords:(id<NSFastEnumeration>)records toStream:(NSOutputStream *)stream error:(NSError **)error;
+
+/**
+ * Reads records written by encodeRecords:toStream:error: from the stream, passing each one
+ * to the block as soon as it has been decoded. For compatibility, data produced by encode:error:
+ * is accepted too, in which case each element of the decoded collection is passed to the block
+ * (property list dictionaries are passed as two-element [key, value] arrays).
+ *
+ * @param stream An opened NSInputStream the records will be read from.
+ * @param block The block invoked for each decoded record. Setting stop to YES stops decoding.
+ * @param error An error object containing details of why the decode failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)decodeRecordsFromStream:(NSInputStream *)stream
+                     usingBlock:(void (^)(id record, BOOL *stop))block
+                          error:(NSError **)error;
+
 @end
 
+// The methods below call the optional methods of an encoder if it implements them,
+// and fall back to encode:error: and decode:error: otherwise.
+
+/**
+ * Encodes each of the given property lists, see AGEncoder encodeAll:error:. Encoders
+ * that don't implement it encode the property lists one at a time.
+ */
+NSArray *AGEncodeAll(id<AGEncoder> encoder, NSArray *plists, NSError **error);
+
+/**
+ * Decodes each of the given data objects, see AGEncoder decodeAll:error:. Encoders
+ * that don't implement it decode the data objects one at a time.
+ */
+NSArray *AGDecodeAll(id<AGEncoder> encoder, NSArray *data, NSError **error);
+
+/**
+ * Decodes the plaintext fields of the given data object, see AGEncoder decodeUnencrypted:error:.
+ * Encoders that don't implement it store no plaintext fields, and nil is returned.
+ */
+id AGDecodeUnencrypted(id<AGEncoder> encoder, NSData *data, NSError **error);
+
+/**
+ * Writes the given records to the stream, see AGEncoder encodeRecords:toStream:error:. Encoders
+ * that don't implement it encode each record with encode:error:.
+ */
+BOOL AGEncodeRecordsToStream(id<AGEncoder> encoder, id<NSFastEnumeration> records,
+                             NSOutputStream *stream, NSError **error);
+
+/**
+ * Reads records from the stream, see AGEncoder decodeRecordsFromStream:usingBlock:error:. Encoders
+ * that don't implement it decode each record with decode:error:.
+ */
+BOOL AGDecodeRecordsFromStream(id<AGEncoder> encoder, NSInputStream *stream,
+                               void (^block)(id record, BOOL *stop), NSError **error);
+
 /**
  An encoder backed by a NSPropertyListSerialization
  */
@@ -76,4 +177,78 @@
  */
 @interface AGEncryptedPListEncoder : NSObject <AGEncoder>
 - (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService;
+
+/**
+ * Creates an encoder that compresses the encoded data before encrypting it.
+ *
+ * @param encryptionService The encryption service used.
+ * @param threshold The size, in bytes, from which encoded data is compressed, or 0 to disable compression.
+ *
+ * @return the newly created AGEncryptedPListEncoder object.
+ */
+- (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService
+                      compressionThreshold:(NSUInteger)threshold;
+
+/**
+ * Creates an encoder that only encrypts the given fields of the dictionaries it encodes, each
+ * value on its own; the remaining fields are encoded in plaintext, see decodeUnencrypted:error:.
+ * Other property lists are encrypted as a whole.
+ *
+ * @param encryptionService The encryption service used.
+ * @param threshold The size, in bytes, from which encoded data is compressed, or 0 to disable compression.
+ * @param fields The names of the fields to encrypt, or nil to encrypt whole property lists.
+ *
+ * @return the newly created AGEncryptedPListEncoder object.
+ */
+- (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService
+                      compressionThreshold:(NSUInteger)threshold
+                           encryptedFields:(NSArray *)fields;
+
+/**
+ * Creates an encoder that tags the data it encrypts with the version of the key, and decrypts data
+ * tagged with the versions of previous keys with their own encryption services (see AGStoreConfig
+ * keyVersion). Untagged data is of version 0.
+ *
+ * @param encryptionService The encryption service of the current key.
+ * @param keyVersion The version of the current key, or 0 to leave the data untagged.
+ * @param previousEncryptionServices The encryption services of the previous keys, keyed by their version.
+ * @param threshold The size, in bytes, from which encoded data is compressed, or 0 to disable compression.
+ * @param fields The names of the fields to encrypt, or nil to encrypt whole property lists.
+ *
+ * @return the newly created AGEncryptedPListEncoder object.
+ */
+- (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService
+                                keyVersion:(NSUInteger)keyVersion
+                previousEncryptionServices:(NSDictionary *)previousEncryptionServices
+                      compressionThreshold:(NSUInteger)threshold
+                           encryptedFields:(NSArray *)fields;
+
+/**
+ * The version of the key the data is encrypted with.
+ */
+@property (nonatomic, readonly) NSUInteger keyVersion;
+
+/**
+ * The bytes the data encrypted with the current key starts with, or nil if the key is of version 0.
+ */
+@property (nonatomic, readonly) NSData *keyVersionTag;
+
+/**
+ * Returns the version of the key the given data was encrypted with, without decrypting it.
+ *
+ * @param data The data object, as returned by encode:error:.
+ *
+ * @return the version of the key, 0 if the data is untagged.
+ */
+- (NSUInteger)keyVersionOfData:(NSData *)data;
+
+/**
+ * Decodes the given records, leaving out those that can't be decrypted (e.g. corrupted ones) rather
+ * than failing them all, as decodeAll:error: does.
+ *
+ * @param records The data objects, as returned by encode:error:, keyed by the record id.
+ *
+ * @return an NSDictionary with the property list of each record decoded, keyed by the record id.
+ */
+- (NSDictionary *)decodeRecords:(NSDictionary *)records;
 @end
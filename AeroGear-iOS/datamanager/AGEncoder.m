@@ -17,6 +17,349 @@
 
 #import "AGEncoder.h"
 #import "AGEncryptionService.h"
+#import "AGJsonArrayParser.h"
+#import "AGNSStream+IO.h"
+#import "AGBaseStorage.h"
+#import "AGStore.h"
+#import <AGRandomGenerator.h>
+#import <zlib.h>
+
+// marks a stream of length-prefixed records written by encodeRecords:toStream:error:
+static const uint8_t kRecordStreamMagic[4] = {'A', 'G', 'R', 'S'};
+
+// marks compressed data, followed by the 32-bit big-endian uncompressed length;
+// never mistaken for a binary plist, which starts with "bplist"
+static const uint8_t kCompressedMagic[4] = {'A', 'G', 'Z', '1'};
+static const NSUInteger kCompressedHeaderLength = sizeof(kCompressedMagic) + 4;
+
+// the best ratio deflate can achieve, used to reject bogus lengths
+static const NSUInteger kMaxCompressionRatio = 1032;
+
+#pragma mark - record stream helpers
+
+// writes each record as a 32-bit big-endian length followed by the encoded bytes
+static BOOL AGWriteFramedRecords(id<NSFastEnumeration> records, NSOutputStream *stream,
+                                 NSData *(^encodeBlock)(id record, NSError **error), NSError **error) {
+
+    if (![stream writeAllBytes:kRecordStreamMagic length:sizeof(kRecordStreamMagic) error:error])
+        return NO;
+
+    // errors are captured in a strong reference, so they
+    // outlive the autorelease pool drained on each record
+    NSError *recordError;
+    BOOL success = YES;
+
+    for (id record in records) {
+        @autoreleasepool {
+            NSData *data = encodeBlock(record, &recordError);
+
+            uint32_t length = CFSwapInt32HostToBig((uint32_t)[data length]);
+
+            success = data &&
+                    [stream writeAllBytes:(const uint8_t *)&length length:sizeof(length) error:&recordError] &&
+                    [stream writeAllData:data error:&recordError];
+        }
+
+        if (!success)
+            break;
+    }
+
+    if (!success && error)
+        *error = recordError;
+
+    return success;
+}
+
+// passes each element of a collection decoded in one go to the block
+static void AGEnumerateRecords(id plist, void (^block)(id record, BOOL *stop)) {
+    __block BOOL stop = NO;
+
+    if ([plist isKindOfClass:[NSArray class]]) {
+        for (id record in plist) {
+            block(record, &stop);
+            if (stop)
+                break;
+        }
+    } else if ([plist isKindOfClass:[NSDictionary class]]) {
+        [plist enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL *stopEnumeration) {
+            block(@[key, value], &stop);
+            *stopEnumeration = stop;
+        }];
+    } else if (plist) {
+        block(plist, &stop);
+    }
+}
+
+// reads records written by AGWriteFramedRecords, falling back to decode the
+// stream in one go if it was written by a plain encode:error:
+static BOOL AGReadFramedRecords(NSInputStream *stream, id<AGEncoder> encoder,
+                                void (^block)(id record, BOOL *stop), NSError **error) {
+
+    NSData *header = [stream readDataOfLength:sizeof(kRecordStreamMagic) error:error];
+
+    if (!header)
+        return NO;
+
+    if ([header length] == 0) // empty stream, nothing to do
+        return YES;
+
+    if (memcmp([header bytes], kRecordStreamMagic, sizeof(kRecordStreamMagic)) != 0) {
+        // not a record stream
+        NSMutableData *data = [header mutableCopy];
+        NSData *remaining = [stream readAllData:error];
+
+        if (!remaining)
+            return NO;
+
+        [data appendData:remaining];
+
+        id plist = [encoder decode:data error:error];
+
+        if (!plist)
+            return NO;
+
+        AGEnumerateRecords(plist, block);
+        return YES;
+    }
+
+    NSError *recordError;
+    BOOL success = YES;
+    BOOL stop = NO;
+
+    while (success && !stop) {
+        @autoreleasepool {
+            NSData *prefix = [stream readDataOfLength:sizeof(uint32_t) error:&recordError];
+
+            if ([prefix length] == 0) { // end of records (or read error)
+                success = (prefix != nil);
+                break;
+            }
+
+            uint32_t length;
+            [prefix getBytes:&length length:sizeof(length)];
+
+            NSData *data = [stream readDataOfLength:CFSwapInt32BigToHost(length) error:&recordError];
+            id record = data ? [encoder decode:data error:&recordError] : nil;
+
+            // fail fast if unable to deserialize caused by a mangled byte stream
+            if (record)
+                block(record, &stop);
+            else
+                success = NO;
+        }
+    }
+
+    if (!success && error)
+        *error = recordError;
+
+    return success;
+}
+
+#pragma mark - compression helpers
+
+static NSData *AGCompress(NSData *data) {
+    uLongf length = compressBound((uLong)[data length]);
+    NSMutableData *compressed = [NSMutableData dataWithLength:kCompressedHeaderLength + length];
+    uint8_t *bytes = [compressed mutableBytes];
+
+    uint32_t originalLength = CFSwapInt32HostToBig((uint32_t)[data length]);
+    memcpy(bytes, kCompressedMagic, sizeof(kCompressedMagic));
+    memcpy(bytes + sizeof(kCompressedMagic), &originalLength, sizeof(originalLength));
+
+    if (compress2(bytes + kCompressedHeaderLength, &length, [data bytes], (uLong)[data length], Z_DEFAULT_COMPRESSION) != Z_OK)
+        return nil;
+
+    [compressed setLength:kCompressedHeaderLength + length];
+
+    return compressed;
+}
+
+static BOOL AGIsCompressed(NSData *data) {
+    return [data length] >= kCompressedHeaderLength
+            && memcmp([data bytes], kCompressedMagic, sizeof(kCompressedMagic)) == 0;
+}
+
+static NSData *AGDecompress(NSData *data) {
+    uint32_t originalLength;
+    memcpy(&originalLength, (const uint8_t *)[data bytes] + sizeof(kCompressedMagic), sizeof(originalLength));
+    originalLength = CFSwapInt32BigToHost(originalLength);
+
+    NSUInteger compressedLength = [data length] - kCompressedHeaderLength;
+
+    if (originalLength > compressedLength * kMaxCompressionRatio)
+        return nil;
+
+    NSMutableData *decompressed = [NSMutableData dataWithLength:originalLength];
+    uLongf length = originalLength;
+
+    if (uncompress([decompressed mutableBytes], &length,
+                   (const uint8_t *)[data bytes] + kCompressedHeaderLength, (uLong)compressedLength) != Z_OK
+            || length != originalLength)
+        return nil;
+
+    return decompressed;
+}
+
+#pragma mark - field encryption helpers
+
+// records with encrypted fields are binary plists holding the plaintext fields
+// and the encrypted ones; records encrypted as a whole are never mistaken for them,
+// except by chance, in which case they fail to decode as such and are decrypted
+static const uint8_t kFieldRecordMagic[6] = {'b', 'p', 'l', 'i', 's', 't'};
+
+static NSString *const kPlainFieldsKey = @"plain";
+// the fields sealed with a nonce of their own, prepended to their ciphertext
+static NSString *const kSealedFieldsKey = @"sealed";
+// the fields written by earlier versions, encrypted as encrypt: does
+static NSString *const kEncryptedFieldsKey = @"encrypted";
+
+// the length of the nonces of the sealed fields, that of the IVs of the encryption services
+static const NSUInteger kFieldNonceLength = 16;
+
+static BOOL AGIsFieldRecord(NSData *data) {
+    return [data length] >= sizeof(kFieldRecordMagic)
+            && memcmp([data bytes], kFieldRecordMagic, sizeof(kFieldRecordMagic)) == 0;
+}
+
+static id AGNoPlaintextFields(NSError **error) {
+    if (error)
+        *error = [NSError errorWithDomain:AGStoreErrorDomain
+                                     code:0
+                                 userInfo:@{NSLocalizedDescriptionKey: @"object isn't stored with plaintext fields!"}];
+    return nil;
+}
+
+#pragma mark - key version helpers
+
+// marks data encrypted with a versioned key, followed by the 32-bit big-endian version;
+// untagged data is of version 0. Data encrypted as a whole is never mistaken for it,
+// except by chance, in which case the version is unknown and it is read as untagged
+static const uint8_t kKeyVersionMagic[4] = {'A', 'G', 'K', 'V'};
+static const NSUInteger kKeyVersionHeaderLength = sizeof(kKeyVersionMagic) + 4;
+
+static NSData *AGKeyVersionTag(NSUInteger keyVersion) {
+    if (keyVersion == 0)
+        return nil;
+
+    NSMutableData *tag = [NSMutableData dataWithBytes:kKeyVersionMagic length:sizeof(kKeyVersionMagic)];
+    uint32_t version = CFSwapInt32HostToBig((uint32_t)keyVersion);
+    [tag appendBytes:&version length:sizeof(version)];
+
+    return tag;
+}
+
+#pragma mark - batch helpers
+
+static NSArray *AGCheckBatch(NSArray *results, NSString *description, NSError **error) {
+    if (!results && error)
+        *error = [NSError errorWithDomain:AGStoreErrorDomain
+                                     code:0
+                                 userInfo:@{NSLocalizedDescriptionKey: description}];
+    return results;
+}
+
+// encodes (or decodes) each object concurrently
+static NSArray *AGMapAll(NSArray *objects, id (^block)(id object), NSString *description, NSError **error) {
+    return AGCheckBatch([AGBaseStorage concurrentlyMapObjects:objects usingBlock:block], description, error);
+}
+
+// encrypts (or decrypts) each data object with the block, for the
+// encryption services that don't implement encryptAll: (or decryptAll:)
+static NSArray *AGCryptEach(NSArray *data, NSData *(^block)(NSData *item)) {
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[data count]];
+
+    for (NSData *item in data) {
+        NSData *result = block(item);
+
+        if (!result)
+            return nil;
+
+        [results addObject:result];
+    }
+
+    return results;
+}
+
+static NSArray *AGEncryptAll(id<AGEncryptionService> encryptionService, NSArray *data) {
+    if ([encryptionService respondsToSelector:@selector(encryptAll:)])
+        return [encryptionService encryptAll:data];
+
+    return AGCryptEach(data, ^NSData *(NSData *item) {
+        return [encryptionService encrypt:item];
+    });
+}
+
+static NSArray *AGDecryptAll(id<AGEncryptionService> encryptionService, NSArray *data) {
+    if ([encryptionService respondsToSelector:@selector(decryptAll:)])
+        return [encryptionService decryptAll:data];
+
+    return AGCryptEach(data, ^NSData *(NSData *item) {
+        return [encryptionService decrypt:item];
+    });
+}
+
+#pragma mark - optional method fallbacks
+
+NSArray *AGEncodeAll(id<AGEncoder> encoder, NSArray *plists, NSError **error) {
+    if ([encoder respondsToSelector:@selector(encodeAll:error:)])
+        return [encoder encodeAll:plists error:error];
+
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[plists count]];
+
+    for (id plist in plists) {
+        NSData *data = [encoder encode:plist error:error];
+
+        if (!data)
+            return nil;
+
+        [results addObject:data];
+    }
+
+    return results;
+}
+
+NSArray *AGDecodeAll(id<AGEncoder> encoder, NSArray *data, NSError **error) {
+    if ([encoder respondsToSelector:@selector(decodeAll:error:)])
+        return [encoder decodeAll:data error:error];
+
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[data count]];
+
+    for (NSData *item in data) {
+        id plist = [encoder decode:item error:error];
+
+        if (!plist)
+            return nil;
+
+        [results addObject:plist];
+    }
+
+    return results;
+}
+
+id AGDecodeUnencrypted(id<AGEncoder> encoder, NSData *data, NSError **error) {
+    if ([encoder respondsToSelector:@selector(decodeUnencrypted:error:)])
+        return [encoder decodeUnencrypted:data error:error];
+
+    return AGNoPlaintextFields(error);
+}
+
+BOOL AGEncodeRecordsToStream(id<AGEncoder> encoder, id<NSFastEnumeration> records,
+                             NSOutputStream *stream, NSError **error) {
+    if ([encoder respondsToSelector:@selector(encodeRecords:toStream:error:)])
+        return [encoder encodeRecords:records toStream:stream error:error];
+
+    return AGWriteFramedRecords(records, stream, ^NSData *(id record, NSError **err) {
+        return [encoder encode:record error:err];
+    }, error);
+}
+
+BOOL AGDecodeRecordsFromStream(id<AGEncoder> encoder, NSInputStream *stream,
+                               void (^block)(id record, BOOL *stop), NSError **error) {
+    if ([encoder respondsToSelector:@selector(decodeRecordsFromStream:usingBlock:error:)])
+        return [encoder decodeRecordsFromStream:stream usingBlock:block error:error];
+
+    return AGReadFramedRecords(stream, encoder, block, error);
+}
 
 @implementation AGPListEncoder {
     NSPropertyListFormat _format;
@@ -38,10 +381,42 @@
                                                      options:0 error:error];
 }
 
-- (id)decode:(NSData *)data error:(NSError **)error {   
+- (id)decode:(NSData *)data error:(NSError **)error {
+    // the format detected is of no interest, but don't let
+    // it override the one used for encoding
+    NSPropertyListFormat format;
+
     return [NSPropertyListSerialization propertyListWithData:data
                                                      options:0
-                                                      format:&_format error:error];
+                                                      format:&format error:error];
+}
+
+- (NSArray *)encodeAll:(NSArray *)plists error:(NSError **)error {
+    return AGMapAll(plists, ^id(id plist) {
+        return [self encode:plist error:nil];
+    }, @"can't encode object!", error);
+}
+
+- (NSArray *)decodeAll:(NSArray *)data error:(NSError **)error {
+    return AGMapAll(data, ^id(NSData *item) {
+        return [self decode:item error:nil];
+    }, @"can't decode object!", error);
+}
+
+- (id)decodeUnencrypted:(NSData *)data error:(NSError **)error {
+    return AGNoPlaintextFields(error);
+}
+
+- (BOOL)encodeRecords:(id<NSFastEnumeration>)records toStream:(NSOutputStream *)stream error:(NSError **)error {
+    return AGWriteFramedRecords(records, stream, ^NSData *(id record, NSError **err) {
+        return [self encode:record error:err];
+    }, error);
+}
+
+- (BOOL)decodeRecordsFromStream:(NSInputStream *)stream
+                     usingBlock:(void (^)(id record, BOOL *stop))block
+                          error:(NSError **)error {
+    return AGReadFramedRecords(stream, self, block, error);
 }
 
 - (BOOL)isValid:(id)plist {
@@ -52,35 +427,466 @@
 
 @implementation AGEncryptedPListEncoder {
     id<AGEncryptionService> _encryptionService;
+    // key version -> encryption service, including the current one
+    NSDictionary *_encryptionServices;
+    NSData *_keyVersionTag;
+    NSUInteger _compressionThreshold;
+    NSArray *_encryptedFields;
 
     AGPListEncoder *_encoder;
 }
 
 - (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService {
+    return [self initWithEncryptionService:encryptionService compressionThreshold:0];
+}
+
+- (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService
+                      compressionThreshold:(NSUInteger)threshold {
+    return [self initWithEncryptionService:encryptionService compressionThreshold:threshold encryptedFields:nil];
+}
+
+- (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService
+                      compressionThreshold:(NSUInteger)threshold
+                           encryptedFields:(NSArray *)fields {
+    return [self initWithEncryptionService:encryptionService keyVersion:0 previousEncryptionServices:nil
+                      compressionThreshold:threshold encryptedFields:fields];
+}
+
+- (instancetype) initWithEncryptionService:(id<AGEncryptionService>)encryptionService
+                                keyVersion:(NSUInteger)keyVersion
+                previousEncryptionServices:(NSDictionary *)previousEncryptionServices
+                      compressionThreshold:(NSUInteger)threshold
+                           encryptedFields:(NSArray *)fields {
     if (self = [super init]) {
         _encryptionService = encryptionService;
+        _keyVersion = keyVersion;
+        _keyVersionTag = AGKeyVersionTag(keyVersion);
+
+        NSMutableDictionary *encryptionServices = [NSMutableDictionary dictionaryWithDictionary:previousEncryptionServices];
+        if (encryptionService)
+            encryptionServices[@(keyVersion)] = encryptionService;
+        _encryptionServices = encryptionServices;
+
+        _compressionThreshold = threshold;
+        _encryptedFields = [fields count] > 0 ? [fields copy] : nil;
         _encoder = [[AGPListEncoder alloc] initWithFormat:NSPropertyListBinaryFormat_v1_0];
     }
 
     return self;
 }
+
 - (NSData *)encode:(id)plist error:(NSError **)error {
+    // records with encrypted fields are encoded like a batch of one
+    if ([self encryptsFieldsOf:plist])
+        return [AGCheckBatch([self encodeBatch:@[plist]], @"can't encrypt object!", error) firstObject];
+
     // convert to plist
     NSData *encodedData = [_encoder encode:plist error:error];
 
-    return [_encryptionService encrypt:encodedData];
+    if (!encodedData)
+        return nil;
+
+    NSData *encryptedData = [_encryptionService encrypt:[self compress:encodedData]];
+
+    if (!encryptedData)
+        AGCheckBatch(nil, @"can't encrypt object!", error);
+
+    return [self tagged:encryptedData];
 }
 
 - (id)decode:(NSData *)data error:(NSError **)error {
-    NSData *decryptedData = [_encryptionService decrypt:data];
+    NSUInteger keyVersion;
+    NSData *payload = [self payloadOfData:data keyVersion:&keyVersion];
+
+    if (AGIsFieldRecord(payload))
+        return [AGCheckBatch([self decodeBatch:@[data]], @"can't decrypt object!", error) firstObject];
+
+    NSData *decryptedData = [self decompress:[_encryptionServices[@(keyVersion)] decrypt:payload]];
 
     return [_encoder decode:decryptedData error:error];
 }
 
+// the records are handed to the encryption service in batches,
+// each batch processed in a single call
+- (NSArray *)encodeAll:(NSArray *)plists error:(NSError **)error {
+    NSArray *results = [AGBaseStorage concurrentlyMapBatchesOfObjects:plists usingBlock:^NSArray *(NSArray *batch) {
+        return [self encodeBatch:batch];
+    }];
+    
+    return AGCheckBatch(results, @"can't encrypt object!", error);
+}
+
+- (NSArray *)decodeAll:(NSArray *)data error:(NSError **)error {
+    NSArray *results = [AGBaseStorage concurrentlyMapBatchesOfObjects:data usingBlock:^NSArray *(NSArray *batch) {
+        return [self decodeBatch:batch];
+    }];
+    
+    return AGCheckBatch(results, @"can't decrypt object!", error);
+}
+
+- (id)decodeUnencrypted:(NSData *)data error:(NSError **)error {
+    NSDictionary *record = [self fieldRecordWithData:[self payloadOfData:data keyVersion:NULL]];
+
+    return record ? record[kPlainFieldsKey] : AGNoPlaintextFields(error);
+}
+
+// each record is encrypted on its own, so that it can be decrypted
+// without having to read the rest of the stream
+- (BOOL)encodeRecords:(id<NSFastEnumeration>)records toStream:(NSOutputStream *)stream error:(NSError **)error {
+    return AGWriteFramedRecords(records, stream, ^NSData *(id record, NSError **err) {
+        return [self encode:record error:err];
+    }, error);
+}
+
+- (BOOL)decodeRecordsFromStream:(NSInputStream *)stream
+                     usingBlock:(void (^)(id record, BOOL *stop))block
+                          error:(NSError **)error {
+    return AGReadFramedRecords(stream, self, block, error);
+}
+
 - (BOOL)isValid:(id)plist {
     return [_encoder isValid:plist];
 }
 
+- (NSUInteger)keyVersionOfData:(NSData *)data {
+    NSUInteger keyVersion;
+    [self payloadOfData:data keyVersion:&keyVersion];
+
+    return keyVersion;
+}
+
+- (NSData *)keyVersionTag {
+    return _keyVersionTag;
+}
+
+- (NSDictionary *)decodeRecords:(NSDictionary *)records {
+    NSArray *recordIds = [records allKeys];
+    NSArray *plists = [self decodeAll:[records objectsForKeys:recordIds notFoundMarker:[NSNull null]] error:nil];
+
+    // the usual case, all of them are decrypted in batches
+    if (plists)
+        return [NSDictionary dictionaryWithObjects:plists forKeys:recordIds];
+
+    // otherwise find out which ones can't be, one at a time
+    NSMutableDictionary *decoded = [NSMutableDictionary dictionaryWithCapacity:[records count]];
+
+    [records enumerateKeysAndObjectsUsingBlock:^(id recordId, NSData *data, BOOL *stop) {
+        id plist = [self decode:data error:nil];
+
+        if (plist)
+            decoded[recordId] = plist;
+    }];
+
+    return decoded;
+}
+
+- (BOOL)encryptsFieldsOf:(id)plist {
+    return _encryptedFields && [plist isKindOfClass:[NSDictionary class]];
+}
+
+// encrypts the whole records in a single call to the encryption service,
+// and seals the values of the encrypted fields each under a nonce of its own
+- (NSArray *)encodeBatch:(NSArray *)batch {
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[batch count]];
+    NSMutableArray *plaintexts = [NSMutableArray array];
+    // the index of the record each plaintext belongs to
+    NSMutableArray *owners = [NSMutableArray array];
+
+    for (id plist in batch) {
+        NSNumber *index = @([results count]);
+
+        if (![self encryptsFieldsOf:plist]) {
+            NSData *encodedData = [_encoder encode:plist error:nil];
+
+            if (!encodedData)
+                return nil;
+
+            [plaintexts addObject:[self compress:encodedData]];
+            [owners addObject:@[index]];
+            [results addObject:[NSNull null]];
+            continue;
+        }
+
+        NSMutableDictionary *plainFields = [plist mutableCopy];
+        NSMutableDictionary *sealedFields = [NSMutableDictionary dictionary];
+
+        for (NSString *field in _encryptedFields) {
+            id value = plist[field];
+
+            if (!value)
+                continue;
+
+            // wrapped, as field values needn't be collections
+            NSData *encodedData = [_encoder encode:@[value] error:nil];
+            NSData *sealedData = encodedData ? [self seal:[self compress:encodedData]] : nil;
+
+            if (!sealedData)
+                return nil;
+
+            [plainFields removeObjectForKey:field];
+            sealedFields[field] = sealedData;
+        }
+
+        [results addObject:@{kPlainFieldsKey: plainFields, kSealedFieldsKey: sealedFields}];
+    }
+
+    NSArray *ciphertexts = [plaintexts count] > 0 ? AGEncryptAll(_encryptionService, plaintexts) : @[];
+
+    if (!ciphertexts)
+        return nil;
+
+    [owners enumerateObjectsUsingBlock:^(NSArray *owner, NSUInteger idx, BOOL *stop) {
+        results[[owner[0] unsignedIntegerValue]] = ciphertexts[idx];
+    }];
+
+    // the fields are encrypted, encode the records themselves
+    for (NSUInteger i = 0; i < [results count]; i++) {
+        if ([results[i] isKindOfClass:[NSDictionary class]]) {
+            NSData *encodedData = [_encoder encode:results[i] error:nil];
+
+            if (!encodedData)
+                return nil;
+
+            results[i] = encodedData;
+        }
+
+        results[i] = [self tagged:results[i]];
+    }
+
+    return results;
+}
+
+// decrypts the records encrypted with each key in a single call to its encryption service
+- (NSArray *)decodeBatch:(NSArray *)batch {
+    // key version -> indexes of the data in the batch
+    NSMutableDictionary *versions = [NSMutableDictionary dictionary];
+    NSMutableArray *payloads = [NSMutableArray arrayWithCapacity:[batch count]];
+
+    for (NSData *data in batch) {
+        NSUInteger keyVersion;
+        [payloads addObject:[self payloadOfData:data keyVersion:&keyVersion]];
+
+        NSMutableIndexSet *indexes = versions[@(keyVersion)];
+
+        if (!indexes) {
+            indexes = [NSMutableIndexSet indexSet];
+            versions[@(keyVersion)] = indexes;
+        }
+
+        [indexes addIndex:[payloads count] - 1];
+    }
+
+    // the usual case, all of them are encrypted with the same key
+    if ([versions count] == 1) {
+        NSNumber *keyVersion = [[versions allKeys] firstObject];
+        return [self decodeBatch:payloads encryptionService:_encryptionServices[keyVersion]];
+    }
+
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[batch count]];
+
+    for (NSUInteger i = 0; i < [batch count]; i++)
+        [results addObject:[NSNull null]];
+
+    for (NSNumber *keyVersion in versions) {
+        NSIndexSet *indexes = versions[keyVersion];
+        NSArray *decoded = [self decodeBatch:[payloads objectsAtIndexes:indexes]
+                           encryptionService:_encryptionServices[keyVersion]];
+
+        if (!decoded)
+            return nil;
+
+        [results replaceObjectsAtIndexes:indexes withObjects:decoded];
+    }
+
+    return results;
+}
+
+// decrypts the whole records, or the values of their encrypted fields,
+// in a single call to the encryption service
+- (NSArray *)decodeBatch:(NSArray *)batch encryptionService:(id<AGEncryptionService>)encryptionService {
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[batch count]];
+    // the plaintext of each owner, NSNull until decrypted
+    NSMutableArray *plaintexts = [NSMutableArray array];
+    NSMutableArray *owners = [NSMutableArray array];
+    // the data decrypted in a single call, and the owners they belong to
+    NSMutableArray *ciphertexts = [NSMutableArray array];
+    NSMutableIndexSet *pending = [NSMutableIndexSet indexSet];
+    NSMutableIndexSet *fieldRecords = [NSMutableIndexSet indexSet];
+
+    for (NSData *data in batch) {
+        NSNumber *index = @([results count]);
+        NSDictionary *record = [self fieldRecordWithData:data];
+
+        if (!record) {
+            [pending addIndex:[owners count]];
+            [ciphertexts addObject:data];
+            [owners addObject:@[index]];
+            [plaintexts addObject:[NSNull null]];
+            [results addObject:[NSNull null]];
+            continue;
+        }
+
+        NSDictionary *sealedFields = record[kSealedFieldsKey];
+
+        for (NSString *field in sealedFields) {
+            NSData *plaintext = [self open:sealedFields[field] encryptionService:encryptionService];
+
+            if (!plaintext)
+                return nil;
+
+            [owners addObject:@[index, field]];
+            [plaintexts addObject:plaintext];
+        }
+
+        NSDictionary *encryptedFields = record[kEncryptedFieldsKey];
+
+        for (NSString *field in encryptedFields) {
+            if (![encryptedFields[field] isKindOfClass:[NSData class]])
+                return nil;
+
+            [pending addIndex:[owners count]];
+            [ciphertexts addObject:encryptedFields[field]];
+            [owners addObject:@[index, field]];
+            [plaintexts addObject:[NSNull null]];
+        }
+
+        [fieldRecords addIndex:[results count]];
+        [results addObject:[record[kPlainFieldsKey] mutableCopy]];
+    }
+
+    NSArray *decrypted = [ciphertexts count] > 0 ? AGDecryptAll(encryptionService, ciphertexts) : @[];
+
+    if (!decrypted)
+        return nil;
+
+    [plaintexts replaceObjectsAtIndexes:pending withObjects:decrypted];
+
+    for (NSUInteger i = 0; i < [owners count]; i++) {
+        NSArray *owner = owners[i];
+        NSUInteger index = [owner[0] unsignedIntegerValue];
+
+        NSData *decompressed = [self decompress:plaintexts[i]];
+        id plist = decompressed ? [_encoder decode:decompressed error:nil] : nil;
+
+        // fail fast if unable to deserialize caused by a mangled byte stream
+        if (!plist)
+            return nil;
+
+        if ([owner count] == 1) {
+            results[index] = plist;
+            continue;
+        }
+
+        if (![plist isKindOfClass:[NSArray class]] || [plist count] != 1)
+            return nil;
+
+        results[index][owner[1]] = plist[0];
+    }
+
+    // immutable, like the records decrypted as a whole
+    [fieldRecords enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+        results[idx] = [results[idx] copy];
+    }];
+
+    return results;
+}
+
+// the record with its plaintext and encrypted fields, or nil if it was encrypted as a whole
+- (NSDictionary *)fieldRecordWithData:(NSData *)data {
+    if (!AGIsFieldRecord(data))
+        return nil;
+
+    NSDictionary *record = [_encoder decode:data error:nil];
+
+    if (![record isKindOfClass:[NSDictionary class]]
+            || ![record[kPlainFieldsKey] isKindOfClass:[NSDictionary class]])
+        return nil;
+
+    id sealedFields = record[kSealedFieldsKey];
+    id encryptedFields = record[kEncryptedFieldsKey];
+
+    if ((!sealedFields && !encryptedFields)
+            || (sealedFields && ![sealedFields isKindOfClass:[NSDictionary class]])
+            || (encryptedFields && ![encryptedFields isKindOfClass:[NSDictionary class]]))
+        return nil;
+
+    return record;
+}
+
+// encrypts the value of a field under a random nonce, so that equal values don't give equal ciphertexts
+- (NSData *)seal:(NSData *)data {
+    NSData *nonce = [AGRandomGenerator randomBytes:kFieldNonceLength];
+    NSData *ciphertext = [_encryptionService encrypt:data IV:nonce];
+
+    if (!ciphertext)
+        return nil;
+
+    NSMutableData *sealed = [NSMutableData dataWithCapacity:kFieldNonceLength + [ciphertext length]];
+    [sealed appendData:nonce];
+    [sealed appendData:ciphertext];
+
+    return sealed;
+}
+
+- (NSData *)open:(NSData *)data encryptionService:(id<AGEncryptionService>)encryptionService {
+    if (![data isKindOfClass:[NSData class]] || [data length] < kFieldNonceLength)
+        return nil;
+
+    NSData *nonce = [data subdataWithRange:NSMakeRange(0, kFieldNonceLength)];
+    NSData *ciphertext = [data subdataWithRange:NSMakeRange(kFieldNonceLength, [data length] - kFieldNonceLength)];
+
+    return [encryptionService decrypt:ciphertext IV:nonce];
+}
+
+// the data prefixed with the tag of the current key version, if any
+- (NSData *)tagged:(NSData *)data {
+    if (!data || !_keyVersionTag)
+        return data;
+
+    NSMutableData *tagged = [NSMutableData dataWithCapacity:[_keyVersionTag length] + [data length]];
+    [tagged appendData:_keyVersionTag];
+    [tagged appendData:data];
+
+    return tagged;
+}
+
+// the data without its key version tag, along with the version (0 if untagged)
+- (NSData *)payloadOfData:(NSData *)data keyVersion:(NSUInteger *)keyVersion {
+    if (keyVersion)
+        *keyVersion = 0;
+
+    if ([data length] < kKeyVersionHeaderLength || memcmp([data bytes], kKeyVersionMagic, sizeof(kKeyVersionMagic)) != 0)
+        return data;
+
+    uint32_t version;
+    memcpy(&version, (const uint8_t *)[data bytes] + sizeof(kKeyVersionMagic), sizeof(version));
+    version = CFSwapInt32BigToHost(version);
+
+    // unknown versions are untagged data that happens to look tagged
+    if (version == 0 || !_encryptionServices[@(version)])
+        return data;
+
+    if (keyVersion)
+        *keyVersion = version;
+
+    return [data subdataWithRange:NSMakeRange(kKeyVersionHeaderLength, [data length] - kKeyVersionHeaderLength)];
+}
+
+// compressed only if large enough and worth it
+- (NSData *)compress:(NSData *)data {
+    if (_compressionThreshold == 0 || [data length] < _compressionThreshold)
+        return data;
+
+    NSData *compressed = AGCompress(data);
+
+    return (compressed && [compressed length] < [data length]) ? compressed : data;
+}
+
+// data written uncompressed is passed through
+- (NSData *)decompress:(NSData *)data {
+    return AGIsCompressed(data) ? AGDecompress(data) : data;
+}
+
 @end
 
 
@@ -100,6 +906,66 @@
     return arr;
 }
 
+- (NSArray *)encodeAll:(NSArray *)plists error:(NSError **)error {
+    return AGMapAll(plists, ^id(id plist) {
+        return [self encode:plist error:nil];
+    }, @"can't encode object!", error);
+}
+
+- (NSArray *)decodeAll:(NSArray *)data error:(NSError **)error {
+    return AGMapAll(data, ^id(NSData *item) {
+        return [self decode:item error:nil];
+    }, @"can't decode object!", error);
+}
+
+- (id)decodeUnencrypted:(NSData *)data error:(NSError **)error {
+    return AGNoPlaintextFields(error);
+}
+
+// records are written as the elements of a JSON array, so the output
+// remains readable by decode:error:
+- (BOOL)encodeRecords:(id<NSFastEnumeration>)records toStream:(NSOutputStream *)stream error:(NSError **)error {
+    static const uint8_t kOpen = '[', kSeparator = ',', kClose = ']';
+
+    if (![stream writeAllBytes:&kOpen length:1 error:error])
+        return NO;
+
+    NSError *recordError;
+    BOOL success = YES;
+    BOOL first = YES;
+
+    for (id record in records) {
+        @autoreleasepool {
+            NSData *data = [self encode:record error:&recordError];
+
+            success = data &&
+                    (first || [stream writeAllBytes:&kSeparator length:1 error:&recordError]) &&
+                    [stream writeAllData:data error:&recordError];
+
+            first = NO;
+        }
+
+        if (!success) {
+            if (error)
+                *error = recordError;
+            return NO;
+        }
+    }
+
+    return [stream writeAllBytes:&kClose length:1 error:error];
+}
+
+- (BOOL)decodeRecordsFromStream:(NSInputStream *)stream
+                     usingBlock:(void (^)(id record, BOOL *stop))block
+                          error:(NSError **)error {
+
+    AGJsonArrayParser *parser = [[AGJsonArrayParser alloc]
+            initWithOptions:NSJSONReadingMutableContainers | NSJSONReadingMutableLeaves
+                recordBlock:block];
+
+    return [parser parseStream:stream error:error];
+}
+
 - (BOOL)isValid:(id)json {
     return [NSJSONSerialization isValidJSONObject:json];
 }
@@ -17,13 +17,37 @@
 
 #import <Foundation/Foundation.h>
 #import "AGMemoryStorage.h"
+#import "AGRecordCache.h"
+#import "AGKeyRotation.h"
 
 /**
  An internal AGStore implementation that uses an encrypted "in-memory" storage.
  
  *IMPORTANT:* Users are not required to instantiate this class directly, instead an instance of this class is returned automatically when an DataStore with default configuration is constructed or with the _type_ config option set to _"ENCRYPTED_MEMORY"_. See AGDataManager and AGStore class documentation for more information.
  */
-@interface AGEncryptedMemoryStorage : AGMemoryStorage
+@interface AGEncryptedMemoryStorage : AGMemoryStorage <AGKeyRotatable>
+
+/**
+ * The cache of decrypted records, or nil if the cache is disabled (see AGStoreConfig cacheSize).
+ * It is invalidated when records are saved, removed or the store is reset, and can be wiped
+ * on demand with removeAllObjects.
+ */
+@property (nonatomic, readonly) AGRecordCache *cache;
+
+/**
+ * Initialize the store with the dictionaries that hold its contents, e.g. to persist them.
+ *
+ * @param storeConfig The store configuration.
+ * @param data The dictionary that holds the encrypted objects, or nil for an empty one.
+ * @param tokens The dictionary the blind index tokens of the objects are persisted to, or nil
+ *        to keep them in memory only. It is only read when the store is initialized, the
+ *        tokens are looked up in memory from then on.
+ *
+ * @return the newly created AGEncryptedMemoryStorage object.
+ */
+- (instancetype)initWithConfig:(id<AGStoreConfig>)storeConfig
+                          data:(NSMutableDictionary *)data
+                        tokens:(NSMutableDictionary *)tokens;
 
 /**
  * Utility method to save an NSData object on the encrypted store.
@@ -36,6 +60,35 @@
  */
 - (void)save:(NSData *)encryptedData forKey:(NSString *)key;
 
+/**
+ * Utility method to save an NSData object on the encrypted store, along with the
+ * blind index tokens of the record (see tokensForKey:).
+ *
+ * @param value An encrypted object to be saved.
+ * @param key The key under which this encrypted object will bound to.
+ * @param tokens The blind index tokens of the object, or nil if unknown.
+ *
+ */
+- (void)save:(NSData *)encryptedData forKey:(NSString *)key tokens:(NSDictionary *)tokens;
+
+/**
+ * Utility method to get the blind index tokens of an encrypted object, so that they can
+ * be persisted along with it.
+ *
+ * @param key The key the encrypted object is bound to.
+ *
+ * @return an NSDictionary with the token of each indexed field, or nil if the object
+ *         hasn't been indexed (or no fields are indexed).
+ */
+- (NSDictionary *)tokensForKey:(NSString *)key;
+
+/**
+ * Utility method to enumerate the encrypted objects of the store, without decrypting them.
+ *
+ * @param block The block invoked with each key and the encrypted object bound to it.
+ */
+- (void)enumerateEncryptedDataUsingBlock:(void (^)(NSString *key, NSData *encryptedData, BOOL *stop))block;
+
 /**
  * utility method to dump the contents of the encrypted storage. The returned 
  * format is Property List compliant and can be saved to a permanent storage for
@@ -18,14 +18,32 @@
 #import "AGEncryptedMemoryStorage.h"
 #import "AGEncryptionService.h"
 #import "AGEncoder.h"
+#import "AGLazyRecord.h"
+#import "AGBlindIndex.h"
 
 @implementation AGEncryptedMemoryStorage {
 
     id<AGEncryptionService> _encryptionService;
     id<AGEncoder> _encoder;
+    // encodes and encrypts each record
+    AGEncryptedPListEncoder *_recordEncoder;
+    // the fields encrypted on their own, or nil if records are encrypted as a whole
+    NSSet *_encryptedFields;
+
+    BOOL _lazyDecoding;
+    
+    AGBlindIndex *_blindIndex;
+    // record id -> tokens of the indexed fields
+    NSMutableDictionary *_tokens;
+    // where the tokens are persisted (e.g. a file), as [key version, tokens] pairs; only
+    // read when the store is initialized
+    NSMutableDictionary *_persistedTokens;
+    // field -> token -> ids of the records
+    NSMutableDictionary *_index;
 }
 
 @synthesize type = _type;
+@synthesize cache = _cache;
 
 // ==============================================
 // ======== 'factory' and 'init' section ========
@@ -36,36 +54,50 @@
 }
 
 - (instancetype)initWithConfig:(id<AGStoreConfig>) storeConfig {
+    return [self initWithConfig:storeConfig data:nil tokens:nil];
+}
+
+- (instancetype)initWithConfig:(id<AGStoreConfig>)storeConfig
+                          data:(NSMutableDictionary *)data
+                        tokens:(NSMutableDictionary *)tokens {
     self = [super init];
     if (self) {
         // base inits:
         _type = @"ENCRYPTED_MEMORY";
 
-        _data = [[NSMutableDictionary alloc] init];
+        _data = data ?: [[NSMutableDictionary alloc] init];
         _recordId = storeConfig.recordId;
         _encryptionService = storeConfig.encryptionService;
         _encoder = [[AGPListEncoder alloc] initWithFormat:NSPropertyListBinaryFormat_v1_0];
+        _recordEncoder = [[AGEncryptedPListEncoder alloc] initWithEncryptionService:_encryptionService
+                                                                          keyVersion:storeConfig.keyVersion
+                                                          previousEncryptionServices:storeConfig.previousEncryptionServices
+                                                                compressionThreshold:storeConfig.compressionThreshold
+                                                                     encryptedFields:storeConfig.encryptedFields];
+        
+        if ([storeConfig.encryptedFields count] > 0)
+            _encryptedFields = [NSSet setWithArray:storeConfig.encryptedFields];
+        _lazyDecoding = storeConfig.lazyDecoding;
+        
+        if (storeConfig.cacheSize > 0)
+            _cache = [[AGRecordCache alloc] initWithCapacity:storeConfig.cacheSize];
+        
+        if ([storeConfig.indexedFields count] > 0) {
+            _blindIndex = [[AGBlindIndex alloc] initWithEncryptionService:_encryptionService
+                                                                   fields:storeConfig.indexedFields];
+            _tokens = [[NSMutableDictionary alloc] init];
+            _persistedTokens = tokens;
+            _index = [[NSMutableDictionary alloc] init];
+            
+            [self loadTokens];
+        }
     }
     
     return self;
 }
 
 - (NSArray *)readAll {
-    NSMutableArray *list = [[NSMutableArray alloc] init];
-    
-    for (NSData *encryptedData in [_data allValues]) {
-        NSData *decryptedData = [_encryptionService decrypt:encryptedData];
-
-        id object = [_encoder decode:decryptedData error:nil];
-        
-        // fail fast if unable to deserialize caused by a mangled byte stream.
-        if (!object)
-            return nil;
-        
-        [list addObject:object];
-    }
-    
-    return list;
+    return [self decodeRecordsWithIds:[_data allKeys]];
 }
 
 - (id)read:(id)recordId {
@@ -74,16 +106,57 @@
     NSData *encryptedData = _data[recordId];
  
     if (encryptedData) {
-        NSData *decryptedData = [_encryptionService decrypt:encryptedData];
+        // hot records skip decryption
+        retval = [_cache objectForKey:recordId];
         
-        retval = [_encoder decode:decryptedData error:nil];
+        if (!retval) {
+            retval = [self decodeRecord:encryptedData withId:recordId];
+            
+            // decoded records are immutable, so they can be shared with the caller
+            if (!_lazyDecoding)
+                [_cache setObject:retval forKey:recordId cost:[encryptedData length]];
+        }
     }
     
     return retval;
 }
 
 - (NSArray *)filter:(NSPredicate *)predicate {
-    return [self.readAll filteredArrayUsingPredicate:predicate];
+    // predicates on plaintext fields are evaluated before decrypting anything
+    if ([self isUnencryptedPredicate:predicate])
+        return [self filterUnencrypted:predicate];
+    
+    NSSet *candidates = [_blindIndex candidatesForPredicate:predicate lookup:^NSSet *(NSString *field, NSData *token) {
+        return _index[field][token];
+    }];
+    
+    // the index can't answer the predicate, decrypt everything
+    if (!candidates)
+        return [self.readAll filteredArrayUsingPredicate:predicate];
+    
+    // records without tokens can't be ruled out
+    NSMutableArray *unindexed = [[NSMutableArray alloc] init];
+    
+    for (id recordId in _data) {
+        if (!_tokens[recordId])
+            [unindexed addObject:recordId];
+    }
+    
+    NSArray *recordIds = [[candidates allObjects] arrayByAddingObjectsFromArray:unindexed];
+    
+    NSArray *records = [self decodeRecordsWithIds:recordIds];
+    
+    if (!records)
+        return nil;
+    
+    // index them now that they are decrypted
+    NSUInteger offset = [candidates count];
+    
+    for (NSUInteger i = 0; i < [unindexed count]; i++) {
+        [self setTokens:[_blindIndex tokensForRecord:records[offset + i]] forKey:unindexed[i]];
+    }
+    
+    return [records filteredArrayUsingPredicate:predicate];
 }
 
 - (BOOL)save:(id)data error:(NSError **)error {
@@ -98,15 +171,36 @@
     }
 
     // convenience to add objects inside an array
-    if ([data isKindOfClass:[NSArray class]]) {
-        for (id record in data)
-            [self saveOne:record];
+    BOOL success = [data isKindOfClass:[NSArray class]]? [self saveRecords:data] : [self saveRecord:data];
 
-    } else {
-        [self saveOne:data];
+    if (!success) {
+        if (error)
+            *error = [NSError errorWithDomain:AGStoreErrorDomain
+                                         code:0
+                                     userInfo:@{NSLocalizedDescriptionKey: @"can't encrypt object!"}];
     }
+
+    return success;
+}
+
+- (BOOL)reset:(NSError **)error {
+    [_cache removeAllObjects];
+    [_tokens removeAllObjects];
+    [_persistedTokens removeAllObjects];
+    [_index removeAllObjects];
     
-    return YES;
+    return [super reset:error];
+}
+
+- (BOOL)remove:(id)record error:(NSError **)error {
+    BOOL success = [super remove:record error:error];
+    
+    if (success) {
+        [_cache removeObjectForKey:record[_recordId]];
+        [self setTokens:nil forKey:record[_recordId]];
+    }
+    
+    return success;
 }
 
 - (NSString *)description {
@@ -117,27 +211,277 @@
 // ================= utility methods  ==================
 // =====================================================
 - (void)save:(NSData *)encryptedData forKey:(NSString *)key {
+    [self save:encryptedData forKey:key tokens:nil];
+}
+
+- (void)save:(NSData *)encryptedData forKey:(NSString *)key tokens:(NSDictionary *)tokens {
+    [_cache removeObjectForKey:key];
+    
     _data[key] = encryptedData;
+    
+    // tokens computed for other fields are of no use
+    [self setTokens:([_blindIndex isComplete:tokens] ? tokens : nil) forKey:key];
+}
+
+- (NSDictionary *)tokensForKey:(NSString *)key {
+    return _tokens[key];
+}
+
+- (void)enumerateEncryptedDataUsingBlock:(void (^)(NSString *key, NSData *encryptedData, BOOL *stop))block {
+    [_data enumerateKeysAndObjectsUsingBlock:block];
 }
 
 - (NSData *)dump {
     return [_encoder encode:_data error:nil];
 }
 
+// =====================================================
+// ======== key rotation (AGKeyRotatable) ========
+// =====================================================
+
+- (NSDictionary *)recordsEncryptedWithPreviousKeys:(NSUInteger)limit cursor:(id *)cursor {
+    NSMutableDictionary *records = [[NSMutableDictionary alloc] init];
+    
+    // the ids when the first batch was read, so that each batch resumes where the previous one left
+    // off; the records saved since are encrypted with the current key already
+    NSEnumerator *recordIds = (cursor ? *cursor : nil) ?: [[_data allKeys] objectEnumerator];
+    id recordId;
+    
+    // the tags are checked, nothing is decrypted
+    while ([records count] < limit && (recordId = [recordIds nextObject])) {
+        NSData *encryptedData = _data[recordId];
+        
+        if (encryptedData && [_recordEncoder keyVersionOfData:encryptedData] != _recordEncoder.keyVersion)
+            records[recordId] = encryptedData;
+    }
+    
+    if (cursor)
+        *cursor = recordIds;
+    
+    return records;
+}
+
+- (NSDictionary *)reencryptRecords:(NSDictionary *)records tokens:(NSDictionary **)tokens error:(NSError **)error {
+    // the records that can't be decrypted are left out
+    NSDictionary *decoded = [_recordEncoder decodeRecords:records];
+    NSArray *recordIds = [decoded allKeys];
+    
+    NSArray *plists = [decoded objectsForKeys:recordIds notFoundMarker:[NSNull null]];
+    NSArray *encryptedRecords = [_recordEncoder encodeAll:plists error:error];
+    
+    if (!encryptedRecords)
+        return nil;
+    
+    // the tokens are keyed by the current key as well
+    if (tokens && _blindIndex) {
+        NSMutableDictionary *recordTokens = [[NSMutableDictionary alloc] initWithCapacity:[recordIds count]];
+        
+        [recordIds enumerateObjectsUsingBlock:^(id recordId, NSUInteger idx, BOOL *stop) {
+            recordTokens[recordId] = [_blindIndex tokensForRecord:plists[idx]];
+        }];
+        
+        *tokens = recordTokens;
+    }
+    
+    return [NSDictionary dictionaryWithObjects:encryptedRecords forKeys:recordIds];
+}
+
+- (BOOL)replaceRecords:(NSDictionary *)records withReencryptedRecords:(NSDictionary *)reencryptedRecords
+                tokens:(NSDictionary *)tokens error:(NSError **)error {
+    [reencryptedRecords enumerateKeysAndObjectsUsingBlock:^(id recordId, NSData *encryptedData, BOOL *stop) {
+        // records saved (or removed) in the meantime are left alone
+        if (![_data[recordId] isEqualToData:records[recordId]])
+            return;
+        
+        _data[recordId] = encryptedData;
+        
+        if (tokens[recordId])
+            [self setTokens:tokens[recordId] forKey:recordId];
+    }];
+    
+    return YES;
+}
+
 // =====================================================
 // =========== private utility methods  ================
 // =====================================================
 
-- (void)saveOne:(NSMutableDictionary *)data {
+- (BOOL)saveRecord:(NSMutableDictionary *)data {
     NSString *recordId = [AGBaseStorage getOrSetIdForData:data withIdentifier:_recordId];
     
-    // convert to plist
-    NSData *plist = [_encoder encode:data error:nil];
+    // convert to plist and encrypt it
+    NSData *encryptedData = [_recordEncoder encode:data error:nil];
+    
+    if (!encryptedData)
+        return NO;
     
-    // encrypt it
-    NSData *encryptedData = [_encryptionService encrypt:plist];
     // set it
+    [_cache removeObjectForKey:recordId];
     _data[recordId] = encryptedData;
+    
+    [self setTokens:[_blindIndex tokensForRecord:data] forKey:recordId];
+    
+    return YES;
+}
+
+- (BOOL)saveRecords:(NSArray *)records {
+    // assign ids upfront, the records are not touched during encryption
+    NSMutableArray *recordIds = [[NSMutableArray alloc] initWithCapacity:[records count]];
+    
+    for (NSMutableDictionary *record in records)
+        [recordIds addObject:[AGBaseStorage getOrSetIdForData:record withIdentifier:_recordId]];
+    
+    // convert to plist and encrypt them in batches
+    NSArray *encryptedRecords = [_recordEncoder encodeAll:records error:nil];
+    
+    // nothing is stored if any of the records failed
+    if (!encryptedRecords)
+        return NO;
+    
+    [recordIds enumerateObjectsUsingBlock:^(id recordId, NSUInteger idx, BOOL *stop) {
+        [_cache removeObjectForKey:recordId];
+        _data[recordId] = encryptedRecords[idx];
+        
+        [self setTokens:[_blindIndex tokensForRecord:records[idx]] forKey:recordId];
+    }];
+    
+    return YES;
+}
+
+- (void)setTokens:(NSDictionary *)tokens forKey:(id)recordId {
+    if (!_blindIndex)
+        return;
+    
+    // drop the previous tokens of the record
+    NSDictionary *previousTokens = _tokens[recordId];
+    
+    [previousTokens enumerateKeysAndObjectsUsingBlock:^(NSString *field, NSData *token, BOOL *stop) {
+        NSMutableSet *recordIds = _index[field][token];
+        
+        [recordIds removeObject:recordId];
+        
+        if ([recordIds count] == 0)
+            [_index[field] removeObjectForKey:token];
+    }];
+    
+    if (!tokens) {
+        if (previousTokens) {
+            [_tokens removeObjectForKey:recordId];
+            [_persistedTokens removeObjectForKey:recordId];
+        }
+        return;
+    }
+    
+    _tokens[recordId] = tokens;
+    // the tokens are computed with the current key
+    _persistedTokens[recordId] = @[@(_recordEncoder.keyVersion), tokens];
+    
+    [self indexTokens:tokens forKey:recordId];
+}
+
+// the tokens are small: they are read once, and looked up in memory from then on
+- (void)loadTokens {
+    NSSet *recordIds = [NSSet setWithArray:[_data allKeys]];
+    
+    for (id recordId in [_persistedTokens allKeys]) {
+        NSArray *persisted = _persistedTokens[recordId];
+        NSDictionary *tokens = nil;
+        
+        // the key version is kept along the tokens, so that no record has to be read
+        if ([persisted isKindOfClass:[NSArray class]] && [persisted count] == 2
+                && [persisted[0] unsignedIntegerValue] == _recordEncoder.keyVersion
+                && [persisted[1] isKindOfClass:[NSDictionary class]])
+            tokens = persisted[1];
+        
+        // drop the tokens of records that are gone, that were computed for other fields,
+        // or with a previous key (their records are indexed again once decrypted)
+        if (![recordIds containsObject:recordId] || ![_blindIndex isComplete:tokens]) {
+            [_persistedTokens removeObjectForKey:recordId];
+            continue;
+        }
+        
+        _tokens[recordId] = tokens;
+        [self indexTokens:tokens forKey:recordId];
+    }
+}
+
+- (void)indexTokens:(NSDictionary *)tokens forKey:(id)recordId {
+    [tokens enumerateKeysAndObjectsUsingBlock:^(NSString *field, NSData *token, BOOL *stop) {
+        // empty tokens never match a lookup
+        if ([token length] == 0)
+            return;
+        
+        NSMutableDictionary *fieldIndex = _index[field];
+        
+        if (!fieldIndex) {
+            fieldIndex = [[NSMutableDictionary alloc] init];
+            _index[field] = fieldIndex;
+        }
+        
+        NSMutableSet *recordIds = fieldIndex[token];
+        
+        if (!recordIds) {
+            recordIds = [[NSMutableSet alloc] init];
+            fieldIndex[token] = recordIds;
+        }
+        
+        [recordIds addObject:recordId];
+    }];
+}
+
+- (BOOL)isUnencryptedPredicate:(NSPredicate *)predicate {
+    if (!_encryptedFields)
+        return NO;
+    
+    NSSet *fields = [AGBaseStorage fieldsOfPredicate:predicate];
+    
+    return fields && ![fields intersectsSet:_encryptedFields];
+}
+
+- (NSArray *)filterUnencrypted:(NSPredicate *)predicate {
+    NSMutableArray *recordIds = [[NSMutableArray alloc] init];
+    
+    for (id recordId in _data) {
+        id plainFields = [_recordEncoder decodeUnencrypted:_data[recordId] error:nil];
+        
+        // records encrypted as a whole (e.g. saved before the fields were configured) can't be ruled out
+        if (!plainFields || [predicate evaluateWithObject:plainFields])
+            [recordIds addObject:recordId];
+    }
+    
+    // only the matching records are decrypted
+    return [[self decodeRecordsWithIds:recordIds] filteredArrayUsingPredicate:predicate];
+}
+
+- (NSArray *)decodeRecordsWithIds:(NSArray *)recordIds {
+    NSMutableArray *list = [[NSMutableArray alloc] initWithCapacity:[recordIds count]];
+    
+    for (id recordId in recordIds) {
+        NSData *encryptedData = _data[recordId];
+        
+        // e.g. the (persisted) record couldn't be read, fails fast
+        if (!encryptedData)
+            return nil;
+        
+        // decryption is deferred, no need to batch
+        [list addObject:_lazyDecoding ? [self decodeRecord:encryptedData withId:recordId] : encryptedData];
+    }
+    
+    if (_lazyDecoding)
+        return list;
+    
+    // decrypt records in batches, fails fast if unable to
+    // deserialize caused by a mangled byte stream.
+    return [_recordEncoder decodeAll:list error:nil];
+}
+
+- (id)decodeRecord:(NSData *)encryptedData withId:(id)recordId {
+    // defer decryption until a field is accessed
+    if (_lazyDecoding)
+        return [[AGLazyRecord alloc] initWithData:encryptedData encoder:_recordEncoder
+                                         recordId:recordId identifier:_recordId];
+
+    return [_recordEncoder decode:encryptedData error:nil];
 }
 
 @end
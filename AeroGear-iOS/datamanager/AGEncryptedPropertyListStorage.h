@@ -19,6 +19,8 @@
 #import "AGBaseStorage.h"
 #import "AGStore.h"
 #import "AGStoreConfiguration.h"
+#import "AGRecordCache.h"
+#import "AGKeyRotation.h"
 /**
  An internal AGStore implementation that uses an encrypted "plist" storage.
  
@@ -26,9 +28,16 @@
  automatically when an DataStore with default configuration is constructed or with the _type_ config option set to
  _"ENCRYPTED_PLIST"_. See AGDataManager and AGStore class documentation for more information.
  */
-@interface AGEncryptedPropertyListStorage : AGBaseStorage <AGStore>
+@interface AGEncryptedPropertyListStorage : AGBaseStorage <AGStore, AGKeyRotatable>
 
 + (instancetype)storeWithConfig:(id<AGStoreConfig>)storeConfig;
 - (instancetype)initWithConfig:(id<AGStoreConfig>)storeConfig;
 
+/**
+ * The cache of decrypted records, or nil if the cache is disabled (see AGStoreConfig cacheSize).
+ * It is invalidated when records are saved, removed or the store is reset, and can be wiped
+ * on demand with removeAllObjects.
+ */
+@property (nonatomic, readonly) AGRecordCache *cache;
+
 @end
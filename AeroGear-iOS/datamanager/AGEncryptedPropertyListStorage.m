@@ -17,6 +17,7 @@
 
 #import "AGEncryptedPropertyListStorage.h"
 #import "AGEncryptedMemoryStorage.h"
+#import "AGSegmentedFile.h"
 #import "AGEncoder.h"
 
 @implementation AGEncryptedPropertyListStorage {
@@ -25,6 +26,11 @@
     AGEncryptedMemoryStorage *_encStorage;
     id<AGEncryptionService> _encryptionService;
     id<AGEncoder> _encoder;
+    
+    // the persisted contents of _encStorage
+    AGSegmentedFile *_records;
+    AGSegmentedFile *_tokens;
+    NSError *_openError;
 }
 
 @synthesize type = _type;
@@ -42,31 +48,28 @@
     if (self) {
         _type = @"ENCRYPTED_PLIST";
         
-        _encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:storeConfig];
         _encryptionService = storeConfig.encryptionService;
         
         // extract file path
         _file = [AGBaseStorage storeURLWithName:storeConfig.name];
         
-        // if plist file exists initialize store from it
-        if ([[NSFileManager defaultManager] fileExistsAtPath:[_file path]]) {
-            // load file
-            NSData *data = [NSData dataWithContentsOfURL:_file];
-            
-            NSError *error;
-            
-            // decode structure
-            _encoder = [[AGPListEncoder alloc] initWithFormat:NSPropertyListBinaryFormat_v1_0];
-            NSDictionary *plist = [_encoder decode:data error:&error];
-            if (!error) {
-                [plist enumerateKeysAndObjectsUsingBlock:^(id key, id encryptedData, BOOL *stop) {
-                    [_encStorage save:encryptedData forKey:key];
-                }];
-                
-            } else { // log the error
-                NSLog(@"%@ %@: %@", [self class], NSStringFromSelector(_cmd), error);
-            }
+        _encoder = [[AGPListEncoder alloc] initWithFormat:NSPropertyListBinaryFormat_v1_0];
+
+        // files written by earlier versions hold all the records in a single stream
+        NSError *error;
+
+        if (![self migrateLegacyFile:&error]) { // log the error
+            NSLog(@"%@ %@: %@", [self class], NSStringFromSelector(_cmd), error);
         }
+
+        // the encrypted records, and their blind index tokens, are only read from
+        // the file when accessed; changes are appended to it as they are made
+        _records = [self segmentedFileAtURL:_file encoder:nil];
+        
+        if ([storeConfig.indexedFields count] > 0)
+            _tokens = [self segmentedFileAtURL:[self tokensURL] encoder:_encoder];
+        
+        _encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:storeConfig data:_records tokens:_tokens];
     }
     
     return self;
@@ -104,6 +107,28 @@
     return [_encStorage remove:record error:error]  && [self updateStore:error];
 }
 
+- (AGRecordCache *)cache {
+    return _encStorage.cache;
+}
+
+// =====================================================
+// ======== key rotation (AGKeyRotatable) ========
+// =====================================================
+
+- (NSDictionary *)recordsEncryptedWithPreviousKeys:(NSUInteger)limit cursor:(id *)cursor {
+    return [_encStorage recordsEncryptedWithPreviousKeys:limit cursor:cursor];
+}
+
+- (NSDictionary *)reencryptRecords:(NSDictionary *)records tokens:(NSDictionary **)tokens error:(NSError **)error {
+    return [_encStorage reencryptRecords:records tokens:tokens error:error];
+}
+
+- (BOOL)replaceRecords:(NSDictionary *)records withReencryptedRecords:(NSDictionary *)reencryptedRecords
+                tokens:(NSDictionary *)tokens error:(NSError **)error {
+    return [_encStorage replaceRecords:records withReencryptedRecords:reencryptedRecords tokens:tokens error:error]
+            && [self updateStore:error];
+}
+
 - (NSString *)description {
     return [NSString stringWithFormat: @"%@ [type=%@]", self.class, _type];
 }
@@ -113,20 +138,95 @@
 // =====================================================
 
 - (BOOL)updateStore:(NSError **)error {
-    NSData *plist = [_encStorage dump];
+    // the changes have already been appended to the file, report any failure
+    NSError *writeError = _openError;
+    
+    BOOL success = !writeError && [_records flush:&writeError] && (!_tokens || [_tokens flush:&writeError]);
     
-    // since 'NSData:writeToFile' fails silently, construct an
+    // since the underlying error is low level, construct an
     // error object to inform client
-    if (![plist writeToURL:_file atomically:YES]) {
-        if (error)
-            *error = [NSError errorWithDomain:AGStoreErrorDomain
-                                         code:0
-                                     userInfo:@{NSLocalizedDescriptionKey: @"an error occurred during save!"}];
-        return NO;
+    if (!success && error) {
+        NSMutableDictionary *userInfo = [@{NSLocalizedDescriptionKey: @"an error occurred during save!"} mutableCopy];
+        if (writeError)
+            userInfo[NSUnderlyingErrorKey] = writeError;
+        
+        *error = [NSError errorWithDomain:AGStoreErrorDomain code:0 userInfo:userInfo];
+    }
+    
+    return success;
+}
+
+- (AGSegmentedFile *)segmentedFileAtURL:(NSURL *)url encoder:(id<AGEncoder>)encoder {
+    NSError *error;
+    AGSegmentedFile *file = [[AGSegmentedFile alloc] initWithURL:url encoder:encoder error:&error];
+    
+    if (!file) {
+        NSLog(@"%@ %@: %@", [self class], NSStringFromSelector(_cmd), error);
+        
+        // keep going in memory, but fail every save
+        _openError = error;
+        file = [[AGSegmentedFile alloc] init];
     }
     
-    // if we reach here, file was saved successfully
-    return YES;
+    return file;
+}
+
+- (NSURL *)tokensURL {
+    return [_file URLByAppendingPathExtension:@"tokens"];
+}
+
+// converts a file holding all the [key, encryptedData, tokens] records in a
+// single stream to segmented files. The original file is kept aside until
+// the conversion completes, so that an interrupted one starts over.
+- (BOOL)migrateLegacyFile:(NSError **)error {
+    if (!_file)
+        return YES;
+    
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSURL *legacyURL = [_file URLByAppendingPathExtension:@"legacy"];
+    NSURL *tokensURL = [self tokensURL];
+    
+    if ([fileManager fileExistsAtPath:[legacyURL path]]) {
+        // an earlier conversion was interrupted
+        for (NSURL *url in @[_file, tokensURL]) {
+            [fileManager removeItemAtURL:url error:nil];
+            [fileManager removeItemAtURL:[url URLByAppendingPathExtension:@"idx"] error:nil];
+        }
+        
+    } else {
+        if (![fileManager fileExistsAtPath:[_file path]] || [AGSegmentedFile isSegmentedFileAtURL:_file])
+            return YES;
+        
+        if (![fileManager moveItemAtURL:_file toURL:legacyURL error:error])
+            return NO;
+    }
+    
+    AGSegmentedFile *records = [[AGSegmentedFile alloc] initWithURL:_file encoder:nil error:error];
+    __block AGSegmentedFile *tokens;
+    
+    if (!records)
+        return NO;
+    
+    BOOL success = [AGBaseStorage readFromURL:legacyURL usingBlock:^BOOL(NSInputStream *stream, NSError **err) {
+        return AGDecodeRecordsFromStream(_encoder, stream, ^(NSArray *record, BOOL *stop) {
+            records[record[0]] = record[1];
+            
+            if ([record count] > 2) {
+                if (!tokens)
+                    tokens = [[AGSegmentedFile alloc] initWithURL:tokensURL encoder:_encoder error:nil];
+                
+                tokens[record[0]] = record[2];
+            }
+        }, err);
+    } error:error];
+    
+    success = success && [records flush:error] && [records checkpoint:error]
+                      && (!tokens || ([tokens flush:error] && [tokens checkpoint:error]));
+    
+    if (success)
+        [fileManager removeItemAtURL:legacyURL error:nil];
+    
+    return success;
 }
 
 @end
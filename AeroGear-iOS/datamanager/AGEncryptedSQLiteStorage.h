@@ -17,6 +17,7 @@
 
 #import <Foundation/Foundation.h>
 #import "AGSQLiteStorage.h"
+#import "AGKeyRotation.h"
 /**
  An AGStore implementation that uses a SQLite for storage and encryption. This storage is a variant of AGSQLiteStorage
  with encryption. You can use your encrypted store transparently, the same way you work with AGSQLiteStorage.
@@ -54,7 +55,40 @@
 
  The ```read```, ```reset``` or ```remove``` methods found in AGStore behave the same, as on the default ("in memory") store.
 
+ ## Page encryption
+
+ By default each record is encrypted on its own, so reading or filtering records decrypts every row. With the
+ _pageEncryption_ config option set, the database file is encrypted page by page instead (through an SQLite VFS,
+ using AES-XTS with keys derived from the encryption service), and the store works as fast as AGSQLiteStorage:
+
+    id<AGStore> store = [manager store:^(id<AGStoreConfig> config) {
+      [config setName:@"secrets"];
+      [config setType:@"ENCRYPTED_SQLITE"];
+      [config setEncryptionService:encService];
+      [config setPageEncryption:YES];  // encrypt the file rather than the records
+    }];
+
+ ## Field encryption
+
+ Alternatively, the _encryptedFields_ config option lists the sensitive fields of the records: only those are
+ encrypted, and filtering on the other fields only decrypts the matching rows:
+
+    id<AGStore> store = [manager store:^(id<AGStoreConfig> config) {
+      [config setName:@"secrets"];
+      [config setType:@"ENCRYPTED_SQLITE"];
+      [config setEncryptionService:encService];
+      [config setEncryptedFields:@[@"password", @"notes"]];  // 'title' and the others stay in plaintext
+    }];
+
+    NSArray *records = [store filter:[NSPredicate predicateWithFormat:@"title BEGINSWITH 'bank'"]];
+
+ ## Key rotation
+
+ The records are tagged with the version of the key they are encrypted with (see the _keyVersion_ config
+ option), so that an AGKeyRotation can re-encrypt them with a new key in the background, while the store
+ remains in use. Page encryption doesn't support key rotation.
+
  */
 
-@interface AGEncryptedSQLiteStorage : AGSQLiteStorage
+@interface AGEncryptedSQLiteStorage : AGSQLiteStorage <AGKeyRotatable>
 @end
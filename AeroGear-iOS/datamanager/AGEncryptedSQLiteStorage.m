@@ -18,6 +18,34 @@
 #import "AGEncryptedSQLiteStorage.h"
 #import "AGSQLiteCommand.h"
 #import "AGBaseStorage.h"
+#import "AGBlindIndex.h"
+#import "AGEncryptedVFS.h"
+
+// the purposes of the keys derived for page encryption
+static NSString *const kPageDataPurpose = @"AGPageEncryption.data";
+static NSString *const kPageTweakPurpose = @"AGPageEncryption.tweak";
+
+static NSString *AGURIEscape(NSString *string) {
+    NSCharacterSet *allowed = [NSCharacterSet characterSetWithCharactersInString:
+            @"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~/"];
+
+    return [string stringByAddingPercentEncodingWithAllowedCharacters:allowed];
+}
+
+// a database opened through the VFS named in its URI
+@interface AGPageEncryptedDatabase : FMDatabase
+@end
+
+@implementation AGPageEncryptedDatabase
+
+- (BOOL)open {
+    if ([self sqliteHandle])
+        return YES;
+
+    return [self openWithFlags:SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI];
+}
+
+@end
 
 @implementation AGEncryptedSQLiteStorage
 
@@ -34,10 +62,79 @@
         _recordId = config.recordId;
         _databaseName = config.name;
         NSURL *file = [AGBaseStorage storeURLWithName:[_databaseName stringByAppendingString:@"%@.sqlite3"]];
-        _database = [FMDatabase databaseWithPath:[file path]];
-        _encoder = [[AGEncryptedPListEncoder alloc] initWithEncryptionService:storeConfig.encryptionService];
+        
+        if (config.pageEncryption) {
+            // the whole file is encrypted, the records are stored as is
+            _database = [self pageEncryptedDatabaseAtPath:[file path] encryptionService:storeConfig.encryptionService];
+            _encoder = [[AGPListEncoder alloc] init];
+        } else {
+            _database = [FMDatabase databaseWithPath:[file path]];
+            _encoder = [[AGEncryptedPListEncoder alloc] initWithEncryptionService:storeConfig.encryptionService
+                                                                       keyVersion:config.keyVersion
+                                                       previousEncryptionServices:config.previousEncryptionServices
+                                                             compressionThreshold:config.compressionThreshold
+                                                                  encryptedFields:config.encryptedFields];
+        }
+        
         _command = [[AGSQLiteCommand alloc] initWithDatabase:_database name:_databaseName recordId:_recordId encoder:_encoder];
+        _command.lazyDecoding = config.lazyDecoding;
+        
+        if ([config.encryptedFields count] > 0 && !config.pageEncryption)
+            _command.encryptedFields = [NSSet setWithArray:config.encryptedFields];
+        
+        if ([config.indexedFields count] > 0 && !config.pageEncryption) {
+            _command.blindIndex = [[AGBlindIndex alloc] initWithEncryptionService:storeConfig.encryptionService
+                                                                           fields:config.indexedFields];
+        }
     }
     return self;
 }
+
+// =====================================================
+// ======== key rotation (AGKeyRotatable) ========
+// =====================================================
+
+- (NSDictionary *)recordsEncryptedWithPreviousKeys:(NSUInteger)limit cursor:(id *)cursor {
+    return [_command recordsEncryptedWithPreviousKeys:limit cursor:cursor];
+}
+
+- (NSDictionary *)reencryptRecords:(NSDictionary *)records tokens:(NSDictionary **)tokens error:(NSError **)error {
+    return [_command reencryptRecords:records tokens:tokens error:error];
+}
+
+- (BOOL)replaceRecords:(NSDictionary *)records withReencryptedRecords:(NSDictionary *)reencryptedRecords
+                tokens:(NSDictionary *)tokens error:(NSError **)error {
+    return [_command replaceRecords:records withReencryptedRecords:reencryptedRecords tokens:tokens error:error];
+}
+
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
+- (FMDatabase *)pageEncryptedDatabaseAtPath:(NSString *)path encryptionService:(id<AGEncryptionService>)encryptionService {
+    // an in-memory database never reaches the disk
+    if (!path)
+        return [FMDatabase databaseWithPath:nil];
+
+    NSData *dataKey, *tweakKey;
+
+    if ([encryptionService respondsToSelector:@selector(keyForPurpose:)]) {
+        dataKey = [encryptionService keyForPurpose:kPageDataPurpose];
+        tweakKey = [encryptionService keyForPurpose:kPageTweakPurpose];
+    }
+
+    // without keys, opening the database fails
+    if ([dataKey length] == AG_ENCRYPTED_VFS_KEY_LENGTH && [tweakKey length] == AG_ENCRYPTED_VFS_KEY_LENGTH) {
+        int rc = AGEncryptedVFSSetKeys([path UTF8String], [dataKey bytes], [tweakKey bytes]);
+
+        if (rc != SQLITE_OK)
+            NSLog(@"%@ %@: unable to register the VFS (%d)", [self class], NSStringFromSelector(_cmd), rc);
+    }
+
+    NSString *uri = [NSString stringWithFormat:@"file:%@?vfs=%s&key=%@",
+                     AGURIEscape(path), AG_ENCRYPTED_VFS_NAME, AGURIEscape(path)];
+
+    return [AGPageEncryptedDatabase databaseWithPath:uri];
+}
+
 @end
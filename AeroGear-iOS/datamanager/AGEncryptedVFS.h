@@ -0,0 +1,63 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sqlite3.h>
+
+/**
+ * The name of the SQLite VFS encrypting database files page by page.
+ */
+#define AG_ENCRYPTED_VFS_NAME "aerogear-encrypted"
+
+/**
+ * The length, in bytes, of each of the keys used by the VFS.
+ */
+#define AG_ENCRYPTED_VFS_KEY_LENGTH 32
+
+/**
+ * Registers the VFS that encrypts database files, so that databases can be opened with the
+ * "vfs=aerogear-encrypted" URI parameter. The VFS wraps the default one: files are encrypted
+ * with AES-256 in XTS mode, in sectors of 512 bytes, so that each read or write only decrypts
+ * or encrypts the sectors it touches and SQLite works on plain pages as usual.
+ *
+ * The database, its rollback journal and its write-ahead log are encrypted with the keys
+ * registered through AGEncryptedVFSSetKeys, named by the "key" URI parameter of the database.
+ * Temporary files are encrypted with keys generated for the lifetime of the process.
+ *
+ * Safe to call more than once.
+ *
+ * @return SQLITE_OK, or an SQLite error code if the VFS couldn't be registered.
+ */
+int AGEncryptedVFSRegister(void);
+
+/**
+ * Registers (or replaces) the keys of the databases opened with the given "key" URI parameter.
+ *
+ * @param keyId The value of the "key" URI parameter.
+ * @param dataKey The AG_ENCRYPTED_VFS_KEY_LENGTH bytes of the key encrypting the data.
+ * @param tweakKey The AG_ENCRYPTED_VFS_KEY_LENGTH bytes of the key encrypting the sector numbers.
+ *
+ * @return SQLITE_OK, or SQLITE_NOMEM.
+ */
+int AGEncryptedVFSSetKeys(const char *keyId, const void *dataKey, const void *tweakKey);
+
+/**
+ * Forgets the keys registered for the given "key" URI parameter. Databases already open
+ * keep working.
+ *
+ * @param keyId The value of the "key" URI parameter.
+ */
+void AGEncryptedVFSRemoveKeys(const char *keyId);
@@ -0,0 +1,789 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGEncryptedVFS.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <CommonCrypto/CommonCryptor.h>
+
+// the unit of encryption, each sector is encrypted on its own
+#define AG_SECTOR_SIZE 512
+#define AG_BLOCK_SIZE 16
+
+// the size of the zeros written at once when a file grows past its end
+#define AG_ZERO_CHUNK_SIZE (64 * 1024)
+
+#define AG_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define AG_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+typedef struct AGKeys {
+    uint8_t data[AG_ENCRYPTED_VFS_KEY_LENGTH];
+    uint8_t tweak[AG_ENCRYPTED_VFS_KEY_LENGTH];
+} AGKeys;
+
+// the keys registered by AGEncryptedVFSSetKeys
+typedef struct AGKeyEntry {
+    char *keyId;
+    AGKeys keys;
+    struct AGKeyEntry *next;
+} AGKeyEntry;
+
+typedef struct AGFile {
+    sqlite3_file base;          // must come first
+    sqlite3_file *real;         // the file of the wrapped VFS, allocated right after this struct
+
+    int encrypted;
+    AGKeys keys;
+    CCCryptorRef encryptor;     // AES-ECB with the data key, XTS is built on top of it
+    CCCryptorRef decryptor;
+    CCCryptorRef tweaker;       // AES-ECB with the tweak key
+
+    const char *name;           // set for main databases, their journals are looked up by it
+    struct AGFile *next;
+} AGFile;
+
+static sqlite3_vfs *AGRootVFS;
+static sqlite3_mutex *AGMutex;  // guards the key entries and the open databases
+static int AGRegisterResult = SQLITE_ERROR;
+
+static AGKeyEntry *AGKeyEntries;
+static AGFile *AGOpenDatabases;
+
+// temporary files don't outlive the process, neither do their keys
+static AGKeys AGTemporaryKeys;
+
+#pragma mark - XTS
+
+static void AGXor(uint8_t *data, const uint8_t *other, size_t length) {
+    for (size_t i = 0; i < length; i++)
+        data[i] ^= other[i];
+}
+
+// multiplies the tweak by the primitive element of GF(2^128), as in IEEE P1619
+static void AGNextTweak(uint8_t *tweak) {
+    uint8_t carry = 0;
+
+    for (int i = 0; i < AG_BLOCK_SIZE; i++) {
+        uint8_t next = tweak[i] >> 7;
+        tweak[i] = (uint8_t)((tweak[i] << 1) | carry);
+        carry = next;
+    }
+
+    if (carry)
+        tweak[0] ^= 0x87;
+}
+
+// encrypts or decrypts whole blocks in place
+static void AGCryptBlocks(CCCryptorRef cryptor, uint8_t *data, size_t length) {
+    size_t moved;
+
+    CCCryptorUpdate(cryptor, data, length, data, length, &moved);
+}
+
+// encrypts or decrypts, in place, the given bytes of a sector: AES-XTS with ciphertext
+// stealing, so that the length is preserved and SQLite sees the same file sizes
+static void AGCryptSector(AGFile *file, sqlite3_int64 sector, uint8_t *data, int length, int encrypt) {
+    uint8_t tweaks[AG_SECTOR_SIZE / AG_BLOCK_SIZE + 1][AG_BLOCK_SIZE];
+    int blocks = length / AG_BLOCK_SIZE;
+    int tail = length % AG_BLOCK_SIZE;
+
+    // the first tweak is the encrypted sector number, the others follow from it
+    memset(tweaks[0], 0, AG_BLOCK_SIZE);
+    for (int i = 0; i < 8; i++)
+        tweaks[0][i] = (uint8_t)((sqlite3_uint64)sector >> (8 * i));
+
+    AGCryptBlocks(file->tweaker, tweaks[0], AG_BLOCK_SIZE);
+
+    for (int i = 1; i <= blocks; i++) {
+        memcpy(tweaks[i], tweaks[i - 1], AG_BLOCK_SIZE);
+        AGNextTweak(tweaks[i]);
+    }
+
+    // too short for XTS, only happens for the last few bytes of a file
+    if (blocks == 0) {
+        uint8_t keystream[AG_BLOCK_SIZE];
+
+        memcpy(keystream, tweaks[0], AG_BLOCK_SIZE);
+        AGCryptBlocks(file->encryptor, keystream, AG_BLOCK_SIZE);
+        AGXor(data, keystream, length);
+        return;
+    }
+
+    CCCryptorRef cryptor = encrypt ? file->encryptor : file->decryptor;
+
+    // all the blocks at once, but the last full one when there's a tail
+    int plain = tail ? blocks - 1 : blocks;
+
+    AGXor(data, tweaks[0], plain * AG_BLOCK_SIZE);
+    AGCryptBlocks(cryptor, data, plain * AG_BLOCK_SIZE);
+    AGXor(data, tweaks[0], plain * AG_BLOCK_SIZE);
+
+    if (!tail)
+        return;
+
+    // ciphertext stealing: the last full block and the tail swap their tweaks
+    uint8_t *last = data + plain * AG_BLOCK_SIZE;
+    uint8_t *partial = last + AG_BLOCK_SIZE;
+    uint8_t *firstTweak = tweaks[encrypt ? plain : blocks];
+    uint8_t *secondTweak = tweaks[encrypt ? blocks : plain];
+    uint8_t block[AG_BLOCK_SIZE], stolen[AG_BLOCK_SIZE];
+
+    memcpy(block, last, AG_BLOCK_SIZE);
+    AGXor(block, firstTweak, AG_BLOCK_SIZE);
+    AGCryptBlocks(cryptor, block, AG_BLOCK_SIZE);
+    AGXor(block, firstTweak, AG_BLOCK_SIZE);
+
+    memcpy(stolen, partial, tail);
+    memcpy(stolen + tail, block + tail, AG_BLOCK_SIZE - tail);
+    memcpy(partial, block, tail);
+
+    AGXor(stolen, secondTweak, AG_BLOCK_SIZE);
+    AGCryptBlocks(cryptor, stolen, AG_BLOCK_SIZE);
+    AGXor(stolen, secondTweak, AG_BLOCK_SIZE);
+
+    memcpy(last, stolen, AG_BLOCK_SIZE);
+}
+
+static int AGCreateCryptors(AGFile *file) {
+    if (CCCryptorCreate(kCCEncrypt, kCCAlgorithmAES, kCCOptionECBMode, file->keys.data,
+                        kCCKeySizeAES256, NULL, &file->encryptor) != kCCSuccess
+            || CCCryptorCreate(kCCDecrypt, kCCAlgorithmAES, kCCOptionECBMode, file->keys.data,
+                               kCCKeySizeAES256, NULL, &file->decryptor) != kCCSuccess
+            || CCCryptorCreate(kCCEncrypt, kCCAlgorithmAES, kCCOptionECBMode, file->keys.tweak,
+                               kCCKeySizeAES256, NULL, &file->tweaker) != kCCSuccess)
+        return SQLITE_NOMEM;
+
+    return SQLITE_OK;
+}
+
+static void AGReleaseCryptors(AGFile *file) {
+    if (file->encryptor)
+        CCCryptorRelease(file->encryptor);
+    if (file->decryptor)
+        CCCryptorRelease(file->decryptor);
+    if (file->tweaker)
+        CCCryptorRelease(file->tweaker);
+
+    file->encryptor = file->decryptor = file->tweaker = NULL;
+    memset(&file->keys, 0, sizeof(file->keys));
+}
+
+#pragma mark - sector I/O
+
+static sqlite3_int64 AGSectorStart(sqlite3_int64 offset) {
+    return offset / AG_SECTOR_SIZE * AG_SECTOR_SIZE;
+}
+
+// reads and decrypts whole sectors: the range starts at a sector boundary, and
+// ends at one or at the end of the file
+static int AGReadSectors(AGFile *file, uint8_t *buffer, sqlite3_int64 offset, int length) {
+    int rc = file->real->pMethods->xRead(file->real, buffer, length, offset);
+
+    if (rc != SQLITE_OK)
+        return rc;
+
+    for (int done = 0; done < length; done += AG_SECTOR_SIZE) {
+        AGCryptSector(file, (offset + done) / AG_SECTOR_SIZE, buffer + done,
+                      AG_MIN(AG_SECTOR_SIZE, length - done), 0);
+    }
+
+    return SQLITE_OK;
+}
+
+// reads what the file holds of a sector, the rest of the buffer is zeroed
+static int AGReadSector(AGFile *file, uint8_t *buffer, int capacity, sqlite3_int64 start, sqlite3_int64 fileSize) {
+    int existing = (int)AG_MIN(AG_MAX(fileSize - start, 0), capacity);
+
+    memset(buffer + existing, 0, capacity - existing);
+
+    return existing > 0 ? AGReadSectors(file, buffer, start, existing) : SQLITE_OK;
+}
+
+// encrypts and writes the given bytes, re-encrypting the parts of the
+// sectors at either end that the write doesn't cover
+static int AGWriteRange(AGFile *file, const uint8_t *data, int amount, sqlite3_int64 offset, sqlite3_int64 fileSize) {
+    sqlite3_int64 end = offset + amount;
+    sqlite3_int64 first = AGSectorStart(offset);
+    sqlite3_int64 last = AG_MIN(AGSectorStart(end + AG_SECTOR_SIZE - 1), AG_MAX(fileSize, end));
+    sqlite3_int64 lastStart = AGSectorStart(last - 1);
+    int length = (int)(last - first);
+
+    uint8_t *sectors = sqlite3_malloc(length);
+
+    if (!sectors)
+        return SQLITE_NOMEM;
+
+    int rc = SQLITE_OK;
+
+    if (offset > first)
+        rc = AGReadSector(file, sectors, (int)AG_MIN(AG_SECTOR_SIZE, length), first, fileSize);
+
+    if (rc == SQLITE_OK && end < last && !(lastStart == first && offset > first))
+        rc = AGReadSector(file, sectors + (lastStart - first), (int)(last - lastStart), lastStart, fileSize);
+
+    if (rc == SQLITE_OK) {
+        memcpy(sectors + (offset - first), data, amount);
+
+        for (int done = 0; done < length; done += AG_SECTOR_SIZE) {
+            AGCryptSector(file, (first + done) / AG_SECTOR_SIZE, sectors + done,
+                          AG_MIN(AG_SECTOR_SIZE, length - done), 1);
+        }
+
+        rc = file->real->pMethods->xWrite(file->real, sectors, length, first);
+    }
+
+    sqlite3_free(sectors);
+
+    return rc;
+}
+
+// the bytes past the end of a file read as zeros, so they are written encrypted
+static int AGZeroFill(AGFile *file, sqlite3_int64 from, sqlite3_int64 to) {
+    uint8_t *zeros = sqlite3_malloc(AG_ZERO_CHUNK_SIZE);
+
+    if (!zeros)
+        return SQLITE_NOMEM;
+
+    memset(zeros, 0, AG_ZERO_CHUNK_SIZE);
+
+    int rc = SQLITE_OK;
+
+    while (rc == SQLITE_OK && from < to) {
+        int amount = (int)AG_MIN(AG_ZERO_CHUNK_SIZE, to - from);
+
+        rc = AGWriteRange(file, zeros, amount, from, from);
+        from += amount;
+    }
+
+    sqlite3_free(zeros);
+
+    return rc;
+}
+
+#pragma mark - encrypted I/O methods
+
+static int AGRead(sqlite3_file *pFile, void *buffer, int amount, sqlite3_int64 offset) {
+    AGFile *file = (AGFile *)pFile;
+    sqlite3_int64 fileSize;
+
+    int rc = file->real->pMethods->xFileSize(file->real, &fileSize);
+
+    if (rc != SQLITE_OK)
+        return rc;
+
+    sqlite3_int64 end = AG_MIN(offset + amount, fileSize);
+    int available = end > offset ? (int)(end - offset) : 0;
+
+    if (available > 0) {
+        sqlite3_int64 first = AGSectorStart(offset);
+        sqlite3_int64 last = AG_MIN(AGSectorStart(end + AG_SECTOR_SIZE - 1), fileSize);
+
+        if (first == offset && last == end) {
+            // whole sectors (e.g. a page), decrypted in place
+            rc = AGReadSectors(file, buffer, first, available);
+        } else {
+            uint8_t *sectors = sqlite3_malloc((int)(last - first));
+
+            if (!sectors)
+                return SQLITE_NOMEM;
+
+            rc = AGReadSectors(file, sectors, first, (int)(last - first));
+
+            if (rc == SQLITE_OK)
+                memcpy(buffer, sectors + (offset - first), available);
+
+            sqlite3_free(sectors);
+        }
+
+        if (rc != SQLITE_OK)
+            return rc;
+    }
+
+    // SQLite expects the bytes past the end of the file to be zeroed
+    if (available < amount) {
+        memset((uint8_t *)buffer + available, 0, amount - available);
+        return SQLITE_IOERR_SHORT_READ;
+    }
+
+    return SQLITE_OK;
+}
+
+static int AGWrite(sqlite3_file *pFile, const void *buffer, int amount, sqlite3_int64 offset) {
+    AGFile *file = (AGFile *)pFile;
+    sqlite3_int64 fileSize;
+
+    int rc = file->real->pMethods->xFileSize(file->real, &fileSize);
+
+    if (rc == SQLITE_OK && offset > fileSize) {
+        rc = AGZeroFill(file, fileSize, offset);
+        fileSize = offset;
+    }
+
+    return rc == SQLITE_OK ? AGWriteRange(file, buffer, amount, offset, fileSize) : rc;
+}
+
+static int AGTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
+    AGFile *file = (AGFile *)pFile;
+    sqlite3_int64 fileSize;
+
+    int rc = file->real->pMethods->xFileSize(file->real, &fileSize);
+
+    if (rc != SQLITE_OK || size >= fileSize)
+        return rc == SQLITE_OK && size > fileSize ? AGZeroFill(file, fileSize, size) : rc;
+
+    // the sector cut short is encrypted again for its new length
+    sqlite3_int64 start = AGSectorStart(size);
+    int tail = (int)(size - start);
+    uint8_t sector[AG_SECTOR_SIZE];
+
+    if (tail > 0)
+        rc = AGReadSectors(file, sector, start, (int)AG_MIN(AG_SECTOR_SIZE, fileSize - start));
+
+    if (rc == SQLITE_OK)
+        rc = file->real->pMethods->xTruncate(file->real, size);
+
+    if (rc == SQLITE_OK && tail > 0) {
+        AGCryptSector(file, start / AG_SECTOR_SIZE, sector, tail, 1);
+        rc = file->real->pMethods->xWrite(file->real, sector, tail, start);
+    }
+
+    return rc;
+}
+
+static int AGFileControl(sqlite3_file *pFile, int op, void *arg) {
+    AGFile *file = (AGFile *)pFile;
+
+    // growing the file ahead of writes would leave unencrypted zeros in it
+    if (op == SQLITE_FCNTL_SIZE_HINT || op == SQLITE_FCNTL_CHUNK_SIZE)
+        return SQLITE_OK;
+
+    return file->real->pMethods->xFileControl(file->real, op, arg);
+}
+
+static int AGSectorSize(sqlite3_file *pFile) {
+    AGFile *file = (AGFile *)pFile;
+
+    return AG_MAX(file->real->pMethods->xSectorSize(file->real), AG_SECTOR_SIZE);
+}
+
+static int AGDeviceCharacteristics(sqlite3_file *pFile) {
+    AGFile *file = (AGFile *)pFile;
+
+    // writes rewrite whole sectors, so neither atomic nor safe appends can be promised
+    return file->real->pMethods->xDeviceCharacteristics(file->real)
+            & (SQLITE_IOCAP_SEQUENTIAL | SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN);
+}
+
+#pragma mark - pass-through I/O methods
+
+static int AGClose(sqlite3_file *pFile) {
+    AGFile *file = (AGFile *)pFile;
+
+    if (file->name) {
+        sqlite3_mutex_enter(AGMutex);
+
+        for (AGFile **entry = &AGOpenDatabases; *entry; entry = &(*entry)->next) {
+            if (*entry == file) {
+                *entry = file->next;
+                break;
+            }
+        }
+
+        sqlite3_mutex_leave(AGMutex);
+    }
+
+    int rc = file->real->pMethods->xClose(file->real);
+
+    AGReleaseCryptors(file);
+
+    return rc;
+}
+
+static int AGPlainRead(sqlite3_file *pFile, void *buffer, int amount, sqlite3_int64 offset) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xRead(file->real, buffer, amount, offset);
+}
+
+static int AGPlainWrite(sqlite3_file *pFile, const void *buffer, int amount, sqlite3_int64 offset) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xWrite(file->real, buffer, amount, offset);
+}
+
+static int AGPlainTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xTruncate(file->real, size);
+}
+
+static int AGPlainFileControl(sqlite3_file *pFile, int op, void *arg) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xFileControl(file->real, op, arg);
+}
+
+static int AGPlainSectorSize(sqlite3_file *pFile) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xSectorSize(file->real);
+}
+
+static int AGPlainDeviceCharacteristics(sqlite3_file *pFile) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xDeviceCharacteristics(file->real);
+}
+
+static int AGSync(sqlite3_file *pFile, int flags) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xSync(file->real, flags);
+}
+
+static int AGFileSize(sqlite3_file *pFile, sqlite3_int64 *size) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xFileSize(file->real, size);
+}
+
+static int AGLock(sqlite3_file *pFile, int lock) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xLock(file->real, lock);
+}
+
+static int AGUnlock(sqlite3_file *pFile, int lock) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xUnlock(file->real, lock);
+}
+
+static int AGCheckReservedLock(sqlite3_file *pFile, int *reserved) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xCheckReservedLock(file->real, reserved);
+}
+
+// the shared memory of the write-ahead log only holds page numbers and checksums
+static int AGShmMap(sqlite3_file *pFile, int region, int size, int extend, void volatile **memory) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xShmMap(file->real, region, size, extend, memory);
+}
+
+static int AGShmLock(sqlite3_file *pFile, int offset, int n, int flags) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xShmLock(file->real, offset, n, flags);
+}
+
+static void AGShmBarrier(sqlite3_file *pFile) {
+    AGFile *file = (AGFile *)pFile;
+    file->real->pMethods->xShmBarrier(file->real);
+}
+
+static int AGShmUnmap(sqlite3_file *pFile, int deleteFlag) {
+    AGFile *file = (AGFile *)pFile;
+    return file->real->pMethods->xShmUnmap(file->real, deleteFlag);
+}
+
+// version 2, without the memory-mapped I/O that would bypass the decryption
+static const sqlite3_io_methods AGEncryptedIOMethods = {
+    2,
+    AGClose,
+    AGRead,
+    AGWrite,
+    AGTruncate,
+    AGSync,
+    AGFileSize,
+    AGLock,
+    AGUnlock,
+    AGCheckReservedLock,
+    AGFileControl,
+    AGSectorSize,
+    AGDeviceCharacteristics,
+    AGShmMap,
+    AGShmLock,
+    AGShmBarrier,
+    AGShmUnmap
+};
+
+static const sqlite3_io_methods AGPlainIOMethods = {
+    2,
+    AGClose,
+    AGPlainRead,
+    AGPlainWrite,
+    AGPlainTruncate,
+    AGSync,
+    AGFileSize,
+    AGLock,
+    AGUnlock,
+    AGCheckReservedLock,
+    AGPlainFileControl,
+    AGPlainSectorSize,
+    AGPlainDeviceCharacteristics,
+    AGShmMap,
+    AGShmLock,
+    AGShmBarrier,
+    AGShmUnmap
+};
+
+#pragma mark - VFS methods
+
+static AGKeyEntry *AGFindKeyEntry(const char *keyId) {
+    for (AGKeyEntry *entry = AGKeyEntries; entry; entry = entry->next) {
+        if (strcmp(entry->keyId, keyId) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
+// journals and write-ahead logs are named after their database, e.g. "db-journal"
+static AGFile *AGFindOpenDatabase(const char *name) {
+    for (AGFile *file = AGOpenDatabases; file; file = file->next) {
+        size_t length = strlen(file->name);
+
+        if (strncmp(name, file->name, length) == 0 && name[length] == '-')
+            return file;
+    }
+
+    return NULL;
+}
+
+static int AGKeysForFile(const char *name, int flags, AGKeys *keys, int *encrypted) {
+    int rc = SQLITE_OK;
+
+    *encrypted = 1;
+
+    sqlite3_mutex_enter(AGMutex);
+
+    if (flags & SQLITE_OPEN_MAIN_DB) {
+        const char *keyId = name ? sqlite3_uri_parameter(name, "key") : NULL;
+        AGKeyEntry *entry = keyId ? AGFindKeyEntry(keyId) : NULL;
+
+        if (entry)
+            *keys = entry->keys;
+        else
+            rc = SQLITE_CANTOPEN;
+
+    } else if (flags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL)) {
+        AGFile *database = name ? AGFindOpenDatabase(name) : NULL;
+
+        if (database)
+            *keys = database->keys;
+        else
+            rc = SQLITE_CANTOPEN;
+
+    } else if (flags & SQLITE_OPEN_MASTER_JOURNAL) {
+        // only holds the names of the journals
+        *encrypted = 0;
+
+    } else {
+        *keys = AGTemporaryKeys;
+    }
+
+    sqlite3_mutex_leave(AGMutex);
+
+    return rc;
+}
+
+static int AGOpen(sqlite3_vfs *vfs, const char *name, sqlite3_file *pFile, int flags, int *outFlags) {
+    AGFile *file = (AGFile *)pFile;
+
+    memset(file, 0, sizeof(AGFile));
+    file->real = (sqlite3_file *)&file[1];
+
+    int rc = AGKeysForFile(name, flags, &file->keys, &file->encrypted);
+
+    if (rc == SQLITE_OK)
+        rc = AGRootVFS->xOpen(AGRootVFS, name, file->real, flags, outFlags);
+
+    if (rc != SQLITE_OK) {
+        memset(&file->keys, 0, sizeof(file->keys));
+        return rc;
+    }
+
+    if (file->encrypted && (rc = AGCreateCryptors(file)) != SQLITE_OK) {
+        file->real->pMethods->xClose(file->real);
+        AGReleaseCryptors(file);
+        return rc;
+    }
+
+    if (file->encrypted && (flags & SQLITE_OPEN_MAIN_DB)) {
+        file->name = name;
+
+        sqlite3_mutex_enter(AGMutex);
+        file->next = AGOpenDatabases;
+        AGOpenDatabases = file;
+        sqlite3_mutex_leave(AGMutex);
+    }
+
+    pFile->pMethods = file->encrypted ? &AGEncryptedIOMethods : &AGPlainIOMethods;
+
+    return SQLITE_OK;
+}
+
+static int AGDelete(sqlite3_vfs *vfs, const char *name, int syncDir) {
+    return AGRootVFS->xDelete(AGRootVFS, name, syncDir);
+}
+
+static int AGAccess(sqlite3_vfs *vfs, const char *name, int flags, int *result) {
+    return AGRootVFS->xAccess(AGRootVFS, name, flags, result);
+}
+
+static int AGFullPathname(sqlite3_vfs *vfs, const char *name, int length, char *output) {
+    return AGRootVFS->xFullPathname(AGRootVFS, name, length, output);
+}
+
+static void *AGDlOpen(sqlite3_vfs *vfs, const char *path) {
+    return AGRootVFS->xDlOpen(AGRootVFS, path);
+}
+
+static void AGDlError(sqlite3_vfs *vfs, int length, char *message) {
+    AGRootVFS->xDlError(AGRootVFS, length, message);
+}
+
+static void (*AGDlSym(sqlite3_vfs *vfs, void *handle, const char *symbol))(void) {
+    return AGRootVFS->xDlSym(AGRootVFS, handle, symbol);
+}
+
+static void AGDlClose(sqlite3_vfs *vfs, void *handle) {
+    AGRootVFS->xDlClose(AGRootVFS, handle);
+}
+
+static int AGRandomness(sqlite3_vfs *vfs, int length, char *output) {
+    return AGRootVFS->xRandomness(AGRootVFS, length, output);
+}
+
+static int AGSleep(sqlite3_vfs *vfs, int microseconds) {
+    return AGRootVFS->xSleep(AGRootVFS, microseconds);
+}
+
+static int AGCurrentTime(sqlite3_vfs *vfs, double *now) {
+    return AGRootVFS->xCurrentTime(AGRootVFS, now);
+}
+
+static int AGGetLastError(sqlite3_vfs *vfs, int length, char *message) {
+    return AGRootVFS->xGetLastError ? AGRootVFS->xGetLastError(AGRootVFS, length, message) : 0;
+}
+
+static int AGCurrentTimeInt64(sqlite3_vfs *vfs, sqlite3_int64 *now) {
+    if (AGRootVFS->iVersion >= 2 && AGRootVFS->xCurrentTimeInt64)
+        return AGRootVFS->xCurrentTimeInt64(AGRootVFS, now);
+
+    double julianDay;
+    int rc = AGRootVFS->xCurrentTime(AGRootVFS, &julianDay);
+    *now = (sqlite3_int64)(julianDay * 86400000.0);
+
+    return rc;
+}
+
+static sqlite3_vfs AGEncryptedVFS = {
+    2,                          // iVersion
+    0,                          // szOsFile, set on registration
+    0,                          // mxPathname, set on registration
+    NULL,                       // pNext
+    AG_ENCRYPTED_VFS_NAME,      // zName
+    NULL,                       // pAppData
+    AGOpen,
+    AGDelete,
+    AGAccess,
+    AGFullPathname,
+    AGDlOpen,
+    AGDlError,
+    AGDlSym,
+    AGDlClose,
+    AGRandomness,
+    AGSleep,
+    AGCurrentTime,
+    AGGetLastError,
+    AGCurrentTimeInt64
+};
+
+#pragma mark - public API
+
+static void AGRegister(void) {
+    sqlite3_vfs *root = sqlite3_vfs_find(NULL);
+    sqlite3_mutex *mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+
+    if (!root || !mutex) {
+        AGRegisterResult = SQLITE_NOMEM;
+        return;
+    }
+
+    AGRootVFS = root;
+    AGMutex = mutex;
+    root->xRandomness(root, sizeof(AGTemporaryKeys), (char *)&AGTemporaryKeys);
+
+    AGEncryptedVFS.szOsFile = (int)sizeof(AGFile) + root->szOsFile;
+    AGEncryptedVFS.mxPathname = root->mxPathname;
+
+    AGRegisterResult = sqlite3_vfs_register(&AGEncryptedVFS, 0);
+}
+
+int AGEncryptedVFSRegister(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, AGRegister);
+
+    return AGRegisterResult;
+}
+
+int AGEncryptedVFSSetKeys(const char *keyId, const void *dataKey, const void *tweakKey) {
+    int rc = AGEncryptedVFSRegister();
+
+    if (rc != SQLITE_OK)
+        return rc;
+
+    sqlite3_mutex_enter(AGMutex);
+
+    AGKeyEntry *entry = AGFindKeyEntry(keyId);
+
+    if (!entry) {
+        entry = sqlite3_malloc(sizeof(AGKeyEntry));
+        char *copy = sqlite3_mprintf("%s", keyId);
+
+        if (!entry || !copy) {
+            sqlite3_free(entry);
+            sqlite3_free(copy);
+            sqlite3_mutex_leave(AGMutex);
+            return SQLITE_NOMEM;
+        }
+
+        entry->keyId = copy;
+        entry->next = AGKeyEntries;
+        AGKeyEntries = entry;
+    }
+
+    memcpy(entry->keys.data, dataKey, AG_ENCRYPTED_VFS_KEY_LENGTH);
+    memcpy(entry->keys.tweak, tweakKey, AG_ENCRYPTED_VFS_KEY_LENGTH);
+
+    sqlite3_mutex_leave(AGMutex);
+
+    return SQLITE_OK;
+}
+
+void AGEncryptedVFSRemoveKeys(const char *keyId) {
+    if (AGEncryptedVFSRegister() != SQLITE_OK)
+        return;
+
+    sqlite3_mutex_enter(AGMutex);
+
+    for (AGKeyEntry **entry = &AGKeyEntries; *entry; entry = &(*entry)->next) {
+        if (strcmp((*entry)->keyId, keyId) == 0) {
+            AGKeyEntry *removed = *entry;
+            *entry = removed->next;
+
+            memset(&removed->keys, 0, sizeof(removed->keys));
+            sqlite3_free(removed->keyId);
+            sqlite3_free(removed);
+            break;
+        }
+    }
+
+    sqlite3_mutex_leave(AGMutex);
+}
@@ -0,0 +1,153 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The key, in the userInfo of the error of a rotation that skipped records, of the NSArray of the
+ * ids of the records that couldn't be decrypted.
+ */
+extern NSString * const AGKeyRotationFailedRecordIdsKey;
+
+/**
+ * Implemented by the stores whose records can be re-encrypted with a new key, record by record
+ * (see AGStoreConfig keyVersion). Used by AGKeyRotation.
+ */
+@protocol AGKeyRotatable <NSObject>
+
+/**
+ * Returns records encrypted with a previous key, without decrypting them.
+ *
+ * @param limit The maximum number of records returned.
+ * @param cursor On input, where the previous call left off, or nil to start from the first record.
+ *        On return, where this call left off. May be NULL.
+ *
+ * @return an NSDictionary with the encrypted data of each record, keyed by the record id;
+ *         empty once all the records past the cursor are encrypted with the current key.
+ */
+- (NSDictionary *)recordsEncryptedWithPreviousKeys:(NSUInteger)limit cursor:(id *)cursor;
+
+/**
+ * Decrypts the given records and encrypts them with the current key. The store is left untouched,
+ * so this can be called from any thread while the store is in use.
+ *
+ * @param records The records, as returned by recordsEncryptedWithPreviousKeys:cursor:.
+ * @param tokens On return, the blind index tokens of the records, keyed by the record id, if
+ *        fields are indexed (see AGStoreConfig indexedFields).
+ * @param error An error object containing details of why the re-encryption failed.
+ *
+ * @return an NSDictionary with the re-encrypted data of each record, leaving out the records that
+ *         couldn't be decrypted, or nil if the records couldn't be encrypted with the current key.
+ */
+- (NSDictionary *)reencryptRecords:(NSDictionary *)records tokens:(NSDictionary **)tokens error:(NSError **)error;
+
+/**
+ * Stores the re-encrypted records, except for those that were saved or removed since they were read.
+ *
+ * @param records The records, as returned by recordsEncryptedWithPreviousKeys:cursor:.
+ * @param reencryptedRecords The records, as returned by reencryptRecords:tokens:error:.
+ * @param tokens The tokens, as returned by reencryptRecords:tokens:error:.
+ * @param error An error object containing details of why the records couldn't be stored.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)replaceRecords:(NSDictionary *)records withReencryptedRecords:(NSDictionary *)reencryptedRecords
+                tokens:(NSDictionary *)tokens error:(NSError **)error;
+
+@end
+
+/**
+ Re-encrypts the records of an encrypted store with its current key, a small batch at a time, so that
+ rotating the key never stalls the application.
+
+ Each batch is read and stored on the main queue, in between the reads and writes of the application,
+ while the records are decrypted and encrypted on a background queue. Reading a batch resumes where the
+ previous one left off, so that it only costs the records it covers. Records saved in the meantime are
+ encrypted with the current key already, and are left alone. Since each record is tagged with the version
+ of its key, an interrupted rotation (e.g. by a restart) resumes by starting a new one.
+
+ Records that can't be decrypted (e.g. corrupted ones) are skipped rather than stopping the rotation,
+ and reported once it completes (see failedRecordIds).
+
+ ## Rotating the key of a store
+
+    id<AGStore> store = [manager store:^(id<AGStoreConfig> config) {
+      [config setName:@"secrets"];
+      [config setType:@"ENCRYPTED_SQLITE"];
+      [config setEncryptionService:newService];  // the new key
+      [config setKeyVersion:2];
+      [config setPreviousEncryptionServices:@{@1: oldService}];  // until the rotation completes
+    }];
+
+    AGKeyRotation *rotation = [[AGKeyRotation alloc] initWithStore:(id<AGKeyRotatable>)store];
+
+    [rotation start:^(NSError *error) {
+        if (!error)
+            // the previous key is no longer needed
+    }];
+
+ *NOTE:* The store must be used from the main queue while the rotation runs.
+ */
+@interface AGKeyRotation : NSObject
+
+/**
+ * The number of records re-encrypted at a time. Defaults to 64.
+ */
+@property (nonatomic, assign) NSUInteger batchSize;
+
+/**
+ * The number of records re-encrypted so far.
+ */
+@property (nonatomic, readonly) NSUInteger rotatedCount;
+
+/**
+ * The ids of the records that couldn't be decrypted, and are still encrypted with a previous key.
+ */
+@property (nonatomic, readonly) NSArray *failedRecordIds;
+
+/**
+ * Whether the rotation is running.
+ */
+@property (nonatomic, readonly, getter=isRunning) BOOL running;
+
+/**
+ * Creates a key rotation for the given store.
+ *
+ * @param store The store, i.e. an AGEncryptedMemoryStorage, AGEncryptedPropertyListStorage or
+ *        AGEncryptedSQLiteStorage.
+ *
+ * @return the newly created AGKeyRotation object.
+ */
+- (instancetype)initWithStore:(id<AGKeyRotatable>)store;
+
+/**
+ * Starts re-encrypting the records, unless the rotation is running already. Must be called from
+ * the main queue.
+ *
+ * @param completion A block object to be executed on the main queue once all the records are encrypted
+ *        with the current key, or the rotation failed or was cancelled. Its argument is nil on success.
+ *        If some records couldn't be decrypted, it is an error whose userInfo holds their ids under
+ *        AGKeyRotationFailedRecordIdsKey.
+ */
+- (void)start:(void (^)(NSError *error))completion;
+
+/**
+ * Stops the rotation once the current batch is stored. The completion block receives an error.
+ */
+- (void)cancel;
+
+@end
@@ -0,0 +1,144 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGKeyRotation.h"
+#import "AGStore.h"
+
+NSString * const AGKeyRotationFailedRecordIdsKey = @"AGKeyRotationFailedRecordIdsKey";
+
+static const NSUInteger kDefaultBatchSize = 64;
+
+@implementation AGKeyRotation {
+    id<AGKeyRotatable> _store;
+    
+    void (^_completion)(NSError *error);
+    BOOL _cancelled;
+    // where the last batch left off
+    id _cursor;
+    NSMutableArray *_failedRecordIds;
+}
+
+@synthesize batchSize = _batchSize;
+@synthesize rotatedCount = _rotatedCount;
+
+- (instancetype)initWithStore:(id<AGKeyRotatable>)store {
+    self = [super init];
+    if (self) {
+        _store = store;
+        _batchSize = kDefaultBatchSize;
+    }
+    
+    return self;
+}
+
+- (BOOL)isRunning {
+    return _completion != nil;
+}
+
+- (void)start:(void (^)(NSError *error))completion {
+    if (_completion)
+        return;
+    
+    _completion = [completion copy] ?: ^(NSError *error) {};
+    _cancelled = NO;
+    _cursor = nil;
+    _failedRecordIds = [[NSMutableArray alloc] init];
+    
+    [self rotateNextBatch];
+}
+
+- (void)cancel {
+    _cancelled = YES;
+}
+
+- (NSArray *)failedRecordIds {
+    return [_failedRecordIds copy];
+}
+
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
+// reads a batch on the main queue, re-encrypts it on a background
+// queue, and stores it back on the main queue
+- (void)rotateNextBatch {
+    if (_cancelled) {
+        [self finishWithError:[NSError errorWithDomain:AGStoreErrorDomain
+                                                  code:0
+                                              userInfo:@{NSLocalizedDescriptionKey: @"key rotation cancelled"}]];
+        return;
+    }
+    
+    id cursor = _cursor;
+    NSDictionary *records = [_store recordsEncryptedWithPreviousKeys:MAX(_batchSize, 1) cursor:&cursor];
+    _cursor = cursor;
+    
+    if ([records count] == 0) {
+        [self finishWithError:[self skippedRecordsError]];
+        return;
+    }
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        NSError *error;
+        NSDictionary *tokens;
+        NSDictionary *reencryptedRecords = [_store reencryptRecords:records tokens:&tokens error:&error];
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            NSError *storeError = error;
+            
+            if (!reencryptedRecords
+                    || ![_store replaceRecords:records withReencryptedRecords:reencryptedRecords tokens:tokens error:&storeError]) {
+                [self finishWithError:storeError ?: [NSError errorWithDomain:AGStoreErrorDomain
+                                                                        code:0
+                                                                    userInfo:@{NSLocalizedDescriptionKey: @"can't re-encrypt records!"}]];
+                return;
+            }
+            
+            _rotatedCount += [reencryptedRecords count];
+            
+            // the records that couldn't be decrypted are left behind the cursor
+            for (id recordId in records) {
+                if (!reencryptedRecords[recordId])
+                    [_failedRecordIds addObject:recordId];
+            }
+            
+            // let the application run in between batches
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self rotateNextBatch];
+            });
+        });
+    });
+}
+
+- (NSError *)skippedRecordsError {
+    if ([_failedRecordIds count] == 0)
+        return nil;
+    
+    return [NSError errorWithDomain:AGStoreErrorDomain
+                               code:0
+                           userInfo:@{NSLocalizedDescriptionKey: @"some records couldn't be decrypted, and were skipped",
+                                      AGKeyRotationFailedRecordIdsKey: [_failedRecordIds copy]}];
+}
+
+- (void)finishWithError:(NSError *)error {
+    void (^completion)(NSError *error) = _completion;
+    _completion = nil;
+    
+    completion(error);
+}
+
+@end
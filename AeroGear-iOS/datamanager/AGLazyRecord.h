@@ -0,0 +1,55 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "AGEncoder.h"
+
+/**
+ A record, as returned by the stores, that defers decoding of its encoded (and possibly encrypted)
+ representation until one of its fields is accessed.
+
+ The identifier of the record is known up-front, so reading it (e.g. to build a list of ids) doesn't
+ require any decoding at all. Neither do fields the encoder stores in plaintext (see AGStoreConfig
+ encryptedFields) require decryption. The first access to any other field decodes the representation into an
+ immutable dictionary, which is only copied into a mutable one if the record is modified.
+
+ *IMPORTANT:* Users are not required to instantiate this class directly, instead instances of this class are
+ returned by the stores configured with the _lazyDecoding_ option. See AGStoreConfig for more information.
+ */
+@interface AGLazyRecord : NSMutableDictionary
+
+/**
+ * Initialize a record from its encoded representation.
+ *
+ * @param data The encoded representation of the record.
+ * @param encoder The encoder used to decode the representation.
+ * @param recordId The id of the record.
+ * @param identifier The name of the field that holds the id of the record.
+ *
+ * @return the newly created AGLazyRecord object.
+ */
+- (instancetype)initWithData:(NSData *)data
+                     encoder:(id<AGEncoder>)encoder
+                    recordId:(id)recordId
+                  identifier:(NSString *)identifier;
+
+/**
+ * Whether the encoded representation has been decoded.
+ */
+@property (nonatomic, readonly, getter=isDecoded) BOOL decoded;
+
+@end
@@ -0,0 +1,164 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGLazyRecord.h"
+
+@implementation AGLazyRecord {
+    NSData *_data;
+    id<AGEncoder> _encoder;
+
+    id _recordId;
+    NSString *_identifier;
+
+    // the fields stored in plaintext, decoded on first access
+    NSDictionary *_plainFields;
+    // decoded on first access to any other field
+    NSDictionary *_fields;
+    // materialized on first mutation
+    NSMutableDictionary *_mutableFields;
+}
+
+- (instancetype)initWithData:(NSData *)data
+                     encoder:(id<AGEncoder>)encoder
+                    recordId:(id)recordId
+                  identifier:(NSString *)identifier {
+    self = [super init];
+    if (self) {
+        _data = data;
+        _encoder = encoder;
+        _recordId = recordId;
+        _identifier = identifier;
+    }
+
+    return self;
+}
+
+// the 'primitive' initializers, required when subclassing a class cluster
+
+- (instancetype)init {
+    return [self initWithCapacity:0];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)numItems {
+    self = [super init];
+    if (self) {
+        _mutableFields = [[NSMutableDictionary alloc] initWithCapacity:numItems];
+    }
+
+    return self;
+}
+
+- (instancetype)initWithObjects:(const id [])objects forKeys:(const id<NSCopying> [])keys count:(NSUInteger)cnt {
+    self = [super init];
+    if (self) {
+        _mutableFields = [[NSMutableDictionary alloc] initWithObjects:objects forKeys:keys count:cnt];
+    }
+
+    return self;
+}
+
+#pragma mark - NSDictionary primitive methods
+
+- (NSUInteger)count {
+    return [[self fields] count];
+}
+
+- (id)objectForKey:(id)key {
+    // no need to decode if only the id is requested
+    if (!self.isDecoded && _identifier && [key isEqual:_identifier])
+        return _recordId;
+
+    // fields stored in plaintext don't require decryption
+    if (!self.isDecoded) {
+        id value = [[self plainFields] objectForKey:key];
+
+        if (value)
+            return value;
+    }
+
+    return [[self fields] objectForKey:key];
+}
+
+- (NSEnumerator *)keyEnumerator {
+    return [[self fields] keyEnumerator];
+}
+
+#pragma mark - NSMutableDictionary primitive methods
+
+- (void)setObject:(id)object forKey:(id<NSCopying>)key {
+    [[self mutableFields] setObject:object forKey:key];
+}
+
+- (void)removeObjectForKey:(id)key {
+    [[self mutableFields] removeObjectForKey:key];
+}
+
+- (BOOL)isDecoded {
+    return _fields != nil || _mutableFields != nil;
+}
+
+#pragma mark - private helper methods
+
+- (NSDictionary *)fields {
+    if (_mutableFields)
+        return _mutableFields;
+
+    if (!_fields) {
+        id decoded = [_encoder decode:_data error:nil];
+
+        if (![decoded isKindOfClass:[NSDictionary class]])
+            decoded = @{};
+
+        // the id may not be part of the encoded representation
+        // (e.g. assigned by the database after the record was encoded)
+        if (_identifier && _recordId && ![decoded[_identifier] isEqual:_recordId]) {
+            _mutableFields = [decoded mutableCopy];
+            _mutableFields[_identifier] = _recordId;
+        } else {
+            _fields = decoded;
+        }
+
+        // no longer needed
+        _data = nil;
+        _encoder = nil;
+        _plainFields = nil;
+    }
+
+    return _mutableFields ? _mutableFields : _fields;
+}
+
+- (NSDictionary *)plainFields {
+    if (!_plainFields) {
+        id decoded = AGDecodeUnencrypted(_encoder, _data, nil);
+
+        // none if the whole representation has to be decoded
+        _plainFields = [decoded isKindOfClass:[NSDictionary class]] ? decoded : @{};
+    }
+
+    return _plainFields;
+}
+
+- (NSMutableDictionary *)mutableFields {
+    if (!_mutableFields) {
+        _mutableFields = [[self fields] mutableCopy];
+        _fields = nil;
+    }
+
+    return _mutableFields;
+}
+
+@end
@@ -55,24 +55,18 @@
         // extract file path
         _file = [AGBaseStorage storeURLWithName:storeConfig.name];
         
-        // if plist file exists initialize store from it
-        if ([[NSFileManager defaultManager] fileExistsAtPath:[_file path]]) {
-            // load file
-            NSData *data = [NSData dataWithContentsOfURL:_file];
-
-            NSError *error;
-
-            // decode structure
-            NSArray *list = [_encoder decode:data error:&error];
-           
-            if (!error) {
-                for (NSMutableDictionary *object in list) {
-                    [_memStorage save:object error:nil];
-                }
-                
-            } else { // log the error
-                NSLog(@"%@ %@: %@", [self class], NSStringFromSelector(_cmd), error);
-            }
+        // if plist file exists initialize store from it,
+        // decoding one record at a time
+        NSError *error;
+
+        BOOL success = [AGBaseStorage readFromURL:_file usingBlock:^BOOL(NSInputStream *stream, NSError **err) {
+            return AGDecodeRecordsFromStream(_encoder, stream, ^(id object, BOOL *stop) {
+                [_memStorage save:object error:nil];
+            }, err);
+        } error:&error];
+
+        if (!success) { // log the error
+            NSLog(@"%@ %@: %@", [self class], NSStringFromSelector(_cmd), error);
         }
     }
     
@@ -125,23 +119,11 @@
 // =====================================================
 
 - (BOOL)updateStore:(NSError **)error {
-    NSData *plist = [_encoder encode:[_memStorage readAll] error:error];
-    
-    if (!plist)
-        return NO;
-    
-    // since 'NSData:writeToFile' fails silently, construct an
-    // error object to inform client
-    if (![plist writeToURL:_file atomically:YES]) {
-        if (error)
-            *error = [NSError errorWithDomain:AGStoreErrorDomain
-                                         code:0
-                                     userInfo:@{NSLocalizedDescriptionKey: @"an error occurred during save!"}];
-        return NO;
-    }
-    
-    // if we reach here, file was saved successfully
-    return YES;
+    // stream the records to the file, so that the complete
+    // serialized form is never held in memory
+    return [AGBaseStorage writeToURL:_file usingBlock:^BOOL(NSOutputStream *stream, NSError **err) {
+        return AGEncodeRecordsToStream(_encoder, [_memStorage readAll], stream, err);
+    } error:error];
 }
 
 @end
@@ -0,0 +1,106 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ A bounded, in-memory cache of decoded records keyed by record id. When the total cost
+ of the cached records exceeds the configured capacity, the least recently used records
+ are evicted.
+
+ The cost of a record is provided by the caller, typically the size in bytes of the
+ encoded form of the record.
+
+ *NOTE:* Like the stores, the cache is not thread-safe.
+ */
+@interface AGRecordCache : NSObject
+
+/**
+ * The maximum total cost of the cached records.
+ */
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/**
+ * The total cost of the records currently cached.
+ */
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+/**
+ * The number of records currently cached.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * The number of lookups that found a cached record.
+ */
+@property (nonatomic, readonly) NSUInteger hits;
+
+/**
+ * The number of lookups that didn't find a cached record.
+ */
+@property (nonatomic, readonly) NSUInteger misses;
+
+/**
+ * The ratio of lookups that found a cached record, or 0 if no lookup has been performed yet.
+ */
+@property (nonatomic, readonly) double hitRate;
+
+/**
+ * Creates a new cache with the given capacity.
+ *
+ * @param capacity The maximum total cost of the cached records.
+ *
+ * @return the newly created AGRecordCache object.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ * Returns the cached record bound to the given key, and updates the hit-rate counters.
+ *
+ * @param key The record id.
+ *
+ * @return the record, or nil if it isn't cached.
+ */
+- (id)objectForKey:(id)key;
+
+/**
+ * Caches a record. Records with a cost larger than the capacity are not cached.
+ *
+ * @param object The record to cache.
+ * @param key The record id.
+ * @param cost The cost of the record.
+ */
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost;
+
+/**
+ * Removes the record bound to the given key.
+ *
+ * @param key The record id.
+ */
+- (void)removeObjectForKey:(id)key;
+
+/**
+ * Removes all the cached records.
+ */
+- (void)removeAllObjects;
+
+/**
+ * Resets the hit-rate counters.
+ */
+- (void)resetStatistics;
+
+@end
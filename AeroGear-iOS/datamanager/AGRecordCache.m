@@ -0,0 +1,126 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGRecordCache.h"
+
+@implementation AGRecordCache {
+    NSMutableDictionary *_objects;
+    NSMutableDictionary *_costs;
+    // keys ordered from the least to the most recently used
+    NSMutableOrderedSet *_keys;
+}
+
+@synthesize capacity = _capacity;
+@synthesize totalCost = _totalCost;
+@synthesize hits = _hits;
+@synthesize misses = _misses;
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _capacity = capacity;
+
+        _objects = [[NSMutableDictionary alloc] init];
+        _costs = [[NSMutableDictionary alloc] init];
+        _keys = [[NSMutableOrderedSet alloc] init];
+    }
+
+    return self;
+}
+
+- (NSUInteger)count {
+    return [_objects count];
+}
+
+- (double)hitRate {
+    NSUInteger lookups = _hits + _misses;
+
+    return lookups == 0 ? 0 : (double)_hits / lookups;
+}
+
+- (id)objectForKey:(id)key {
+    id object = _objects[key];
+
+    if (object) {
+        _hits++;
+
+        [self touchKey:key];
+    } else {
+        _misses++;
+    }
+
+    return object;
+}
+
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost {
+    [self removeObjectForKey:key];
+
+    if (!object || cost > _capacity)
+        return;
+
+    _objects[key] = object;
+    _costs[key] = @(cost);
+    [_keys addObject:key];
+    _totalCost += cost;
+
+    // evict least recently used records until within budget
+    while (_totalCost > _capacity)
+        [self removeObjectForKey:[_keys firstObject]];
+}
+
+- (void)removeObjectForKey:(id)key {
+    NSNumber *cost = _costs[key];
+
+    if (!cost)
+        return;
+
+    _totalCost -= [cost unsignedIntegerValue];
+
+    [_objects removeObjectForKey:key];
+    [_costs removeObjectForKey:key];
+    [_keys removeObject:key];
+}
+
+- (void)removeAllObjects {
+    [_objects removeAllObjects];
+    [_costs removeAllObjects];
+    [_keys removeAllObjects];
+
+    _totalCost = 0;
+}
+
+- (void)resetStatistics {
+    _hits = 0;
+    _misses = 0;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"%@ [count=%lu, cost=%lu/%lu, hitRate=%.2f]", self.class,
+            (unsigned long)self.count, (unsigned long)_totalCost, (unsigned long)_capacity, self.hitRate];
+}
+
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
+- (void)touchKey:(id)key {
+    NSUInteger index = [_keys indexOfObject:key];
+
+    [_keys moveObjectsAtIndexes:[NSIndexSet indexSetWithIndex:index] toIndex:[_keys count] - 1];
+}
+
+@end
@@ -18,6 +18,7 @@
 #import <Foundation/Foundation.h>
 
 @class FMDatabase;
+@class AGBlindIndex;
 @protocol AGEncoder;
 
 @interface AGSQLiteCommand : NSObject {
@@ -30,7 +31,34 @@
 - (instancetype)initWithDatabase:(FMDatabase *)database name:(NSString*)name recordId:(NSString*)recordId encoder:(id<AGEncoder>) encoder;
 - (BOOL)createTableWith:(NSDictionary*)value error:(NSError**)error;
 - (BOOL)save:(NSMutableDictionary *)value error:(NSError **)error;
+- (BOOL)saveAll:(NSArray *)values error:(NSError **)error;
 - (id)read:(NSString*) recordId;
+- (NSArray *)filter:(NSPredicate *)predicate;
 - (BOOL)reset:(NSError**)error;
 - (BOOL)remove:(id)record error:(NSError**)error;
+
+/**
+ * Key rotation, see AGKeyRotatable. Records are only found encrypted with a previous key if the
+ * encoder tags them with the version of its key (see AGEncryptedPListEncoder keyVersionTag).
+ */
+- (NSDictionary *)recordsEncryptedWithPreviousKeys:(NSUInteger)limit cursor:(id *)cursor;
+- (NSDictionary *)reencryptRecords:(NSDictionary *)records tokens:(NSDictionary **)tokens error:(NSError **)error;
+- (BOOL)replaceRecords:(NSDictionary *)records withReencryptedRecords:(NSDictionary *)reencryptedRecords
+                tokens:(NSDictionary *)tokens error:(NSError **)error;
+
+/**
+ * Whether read records are returned as AGLazyRecord objects.
+ */
+@property (nonatomic, assign) BOOL lazyDecoding;
+
+/**
+ * The blind index kept in the '<name>_index' table, or nil if no fields are indexed.
+ */
+@property (nonatomic, strong) AGBlindIndex *blindIndex;
+
+/**
+ * The fields the encoder encrypts on their own, or nil if it encrypts whole records. Predicates
+ * on the other fields are evaluated on the plaintext fields of the rows, before decrypting them.
+ */
+@property (nonatomic, copy) NSSet *encryptedFields;
 @end
\ No newline at end of file
@@ -19,6 +19,9 @@
 #import "FMDatabase.h"
 #import "AGEncoder.h"
 #import "AGStore.h"
+#import "AGBaseStorage.h"
+#import "AGLazyRecord.h"
+#import "AGBlindIndex.h"
 
 
 @implementation AGSQLiteCommand
@@ -38,41 +41,60 @@
         return NO;
     }
     
-    BOOL returnStatus = YES;
+    NSError *encodeError;
+    NSData *data = [_encoder encode:value error:&encodeError];
     
-    NSMutableString *builderString = [[NSMutableString alloc] init];
+    // e.g. the value isn't a property list, or couldn't be encrypted
+    if (!data) {
+        if (error) {
+            *error = encodeError ?: [NSError errorWithDomain:AGStoreErrorDomain
+                                                        code:0
+                                                    userInfo:@{NSLocalizedDescriptionKey: @"can't encode object!"}];
+        }
+        return NO;
+    }
     
-    NSData *data = [_encoder encode:value error:nil];
+    [_database open];
     
-    BOOL isNewRecord = (value[_recordId] == nil || [[self read:value[_recordId]] count] == 0);
+    BOOL returnStatus = [self saveValue:value data:data error:error];
     
-    if(isNewRecord) {
-        [builderString appendString:@"insert into "];
-        [builderString appendString:_tableName];
-        [builderString appendString:@" (oid, value) values (?, ?);"];
-    } else {
-        [builderString appendString:@"update "];
-        [builderString appendString:_tableName];
-        [builderString appendString:@" set value = ? where id = ?"];
+    [_database close];
+
+    return returnStatus;
+}
+
+- (BOOL)saveAll:(NSArray *)values error:(NSError **)error {
+    // encode (and encrypt) the records in batches, the
+    // database is only written once all of them succeed
+    NSError *encodeError;
+    NSArray *encodedValues = AGEncodeAll(_encoder, values, &encodeError);
+    
+    if (!encodedValues) {
+        if (error) {
+            *error = encodeError ?: [NSError errorWithDomain:AGStoreErrorDomain
+                                                        code:0
+                                                    userInfo:@{NSLocalizedDescriptionKey: @"can't encode object!"}];
+        }
+        return NO;
     }
     
+    BOOL returnStatus = YES;
+    
     [_database open];
+    [_database beginTransaction];
     
-    returnStatus = [_database executeUpdate:builderString, value[_recordId], data];
-
-    if (!returnStatus) {
-        if (error)
-            *error = [_database lastError];
+    for (NSUInteger i = 0; i < [values count] && returnStatus; i++) {
+        returnStatus = [self saveValue:values[i] data:encodedValues[i] error:error];
+    }
+    
+    if (returnStatus) {
+        [_database commit];
     } else {
-        // for a brand new record, we need to set the ID as generated by the DB
-        if (isNewRecord) {
-            long long int lastId = [_database lastInsertRowId];
-            [value setValue:[NSString stringWithFormat:@"%lld", lastId] forKey:_recordId];
-        }
+        [_database rollback];
     }
     
     [_database close];
-
+    
     return returnStatus;
 }
 
@@ -82,24 +104,7 @@
     id result;
     
     if(recordId == nil) {
-        dbResults = [_database executeQuery:[NSString stringWithFormat:@"select oid, value from %@", _tableName]];
-        NSMutableArray *results = [NSMutableArray array];
-        while([dbResults next]) {
-            NSData* readData = [dbResults dataForColumn:@"value"];
-            
-            NSMutableDictionary* val = [[_encoder decode:readData error:nil] mutableCopy];
-            
-            // fail fast if unable to deserialize caused by a mangled byte stream
-            if (!val) {
-                [_database close];
-                return nil;
-            }
-            
-            val[_recordId] = [dbResults stringForColumnIndex:0];
-            [results addObject:val];
-        }
-        
-        result = results ;
+        result = [self readRecordsWhere:nil];
         
     } else {
         dbResults = [_database executeQuery:[NSString stringWithFormat:@"select oid, value from %@ where oid = %@", _tableName, recordId]];
@@ -107,15 +112,20 @@
         
         if([dbResults next]) {
             NSData* readData = [dbResults dataForColumn:@"value"];
-            val = [[_encoder decode:readData error:nil] mutableCopy];
             
-            // fail fast if unable to deserialize caused by a mangled byte stream.
-            if (!val) {
-                [_database close];
-                return nil;
+            if (self.lazyDecoding) {
+                val = [self lazyRecordWithData:readData recordId:[dbResults stringForColumnIndex:0]];
+            } else {
+                val = [[_encoder decode:readData error:nil] mutableCopy];
+                
+                // fail fast if unable to deserialize caused by a mangled byte stream.
+                if (!val) {
+                    [_database close];
+                    return nil;
+                }
+                
+                val[_recordId] = [dbResults stringForColumnIndex:0];
             }
-            
-            val[_recordId] = [dbResults stringForColumnIndex:0];
         }
         
         result = val;
@@ -125,6 +135,78 @@
     return result;
 }
 
+-(NSArray *)filter:(NSPredicate *)predicate {
+    // predicates on plaintext fields are evaluated before decrypting anything
+    if ([self isUnencryptedPredicate:predicate]) {
+        [_database open];
+        
+        NSSet *recordIds = [self recordIdsMatchingUnencryptedPredicate:predicate];
+        NSArray *results = [self readRecordsWhere:[NSString stringWithFormat:@"oid in (%@)", [[recordIds allObjects] componentsJoinedByString:@", "]]];
+        
+        [_database close];
+        
+        return [results filteredArrayUsingPredicate:predicate];
+    }
+    
+    if (!self.blindIndex)
+        return [[self read:nil] filteredArrayUsingPredicate:predicate];
+    
+    [_database open];
+    
+    // the index table is missing if the fields were indexed after the records were saved
+    [_database executeUpdate:[self buildCreateIndexStatement]];
+    
+    NSSet *candidates = [self.blindIndex candidatesForPredicate:predicate lookup:^NSSet *(NSString *field, NSData *token) {
+        return [self recordIdsForQuery:[NSString stringWithFormat:@"select oid from %@_index where field = ? and token = ?", _tableName]
+                             arguments:@[field, token]];
+    }];
+    
+    NSArray *results;
+    
+    if (!candidates) {
+        // the index can't answer the predicate, decrypt everything
+        results = [self readRecordsWhere:nil];
+        
+    } else {
+        // records saved before a field was indexed can't be ruled out
+        NSMutableSet *unindexed = [NSMutableSet set];
+        
+        for (NSString *field in self.blindIndex.fields) {
+            [unindexed unionSet:[self recordIdsForQuery:[NSString stringWithFormat:@"select oid from %@ where oid not in (select oid from %@_index where field = ?)", _tableName, _tableName]
+                                              arguments:@[field]]];
+        }
+        
+        // nor can records encrypted with a previous key, their tokens are keyed by it too
+        NSData *tag = [self keyVersionTag];
+        
+        if (tag) {
+            [unindexed unionSet:[self recordIdsForQuery:[NSString stringWithFormat:@"select oid from %@ where substr(value, 1, ?) != ?", _tableName]
+                                              arguments:@[@([tag length]), tag]]];
+        }
+        
+        NSSet *recordIds = [candidates setByAddingObjectsFromSet:unindexed];
+        
+        // the ids are read from the database
+        results = [self readRecordsWhere:[NSString stringWithFormat:@"oid in (%@)", [[recordIds allObjects] componentsJoinedByString:@", "]]];
+        
+        // index them now that they are decrypted
+        if ([unindexed count] > 0 && results) {
+            [_database beginTransaction];
+            
+            for (NSMutableDictionary *record in results) {
+                if ([unindexed containsObject:record[_recordId]])
+                    [self updateIndexForValue:record];
+            }
+            
+            [_database commit];
+        }
+    }
+    
+    [_database close];
+    
+    return [results filteredArrayUsingPredicate:predicate];
+}
+
 -(BOOL) createTableWith:(NSDictionary*)value error:(NSError**)error {
     BOOL statusCode = YES;
     NSString *createStatement = [self buildCreateStatementWithValue:value];
@@ -133,6 +215,12 @@
     
     if (createStatement) {
         statusCode = [_database executeUpdate:createStatement];
+        
+        if (statusCode && self.blindIndex) {
+            statusCode = [_database executeUpdate:[self buildCreateIndexStatement]]
+                && [_database executeUpdate:[NSString stringWithFormat:@"create index if not exists %@_index_token on %@_index (field, token);", _tableName, _tableName]];
+        }
+        
         if (!statusCode && error) {
             *error = [_database lastError];
         }
@@ -158,6 +246,11 @@
     
     if (dropStatement) {
         statusCode = [_database executeUpdate:dropStatement];
+        
+        if (statusCode && self.blindIndex) {
+            statusCode = [_database executeUpdate:[NSString stringWithFormat:@"drop table if exists %@_index;", _tableName]];
+        }
+        
         if (!statusCode && error) {
             *error = [_database lastError];
         }
@@ -191,6 +284,10 @@
             
             statusCode = [_database executeUpdate:deleteStatement];
             
+            if (statusCode && self.blindIndex) {
+                statusCode = [_database executeUpdate:[NSString stringWithFormat:@"delete from %@_index where oid = ?", _tableName], idString];
+            }
+            
             if (!statusCode && error) {
                 *error = [_database lastError];
             }
@@ -218,9 +315,261 @@
     return statusCode;
 }
 
+-(NSDictionary *) recordsEncryptedWithPreviousKeys:(NSUInteger)limit cursor:(id *)cursor {
+    NSMutableDictionary *records = [NSMutableDictionary dictionary];
+    NSData *tag = [self keyVersionTag];
+    
+    if (!tag)
+        return records;
+    
+    // the cursor is the last oid read, so that each batch resumes where the previous one left off
+    NSNumber *lastId = (cursor ? *cursor : nil) ?: @0;
+    
+    [_database open];
+    
+    // the tags are compared, nothing is decrypted
+    FMResultSet *dbResults = [_database executeQuery:[NSString stringWithFormat:@"select oid, value from %@ where oid > ? and substr(value, 1, ?) != ? order by oid limit ?", _tableName],
+                              lastId, @([tag length]), tag, @(limit)];
+    
+    while ([dbResults next]) {
+        records[[dbResults stringForColumnIndex:0]] = [dbResults dataForColumn:@"value"];
+        lastId = @([dbResults longLongIntForColumnIndex:0]);
+    }
+    
+    [_database close];
+    
+    if (cursor)
+        *cursor = lastId;
+    
+    return records;
+}
+
+-(NSDictionary *) reencryptRecords:(NSDictionary *)records tokens:(NSDictionary **)tokens error:(NSError **)error {
+    // only tagged records are read, and the records that can't be decrypted are left out
+    NSDictionary *decoded = [(AGEncryptedPListEncoder *)_encoder decodeRecords:records];
+    NSArray *recordIds = [decoded allKeys];
+    
+    NSArray *values = [decoded objectsForKeys:recordIds notFoundMarker:[NSNull null]];
+    NSArray *encodedValues = AGEncodeAll(_encoder, values, error);
+    
+    if (!encodedValues)
+        return nil;
+    
+    // the tokens are keyed by the current key as well
+    if (tokens && self.blindIndex) {
+        NSMutableDictionary *recordTokens = [NSMutableDictionary dictionaryWithCapacity:[recordIds count]];
+        
+        [recordIds enumerateObjectsUsingBlock:^(NSString *recordId, NSUInteger idx, BOOL *stop) {
+            recordTokens[recordId] = [self.blindIndex tokensForRecord:values[idx]];
+        }];
+        
+        *tokens = recordTokens;
+    }
+    
+    return [NSDictionary dictionaryWithObjects:encodedValues forKeys:recordIds];
+}
+
+-(BOOL) replaceRecords:(NSDictionary *)records withReencryptedRecords:(NSDictionary *)reencryptedRecords
+                tokens:(NSDictionary *)tokens error:(NSError **)error {
+    BOOL returnStatus = YES;
+    
+    [_database open];
+    [_database beginTransaction];
+    
+    // the index table is missing if the fields were indexed after the records were saved
+    if (self.blindIndex)
+        returnStatus = [_database executeUpdate:[self buildCreateIndexStatement]];
+    
+    for (NSString *recordId in reencryptedRecords) {
+        if (!returnStatus)
+            break;
+        
+        // records saved (or removed) in the meantime are left alone
+        returnStatus = [_database executeUpdate:[NSString stringWithFormat:@"update %@ set value = ? where oid = ? and value = ?;", _tableName],
+                        reencryptedRecords[recordId], recordId, records[recordId]];
+        
+        if (returnStatus && [_database changes] > 0 && tokens[recordId])
+            returnStatus = [self updateIndexWithTokens:tokens[recordId] recordId:recordId];
+    }
+    
+    if (returnStatus) {
+        [_database commit];
+    } else {
+        if (error)
+            *error = [_database lastError];
+        
+        [_database rollback];
+    }
+    
+    [_database close];
+    
+    return returnStatus;
+}
+
 // =====================================================
 // ======== private methods                     ========
 // =====================================================
+-(BOOL) saveValue:(NSMutableDictionary *)value data:(NSData *)data error:(NSError **)error {
+    NSString *statement;
+    NSArray *arguments;
+    
+    BOOL isNewRecord = (value[_recordId] == nil || ![self recordExists:value[_recordId]]);
+    
+    if(isNewRecord) {
+        statement = [NSString stringWithFormat:@"insert into %@ (oid, value) values (?, ?);", _tableName];
+        arguments = @[value[_recordId] ?: [NSNull null], data];
+    } else {
+        statement = [NSString stringWithFormat:@"update %@ set value = ? where oid = ?;", _tableName];
+        arguments = @[data, value[_recordId]];
+    }
+    
+    BOOL returnStatus = [_database executeUpdate:statement withArgumentsInArray:arguments];
+    
+    if (!returnStatus) {
+        if (error)
+            *error = [_database lastError];
+    } else {
+        // for a brand new record, we need to set the ID as generated by the DB
+        if (isNewRecord) {
+            long long int lastId = [_database lastInsertRowId];
+            [value setValue:[NSString stringWithFormat:@"%lld", lastId] forKey:_recordId];
+        }
+        
+        returnStatus = [self updateIndexForValue:value];
+        
+        if (!returnStatus && error)
+            *error = [_database lastError];
+    }
+    
+    return returnStatus;
+}
+
+-(BOOL) updateIndexForValue:(NSDictionary *)value {
+    if (!self.blindIndex)
+        return YES;
+    
+    return [self updateIndexWithTokens:[self.blindIndex tokensForRecord:value] recordId:value[_recordId]];
+}
+
+-(BOOL) updateIndexWithTokens:(NSDictionary *)tokens recordId:(id)recordId {
+    BOOL returnStatus = [_database executeUpdate:[NSString stringWithFormat:@"delete from %@_index where oid = ?", _tableName], recordId];
+    
+    // a row per indexed field, even without a value (empty token), marks the record as indexed
+    for (NSString *field in tokens) {
+        if (!returnStatus)
+            break;
+        
+        returnStatus = [_database executeUpdate:[NSString stringWithFormat:@"insert into %@_index (oid, field, token) values (?, ?, ?);", _tableName],
+                        recordId, field, tokens[field]];
+    }
+    
+    return returnStatus;
+}
+
+// the tag of the records encrypted with the current key, or nil if the encoder doesn't tag them
+-(NSData *) keyVersionTag {
+    if (![_encoder isKindOfClass:[AGEncryptedPListEncoder class]])
+        return nil;
+    
+    return [(AGEncryptedPListEncoder *)_encoder keyVersionTag];
+}
+
+-(NSSet *) recordIdsForQuery:(NSString *)query arguments:(NSArray *)arguments {
+    FMResultSet *dbResults = [_database executeQuery:query withArgumentsInArray:arguments];
+    NSMutableSet *recordIds = [NSMutableSet set];
+    
+    while ([dbResults next]) {
+        [recordIds addObject:[dbResults stringForColumnIndex:0]];
+    }
+    
+    return recordIds;
+}
+
+-(BOOL) isUnencryptedPredicate:(NSPredicate *)predicate {
+    if ([self.encryptedFields count] == 0)
+        return NO;
+    
+    NSSet *fields = [AGBaseStorage fieldsOfPredicate:predicate];
+    
+    return fields && ![fields intersectsSet:self.encryptedFields];
+}
+
+// the ids of the records whose plaintext fields match, the database must be open
+-(NSSet *) recordIdsMatchingUnencryptedPredicate:(NSPredicate *)predicate {
+    FMResultSet *dbResults = [_database executeQuery:[NSString stringWithFormat:@"select oid, value from %@", _tableName]];
+    NSMutableSet *recordIds = [NSMutableSet set];
+    
+    while ([dbResults next]) {
+        NSString *recordId = [dbResults stringForColumnIndex:0];
+        NSMutableDictionary *plainFields = [AGDecodeUnencrypted(_encoder, [dbResults dataForColumn:@"value"], nil) mutableCopy];
+        
+        // records encrypted as a whole (e.g. saved before the fields were configured) can't be ruled out
+        if (plainFields)
+            plainFields[_recordId] = recordId;
+        
+        if (!plainFields || [predicate evaluateWithObject:plainFields])
+            [recordIds addObject:recordId];
+    }
+    
+    return recordIds;
+}
+
+-(BOOL) recordExists:(id)recordId {
+    FMResultSet *dbResults = [_database executeQuery:[NSString stringWithFormat:@"select oid from %@ where oid = ?", _tableName], recordId];
+    
+    BOOL exists = [dbResults next];
+    [dbResults close];
+    
+    return exists;
+}
+
+// reads the records matching the condition, the database must be open
+-(NSArray *) readRecordsWhere:(NSString *)condition {
+    NSString *query = [NSString stringWithFormat:@"select oid, value from %@", _tableName];
+    
+    if (condition)
+        query = [query stringByAppendingFormat:@" where %@", condition];
+    
+    FMResultSet *dbResults = [_database executeQuery:query];
+    NSMutableArray *results = [NSMutableArray array];
+    NSMutableArray *recordIds = [NSMutableArray array];
+    while([dbResults next]) {
+        NSData* readData = [dbResults dataForColumn:@"value"];
+        
+        if (self.lazyDecoding) {
+            [results addObject:[self lazyRecordWithData:readData recordId:[dbResults stringForColumnIndex:0]]];
+            continue;
+        }
+        
+        [results addObject:readData];
+        [recordIds addObject:[dbResults stringForColumnIndex:0]];
+    }
+    
+    if (!self.lazyDecoding) {
+        // decode (and decrypt) the records in batches
+        NSArray *decoded = AGDecodeAll(_encoder, results, nil);
+        
+        // fail fast if unable to deserialize caused by a mangled byte stream
+        if (!decoded)
+            return nil;
+        
+        results = [NSMutableArray arrayWithCapacity:[decoded count]];
+        
+        [decoded enumerateObjectsUsingBlock:^(NSDictionary *val, NSUInteger idx, BOOL *stop) {
+            NSMutableDictionary *record = [val mutableCopy];
+            record[_recordId] = recordIds[idx];
+            
+            [results addObject:record];
+        }];
+    }
+    
+    return results;
+}
+
+-(AGLazyRecord *) lazyRecordWithData:(NSData *)data recordId:(NSString *)recordId {
+    return [[AGLazyRecord alloc] initWithData:data encoder:_encoder recordId:recordId identifier:_recordId];
+}
+
 -(NSString *) buildDeleteStatementForId:(id)record {
     NSMutableString *statement = nil;
     
@@ -265,6 +614,10 @@
     return statement;
 }
 
+-(NSString *) buildCreateIndexStatement {
+    return [NSString stringWithFormat:@"create table if not exists %@_index (oid integer, field text, token blob);", _tableName];
+}
+
 -(NSString *) buildDropStatement {
     NSMutableString *statement = nil;
     if(_tableName != nil && [_tableName isKindOfClass:[NSString class]]) {
@@ -44,6 +44,7 @@
         _database = [FMDatabase databaseWithPath:[file path]];
         _encoder = [[AGPListEncoder alloc] init];
         _command = [[AGSQLiteCommand alloc] initWithDatabase:_database name:_databaseName recordId:_recordId encoder:_encoder];
+        _command.lazyDecoding = config.lazyDecoding;
     }
     
     return self;
@@ -63,8 +64,7 @@
 
 
 -(NSArray*) filter:(NSPredicate*)predicate {
-    NSArray* results = [self readAll];
-    return [results filteredArrayUsingPredicate:predicate];
+    return [_command filter:predicate];
 }
 
 
@@ -86,9 +86,8 @@
             }
 
             statusCode = [_command createTableWith: data[0] error:error];
-
-            for (id record in data) {
-                statusCode = [self saveOne:record error:error];
+            if (statusCode) {
+                statusCode = [_command saveAll:data error:error];
             }
 
         } else if([data isKindOfClass:[NSDictionary class]]) {
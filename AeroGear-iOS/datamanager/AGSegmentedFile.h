@@ -0,0 +1,97 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "AGEncoder.h"
+
+/**
+ A dictionary persisted to a segmented, append-only file, which stores are built upon so that
+ saving a record writes only that record's bytes.
+
+ Every change is appended to a log as a record (the key and the value's bytes). An offset table
+ locating the live values is kept in memory and checkpointed to a companion _.idx_ file from time to
+ time, so that opening the file reads the offset table and only the changes appended since the last
+ checkpoint. Values are read from the file when accessed. Once superseded and removed values take up
+ more space than the live ones, the file is compacted in the background.
+
+ Keys must be property list objects (e.g. NSString or NSNumber). Values must be NSData objects, unless
+ an encoder is given to encode and decode them.
+
+ *NOTE:* As NSMutableDictionary methods can't report errors, write failures are recorded and reported
+ by the next call of flush:, which also makes the changes durable. Changes that haven't been flushed
+ may be lost on a crash.
+
+ *IMPORTANT:* Users are not required to instantiate this class directly, it is used internally by the
+ encrypted "plist" store.
+ */
+@interface AGSegmentedFile : NSMutableDictionary
+
+/**
+ * Opens (or creates) a segmented file.
+ *
+ * @param url The URL of the file, or nil to keep the dictionary in memory only.
+ * @param encoder The encoder used for the values, or nil if the values are NSData objects.
+ * @param error An error object containing details of why the file couldn't be opened.
+ *
+ * @return the newly created AGSegmentedFile object, or nil if the file couldn't be opened
+ *         (e.g. because it isn't a segmented file).
+ */
+- (instancetype)initWithURL:(NSURL *)url encoder:(id<AGEncoder>)encoder error:(NSError **)error;
+
+/**
+ * Checks whether the file at the given URL is a segmented file.
+ *
+ * @param url The URL of the file.
+ *
+ * @return YES if the file is a segmented file, otherwise NO.
+ */
++ (BOOL)isSegmentedFileAtURL:(NSURL *)url;
+
+/**
+ * Syncs the changes made so far to permanent storage, and reports the first write failure
+ * since the last call, if any.
+ *
+ * @param error An error object containing details of why a write (or the sync) failed.
+ *
+ * @return YES if all writes succeeded and are durable, otherwise NO.
+ */
+- (BOOL)flush:(NSError **)error;
+
+/**
+ * Writes the offset table, so that the next open doesn't need to read the changes appended so far.
+ *
+ * @param error An error object containing details of why the offset table couldn't be written.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)checkpoint:(NSError **)error;
+
+/**
+ * Compacts the file right away, rather than waiting for it to be done in the background.
+ *
+ * @param error An error object containing details of why the compaction failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)compact:(NSError **)error;
+
+/**
+ * The size of the file, in bytes.
+ */
+@property (nonatomic, readonly) unsigned long long fileSize;
+
+@end
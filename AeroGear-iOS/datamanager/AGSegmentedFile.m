@@ -0,0 +1,858 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGSegmentedFile.h"
+#import "AGStore.h"
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+// the file format:
+//
+//   header: 'AGSF' | version (uint32) | file id (16 bytes)
+//   record: operation (uint8) | key length (uint32) | value length (uint32) | key | value
+//
+// integers are big-endian and keys are binary property lists. The file id
+// changes whenever the file is truncated or compacted, so that an offset
+// table checkpointed for another incarnation of the file is never used.
+static const char kMagic[4] = {'A', 'G', 'S', 'F'};
+static const uint32_t kVersion = 1;
+static const NSUInteger kFileIdLength = 16;
+static const off_t kHeaderLength = 4 + 4 + kFileIdLength;
+static const NSUInteger kRecordHeaderLength = 1 + 4 + 4;
+
+static const uint8_t kPutOperation = 1;
+static const uint8_t kRemoveOperation = 2;
+
+// bytes appended after which the offset table is checkpointed, at the least. As writing the
+// table costs in proportion to the live records, the budget grows with them (see didAppendRecord)
+static const off_t kMinCheckpointBytes = 256 * 1024;
+// superseded bytes tolerated before compacting, in addition to the live ones
+static const unsigned long long kMinCompactionBytes = 256 * 1024;
+
+// the location of a value in the file
+@interface AGSegmentEntry : NSObject
+@property (nonatomic, assign) off_t offset;
+@property (nonatomic, assign) uint32_t length;
+// the length of the whole record holding the value
+@property (nonatomic, assign) uint32_t recordLength;
+@end
+
+@implementation AGSegmentEntry
+@end
+
+static NSError *AGPOSIXError(NSString *description) {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain
+                               code:errno
+                           userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+static BOOL AGReadFully(int fd, void *buffer, size_t length, off_t offset) {
+    size_t total = 0;
+
+    while (total < length) {
+        ssize_t result = pread(fd, (uint8_t *)buffer + total, length - total, offset + total);
+
+        if (result < 0 && errno == EINTR)
+            continue;
+
+        if (result <= 0)
+            return NO;
+
+        total += result;
+    }
+
+    return YES;
+}
+
+static BOOL AGWriteFully(int fd, const void *buffer, size_t length, off_t offset) {
+    size_t total = 0;
+
+    while (total < length) {
+        ssize_t result = pwrite(fd, (const uint8_t *)buffer + total, length - total, offset + total);
+
+        if (result < 0 && errno == EINTR)
+            continue;
+
+        if (result <= 0)
+            return NO;
+
+        total += result;
+    }
+
+    return YES;
+}
+
+// flushes the file to permanent storage; fsync alone leaves it in the drive's cache on Darwin
+static BOOL AGSyncFile(int fd) {
+#ifdef F_FULLFSYNC
+    if (fcntl(fd, F_FULLFSYNC) == 0)
+        return YES;
+#endif
+
+    return fsync(fd) == 0;
+}
+
+static BOOL AGSyncDirectory(NSURL *url) {
+    int fd = open([[url path] fileSystemRepresentation], O_RDONLY);
+
+    if (fd < 0)
+        return NO;
+
+    BOOL success = AGSyncFile(fd);
+    close(fd);
+
+    return success;
+}
+
+@implementation AGSegmentedFile {
+    NSURL *_url;
+    NSURL *_indexURL;
+    id<AGEncoder> _encoder;
+
+    // the values, when kept in memory only
+    NSMutableDictionary *_values;
+
+    int _fd;
+    NSData *_fileId;
+    // where the next record is appended
+    off_t _length;
+    // key -> AGSegmentEntry
+    NSMutableDictionary *_table;
+    unsigned long long _liveBytes;
+    // the length of the file covered by the last checkpoint
+    off_t _checkpointLength;
+    // whether the file changed since it was last synced by flush:
+    BOOL _unsynced;
+
+    // serializes all access to the file and the offset table
+    dispatch_queue_t _queue;
+    BOOL _compacting;
+    // changes when the file is truncated, which invalidates a running compaction
+    NSUInteger _generation;
+
+    NSError *_lastError;
+}
+
+// ==============================================
+// ======== 'factory' and 'init' section ========
+// ==============================================
+
+- (instancetype)init {
+    return [self initWithURL:nil encoder:nil error:nil];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)numItems {
+    return [self init];
+}
+
+- (instancetype)initWithObjects:(const id [])objects forKeys:(const id<NSCopying> [])keys count:(NSUInteger)count {
+    self = [self init];
+    if (self) {
+        for (NSUInteger i = 0; i < count; i++)
+            [self setObject:objects[i] forKey:keys[i]];
+    }
+
+    return self;
+}
+
+- (instancetype)initWithURL:(NSURL *)url encoder:(id<AGEncoder>)encoder error:(NSError **)error {
+    self = [super init];
+    if (self) {
+        _encoder = encoder;
+        _fd = -1;
+        _table = [[NSMutableDictionary alloc] init];
+        _queue = dispatch_queue_create("org.jboss.aerogear.segmentedfile", DISPATCH_QUEUE_SERIAL);
+
+        if (!url) {
+            _values = [[NSMutableDictionary alloc] init];
+            return self;
+        }
+
+        _url = url;
+        _indexURL = [url URLByAppendingPathExtension:@"idx"];
+
+        if (![self openFile:error])
+            return nil;
+    }
+
+    return self;
+}
+
++ (BOOL)isSegmentedFileAtURL:(NSURL *)url {
+    NSFileHandle *file = [NSFileHandle fileHandleForReadingFromURL:url error:nil];
+    NSData *magic = [file readDataOfLength:sizeof(kMagic)];
+    [file closeFile];
+
+    return [magic isEqualToData:[NSData dataWithBytes:kMagic length:sizeof(kMagic)]];
+}
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        if (_length > _checkpointLength)
+            [self writeCheckpoint:nil];
+
+        close(_fd);
+    }
+}
+
+// =====================================================
+// ======== NSMutableDictionary primitives      ========
+// =====================================================
+
+- (NSUInteger)count {
+    __block NSUInteger count;
+
+    dispatch_sync(_queue, ^{
+        count = _values ? [_values count] : [_table count];
+    });
+
+    return count;
+}
+
+- (id)objectForKey:(id)key {
+    if (!key)
+        return nil;
+
+    __block id object;
+
+    dispatch_sync(_queue, ^{
+        if (_values) {
+            object = _values[key];
+            return;
+        }
+
+        AGSegmentEntry *entry = _table[key];
+
+        if (entry)
+            object = [self readEntry:entry fromFile:_fd];
+    });
+
+    // decoding doesn't need to hold up other readers
+    if (_encoder && !_values && object)
+        object = [_encoder decode:object error:nil];
+
+    return object;
+}
+
+- (NSEnumerator *)keyEnumerator {
+    __block NSArray *keys;
+
+    dispatch_sync(_queue, ^{
+        keys = _values ? [_values allKeys] : [_table allKeys];
+    });
+
+    return [keys objectEnumerator];
+}
+
+- (void)setObject:(id)object forKey:(id<NSCopying>)key {
+    if (!object || !key)
+        [NSException raise:NSInvalidArgumentException format:@"object and key can't be nil"];
+
+    NSError *encodeError;
+    NSData *value = (_encoder && !_values) ? [_encoder encode:object error:&encodeError] : object;
+
+    dispatch_sync(_queue, ^{
+        if (_values) {
+            _values[key] = object;
+            return;
+        }
+
+        NSError *writeError = encodeError;
+        AGSegmentEntry *entry = value ? [self appendOperation:kPutOperation key:key value:value error:&writeError] : nil;
+
+        if (!entry) {
+            [self recordError:writeError];
+            return;
+        }
+
+        [self removeEntryForKey:key];
+
+        _table[key] = entry;
+        _liveBytes += entry.recordLength;
+
+        [self didAppendRecord];
+    });
+}
+
+- (void)removeObjectForKey:(id)key {
+    dispatch_sync(_queue, ^{
+        if (_values) {
+            [_values removeObjectForKey:key];
+            return;
+        }
+
+        if (!_table[key])
+            return;
+
+        NSError *writeError;
+
+        if (![self appendOperation:kRemoveOperation key:key value:[NSData data] error:&writeError]) {
+            [self recordError:writeError];
+            return;
+        }
+
+        [self removeEntryForKey:key];
+
+        [self didAppendRecord];
+    });
+}
+
+- (void)removeAllObjects {
+    dispatch_sync(_queue, ^{
+        if (_values) {
+            [_values removeAllObjects];
+            return;
+        }
+
+        NSError *writeError;
+
+        _generation++;
+
+        if (ftruncate(_fd, kHeaderLength) != 0) {
+            [self recordError:AGPOSIXError(@"unable to truncate file")];
+            return;
+        }
+
+        // a new incarnation of the file
+        _unsynced = YES;
+        [_table removeAllObjects];
+        _liveBytes = 0;
+        _length = kHeaderLength;
+        _checkpointLength = kHeaderLength;
+
+        if (![self writeHeaderToFile:_fd error:&writeError] || ![self writeCheckpoint:&writeError])
+            [self recordError:writeError];
+    });
+}
+
+// =====================================================
+// ======== public API                          ========
+// =====================================================
+
+- (BOOL)flush:(NSError **)error {
+    __block NSError *lastError;
+
+    dispatch_sync(_queue, ^{
+        // the appends are serialized on the queue, a single sync makes all of them durable
+        if (_unsynced) {
+            if (AGSyncFile(_fd))
+                _unsynced = NO;
+            else
+                [self recordError:AGPOSIXError(@"unable to sync file")];
+        }
+
+        lastError = _lastError;
+        _lastError = nil;
+    });
+
+    if (lastError && error)
+        *error = lastError;
+
+    return lastError == nil;
+}
+
+- (BOOL)checkpoint:(NSError **)error {
+    __block BOOL success = YES;
+    __block NSError *checkpointError;
+
+    dispatch_sync(_queue, ^{
+        NSError *writeError;
+
+        if (!_values && ![self writeCheckpoint:&writeError]) {
+            checkpointError = writeError;
+            success = NO;
+        }
+    });
+
+    if (!success && error)
+        *error = checkpointError;
+
+    return success;
+}
+
+- (BOOL)compact:(NSError **)error {
+    __block BOOL running;
+
+    dispatch_sync(_queue, ^{
+        running = _compacting || _values;
+
+        if (!running)
+            _compacting = YES;
+    });
+
+    // a background compaction is on its way (or there's no file)
+    if (running)
+        return YES;
+
+    return [self compactFile:error];
+}
+
+- (unsigned long long)fileSize {
+    __block off_t length;
+
+    dispatch_sync(_queue, ^{
+        length = _values ? 0 : _length;
+    });
+
+    return length;
+}
+
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
+- (BOOL)openFile:(NSError **)error {
+    _fd = open([[_url path] fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+
+    if (_fd < 0) {
+        if (error)
+            *error = AGPOSIXError(@"unable to open file");
+        return NO;
+    }
+
+    struct stat info;
+    fstat(_fd, &info);
+
+    // a brand new file
+    if (info.st_size == 0) {
+        _length = kHeaderLength;
+        _checkpointLength = kHeaderLength;
+
+        return [self writeHeaderToFile:_fd error:error];
+    }
+
+    uint8_t header[kHeaderLength];
+
+    if (info.st_size < kHeaderLength || !AGReadFully(_fd, header, kHeaderLength, 0)
+            || memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+        if (error)
+            *error = [NSError errorWithDomain:AGStoreErrorDomain
+                                         code:0
+                                     userInfo:@{NSLocalizedDescriptionKey: @"not a segmented file"}];
+        close(_fd);
+        _fd = -1;
+        return NO;
+    }
+
+    _fileId = [NSData dataWithBytes:header + 8 length:kFileIdLength];
+
+    // read the records appended since the last checkpoint
+    off_t offset = [self readCheckpoint:info.st_size];
+    _checkpointLength = offset;
+
+    return [self replayFromOffset:offset fileSize:info.st_size];
+}
+
+- (BOOL)writeHeaderToFile:(int)fd error:(NSError **)error {
+    NSMutableData *header = [NSMutableData dataWithBytes:kMagic length:sizeof(kMagic)];
+    uint32_t version = CFSwapInt32HostToBig(kVersion);
+    [header appendBytes:&version length:sizeof(version)];
+
+    CFUUIDRef uuid = CFUUIDCreate(NULL);
+    CFUUIDBytes bytes = CFUUIDGetUUIDBytes(uuid);
+    CFRelease(uuid);
+
+    NSData *fileId = [NSData dataWithBytes:&bytes length:kFileIdLength];
+    [header appendData:fileId];
+
+    if (!AGWriteFully(fd, [header bytes], [header length], 0)) {
+        if (error)
+            *error = AGPOSIXError(@"unable to write file header");
+        return NO;
+    }
+
+    if (fd == _fd)
+        _fileId = fileId;
+
+    return YES;
+}
+
+// loads the offset table and returns the offset of the first record not covered by it
+- (off_t)readCheckpoint:(off_t)fileSize {
+    NSData *data = [NSData dataWithContentsOfURL:_indexURL];
+    NSDictionary *checkpoint = data ? [NSPropertyListSerialization propertyListWithData:data options:0 format:NULL error:nil] : nil;
+
+    if (![checkpoint isKindOfClass:[NSDictionary class]])
+        return kHeaderLength;
+
+    NSArray *keys = checkpoint[@"keys"];
+    NSData *entries = checkpoint[@"entries"];
+    off_t length = [checkpoint[@"length"] longLongValue];
+
+    // the checkpoint belongs to another incarnation of the file, read it all
+    if (![checkpoint[@"fileId"] isEqual:_fileId]
+            || length < kHeaderLength || length > fileSize || [entries length] != [keys count] * 16)
+        return kHeaderLength;
+
+    const uint8_t *bytes = [entries bytes];
+
+    for (NSUInteger i = 0; i < [keys count]; i++) {
+        uint64_t offset;
+        uint32_t valueLength, recordLength;
+
+        memcpy(&offset, bytes + i * 16, 8);
+        memcpy(&valueLength, bytes + i * 16 + 8, 4);
+        memcpy(&recordLength, bytes + i * 16 + 12, 4);
+
+        AGSegmentEntry *entry = [[AGSegmentEntry alloc] init];
+        entry.offset = (off_t)CFSwapInt64BigToHost(offset);
+        entry.length = CFSwapInt32BigToHost(valueLength);
+        entry.recordLength = CFSwapInt32BigToHost(recordLength);
+
+        _table[keys[i]] = entry;
+        _liveBytes += entry.recordLength;
+    }
+
+    return length;
+}
+
+- (BOOL)writeCheckpoint:(NSError **)error {
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:[_table count]];
+    NSMutableData *entries = [NSMutableData dataWithCapacity:[_table count] * 16];
+
+    [_table enumerateKeysAndObjectsUsingBlock:^(id key, AGSegmentEntry *entry, BOOL *stop) {
+        uint64_t offset = CFSwapInt64HostToBig((uint64_t)entry.offset);
+        uint32_t valueLength = CFSwapInt32HostToBig(entry.length);
+        uint32_t recordLength = CFSwapInt32HostToBig(entry.recordLength);
+
+        [keys addObject:key];
+        [entries appendBytes:&offset length:sizeof(offset)];
+        [entries appendBytes:&valueLength length:sizeof(valueLength)];
+        [entries appendBytes:&recordLength length:sizeof(recordLength)];
+    }];
+
+    NSDictionary *checkpoint = @{@"fileId": _fileId, @"length": @(_length), @"keys": keys, @"entries": entries};
+
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:checkpoint
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0 error:error];
+
+    if (!data || ![data writeToURL:_indexURL options:NSDataWritingAtomic error:error])
+        return NO;
+
+    _checkpointLength = _length;
+
+    return YES;
+}
+
+- (BOOL)replayFromOffset:(off_t)offset fileSize:(off_t)fileSize {
+    while (offset + (off_t)kRecordHeaderLength <= fileSize) {
+        uint8_t header[kRecordHeaderLength];
+        uint32_t keyLength, valueLength;
+
+        if (!AGReadFully(_fd, header, kRecordHeaderLength, offset))
+            break;
+
+        memcpy(&keyLength, header + 1, 4);
+        memcpy(&valueLength, header + 5, 4);
+        keyLength = CFSwapInt32BigToHost(keyLength);
+        valueLength = CFSwapInt32BigToHost(valueLength);
+
+        off_t recordLength = kRecordHeaderLength + (off_t)keyLength + valueLength;
+
+        // a record only partially written, e.g. when the app was killed
+        if (offset + recordLength > fileSize)
+            break;
+
+        NSMutableData *keyData = [NSMutableData dataWithLength:keyLength];
+        id key = nil;
+
+        if (AGReadFully(_fd, [keyData mutableBytes], keyLength, offset + kRecordHeaderLength))
+            key = [NSPropertyListSerialization propertyListWithData:keyData options:0 format:NULL error:nil];
+
+        if (!key || (header[0] != kPutOperation && header[0] != kRemoveOperation))
+            break;
+
+        [self removeEntryForKey:key];
+
+        if (header[0] == kPutOperation) {
+            AGSegmentEntry *entry = [[AGSegmentEntry alloc] init];
+            entry.offset = offset + kRecordHeaderLength + keyLength;
+            entry.length = valueLength;
+            entry.recordLength = (uint32_t)recordLength;
+
+            _table[key] = entry;
+            _liveBytes += entry.recordLength;
+        }
+
+        offset += recordLength;
+    }
+
+    // drop whatever follows the last complete record
+    if (offset < fileSize && ftruncate(_fd, offset) != 0)
+        return NO;
+
+    _length = offset;
+
+    return YES;
+}
+
+- (AGSegmentEntry *)appendOperation:(uint8_t)operation key:(id)key value:(NSData *)value error:(NSError **)error {
+    AGSegmentEntry *entry = [self writeOperation:operation key:key value:value toFile:_fd atOffset:_length error:error];
+
+    if (entry) {
+        _length += entry.recordLength;
+        _unsynced = YES;
+    } else {
+        // don't leave a partial record behind
+        ftruncate(_fd, _length);
+    }
+
+    return entry;
+}
+
+- (AGSegmentEntry *)writeOperation:(uint8_t)operation key:(id)key value:(NSData *)value
+                            toFile:(int)fd atOffset:(off_t)offset error:(NSError **)error {
+
+    NSData *keyData = [NSPropertyListSerialization dataWithPropertyList:key
+                                                                 format:NSPropertyListBinaryFormat_v1_0
+                                                                options:0 error:error];
+    if (!keyData)
+        return nil;
+
+    uint32_t keyLength = CFSwapInt32HostToBig((uint32_t)[keyData length]);
+    uint32_t valueLength = CFSwapInt32HostToBig((uint32_t)[value length]);
+
+    NSMutableData *record = [NSMutableData dataWithCapacity:kRecordHeaderLength + [keyData length] + [value length]];
+    [record appendBytes:&operation length:sizeof(operation)];
+    [record appendBytes:&keyLength length:sizeof(keyLength)];
+    [record appendBytes:&valueLength length:sizeof(valueLength)];
+    [record appendData:keyData];
+    [record appendData:value];
+
+    if (!AGWriteFully(fd, [record bytes], [record length], offset)) {
+        if (error)
+            *error = AGPOSIXError(@"unable to write record");
+        return nil;
+    }
+
+    AGSegmentEntry *entry = [[AGSegmentEntry alloc] init];
+    entry.offset = offset + kRecordHeaderLength + [keyData length];
+    entry.length = (uint32_t)[value length];
+    entry.recordLength = (uint32_t)[record length];
+
+    return entry;
+}
+
+- (NSData *)readEntry:(AGSegmentEntry *)entry fromFile:(int)fd {
+    NSMutableData *data = [NSMutableData dataWithLength:entry.length];
+
+    if (!AGReadFully(fd, [data mutableBytes], entry.length, entry.offset))
+        return nil;
+
+    return data;
+}
+
+- (void)removeEntryForKey:(id)key {
+    AGSegmentEntry *entry = _table[key];
+
+    if (entry) {
+        _liveBytes -= entry.recordLength;
+        [_table removeObjectForKey:key];
+    }
+}
+
+- (void)recordError:(NSError *)error {
+    // keep the first one, it's the most likely to explain the others
+    if (!_lastError)
+        _lastError = error;
+}
+
+- (void)didAppendRecord {
+    // checkpointing once the appended bytes reach half the live ones keeps its cost linear
+    // overall, and bounds what the next open has to replay
+    off_t budget = MAX(kMinCheckpointBytes, (off_t)(_liveBytes / 2));
+
+    if (_length - _checkpointLength >= budget) {
+        NSError *checkpointError;
+
+        if (![self writeCheckpoint:&checkpointError])
+            [self recordError:checkpointError];
+    }
+
+    unsigned long long deadBytes = (_length - kHeaderLength) - _liveBytes;
+
+    if (!_compacting && deadBytes > kMinCompactionBytes && deadBytes > _liveBytes) {
+        _compacting = YES;
+
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+            NSError *compactError;
+
+            if (![self compactFile:&compactError])
+                NSLog(@"%@ %@: %@", [self class], NSStringFromSelector(_cmd), compactError);
+        });
+    }
+}
+
+// copies the live records to a new file, while the current one keeps being
+// written to; the records changed meanwhile are copied once done
+- (BOOL)compactFile:(NSError **)error {
+    __block NSDictionary *snapshot;
+    __block int fd;
+    __block NSUInteger generation;
+
+    dispatch_sync(_queue, ^{
+        snapshot = [_table copy];
+        fd = _fd;
+        generation = _generation;
+    });
+
+    NSURL *tempURL = [_url URLByAppendingPathExtension:@"compacting"];
+    int newFd = open([[tempURL path] fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (newFd < 0) {
+        if (error)
+            *error = AGPOSIXError(@"unable to create file");
+
+        dispatch_sync(_queue, ^{
+            _compacting = NO;
+        });
+        return NO;
+    }
+
+    NSMutableDictionary *table = [[NSMutableDictionary alloc] initWithCapacity:[snapshot count]];
+    __block off_t length = kHeaderLength;
+    __block NSError *compactError;
+
+    // a record copied from the current file, nil if it can't be read or written
+    AGSegmentEntry *(^copyRecord)(id, AGSegmentEntry *) = ^AGSegmentEntry *(id key, AGSegmentEntry *entry) {
+        NSData *value = [self readEntry:entry fromFile:fd];
+
+        if (!value) {
+            compactError = AGPOSIXError(@"unable to read record");
+            return nil;
+        }
+
+        NSError *writeError;
+        AGSegmentEntry *copy = [self writeOperation:kPutOperation key:key value:value
+                                             toFile:newFd atOffset:length error:&writeError];
+        if (!copy)
+            compactError = writeError;
+
+        length += copy.recordLength;
+
+        return copy;
+    };
+
+    NSError *headerError;
+    __block BOOL success = [self writeHeaderToFile:newFd error:&headerError];
+    compactError = headerError;
+
+    for (id key in snapshot) {
+        if (!success)
+            break;
+
+        @autoreleasepool {
+            AGSegmentEntry *copy = copyRecord(key, snapshot[key]);
+
+            if (copy)
+                table[key] = copy;
+            else
+                success = NO;
+        }
+    }
+
+    // the bulk of the copy reaches the disk before the writers are held up
+    if (success && !AGSyncFile(newFd)) {
+        compactError = AGPOSIXError(@"unable to sync file");
+        success = NO;
+    }
+
+    dispatch_sync(_queue, ^{
+        _compacting = NO;
+
+        // the file has been truncated meanwhile, the copy is of no use
+        if (!success || generation != _generation) {
+            success = NO;
+            return;
+        }
+
+        // catch up with the changes made while copying
+        for (id key in [table allKeys]) {
+            if (!_table[key])
+                [table removeObjectForKey:key];
+        }
+
+        off_t copiedLength = length;
+
+        for (id key in _table) {
+            AGSegmentEntry *entry = _table[key];
+
+            if (snapshot[key] == entry)
+                continue;
+
+            AGSegmentEntry *copy = copyRecord(key, entry);
+
+            if (!copy) {
+                success = NO;
+                return;
+            }
+
+            table[key] = copy;
+        }
+
+        // the new file must be durable before it replaces the current one, or a crash
+        // could leave a name pointing to records that never reached the disk
+        if (length > copiedLength && !AGSyncFile(newFd)) {
+            compactError = AGPOSIXError(@"unable to sync file");
+            success = NO;
+            return;
+        }
+
+        if (rename([[tempURL path] fileSystemRepresentation], [[_url path] fileSystemRepresentation]) != 0) {
+            compactError = AGPOSIXError(@"unable to replace file");
+            success = NO;
+            return;
+        }
+
+        // and so must the rename itself
+        if (!AGSyncDirectory([_url URLByDeletingLastPathComponent]))
+            [self recordError:AGPOSIXError(@"unable to sync directory")];
+
+        close(_fd);
+        _fd = newFd;
+        _length = length;
+        _checkpointLength = kHeaderLength;
+        _table = table;
+        _liveBytes = 0;
+
+        for (AGSegmentEntry *entry in [table allValues])
+            _liveBytes += entry.recordLength;
+
+        // the header of the new file carries a new file id
+        uint8_t header[kHeaderLength];
+        if (AGReadFully(_fd, header, kHeaderLength, 0))
+            _fileId = [NSData dataWithBytes:header + 8 length:kFileIdLength];
+
+        NSError *checkpointError;
+        if (![self writeCheckpoint:&checkpointError])
+            [self recordError:checkpointError];
+    });
+
+    if (!success) {
+        close(newFd);
+        unlink([[tempURL path] fileSystemRepresentation]);
+
+        if (error)
+            *error = compactError;
+    }
+
+    return success;
+}
+
+@end
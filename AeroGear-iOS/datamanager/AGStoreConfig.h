@@ -34,4 +34,79 @@
  */
 @property (strong, nonatomic) id<AGEncryptionService> encryptionService;
 
+/**
+ * Whether records read from the store are decoded lazily, on first access of one of their
+ * fields. Useful when only a few fields of (large) records are accessed, e.g. to render a list.
+ * Defaults to NO. Applies to the SQLite and encrypted stores.
+ *
+ * *NOTE:* Records that can't be decoded (e.g. due to a wrong encryption key) are not detected
+ * on read, but appear as records containing only their id.
+ */
+@property (assign, nonatomic) BOOL lazyDecoding;
+
+/**
+ * The size, in bytes, of the cache of decrypted records kept by the encrypted "in-memory"
+ * and "plist" stores, so that frequently read records aren't decrypted on each read.
+ * The size of a record is estimated from the size of its encrypted form.
+ * Defaults to 0, which disables the cache.
+ */
+@property (assign, nonatomic) NSUInteger cacheSize;
+
+/**
+ * The size, in bytes, from which records saved to the encrypted stores are compressed before
+ * being encrypted. Records that don't shrink are stored uncompressed, and stores written
+ * without compression remain readable. Defaults to 0, which disables compression.
+ */
+@property (assign, nonatomic) NSUInteger compressionThreshold;
+
+/**
+ * The names of the fields to keep blind indexes for, in the encrypted stores. A blind index
+ * stores a keyed hash of each field value next to the encrypted record, so that filter:
+ * with equality (==, IN) predicates on these fields only decrypts the matching records.
+ *
+ * *NOTE:* The hashes reveal which records share the same value of an indexed field, so
+ * only index fields for which that is acceptable.
+ */
+@property (copy, nonatomic) NSArray *indexedFields;
+
+/**
+ * The names of the sensitive fields of the records saved to the encrypted stores. When set, only
+ * these fields are encrypted, each value on its own under a random nonce, while the remaining fields are stored in
+ * plaintext: filter: with predicates on plaintext fields only decrypts the matching records, and
+ * lazily decoded records (see lazyDecoding) return plaintext fields without decrypting anything.
+ * Defaults to nil, which encrypts whole records.
+ *
+ * *NOTE:* Plaintext fields are readable by anyone with access to the stored data, so make sure every
+ * sensitive field is listed. Records saved with and without this option remain readable.
+ */
+@property (copy, nonatomic) NSArray *encryptedFields;
+
+/**
+ * Whether the encrypted "SQLite" store encrypts the database file page by page, rather than each
+ * record on its own. The records are then stored as in the "SQLite" store, and reading them
+ * doesn't decrypt every row. Defaults to NO.
+ *
+ * *NOTE:* The two modes don't share their files format, so a database can't switch from one to
+ * the other. Blind indexes (see indexedFields) and field encryption (see encryptedFields) are not
+ * used, as the whole file is encrypted.
+ */
+@property (assign, nonatomic) BOOL pageEncryption;
+
+/**
+ * The version of the key of the encryption service, from 1 on, when keys are rotated. The records
+ * saved to the encrypted stores are then tagged with it, so that records saved with a previous key
+ * (see previousEncryptionServices) remain readable and can be re-encrypted with an AGKeyRotation.
+ * Defaults to 0, for records saved untagged (e.g. before keys were first rotated).
+ *
+ * *NOTE:* Doesn't apply to page encryption (see pageEncryption), which encrypts the file with a single key.
+ */
+@property (assign, nonatomic) NSUInteger keyVersion;
+
+/**
+ * The encryption services of the previous keys, keyed by their version (NSNumber, see keyVersion),
+ * that are used to read the records not yet re-encrypted with the current key. Keep them configured
+ * until the rotation of the store completes. Defaults to nil.
+ */
+@property (copy, nonatomic) NSDictionary *previousEncryptionServices;
+
 @end
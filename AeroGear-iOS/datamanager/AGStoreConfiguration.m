@@ -23,6 +23,14 @@
 @synthesize name = _name;
 @synthesize type = _type;
 @synthesize encryptionService = _encryptionService;
+@synthesize lazyDecoding = _lazyDecoding;
+@synthesize cacheSize = _cacheSize;
+@synthesize compressionThreshold = _compressionThreshold;
+@synthesize indexedFields = _indexedFields;
+@synthesize encryptedFields = _encryptedFields;
+@synthesize pageEncryption = _pageEncryption;
+@synthesize keyVersion = _keyVersion;
+@synthesize previousEncryptionServices = _previousEncryptionServices;
 
 - (instancetype)init {
     self = [super init];
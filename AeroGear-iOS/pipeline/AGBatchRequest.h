@@ -0,0 +1,147 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class AGHttpClient;
+
+/**
+ * The key, in the userInfo of the error of a failed operation, of the HTTP status code (NSNumber) of its response.
+ */
+extern NSString * const AGBatchStatusCodeKey;
+
+/**
+ An AGBatchRequest collects operations on several pipes of an AGPipeline, and sends them as a single
+ (JSON batch) request, cutting the round trips of screens that need data from several pipes. The responses
+ are handed back to the callbacks of each operation.
+
+ The batch request is POSTed to the batch endpoint of the pipeline, see [AGPipeline batchEndpoint]:
+
+    {"requests": [{"id": "0", "method": "GET", "url": "/todo-server/projects", "headers": {...}},
+                  {"id": "1", "method": "PUT", "url": "/todo-server/tasks/3", "headers": {...}, "body": {...}}]}
+
+ and the server answers with the response of each operation, in any order:
+
+    {"responses": [{"id": "0", "status": 200, "body": [...]},
+                   {"id": "1", "status": 200, "body": {...}}]}
+
+ The batch request is authenticated with the auth/authz module of the pipeline (see [AGPipeline authModule]),
+ the tokens of the pipes are not sent. Operations on pipes of another server (scheme, host or port) than the
+ one of the batch endpoint are rejected, see their failure block.
+
+ ## Batching operations
+
+    AGBatchRequest *batch = [pipeline batch];
+
+    [batch readWithParams:nil pipe:@"projects" success:^(id responseObject) {
+        // the projects
+    } failure:^(NSError *error) {
+        // when the read failed
+    }];
+
+    [batch save:task pipe:@"tasks" success:^(id responseObject) {
+        // the task was saved
+    } failure:^(NSError *error) {
+        // when the save failed
+    }];
+
+    [batch send:^(NSError *error) {
+        // all the callbacks ran, error is set if the batch request itself failed
+    }];
+
+ *NOTE:* Paging and multipart uploads are not supported by batches, so reads deliver the response as is.
+ */
+@interface AGBatchRequest : NSObject
+
+/**
+ * Initialize a batch, usually through [AGPipeline batch].
+ *
+ * @param client The HTTP client the batch request is sent with.
+ * @param URL The URL of the batch endpoint.
+ * @param pipeConfigs The AGPipeConfig objects of the pipes, by name.
+ *
+ * @return the newly created AGBatchRequest object.
+ */
+- (instancetype)initWithClient:(AGHttpClient *)client URL:(NSURL *)URL pipeConfigs:(NSDictionary *)pipeConfigs;
+
+/**
+ * The number of operations waiting to be sent.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * Adds the read of a specific object, see [AGPipe read:success:failure:].
+ *
+ * @param value The value of the recordId.
+ * @param pipeName The name of the pipe.
+ * @param success A block object to be executed when the read succeeded, with the object read.
+ * @param failure A block object to be executed when the read, or the batch request, failed.
+ */
+- (void)read:(id)value
+        pipe:(NSString *)pipeName
+     success:(void (^)(id responseObject))success
+     failure:(void (^)(NSError *error))failure;
+
+/**
+ * Adds a read of the pipe, with (filter/query) params, see [AGPipe readWithParams:success:failure:].
+ *
+ * @param parameterProvider A dictionary of the query parameters, or nil.
+ * @param pipeName The name of the pipe.
+ * @param success A block object to be executed when the read succeeded, with the objects read.
+ * @param failure A block object to be executed when the read, or the batch request, failed.
+ */
+- (void)readWithParams:(NSDictionary *)parameterProvider
+                  pipe:(NSString *)pipeName
+               success:(void (^)(id responseObject))success
+               failure:(void (^)(NSError *error))failure;
+
+/**
+ * Adds the save (or update) of an object, see [AGPipe save:success:failure:].
+ *
+ * @param object A 'JSON' map, representing the data to save/update.
+ * @param pipeName The name of the pipe.
+ * @param success A block object to be executed when the save succeeded, with the response object.
+ * @param failure A block object to be executed when the save, or the batch request, failed.
+ */
+- (void)save:(NSDictionary *)object
+        pipe:(NSString *)pipeName
+     success:(void (^)(id responseObject))success
+     failure:(void (^)(NSError *error))failure;
+
+/**
+ * Adds the removal of an object, see [AGPipe remove:success:failure:].
+ *
+ * @param object A 'JSON' map, representing the data to remove, with the 'recordId' key set.
+ * @param pipeName The name of the pipe.
+ * @param success A block object to be executed when the removal succeeded, with the response object.
+ * @param failure A block object to be executed when the removal, or the batch request, failed.
+ */
+- (void)remove:(NSDictionary *)object
+          pipe:(NSString *)pipeName
+       success:(void (^)(id responseObject))success
+       failure:(void (^)(NSError *error))failure;
+
+/**
+ * Sends the operations added so far in a single request, and hands their responses to their callbacks.
+ * The batch can be reused afterwards.
+ *
+ * @param completion A block object to be executed once the callbacks of all the operations ran. It takes one
+ * argument: the NSError of the batch request, if it failed as a whole, otherwise nil.
+ */
+- (void)send:(void (^)(NSError *error))completion;
+
+@end
@@ -0,0 +1,316 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGBatchRequest.h"
+#import "AGHttpClient.h"
+#import "AGMultipart.h"
+#import "AGPipeConfiguration.h"
+
+NSString * const AGBatchStatusCodeKey = @"AGBatchStatusCodeKey";
+
+// an operation of the batch, along with its callbacks
+@interface AGBatchOperation : NSObject
+
+    @property (nonatomic, copy) NSString *operationId;
+    @property (nonatomic, copy) NSDictionary *request;
+    @property (nonatomic, copy) void (^success)(id responseObject);
+    @property (nonatomic, copy) void (^failure)(NSError *error);
+
+@end
+
+@implementation AGBatchOperation
+
+@end
+
+@implementation AGBatchRequest {
+    AGHttpClient *_client;
+    NSURL *_URL;
+    NSDictionary *_pipeConfigs;
+
+    NSMutableArray *_operations;
+    NSUInteger _nextOperationId;
+}
+
+- (instancetype)initWithClient:(AGHttpClient *)client URL:(NSURL *)URL pipeConfigs:(NSDictionary *)pipeConfigs {
+    self = [super init];
+    if (self) {
+        _client = client;
+        _URL = URL;
+        _pipeConfigs = [pipeConfigs copy];
+        _operations = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (NSUInteger)count {
+    return [_operations count];
+}
+
+#pragma mark - operations
+
+- (void)read:(id)value
+        pipe:(NSString *)pipeName
+     success:(void (^)(id responseObject))success
+     failure:(void (^)(NSError *error))failure {
+
+    if (value == nil || [value isKindOfClass:[NSNull class]]) {
+        [self raiseError:@"read id value was nil" failure:failure];
+        return;
+    }
+
+    AGPipeConfiguration *config = [self configOfPipe:pipeName failure:failure];
+
+    if (!config)
+        return;
+
+    [self addOperationWithMethod:@"GET" URL:[[self URLOfPipe:config] URLByAppendingPathComponent:[self getStringValue:value]]
+                            body:nil success:success failure:failure];
+}
+
+- (void)readWithParams:(NSDictionary *)parameterProvider
+                  pipe:(NSString *)pipeName
+               success:(void (^)(id responseObject))success
+               failure:(void (^)(NSError *error))failure {
+
+    AGPipeConfiguration *config = [self configOfPipe:pipeName failure:failure];
+
+    if (!config)
+        return;
+
+    NSURL *URL = [self URLOfPipe:config];
+
+    // let the serializer encode the query
+    if ([parameterProvider count] > 0) {
+        URL = [[AFHTTPRequestSerializer serializer] requestWithMethod:@"GET"
+                                                            URLString:[URL absoluteString]
+                                                           parameters:parameterProvider error:nil].URL;
+    }
+
+    [self addOperationWithMethod:@"GET" URL:URL body:nil success:success failure:failure];
+}
+
+- (void)save:(NSDictionary *)object
+        pipe:(NSString *)pipeName
+     success:(void (^)(id responseObject))success
+     failure:(void (^)(NSError *error))failure {
+
+    if (object == nil || [object isKindOfClass:[NSNull class]]) {
+        [self raiseError:@"object was nil" failure:failure];
+        return;
+    }
+
+    for (id value in [object allValues]) {
+        if ([value conformsToProtocol:@protocol(AGMultipart)] || [value isKindOfClass:[NSURL class]]) {
+            [self raiseError:@"multipart objects can't be batched" failure:failure];
+            return;
+        }
+    }
+
+    AGPipeConfiguration *config = [self configOfPipe:pipeName failure:failure];
+
+    if (!config)
+        return;
+
+    id objectKey = object[config.recordId];
+
+    // POST or PUT, as the pipe would
+    if (objectKey == nil || [objectKey isKindOfClass:[NSNull class]]) {
+        [self addOperationWithMethod:@"POST" URL:[self URLOfPipe:config] body:object success:success failure:failure];
+    } else {
+        [self addOperationWithMethod:@"PUT" URL:[[self URLOfPipe:config] URLByAppendingPathComponent:[self getStringValue:objectKey]]
+                                body:object success:success failure:failure];
+    }
+}
+
+- (void)remove:(NSDictionary *)object
+          pipe:(NSString *)pipeName
+       success:(void (^)(id responseObject))success
+       failure:(void (^)(NSError *error))failure {
+
+    if (object == nil || [object isKindOfClass:[NSNull class]]) {
+        [self raiseError:@"object was nil" failure:failure];
+        return;
+    }
+
+    AGPipeConfiguration *config = [self configOfPipe:pipeName failure:failure];
+
+    if (!config)
+        return;
+
+    id objectKey = object[config.recordId];
+
+    if (objectKey == nil || [objectKey isKindOfClass:[NSNull class]]) {
+        [self raiseError:@"recordId not set" failure:failure];
+        return;
+    }
+
+    [self addOperationWithMethod:@"DELETE" URL:[[self URLOfPipe:config] URLByAppendingPathComponent:[self getStringValue:objectKey]]
+                            body:nil success:success failure:failure];
+}
+
+- (void)send:(void (^)(NSError *error))completion {
+    NSArray *operations = [_operations copy];
+    [_operations removeAllObjects];
+
+    if ([operations count] == 0) {
+        if (completion) {
+            completion(nil);
+        }
+        return;
+    }
+
+    NSMutableArray *requests = [NSMutableArray arrayWithCapacity:[operations count]];
+
+    for (AGBatchOperation *operation in operations)
+        [requests addObject:operation.request];
+
+    [_client POST:[_URL absoluteString] parameters:@{@"requests": requests} success:^(NSURLSessionDataTask *task, id responseObject) {
+        // demultiplex the responses, by operation id
+        NSMutableDictionary *responses = [NSMutableDictionary dictionary];
+
+        if ([responseObject isKindOfClass:[NSDictionary class]] && [responseObject[@"responses"] isKindOfClass:[NSArray class]]) {
+            for (id response in responseObject[@"responses"]) {
+                if ([response isKindOfClass:[NSDictionary class]] && response[@"id"])
+                    responses[[self getStringValue:response[@"id"]]] = response;
+            }
+        }
+
+        for (AGBatchOperation *operation in operations)
+            [self completeOperation:operation withResponse:responses[operation.operationId]];
+
+        if (completion) {
+            completion(nil);
+        }
+    } failure:^(NSURLSessionDataTask *task, NSError *error) {
+        for (AGBatchOperation *operation in operations) {
+            if (operation.failure) {
+                operation.failure(error);
+            }
+        }
+
+        if (completion) {
+            completion(error);
+        }
+    }];
+}
+
+#pragma mark - utility methods
+
+- (void)addOperationWithMethod:(NSString *)method
+                           URL:(NSURL *)URL
+                          body:(id)body
+                       success:(void (^)(id responseObject))success
+                       failure:(void (^)(NSError *error))failure {
+
+    NSString *path = URL.path;
+
+    if (URL.query)
+        path = [NSString stringWithFormat:@"%@?%@", path, URL.query];
+
+    AGBatchOperation *operation = [[AGBatchOperation alloc] init];
+    operation.operationId = [NSString stringWithFormat:@"%lu", (unsigned long) _nextOperationId++];
+    operation.success = success;
+    operation.failure = failure;
+
+    NSMutableDictionary *request = [NSMutableDictionary dictionary];
+    request[@"id"] = operation.operationId;
+    request[@"method"] = method;
+    request[@"url"] = path;
+    // the tokens of the pipes stay out of the body, the batch request itself is authenticated
+    request[@"headers"] = @{@"Accept": @"application/json", @"Content-Type": @"application/json"};
+
+    if (body)
+        request[@"body"] = body;
+
+    operation.request = request;
+
+    [_operations addObject:operation];
+}
+
+- (void)completeOperation:(AGBatchOperation *)operation withResponse:(NSDictionary *)response {
+    NSInteger statusCode = [response[@"status"] integerValue];
+
+    if (statusCode >= 200 && statusCode < 300) {
+        if (operation.success) {
+            id body = response[@"body"];
+            operation.success([body isKindOfClass:[NSNull class]] ? nil : body);
+        }
+        return;
+    }
+
+    if (!operation.failure)
+        return;
+
+    NSString *msg = response ? [NSString stringWithFormat:@"request failed with status %ld", (long) statusCode] : @"no response to request";
+
+    operation.failure([NSError errorWithDomain:@"org.aerogear.pipes.batch"
+                                          code:0
+                                      userInfo:@{NSLocalizedDescriptionKey: msg, AGBatchStatusCodeKey: @(statusCode)}]);
+}
+
+- (AGPipeConfiguration *)configOfPipe:(NSString *)pipeName failure:(void (^)(NSError *error))failure {
+    AGPipeConfiguration *config = pipeName ? _pipeConfigs[pipeName] : nil;
+
+    if (!config) {
+        [self raiseError:[NSString stringWithFormat:@"no pipe named %@", pipeName] failure:failure];
+        return nil;
+    }
+
+    // only the paths of the operations are sent, they run on the server of the batch endpoint
+    if (![self isURL:[self URLOfPipe:config] onServerOf:_URL]) {
+        [self raiseError:[NSString stringWithFormat:@"pipe %@ is not on the server of the batch endpoint", pipeName] failure:failure];
+        return nil;
+    }
+
+    return config;
+}
+
+// whether the URLs have the same scheme, host and port
+- (BOOL)isURL:(NSURL *)URL onServerOf:(NSURL *)serverURL {
+    NSString *scheme = [URL.scheme lowercaseString];
+
+    if (![scheme isEqualToString:[serverURL.scheme lowercaseString]] ||
+            [URL.host caseInsensitiveCompare:serverURL.host ?: @""] != NSOrderedSame)
+        return NO;
+
+    NSNumber *defaultPort = [scheme isEqualToString:@"https"] ? @443 : @80;
+
+    return [(URL.port ?: defaultPort) isEqualToNumber:(serverURL.port ?: defaultPort)];
+}
+
+// the URL of the pipe, as it computes it
+- (NSURL *)URLOfPipe:(AGPipeConfiguration *)config {
+    return [config.baseURL URLByAppendingPathComponent:config.endpoint ?: @""];
+}
+
+- (NSString *)getStringValue:(id)value {
+    if ([value isKindOfClass:[NSString class]])
+        return value;
+
+    return [value stringValue];
+}
+
+- (void)raiseError:(NSString *)msg failure:(void (^)(NSError *error))failure {
+    if (!failure)
+        return;
+
+    failure([NSError errorWithDomain:@"org.aerogear.pipes.batch"
+                                code:0
+                            userInfo:@{NSLocalizedDescriptionKey: msg}]);
+}
+
+@end
@@ -199,6 +199,13 @@ Of course the _collection_ behind the responseObject can be stored to a variable
     // cancel the request
     [projects cancel];
  */
+/**
+ * The key, in the userInfo of the error of a failed saveAll: or removeAll:, of the NSArray of the
+ * per-object results: the response object of each object that succeeded, and the NSError of each
+ * object that failed, in the order of the objects given.
+ */
+extern NSString * const AGPipeBulkResultsKey;
+
 @protocol AGPipe <NSObject>
 
 /**
@@ -264,6 +271,36 @@ Of course the _collection_ behind the responseObject can be stored to a variable
                success:(void (^)(id responseObject))success
                failure:(void (^)(NSError *error))failure;
 
+/**
+ * Reads all the data that matches a given parameter provider, handing the records over in batches
+ * as the response is received. Unlike readWithParams:success:failure:, the response is not held in
+ * memory as a whole, which suits (very) large collections.
+ *
+ * @param parameterProvider A dictionary containing all the parameters and their values, that are
+ * passed to the server. If no parameterProvider is given, the defaults from the `AGPipeConfig`
+ * are used.
+ *
+ * @param batchSize The (maximum) number of records per batch, 0 defaults to 100.
+ *
+ * @param records A block object to be executed, on the main thread, with each batch of records.
+ * This block has no return value and takes one argument: the NSArray of records.
+ *
+ * @param success A block object to be executed after the last batch, when the request operation finishes
+ * successfully. This block has no return value and takes one argument: an empty paging result (see
+ * AGNSMutableArray+Paging), which allows to move to the next or previous page of the result set when
+ * the paging metadata are located in the response headers.
+ *
+ * @param failure A block object to be executed when the request operation finishes unsuccessfully,
+ * or that finishes successfully, but encountered an error while parsing the response data.
+ * This block has no return value and takes one argument: The `NSError` object describing
+ * the network or parsing error that occurred.
+ */
+-(void) readWithParams:(NSDictionary*)parameterProvider
+             batchSize:(NSUInteger)batchSize
+               records:(void (^)(NSArray *records))records
+               success:(void (^)(id responseObject))success
+               failure:(void (^)(NSError *error))failure;
+
 
 /**
  * Saves (or updates) a given object from the underlying server connection.
@@ -305,6 +342,46 @@ Of course the _collection_ behind the responseObject can be stored to a variable
        success:(void (^)(id responseObject))success
        failure:(void (^)(NSError *error))failure;
 
+/**
+ * Saves (or updates) a collection of objects. If the pipe has a bulk endpoint (see [AGPipeConfig bulkEndpoint]),
+ * the objects are POSTed at once, as a JSON array. Otherwise, or if the server doesn't support the bulk endpoint,
+ * the objects are saved one by one, with up to [AGPipeConfig bulkConcurrency] requests under way at once.
+ *
+ * @param objects An NSArray of 'JSON' maps, representing the data to save/update.
+ *
+ * @param success A block object to be executed when all the objects were saved successfully.
+ * This block has no return value and takes one argument: the NSArray of the response objects,
+ * in the order of the objects given (NSNull for empty responses).
+ *
+ * @param failure A block object to be executed when any of the objects failed to save. This block has
+ * no return value and takes one argument: The `NSError` object describing the failure, whose userInfo
+ * holds the per-object results under the AGPipeBulkResultsKey key.
+ */
+-(void) saveAll:(NSArray*) objects
+        success:(void (^)(NSArray *responseObjects))success
+        failure:(void (^)(NSError *error))failure;
+
+/**
+ * Removes a collection of objects. If the pipe has a bulk endpoint (see [AGPipeConfig bulkEndpoint]), a single
+ * DELETE request is sent, listing the comma separated ids under the recordId query parameter. Otherwise, or if
+ * the server doesn't support the bulk endpoint, the objects are removed one by one, with up to
+ * [AGPipeConfig bulkConcurrency] requests under way at once.
+ *
+ * @param objects An NSArray of 'JSON' maps, representing the data to remove. Note the maps must have the
+ * 'recordId' key set. See property [AGPipeConfig recordId].
+ *
+ * @param success A block object to be executed when all the objects were removed successfully.
+ * This block has no return value and takes one argument: the NSArray of the response objects,
+ * in the order of the objects given (NSNull for empty responses).
+ *
+ * @param failure A block object to be executed when any of the objects failed to be removed. This block
+ * has no return value and takes one argument: The `NSError` object describing the failure, whose userInfo
+ * holds the per-object results under the AGPipeBulkResultsKey key.
+ */
+-(void) removeAll:(NSArray*) objects
+          success:(void (^)(NSArray *responseObjects))success
+          failure:(void (^)(NSError *error))failure;
+
 /**
  * Cancel all running pipe operations. Doing so will invoke the pipe's 'failure' block with an error
  * code set to NSURLErrorCancelled so that you can perform your 'cancellation' logic.
@@ -19,6 +19,12 @@
 #import "AGPageConfig.h"
 #import "AGAuthenticationModule.h"
 #import "AGAuthzModule.h"
+#import "AGRequestScheduler.h"
+
+@class AGResponseCache;
+@class AGRetryPolicy;
+@protocol AGStore;
+@protocol AGSerializer;
 
 /**
  * Represents the public API to configure AGPipe objects.
@@ -84,4 +90,74 @@
  */
 @property (copy, nonatomic) void (^pageConfig)(id<AGPageConfig>);
 
+/**
+ * Whether updates of this Pipe only send what changed, as a JSON merge patch (RFC 7396) in a PATCH request,
+ * instead of PUTting the whole object. The difference is computed against the last version of the object
+ * acknowledged by the server (i.e. read, saved or returned by a save). Objects without such a version,
+ * or servers rejecting PATCH requests (405, 415 or 501), get PUT requests. Defaults to NO.
+ */
+@property (assign, nonatomic) BOOL patchUpdates;
+
+/**
+ * The store that keeps the acknowledged versions of the objects when patchUpdates is set, so that they
+ * outlive the application. Its recordId must be the one of this Pipe. Defaults to nil, i.e. the versions
+ * are kept in memory.
+ */
+@property (strong, nonatomic) id<AGStore> versionStore;
+
+/**
+ * The endpoint, relative to the URL of this Pipe, that saves and removes collections of objects in a single
+ * request (see [AGPipe saveAll:success:failure:] and [AGPipe removeAll:success:failure:]), or an empty string
+ * if the URL of this Pipe does. Defaults to nil, i.e. objects are saved and removed one by one.
+ */
+@property (copy, nonatomic) NSString* bulkEndpoint;
+
+/**
+ * The maximum number of requests under way at once when saving or removing collections of objects one
+ * by one. Defaults to 4.
+ */
+@property (assign, nonatomic) NSUInteger bulkConcurrency;
+
+/**
+ * The size, in bytes, from which the bodies of the saves (and multipart uploads) of this Pipe are sent
+ * gzip compressed, with a "Content-Encoding: gzip" header. Only enable it for servers that accept
+ * compressed requests. Defaults to 0, which disables compression.
+ */
+@property (assign, nonatomic) NSUInteger requestCompressionThreshold;
+
+/**
+ * The cache of the responses to the reads of this Pipe. Reads are then sent as conditional requests,
+ * and answered with the cached response when it hasn't changed (e.g. when polling), so only headers
+ * are exchanged. The cache can be shared between pipes. Defaults to nil.
+ * See AGResponseCache for more information.
+ */
+@property (strong, nonatomic) AGResponseCache *responseCache;
+
+/**
+ * The serializer of the request bodies of this Pipe, e.g. AGMessagePackSerializer to exchange a compact
+ * binary format with the server. Responses in that format are preferred (see the Accept header), JSON
+ * responses are still understood. Defaults to nil, i.e. JSON.
+ */
+@property (strong, nonatomic) id<AGSerializer> serializer;
+
+/**
+ * The policy under which the failed requests of this Pipe are sent again, with exponential backoff,
+ * and fail fast while their host keeps failing. Only idempotent requests are retried by default.
+ * Defaults to nil, i.e. no retries. See AGRetryPolicy for more information.
+ */
+@property (strong, nonatomic) AGRetryPolicy *retryPolicy;
+
+/**
+ * The scheduler that decides when the requests of this Pipe go out. Pipes created by an AGPipeline
+ * default to the scheduler of the pipeline, shared between its pipes; set it to nil to send the
+ * requests right away. See AGRequestScheduler for more information.
+ */
+@property (strong, nonatomic) AGRequestScheduler *scheduler;
+
+/**
+ * The priority class of the requests of this Pipe, e.g. AGRequestPriorityBackground for a sync, or
+ * AGRequestPriorityUserInteractive for reads the user waits for. Defaults to AGRequestPriorityDefault.
+ */
+@property (assign, nonatomic) AGRequestPriority priority;
+
 @end
\ No newline at end of file
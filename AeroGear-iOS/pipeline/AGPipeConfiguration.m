@@ -30,6 +30,16 @@
 @synthesize timeout = _timeout;
 @synthesize credential = _credential;
 @synthesize pageConfig = _pageConfig;
+@synthesize responseCache = _responseCache;
+@synthesize serializer = _serializer;
+@synthesize requestCompressionThreshold = _requestCompressionThreshold;
+@synthesize retryPolicy = _retryPolicy;
+@synthesize scheduler = _scheduler;
+@synthesize priority = _priority;
+@synthesize bulkEndpoint = _bulkEndpoint;
+@synthesize bulkConcurrency = _bulkConcurrency;
+@synthesize patchUpdates = _patchUpdates;
+@synthesize versionStore = _versionStore;
 
 - (instancetype)init {
     self = [super init];
@@ -38,6 +48,8 @@
         _type = @"REST";
         _recordId = @"id";
         _timeout = 60;  // the default timeout interval of NSMutableURLRequest (60 secs)
+        _priority = AGRequestPriorityDefault;
+        _bulkConcurrency = 4;
     }
     return self;
 }
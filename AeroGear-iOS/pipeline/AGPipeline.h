@@ -18,7 +18,9 @@
 #import <Foundation/Foundation.h>
 #import "AGPipe.h"
 #import "AGPipeConfig.h"
+#import "AGBatchRequest.h"
 #import "AGAuthenticationModule.h"
+#import "AGAuthzModule.h"
 
 /**
  AGPipeline represents a 'collection' of server connections (aka [Pipes](AGPipe)). It provides a standard way to
@@ -40,9 +42,58 @@
         [config setName:@"projects"];
         [config setType:@"REST"]; // this is the default, can be emitted
     }];
+
+ ## Prioritizing requests
+
+ The requests of the pipes of a pipeline go through a shared AGRequestScheduler, so a pipe syncing in the
+ background doesn't hold up the requests the user waits for:
+
+    id<AGPipe> sync = [todo pipe:^(id<AGPipeConfig> config) {
+        [config setName:@"tasks"];
+        [config setPriority:AGRequestPriorityBackground];
+    }];
+
+ ## Batching requests
+
+ Operations on several pipes can be sent in a single request, see AGBatchRequest:
+
+    AGBatchRequest *batch = [todo batch];
+
+    [batch readWithParams:nil pipe:@"projects" success:^(id responseObject) {
+        // the projects
+    } failure:nil];
+
+    [batch save:tag pipe:@"tags" success:nil failure:nil];
+
+    [batch send:nil];
  */
 @interface AGPipeline : NSObject
 
+/**
+ * The scheduler shared by the pipes of this pipeline, which makes their requests take turns and lets
+ * the requests of higher priority go first (see [AGPipeConfig priority]). Its limits can be adjusted,
+ * see AGRequestScheduler.
+ */
+@property (nonatomic, readonly) AGRequestScheduler *scheduler;
+
+/**
+ * The endpoint, relative to the baseURL, that accepts the batches of this pipeline (see batch).
+ * Defaults to "batch".
+ */
+@property (nonatomic, copy) NSString *batchEndpoint;
+
+/**
+ * The Authentication Module the batch requests of this pipeline are sent with (see batch), the operations
+ * of a batch don't carry the tokens of their pipes. Defaults to nil.
+ */
+@property (nonatomic, strong) id<AGAuthenticationModule> authModule;
+
+/**
+ * The Authorization Module the batch requests of this pipeline are sent with, unless an authModule is set.
+ * Defaults to nil.
+ */
+@property (nonatomic, strong) id<AGAuthzModule> authzModule;
+
 /**
  * An initializer method to instantiate an empty AGPipeline.
  *
@@ -95,6 +146,14 @@
  */
 -(id<AGPipe>) pipe:(void (^)(id<AGPipeConfig> config)) config;
 
+/**
+ * Creates a batch, which sends operations on the pipes of this pipeline in a single request.
+ * See AGBatchRequest for more information.
+ *
+ * @return the newly created AGBatchRequest object.
+ */
+-(AGBatchRequest*) batch;
+
 /**
  * Removes a pipe from the AGPipeline object.
  *
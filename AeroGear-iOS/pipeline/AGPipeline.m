@@ -18,6 +18,7 @@
 #import "AGPipeline.h"
 #import "AGPipeConfiguration.h"
 #import "AGRESTPipe.h"
+#import "AGHttpClient.h"
 
 // category
 @interface AGPipeline ()
@@ -28,8 +29,17 @@
 @implementation AGPipeline {
     NSURL* _baseURL;
     NSURLSessionConfiguration *_sessionConfiguration;
+
+    // the configurations of the pipes, by name, for the batches
+    NSMutableDictionary* _pipeConfigs;
+    // sends the batches, created on first use
+    AGHttpClient* _batchClient;
 }
 @synthesize pipes = _pipes;
+@synthesize scheduler = _scheduler;
+@synthesize batchEndpoint = _batchEndpoint;
+@synthesize authModule = _authModule;
+@synthesize authzModule = _authzModule;
 
 - (instancetype)init {
    return [self initWithBaseURL:nil];
@@ -43,6 +53,8 @@
     if (self = [super init]) {
         // to hold our Pipes
         _pipes = [NSMutableDictionary dictionary];
+        _pipeConfigs = [NSMutableDictionary dictionary];
+        _batchEndpoint = @"batch";
         // stash the baseURL, used for the 'add' functions that have no (base)URL argument
         _baseURL = baseURL;
 
@@ -51,6 +63,9 @@
         if (!_sessionConfiguration) {
             _sessionConfiguration = [NSURLSessionConfiguration defaultSessionConfiguration];
         }
+
+        // shared by the pipes, so their requests take turns
+        _scheduler = [AGRequestScheduler scheduler];
     }
     return self;
 }
@@ -73,6 +88,7 @@
     // applying the defaults:
     [pipeConfig setBaseURL:_baseURL];
     [pipeConfig setSessionConfiguration:_sessionConfiguration];
+    [pipeConfig setScheduler:_scheduler];
 
     if (config) {
         config(pipeConfig);
@@ -85,6 +101,7 @@
 
     id<AGPipe> pipe = [AGRESTPipe pipeWithConfig:pipeConfig];
     [_pipes setValue:pipe forKey:[pipeConfig name]];
+    [_pipeConfigs setValue:pipeConfig forKey:[pipeConfig name]];
     
     return pipe;
 }
@@ -92,6 +109,7 @@
 -(id<AGPipe>) remove:(NSString*) name {
     id<AGPipe> pipe = [self pipeWithName:name];
     [_pipes removeObjectForKey:name];
+    [_pipeConfigs removeObjectForKey:name];
     
     return pipe;
 }
@@ -100,6 +118,30 @@
     return [_pipes valueForKey:name];
 }
 
+-(void) setAuthModule:(id<AGAuthenticationModule>) authModule {
+    _authModule = authModule;
+    // recreated with the module on next use
+    _batchClient = nil;
+}
+
+-(void) setAuthzModule:(id<AGAuthzModule>) authzModule {
+    _authzModule = authzModule;
+    _batchClient = nil;
+}
+
+-(AGBatchRequest*) batch {
+    if (!_batchClient) {
+        _batchClient = [AGHttpClient clientFor:_baseURL timeout:60 sessionConfiguration:_sessionConfiguration
+                                    authModule:(id<AGAuthenticationModuleAdapter>) _authModule
+                                   authzModule:(id<AGAuthzModuleAdapter>) _authzModule];
+        _batchClient.scheduler = _scheduler;
+    }
+
+    NSURL* batchURL = [_baseURL URLByAppendingPathComponent:_batchEndpoint ?: @""];
+
+    return [[AGBatchRequest alloc] initWithClient:_batchClient URL:batchURL pipeConfigs:_pipeConfigs];
+}
+
 -(NSString *) description {
     return [NSString stringWithFormat: @"%@ %@", self.class, _pipes];
 }
@@ -17,6 +17,8 @@
 
 #import "AGRESTPipe.h"
 #import "AGHttpClient.h"
+#import "AGJsonMergePatch.h"
+#import "AGStore.h"
 
 #import "AGPageHeaderExtractor.h"
 #import "AGPageBodyExtractor.h"
@@ -25,9 +27,23 @@
 //category:
 #import "AGNSMutableArray+Paging.h"
 
+NSString * const AGPipeBulkResultsKey = @"AGPipeBulkResultsKey";
+
 @implementation AGRESTPipe {
 
     NSString* _recordId;
+
+    NSString* _bulkEndpoint;
+    NSUInteger _bulkConcurrency;
+    // set once the server rejected the bulk endpoint
+    BOOL _bulkUnsupported;
+
+    BOOL _patchUpdates;
+    // set once the server rejected a PATCH request
+    BOOL _patchUnsupported;
+    // the versions acknowledged by the server, by id (unless kept in the _versionStore)
+    NSMutableDictionary* _versions;
+    id<AGStore> _versionStore;
     
     AGPageConfiguration* _pageConfig;
 }
@@ -56,12 +72,24 @@
         
         _URL = finalURL;
         _recordId = _config.recordId;
+        _bulkEndpoint = _config.bulkEndpoint;
+        _bulkConcurrency = MAX(_config.bulkConcurrency, 1);
+        _patchUpdates = _config.patchUpdates;
+        _versions = [[NSMutableDictionary alloc] init];
+        _versionStore = _config.versionStore;
 
         _restClient = [AGHttpClient clientFor:finalURL timeout:_config.timeout
                          sessionConfiguration:_config.sessionConfiguration
                                    authModule:(id <AGAuthenticationModuleAdapter>) _config.authModule
                                   authzModule:(id <AGAuthzModuleAdapter>) _config.authzModule];
 
+        _restClient.responseCache = _config.responseCache;
+        _restClient.serializer = _config.serializer;
+        _restClient.requestCompressionThreshold = _config.requestCompressionThreshold;
+        _restClient.retryPolicy = _config.retryPolicy;
+        _restClient.scheduler = _config.scheduler;
+        _restClient.priority = _config.priority;
+
 
         // if NSURLCredential object is set on the config
         if (_config.credential) {
@@ -114,6 +142,8 @@
 
     NSString* objectKey = [self getStringValue:value];
     [_restClient GET:[self appendObjectPath:objectKey] parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+        [self acknowledgeVersion:responseObject];
+
         if (success) {
             success(responseObject);
         }
@@ -153,10 +183,13 @@
             pagingObject = (NSMutableArray*) [responseObject mutableCopy];
         }
 
+        for (id object in pagingObject)
+            [self acknowledgeVersion:object];
+
         // stash pipe reference:
         pagingObject.pipe = self;
         pagingObject.parameterProvider = [_pageConfig.pageExtractor parse:responseObject
-                                                                  headers:[(NSHTTPURLResponse *) [task response] allHeaderFields]
+                                                                  headers:[_restClient responseHeadersForTask:task]
                                                                      next:_pageConfig.nextIdentifier
                                                                      prev:_pageConfig.previousIdentifier];
         if (success) {
@@ -170,6 +203,37 @@
     } ];
 }
 
+// read, with the response parsed as it is received. The records are not kept, so
+// only the paging metadata located in the headers are available
+-(void) readWithParams:(NSDictionary*)parameterProvider
+             batchSize:(NSUInteger)batchSize
+               records:(void (^)(NSArray *records))records
+               success:(void (^)(id responseObject))success
+               failure:(void (^)(NSError *error))failure {
+
+    if (!parameterProvider)
+        parameterProvider = _pageConfig.parameterProvider;
+
+    [_restClient GET:_URL.path parameters:parameterProvider batchSize:batchSize records:records success:^(NSURLSessionDataTask *task) {
+
+        NSMutableArray* pagingObject = [NSMutableArray array];
+
+        // stash pipe reference:
+        pagingObject.pipe = self;
+        pagingObject.parameterProvider = [_pageConfig.pageExtractor parse:nil
+                                                                  headers:[_restClient responseHeadersForTask:task]
+                                                                     next:_pageConfig.nextIdentifier
+                                                                     prev:_pageConfig.previousIdentifier];
+        if (success) {
+            success(pagingObject);
+        }
+    } failure:^(NSURLSessionDataTask *task, NSError *error) {
+
+        if (failure) {
+            failure(error);
+        }
+    }];
+}
 
 -(void) save:(NSDictionary*) object
      success:(void (^)(id responseObject))success
@@ -184,6 +248,9 @@
 
     // the blocks are unique to PUT and POST, so let's define them up-front:
     id successCallback = ^(NSURLSessionDataTask *task, id responseObject) {
+        // the server returns the saved object, or nothing
+        [self acknowledgeVersion:[responseObject isKindOfClass:[NSDictionary class]] ? responseObject : object];
+
         if (success) {
             success(responseObject);
         }
@@ -205,7 +272,48 @@
 
         // extract object's id
         NSString* updateId = [self getStringValue:objectKey];
-       [_restClient PUT:[self appendObjectPath:updateId] parameters:object success:successCallback failure:failureCallback];
+        NSDictionary* version = (_patchUpdates && !_patchUnsupported) ? [self acknowledgedVersionOf:objectKey] : nil;
+
+        if (!version) {
+            [_restClient PUT:[self appendObjectPath:updateId] parameters:object success:successCallback failure:failureCallback];
+            return;
+        }
+
+        // only send what changed since
+        NSDictionary* patch = [AGJsonMergePatch patchFromObject:version toObject:object];
+
+        // the changes set a member to null, which only a full update can do
+        if (!patch) {
+            [_restClient PUT:[self appendObjectPath:updateId] parameters:object success:successCallback failure:failureCallback];
+            return;
+        }
+
+        if ([patch count] == 0) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (success) {
+                    success(object);
+                }
+            });
+            return;
+        }
+
+        [_restClient PATCH:[self appendObjectPath:updateId] parameters:patch success:^(NSURLSessionDataTask *task, id responseObject) {
+            [self acknowledgeVersion:[responseObject isKindOfClass:[NSDictionary class]] ? responseObject
+                                                                                        : [AGJsonMergePatch applyPatch:patch toObject:version]];
+            if (success) {
+                success(responseObject);
+            }
+        } failure:^(NSURLSessionDataTask *task, NSError *error) {
+            NSInteger statusCode = [(NSHTTPURLResponse *) task.response statusCode];
+
+            // the server doesn't do PATCH, fall back to PUT from now on
+            if (statusCode == 405 || statusCode == 415 || statusCode == 501) {
+                _patchUnsupported = YES;
+                [_restClient PUT:[self appendObjectPath:updateId] parameters:object success:successCallback failure:failureCallback];
+            } else if (failure) {
+                failure(error);
+            }
+        }];
     }
 }
 
@@ -231,6 +339,7 @@
     NSString* deleteKey = [self getStringValue:objectKey];
 
     [_restClient DELETE:[self appendObjectPath:deleteKey] parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+        [self forgetVersionOf:object];
 
         if (success) {
             success(responseObject);
@@ -243,7 +352,112 @@
     } ];
 }
 
+-(void) saveAll:(NSArray*) objects
+        success:(void (^)(NSArray *responseObjects))success
+        failure:(void (^)(NSError *error))failure {
+
+    // when null is provided we try to invoke the failure block
+    if (objects == nil || [objects isKindOfClass:[NSNull class]]) {
+        [self raiseError:@"saveAll" msg:@"objects were nil" failure:failure];
+        // do nothing
+        return;
+    }
+
+    // saves them one by one
+    void (^saveEach)(void) = ^{
+        [self performAll:objects operation:^(id object, void (^completion)(id result)) {
+            [self save:object success:completion failure:completion];
+        } domain:@"saveAll" success:success failure:failure];
+    };
+
+    if (![self hasBulkEndpoint] || [objects count] == 0) {
+        saveEach();
+        return;
+    }
+
+    [_restClient POST:[self bulkPath] parameters:(id)objects success:^(NSURLSessionDataTask *task, id responseObject) {
+        // the server answers with the saved objects, in order
+        NSArray *responseObjects = ([responseObject isKindOfClass:[NSArray class]] && [responseObject count] == [objects count])
+                                    ? responseObject : objects;
+
+        [responseObjects enumerateObjectsUsingBlock:^(id savedObject, NSUInteger idx, BOOL *stop) {
+            [self acknowledgeVersion:[savedObject isKindOfClass:[NSDictionary class]] ? savedObject : objects[idx]];
+        }];
+
+        if (success) {
+            success(responseObjects);
+        }
+    } failure:^(NSURLSessionDataTask *task, NSError *error) {
+        if ([self isBulkEndpointRejectedByTask:task]) {
+            saveEach();
+        } else if (failure) {
+            failure([self bulkError:@"saveAll" results:[self results:error count:[objects count]] underlyingError:error]);
+        }
+    }];
+}
+
+-(void) removeAll:(NSArray*) objects
+          success:(void (^)(NSArray *responseObjects))success
+          failure:(void (^)(NSError *error))failure {
+
+    // when null is provided we try to invoke the failure block
+    if (objects == nil || [objects isKindOfClass:[NSNull class]]) {
+        [self raiseError:@"removeAll" msg:@"objects were nil" failure:failure];
+        // do nothing
+        return;
+    }
+
+    // removes them one by one
+    void (^removeEach)(void) = ^{
+        [self performAll:objects operation:^(id object, void (^completion)(id result)) {
+            [self remove:object success:completion failure:completion];
+        } domain:@"removeAll" success:success failure:failure];
+    };
+
+    NSMutableArray *deleteKeys = [NSMutableArray arrayWithCapacity:[objects count]];
+
+    for (id object in objects) {
+        id objectKey = [object isKindOfClass:[NSDictionary class]] ? object[_recordId] : nil;
+
+        // let the individual removes report the objects without id
+        if (objectKey == nil || [objectKey isKindOfClass:[NSNull class]]) {
+            deleteKeys = nil;
+            break;
+        }
+
+        [deleteKeys addObject:[self getStringValue:objectKey]];
+    }
+
+    if (![self hasBulkEndpoint] || [objects count] == 0 || !deleteKeys) {
+        removeEach();
+        return;
+    }
+
+    [_restClient DELETE:[self bulkPath] parameters:@{_recordId: [deleteKeys componentsJoinedByString:@","]} success:^(NSURLSessionDataTask *task, id responseObject) {
+        for (NSDictionary *object in objects)
+            [self forgetVersionOf:object];
+
+        if (success) {
+            NSMutableArray *responseObjects = [NSMutableArray arrayWithCapacity:[objects count]];
+
+            for (NSUInteger i = 0; i < [objects count]; i++)
+                [responseObjects addObject:[NSNull null]];
+
+            success(responseObjects);
+        }
+    } failure:^(NSURLSessionDataTask *task, NSError *error) {
+        if ([self isBulkEndpointRejectedByTask:task]) {
+            removeEach();
+        } else if (failure) {
+            failure([self bulkError:@"removeAll" results:[self results:error count:[objects count]] underlyingError:error]);
+        }
+    }];
+}
+
 -(void) cancel {
+    // drop the retries waiting for their delay
+    [_restClient cancelPendingRetries];
+
     // enumerate all running tasks
     [_restClient.tasks enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
         NSURLSessionTask *task = obj;
@@ -269,6 +483,159 @@
     return objectKey;
 }
 
+// the last version of an object acknowledged by the server, if known
+-(NSDictionary*) acknowledgedVersionOf:(id) objectKey {
+    if (_versionStore)
+        return [_versionStore read:objectKey];
+
+    @synchronized(_versions) {
+        return _versions[[self getStringValue:objectKey]];
+    }
+}
+
+// keeps the version of an object the server acknowledged, to PATCH it later on
+-(void) acknowledgeVersion:(id) object {
+    if (!_patchUpdates || ![object isKindOfClass:[NSDictionary class]])
+        return;
+
+    id objectKey = object[_recordId];
+
+    if (objectKey == nil || [objectKey isKindOfClass:[NSNull class]])
+        return;
+
+    // the caller may change its (mutable) object later on
+    NSDictionary* version = [AGJsonMergePatch copyOfObject:object];
+
+    if (_versionStore) {
+        [_versionStore save:version error:nil];
+        return;
+    }
+
+    @synchronized(_versions) {
+        _versions[[self getStringValue:objectKey]] = version;
+    }
+}
+
+-(void) forgetVersionOf:(NSDictionary*) object {
+    if (!_patchUpdates)
+        return;
+
+    if (_versionStore) {
+        [_versionStore remove:object error:nil];
+        return;
+    }
+
+    @synchronized(_versions) {
+        [_versions removeObjectForKey:[self getStringValue:object[_recordId]]];
+    }
+}
+
+// runs an operation on each object, with up to _bulkConcurrency of them under way at once,
+// collecting the per-object results (response object, or NSError) in order
+-(void) performAll:(NSArray*) objects
+         operation:(void (^)(id object, void (^completion)(id result)))operation
+            domain:(NSString*) domain
+           success:(void (^)(NSArray *responseObjects))success
+           failure:(void (^)(NSError *error))failure {
+
+    NSUInteger count = [objects count];
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:count];
+
+    for (NSUInteger i = 0; i < count; i++)
+        [results addObject:[NSNull null]];
+
+    void (^completed)(void) = ^{
+        NSUInteger failures = [[results indexesOfObjectsPassingTest:^BOOL(id result, NSUInteger idx, BOOL *stop) {
+            return [result isKindOfClass:[NSError class]];
+        }] count];
+
+        if (failures == 0) {
+            if (success) {
+                success(results);
+            }
+        } else if (failure) {
+            failure([self bulkError:domain results:results underlyingError:nil]);
+        }
+    };
+
+    if (count == 0) {
+        completed();
+        return;
+    }
+
+    __block NSUInteger started = 0;
+    __block NSUInteger finished = 0;
+    __block void (^startNext)(void);
+
+    startNext = ^{
+        NSUInteger index = started++;
+
+        operation(objects[index], ^(id result) {
+            results[index] = result ?: [NSNull null];
+
+            if (++finished == count) {
+                completed();
+                // break the cycle of the block
+                startNext = nil;
+            } else if (started < count) {
+                startNext();
+            }
+        });
+    };
+
+    for (NSUInteger i = 0; i < MIN(_bulkConcurrency, count); i++) {
+        if (started < count)
+            startNext();
+    }
+}
+
+-(BOOL) hasBulkEndpoint {
+    return _bulkEndpoint != nil && !_bulkUnsupported;
+}
+
+-(NSString*) bulkPath {
+    return [_bulkEndpoint length] > 0 ? [self appendObjectPath:_bulkEndpoint] : _URL.path;
+}
+
+// whether the server doesn't know the bulk endpoint, in which case it is no longer used
+-(BOOL) isBulkEndpointRejectedByTask:(NSURLSessionDataTask*) task {
+    NSInteger statusCode = [(NSHTTPURLResponse *) task.response statusCode];
+
+    if (statusCode == 404 || statusCode == 405 || statusCode == 501) {
+        _bulkUnsupported = YES;
+        return YES;
+    }
+
+    return NO;
+}
+
+// the results of a bulk request that failed as a whole
+-(NSArray*) results:(NSError*) error count:(NSUInteger) count {
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:count];
+
+    for (NSUInteger i = 0; i < count; i++)
+        [results addObject:error];
+
+    return results;
+}
+
+-(NSError*) bulkError:(NSString*) domain results:(NSArray*) results underlyingError:(NSError*) underlyingError {
+    NSUInteger failures = [[results indexesOfObjectsPassingTest:^BOOL(id result, NSUInteger idx, BOOL *stop) {
+        return [result isKindOfClass:[NSError class]];
+    }] count];
+
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+    userInfo[NSLocalizedDescriptionKey] = [NSString stringWithFormat:@"%lu of %lu objects failed", (unsigned long) failures, (unsigned long) [results count]];
+    userInfo[AGPipeBulkResultsKey] = results;
+
+    if (underlyingError)
+        userInfo[NSUnderlyingErrorKey] = underlyingError;
+
+    return [NSError errorWithDomain:[NSString stringWithFormat:@"org.aerogear.pipes.%@", domain]
+                               code:0
+                           userInfo:userInfo];
+}
+
 // appends the path for delete/updates to the URL
 -(NSString*) appendObjectPath:(NSString*)path {
     return [NSString stringWithFormat:@"%@/%@", _URL, path];
@@ -0,0 +1,99 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The length, in bytes, of the keys used by AGAESGCM.
+ */
+extern const NSUInteger AGAESGCMKeyLength;
+
+/**
+ * The recommended length, in bytes, of the IVs (nonces) passed to AGAESGCM.
+ */
+extern const NSUInteger AGAESGCMNonceLength;
+
+/**
+ * The length, in bytes, of the authentication tag appended to the ciphertext.
+ */
+extern const NSUInteger AGAESGCMTagLength;
+
+/**
+ AES-256 in Galois/Counter Mode (NIST SP 800-38D), with the same interface as AGSecretBox.
+
+ The AES rounds run through CommonCrypto, which uses the AES instructions of the CPU where
+ available, and the GHASH multiplications use the carry-less multiply instructions (PCLMULQDQ
+ on Intel, PMULL on ARMv8) when the library is built for a CPU that has them, falling back to
+ a table-driven implementation otherwise.
+
+ *IMPORTANT:* An IV must never be used twice with the same key. AGBaseEncryptionService
+ generates a random one for each encrypted record.
+ */
+@interface AGAESGCM : NSObject
+
+/**
+ * Initialize the cipher with the given key.
+ *
+ * @param key The AGAESGCMKeyLength bytes of the key.
+ *
+ * @return the newly created AGAESGCM object, or nil if the key has the wrong length.
+ */
+- (instancetype)initWithKey:(NSData *)key;
+
+/**
+ * Encrypts the data.
+ *
+ * @param data The data to encrypt.
+ * @param IV The IV, any non-empty length is supported but AGAESGCMNonceLength is recommended.
+ *
+ * @return the ciphertext followed by the authentication tag, or nil if the data couldn't be encrypted.
+ */
+- (NSData *)encrypt:(NSData *)data IV:(NSData *)IV;
+
+/**
+ * Encrypts the data, and authenticates it along with additional data that isn't encrypted.
+ *
+ * @param data The data to encrypt.
+ * @param IV The IV, any non-empty length is supported but AGAESGCMNonceLength is recommended.
+ * @param additionalData The data authenticated but not encrypted (e.g. a header), or nil.
+ *
+ * @return the ciphertext followed by the authentication tag, or nil if the data couldn't be encrypted.
+ */
+- (NSData *)encrypt:(NSData *)data IV:(NSData *)IV additionalData:(NSData *)additionalData;
+
+/**
+ * Verifies the authentication tag and decrypts the data.
+ *
+ * @param data The ciphertext followed by the authentication tag, as returned by encrypt:IV:.
+ * @param IV The IV the data was encrypted with.
+ *
+ * @return the plain data, or nil if the data is not authentic (e.g. a wrong key or IV was given).
+ */
+- (NSData *)decrypt:(NSData *)data IV:(NSData *)IV;
+
+/**
+ * Verifies the authentication tag of the data and the additional data, and decrypts the data.
+ *
+ * @param data The ciphertext followed by the authentication tag, as returned by encrypt:IV:additionalData:.
+ * @param IV The IV the data was encrypted with.
+ * @param additionalData The additional data the data was encrypted with, or nil.
+ *
+ * @return the plain data, or nil if the data is not authentic (e.g. a wrong key, IV or additional data was given).
+ */
+- (NSData *)decrypt:(NSData *)data IV:(NSData *)IV additionalData:(NSData *)additionalData;
+
+@end
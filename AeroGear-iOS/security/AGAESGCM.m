@@ -0,0 +1,480 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGAESGCM.h"
+
+#include <string.h>
+#include <CommonCrypto/CommonCryptor.h>
+
+#if defined(__x86_64__) && defined(__PCLMUL__)
+#include <wmmintrin.h>
+#define AG_GCM_CLMUL 1
+#elif defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#define AG_GCM_CLMUL 1
+#endif
+
+const NSUInteger AGAESGCMKeyLength = 32;
+const NSUInteger AGAESGCMNonceLength = 12;
+const NSUInteger AGAESGCMTagLength = 16;
+
+#define AG_GCM_BLOCK_SIZE 16
+
+// the longest plain data GCM allows, 2^32 - 2 blocks
+#define AG_GCM_MAX_LENGTH ((((uint64_t)1 << 32) - 2) * AG_GCM_BLOCK_SIZE)
+
+// the blocks hashed with a single reduction, when carry-less multiplication is available
+#define AG_GCM_AGGREGATED_BLOCKS 4
+
+typedef struct AGGCMKey {
+    uint8_t key[32];
+    uint64_t H[2];              // the hash key, as big-endian words
+#ifdef AG_GCM_CLMUL
+    uint64_t powers[AG_GCM_AGGREGATED_BLOCKS][2];   // H, H^2, H^3 and H^4
+#else
+    uint64_t HL[16], HH[16];    // multiples of H, for the table-driven multiplication
+#endif
+} AGGCMKey;
+
+#pragma mark - GHASH
+
+static inline uint64_t AGLoad64(const uint8_t *bytes) {
+    uint64_t value;
+
+    memcpy(&value, bytes, sizeof(value));
+
+    return CFSwapInt64BigToHost(value);
+}
+
+static inline void AGStore64(uint8_t *bytes, uint64_t value) {
+    value = CFSwapInt64HostToBig(value);
+
+    memcpy(bytes, &value, sizeof(value));
+}
+
+#ifdef AG_GCM_CLMUL
+
+static inline void AGCarrylessMultiply(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi) {
+#if defined(__x86_64__)
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)a), _mm_cvtsi64_si128((long long)b), 0x00);
+
+    *lo = (uint64_t)_mm_cvtsi128_si64(product);
+    *hi = (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(product, product));
+#else
+    uint64x2_t product = vreinterpretq_u64_p128(vmull_p64((poly64_t)a, (poly64_t)b));
+
+    *lo = vgetq_lane_u64(product, 0);
+    *hi = vgetq_lane_u64(product, 1);
+#endif
+}
+
+// acc += A * B, the 256-bit carry-less product (Karatsuba)
+static inline void AGMultiplyAccumulate(const uint64_t A[2], const uint64_t B[2], uint64_t acc[4]) {
+    uint64_t lo0, hi0, lo1, hi1, lom, him;
+
+    AGCarrylessMultiply(A[1], B[1], &lo0, &hi0);
+    AGCarrylessMultiply(A[0], B[0], &lo1, &hi1);
+    AGCarrylessMultiply(A[0] ^ A[1], B[0] ^ B[1], &lom, &him);
+
+    lom ^= lo0 ^ lo1;
+    him ^= hi0 ^ hi1;
+
+    acc[0] ^= lo0;
+    acc[1] ^= hi0 ^ lom;
+    acc[2] ^= lo1 ^ him;
+    acc[3] ^= hi1;
+}
+
+// X = acc mod x^128 + x^7 + x^2 + x + 1, on the byte-reflected representation of the
+// blocks (see Gueron and Kounavis, "Intel Carry-Less Multiplication Instruction and its
+// Usage for Computing the GCM Mode")
+static void AGReduce(const uint64_t acc[4], uint64_t X[2]) {
+    // the product of two reflected values is shifted by one bit
+    uint64_t x3 = (acc[3] << 1) | (acc[2] >> 63);
+    uint64_t x2 = (acc[2] << 1) | (acc[1] >> 63);
+    uint64_t x1 = (acc[1] << 1) | (acc[0] >> 63);
+    uint64_t x0 = acc[0] << 1;
+
+    uint64_t d = x1 ^ (x0 << 63) ^ (x0 << 62) ^ (x0 << 57);
+
+    uint64_t h1 = d ^ (d >> 1) ^ (d >> 2) ^ (d >> 7);
+    uint64_t h0 = x0 ^ ((x0 >> 1) | (d << 63)) ^ ((x0 >> 2) | (d << 62)) ^ ((x0 >> 7) | (d << 57));
+
+    X[0] = x3 ^ h1;
+    X[1] = x2 ^ h0;
+}
+
+// X = X * H in GF(2^128)
+static void AGGCMMultiply(const AGGCMKey *key, uint64_t X[2]) {
+    uint64_t acc[4] = {0, 0, 0, 0};
+
+    AGMultiplyAccumulate(X, key->H, acc);
+    AGReduce(acc, X);
+}
+
+static void AGGCMPrepare(AGGCMKey *key) {
+    memcpy(key->powers[0], key->H, sizeof(key->H));
+
+    for (int i = 1; i < AG_GCM_AGGREGATED_BLOCKS; i++) {
+        memcpy(key->powers[i], key->powers[i - 1], sizeof(key->H));
+        AGGCMMultiply(key, key->powers[i]);
+    }
+}
+
+// absorbs the blocks in groups, Y = (Y + B1) * H^4 + B2 * H^3 + B3 * H^2 + B4 * H,
+// so that a single reduction is needed for each group
+static size_t AGGHashAggregated(const AGGCMKey *key, uint64_t Y[2], const uint8_t *data, size_t length) {
+    size_t groupLength = AG_GCM_AGGREGATED_BLOCKS * AG_GCM_BLOCK_SIZE;
+    size_t offset = 0;
+
+    for (; length - offset >= groupLength; offset += groupLength) {
+        uint64_t acc[4] = {0, 0, 0, 0};
+
+        for (int i = 0; i < AG_GCM_AGGREGATED_BLOCKS; i++) {
+            const uint8_t *block = data + offset + i * AG_GCM_BLOCK_SIZE;
+            uint64_t B[2] = {AGLoad64(block), AGLoad64(block + 8)};
+
+            if (i == 0) {
+                B[0] ^= Y[0];
+                B[1] ^= Y[1];
+            }
+
+            AGMultiplyAccumulate(B, key->powers[AG_GCM_AGGREGATED_BLOCKS - 1 - i], acc);
+        }
+
+        AGReduce(acc, Y);
+    }
+
+    return offset;
+}
+
+#else
+
+// the reduction of the 4 bits shifted out by each step of the table-driven multiplication
+static const uint64_t AGGCMLast4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+// X = X * H in GF(2^128), 4 bits at a time (Shoup's method)
+static void AGGCMMultiply(const AGGCMKey *key, uint64_t X[2]) {
+    uint8_t x[AG_GCM_BLOCK_SIZE];
+
+    AGStore64(x, X[0]);
+    AGStore64(x + 8, X[1]);
+
+    uint8_t lo = x[15] & 0xf;
+    uint64_t zh = key->HH[lo];
+    uint64_t zl = key->HL[lo];
+
+    for (int i = 15; i >= 0; i--) {
+        lo = x[i] & 0xf;
+        uint8_t hi = (x[i] >> 4) & 0xf;
+
+        if (i != 15) {
+            uint8_t rem = (uint8_t)zl & 0xf;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (AGGCMLast4[rem] << 48) ^ key->HH[lo];
+            zl ^= key->HL[lo];
+        }
+
+        uint8_t rem = (uint8_t)zl & 0xf;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (AGGCMLast4[rem] << 48) ^ key->HH[hi];
+        zl ^= key->HL[hi];
+    }
+
+    X[0] = zh;
+    X[1] = zl;
+}
+
+static void AGGCMPrepare(AGGCMKey *key) {
+    uint64_t vh = key->H[0];
+    uint64_t vl = key->H[1];
+
+    key->HH[0] = key->HL[0] = 0;
+    key->HH[8] = vh;
+    key->HL[8] = vl;
+
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t reduction = (vl & 1) ? ((uint64_t)0xe1000000 << 32) : 0;
+
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ reduction;
+
+        key->HH[i] = vh;
+        key->HL[i] = vl;
+    }
+
+    for (int i = 2; i <= 8; i *= 2) {
+        for (int j = 1; j < i; j++) {
+            key->HH[i + j] = key->HH[i] ^ key->HH[j];
+            key->HL[i + j] = key->HL[i] ^ key->HL[j];
+        }
+    }
+}
+
+#endif
+
+// absorbs the data into the hash, the last block padded with zeros
+static void AGGHash(const AGGCMKey *key, uint64_t Y[2], const uint8_t *data, size_t length) {
+    uint8_t block[AG_GCM_BLOCK_SIZE];
+
+#ifdef AG_GCM_CLMUL
+    size_t aggregated = AGGHashAggregated(key, Y, data, length);
+
+    data += aggregated;
+    length -= aggregated;
+#endif
+
+    while (length > 0) {
+        size_t n = length < AG_GCM_BLOCK_SIZE ? length : AG_GCM_BLOCK_SIZE;
+
+        if (n < AG_GCM_BLOCK_SIZE) {
+            memset(block, 0, sizeof(block));
+            memcpy(block, data, n);
+            data = block;
+        }
+
+        Y[0] ^= AGLoad64(data);
+        Y[1] ^= AGLoad64(data + 8);
+        AGGCMMultiply(key, Y);
+
+        data += n;
+        length -= n;
+    }
+}
+
+static void AGGHashLengths(const AGGCMKey *key, uint64_t Y[2], uint64_t aadLength, uint64_t dataLength) {
+    Y[0] ^= aadLength * 8;
+    Y[1] ^= dataLength * 8;
+    AGGCMMultiply(key, Y);
+}
+
+#pragma mark - GCM
+
+static int AGGCMInit(AGGCMKey *key, const uint8_t *bytes) {
+    static const uint8_t zeros[AG_GCM_BLOCK_SIZE] = {0};
+    uint8_t H[AG_GCM_BLOCK_SIZE];
+    size_t moved;
+
+    memcpy(key->key, bytes, sizeof(key->key));
+
+    if (CCCrypt(kCCEncrypt, kCCAlgorithmAES, kCCOptionECBMode, key->key, sizeof(key->key), NULL,
+                zeros, sizeof(zeros), H, sizeof(H), &moved) != kCCSuccess)
+        return -1;
+
+    key->H[0] = AGLoad64(H);
+    key->H[1] = AGLoad64(H + 8);
+
+    AGGCMPrepare(key);
+
+    return 0;
+}
+
+static void AGGCMCounter(const AGGCMKey *key, const uint8_t *IV, size_t IVLength, uint8_t J0[AG_GCM_BLOCK_SIZE]) {
+    if (IVLength == 12) {
+        memcpy(J0, IV, IVLength);
+        J0[12] = J0[13] = J0[14] = 0;
+        J0[15] = 1;
+        return;
+    }
+
+    uint64_t Y[2] = {0, 0};
+
+    AGGHash(key, Y, IV, IVLength);
+    AGGHashLengths(key, Y, 0, IVLength);
+
+    AGStore64(J0, Y[0]);
+    AGStore64(J0 + 8, Y[1]);
+}
+
+// encrypts J0 into the mask of the tag, and the data with the counters that follow it;
+// only the last 32 bits of the counter are incremented, so they wrap around on their own
+static int AGGCMCounterMode(const AGGCMKey *key, const uint8_t J0[AG_GCM_BLOCK_SIZE],
+                            const uint8_t *input, uint8_t *output, size_t length,
+                            uint8_t mask[AG_GCM_BLOCK_SIZE]) {
+    static const uint8_t zeros[AG_GCM_BLOCK_SIZE] = {0};
+    uint8_t counter[AG_GCM_BLOCK_SIZE];
+    CCCryptorRef cryptor = NULL;
+    size_t moved;
+
+    memcpy(counter, J0, sizeof(counter));
+
+    // the blocks left before the last 32 bits wrap around
+    uint64_t available = ((uint64_t)1 << 32) - AGLoad64(counter + 8) % ((uint64_t)1 << 32);
+    int status = CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES, ccNoPadding, counter,
+                                         key->key, sizeof(key->key), NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
+
+    if (status == kCCSuccess)
+        status = CCCryptorUpdate(cryptor, zeros, sizeof(zeros), mask, AG_GCM_BLOCK_SIZE, &moved);
+
+    available--;
+
+    for (size_t offset = 0; offset < length && status == kCCSuccess; ) {
+        if (available == 0) {
+            CCCryptorRelease(cryptor);
+            cryptor = NULL;
+
+            memset(counter + 12, 0, 4);
+            available = (uint64_t)1 << 32;
+
+            status = CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES, ccNoPadding, counter,
+                                             key->key, sizeof(key->key), NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
+            if (status != kCCSuccess)
+                break;
+        }
+
+        size_t n = length - offset;
+
+        if (n > available * AG_GCM_BLOCK_SIZE)
+            n = (size_t)(available * AG_GCM_BLOCK_SIZE);
+
+        status = CCCryptorUpdate(cryptor, input + offset, n, output + offset, n, &moved);
+
+        offset += n;
+        available -= (n + AG_GCM_BLOCK_SIZE - 1) / AG_GCM_BLOCK_SIZE;
+    }
+
+    if (cryptor)
+        CCCryptorRelease(cryptor);
+
+    return status == kCCSuccess ? 0 : -1;
+}
+
+static void AGGCMTag(const AGGCMKey *key, const uint8_t *aad, size_t aadLength,
+                     const uint8_t *ciphertext, size_t length,
+                     const uint8_t mask[AG_GCM_BLOCK_SIZE], uint8_t tag[AG_GCM_BLOCK_SIZE]) {
+    uint64_t S[2] = {0, 0};
+
+    AGGHash(key, S, aad, aadLength);
+    AGGHash(key, S, ciphertext, length);
+    AGGHashLengths(key, S, aadLength, length);
+
+    AGStore64(tag, S[0]);
+    AGStore64(tag + 8, S[1]);
+
+    for (int i = 0; i < AG_GCM_BLOCK_SIZE; i++)
+        tag[i] ^= mask[i];
+}
+
+static int AGGCMEncrypt(const AGGCMKey *key, const uint8_t *IV, size_t IVLength, const uint8_t *aad, size_t aadLength,
+                        const uint8_t *input, size_t length, uint8_t *output, uint8_t tag[AG_GCM_BLOCK_SIZE]) {
+    uint8_t J0[AG_GCM_BLOCK_SIZE], mask[AG_GCM_BLOCK_SIZE];
+
+    if (IVLength == 0 || (uint64_t)length > AG_GCM_MAX_LENGTH)
+        return -1;
+
+    AGGCMCounter(key, IV, IVLength, J0);
+
+    if (AGGCMCounterMode(key, J0, input, output, length, mask) != 0)
+        return -1;
+
+    AGGCMTag(key, aad, aadLength, output, length, mask, tag);
+
+    return 0;
+}
+
+static int AGGCMDecrypt(const AGGCMKey *key, const uint8_t *IV, size_t IVLength, const uint8_t *aad, size_t aadLength,
+                        const uint8_t *input, size_t length, const uint8_t tag[AG_GCM_BLOCK_SIZE], uint8_t *output) {
+    uint8_t J0[AG_GCM_BLOCK_SIZE], mask[AG_GCM_BLOCK_SIZE], expected[AG_GCM_BLOCK_SIZE];
+
+    if (IVLength == 0 || (uint64_t)length > AG_GCM_MAX_LENGTH)
+        return -1;
+
+    AGGCMCounter(key, IV, IVLength, J0);
+
+    if (AGGCMCounterMode(key, J0, input, output, length, mask) != 0)
+        return -1;
+
+    AGGCMTag(key, aad, aadLength, input, length, mask, expected);
+
+    // compared in constant time
+    uint8_t difference = 0;
+
+    for (int i = 0; i < AG_GCM_BLOCK_SIZE; i++)
+        difference |= expected[i] ^ tag[i];
+
+    if (difference != 0) {
+        // never release unauthenticated data
+        memset(output, 0, length);
+        return -1;
+    }
+
+    return 0;
+}
+
+@implementation AGAESGCM {
+    AGGCMKey _key;
+}
+
+- (instancetype)initWithKey:(NSData *)key {
+    if ([key length] != AGAESGCMKeyLength)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        if (AGGCMInit(&_key, [key bytes]) != 0)
+            return nil;
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    memset(&_key, 0, sizeof(_key));
+}
+
+- (NSData *)encrypt:(NSData *)data IV:(NSData *)IV {
+    return [self encrypt:data IV:IV additionalData:nil];
+}
+
+- (NSData *)encrypt:(NSData *)data IV:(NSData *)IV additionalData:(NSData *)additionalData {
+    if (!data || !IV)
+        return nil;
+
+    NSUInteger length = [data length];
+    NSMutableData *ciphertext = [NSMutableData dataWithLength:length + AGAESGCMTagLength];
+    uint8_t *bytes = [ciphertext mutableBytes];
+
+    if (AGGCMEncrypt(&_key, [IV bytes], [IV length], [additionalData bytes], [additionalData length],
+                     [data bytes], length, bytes, bytes + length) != 0)
+        return nil;
+
+    return ciphertext;
+}
+
+- (NSData *)decrypt:(NSData *)data IV:(NSData *)IV {
+    return [self decrypt:data IV:IV additionalData:nil];
+}
+
+- (NSData *)decrypt:(NSData *)data IV:(NSData *)IV additionalData:(NSData *)additionalData {
+    if ([data length] < AGAESGCMTagLength || !IV)
+        return nil;
+
+    NSUInteger length = [data length] - AGAESGCMTagLength;
+    NSMutableData *plaintext = [NSMutableData dataWithLength:length];
+    const uint8_t *bytes = [data bytes];
+
+    if (AGGCMDecrypt(&_key, [IV bytes], [IV length], [additionalData bytes], [additionalData length],
+                     bytes, length, bytes + length, [plaintext mutableBytes]) != 0)
+        return nil;
+
+    return plaintext;
+}
+
+@end
@@ -18,6 +18,7 @@
 #import <Foundation/Foundation.h>
 
 #import "AGEncryptionService.h"
+#import "AGCryptoConfig.h"
 
 @class AGSecretBox;
 
@@ -30,6 +31,28 @@
 @protected
     AGSecretBox *_secretBox;
     NSData *_applicationIV;
+    NSData *_indexKey;
+    NSData *_streamKey;
 }
 
+/**
+ * Sets up the service with the given symmetric key. Subclasses call this
+ * method once they have derived or retrieved their key.
+ *
+ * @param key The key used for encryption/decryption.
+ */
+- (void)applyKey:(NSData *)key;
+
+/**
+ * The cipher data is encrypted with, see AGCipherSuite. Defaults to AGCipherSuiteSecretBox.
+ * The AES-256-GCM key is derived from the key of the service (see keyForPurpose:).
+ */
+@property (nonatomic, assign) AGCipherSuite cipherSuite;
+
+/**
+ * The size of the plain data segments written by encryptStream:toStream:error:.
+ * Defaults to 64 KiB, and is rounded up to a multiple of the cipher block size.
+ */
+@property (nonatomic, assign) NSUInteger segmentSize;
+
 @end
@@ -18,10 +18,52 @@
 #import "AGBaseEncryptionService.h"
 #import <AGSecretBox.h>
 #import <AGRandomGenerator.h>
+#import <CommonCrypto/CommonHMAC.h>
+#import "AGNSStream+IO.h"
+#import "AGAESGCM.h"
+
+// error domain for encryption services
+NSString * const AGEncryptionErrorDomain = @"AGEncryptionErrorDomain";
 
 static NSString *const kApplicationIV = @"applicationIV";
 
-@implementation AGBaseEncryptionService
+// the purpose the blind index key is derived for, so that the
+// encryption key itself is never used to compute the tokens
+static NSString *const kBlindIndexPurpose = @"AGBlindIndex";
+
+// tokens are truncated, which is enough to tell values apart
+// while leaking less about values that happen to collide
+static const NSUInteger kBlindIndexLength = 16;
+
+// the purpose the segment authentication key is derived for
+static NSString *const kStreamPurpose = @"AGStream";
+
+// the purpose the AES-256-GCM key is derived for
+static NSString *const kAESGCMPurpose = @"AGCipherSuite.AES256GCM";
+
+// the encrypted stream format:
+//
+//   header:  'AGE1' | segment size (uint32) | base nonce (16 bytes)
+//   segment: final flag (uint8) | length (uint32) | ciphertext | tag (32 bytes)
+//
+// integers are big-endian. The IV of each segment is the base nonce with its
+// index xor'ed into the last 8 bytes, and the tag is an HMAC of the header,
+// the index, the final flag and the ciphertext.
+static const char kStreamMagic[4] = {'A', 'G', 'E', '1'};
+static const NSUInteger kStreamNonceLength = 16;
+static const NSUInteger kStreamHeaderLength = 4 + 4 + kStreamNonceLength;
+static const NSUInteger kSegmentHeaderLength = 1 + 4;
+static const NSUInteger kSegmentTagLength = CC_SHA256_DIGEST_LENGTH;
+static const NSUInteger kDefaultSegmentSize = 64 * 1024;
+static const NSUInteger kCipherBlockSize = 16;
+// bounds the memory used to read a (corrupted) segment
+static const NSUInteger kMaxSegmentLength = 16 * 1024 * 1024;
+
+@implementation AGBaseEncryptionService {
+    NSData *_key;
+    // set if the AES-256-GCM cipher suite is selected
+    AGAESGCM *_gcm;
+}
 
 - (instancetype)init {
     self = [super init];
@@ -36,29 +78,476 @@ static NSString *const kApplicationIV = @"applicationIV";
             [defaults setObject:_applicationIV forKey:kApplicationIV];
             [defaults synchronize];
         }
+        
+        _segmentSize = kDefaultSegmentSize;
     }
     
     return self;
 }
 
+- (void)applyKey:(NSData *)key {
+    _secretBox = [[AGSecretBox alloc] initWithKey:key];
+    _key = key;
+    
+    _indexKey = [self keyForPurpose:kBlindIndexPurpose];
+    _streamKey = [self keyForPurpose:kStreamPurpose];
+    
+    [self setUpCipher];
+}
+
+- (void)setCipherSuite:(AGCipherSuite)cipherSuite {
+    _cipherSuite = cipherSuite;
+    
+    [self setUpCipher];
+}
+
+- (NSData *)keyForPurpose:(NSString *)purpose {
+    if (!_key)
+        return nil;
+    
+    return [self HMAC:[purpose dataUsingEncoding:NSUTF8StringEncoding] key:_key];
+}
+
+- (void)setSegmentSize:(NSUInteger)segmentSize {
+    // keep segments aligned to the cipher blocks
+    segmentSize = MAX(segmentSize, kCipherBlockSize);
+    _segmentSize = (segmentSize + kCipherBlockSize - 1) / kCipherBlockSize * kCipherBlockSize;
+}
+
 - (NSData *)encrypt:(NSData *)data {
+    if (_gcm)
+        return [self sealWithRandomNonce:data cipher:_gcm];
+    
     return [self encrypt:data IV:_applicationIV];
     
 }
 
 - (NSData *)encrypt:(NSData *)data IV:(NSData *)IV {
+    if (_gcm)
+        return [_gcm encrypt:data IV:IV];
+    
     return [_secretBox encrypt:data IV:IV];
     
 }
 
 - (NSData *)decrypt:(NSData *)data {
+    if (_gcm)
+        return [self openWithRandomNonce:data cipher:_gcm];
+    
     return [self decrypt:data IV:_applicationIV];
     
 }
 
 - (NSData *)decrypt:(NSData *)data IV:(NSData *)IV {
+    if (_gcm)
+        return [_gcm decrypt:data IV:IV];
+    
     return [_secretBox decrypt:data IV:IV];
 }
 
+- (NSArray *)encryptAll:(NSArray *)data {
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[data count]];
+    
+    // the cipher and IV are looked up once for the whole batch
+    AGSecretBox *secretBox = _secretBox;
+    AGAESGCM *gcm = _gcm;
+    NSData *IV = _applicationIV;
+    
+    // the nonces of the whole batch are drawn from the random generator at once
+    NSData *nonces = gcm ? [AGRandomGenerator randomBytes:AGAESGCMNonceLength * [data count]] : nil;
+    
+    @autoreleasepool {
+        for (NSUInteger i = 0; i < [data count]; i++) {
+            NSData *encryptedData;
+            
+            if (gcm) {
+                NSData *nonce = [nonces subdataWithRange:NSMakeRange(i * AGAESGCMNonceLength, AGAESGCMNonceLength)];
+                encryptedData = [self seal:data[i] nonce:nonce cipher:gcm];
+            } else {
+                encryptedData = [secretBox encrypt:data[i] IV:IV];
+            }
+            
+            if (!encryptedData)
+                return nil;
+            
+            [results addObject:encryptedData];
+        }
+    }
+    
+    return results;
+}
+
+- (NSArray *)decryptAll:(NSArray *)data {
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:[data count]];
+    
+    AGSecretBox *secretBox = _secretBox;
+    AGAESGCM *gcm = _gcm;
+    NSData *IV = _applicationIV;
+    
+    @autoreleasepool {
+        for (NSData *item in data) {
+            NSData *decryptedData = gcm ? [self openWithRandomNonce:item cipher:gcm] : [secretBox decrypt:item IV:IV];
+            
+            if (!decryptedData)
+                return nil;
+            
+            [results addObject:decryptedData];
+        }
+    }
+    
+    return results;
+}
+
+- (NSData *)blindIndex:(NSData *)data {
+    if (!_indexKey || !data)
+        return nil;
+    
+    return [[self HMAC:data key:_indexKey] subdataWithRange:NSMakeRange(0, kBlindIndexLength)];
+}
+
+- (BOOL)encryptStream:(NSInputStream *)input toStream:(NSOutputStream *)output error:(NSError **)error {
+    if (!_streamKey) {
+        if (error)
+            *error = [self errorWithDescription:@"no key available for encryption"];
+        return NO;
+    }
+    
+    NSUInteger segmentSize = _segmentSize;
+    
+    NSMutableData *header = [NSMutableData dataWithBytes:kStreamMagic length:sizeof(kStreamMagic)];
+    uint32_t size = CFSwapInt32HostToBig((uint32_t)segmentSize);
+    [header appendBytes:&size length:sizeof(size)];
+    [header appendData:[AGRandomGenerator randomBytes:kStreamNonceLength]];
+    
+    if (![output writeAllData:header error:error])
+        return NO;
+    
+    NSError *segmentError;
+    
+    // read one segment ahead, to know which one is the final
+    NSData *segment = [input readDataUpToLength:segmentSize error:&segmentError];
+    BOOL success = segment != nil;
+    
+    for (uint64_t index = 0; segment; index++) {
+        @autoreleasepool {
+            NSData *next = nil;
+            
+            // a short segment can only be the final one
+            if ([segment length] == segmentSize) {
+                next = [input readDataUpToLength:segmentSize error:&segmentError];
+                
+                if (!next) {
+                    success = NO;
+                    break;
+                }
+            }
+            
+            BOOL final = [next length] == 0;
+            
+            success = [self writeSegment:segment index:index final:final header:header toStream:output error:&segmentError];
+            
+            segment = (final || !success) ? nil : next;
+        }
+    }
+    
+    // the error must outlive the autorelease pool
+    if (!success && error)
+        *error = segmentError;
+    
+    return success;
+}
+
+- (BOOL)decryptStream:(NSInputStream *)input toStream:(NSOutputStream *)output error:(NSError **)error {
+    NSData *header = [self readHeaderFromStream:input error:error];
+    
+    if (!header)
+        return NO;
+    
+    NSError *segmentError;
+    BOOL final = NO;
+    BOOL success = YES;
+    
+    for (uint64_t index = 0; !final && success; index++) {
+        @autoreleasepool {
+            NSData *segmentHeader = [input readDataOfLength:kSegmentHeaderLength error:&segmentError];
+            
+            if ([segmentHeader length] == 0) {
+                // the stream ended before the final segment
+                if (segmentHeader)
+                    segmentError = [self errorWithDescription:@"encrypted stream is truncated"];
+                success = NO;
+                break;
+            }
+            
+            NSData *ciphertext = [self readSegmentWithHeader:segmentHeader fromStream:input final:&final error:&segmentError];
+            NSData *plaintext = [self openSegment:ciphertext index:index final:final header:header error:&segmentError];
+            
+            success = plaintext && [output writeAllData:plaintext error:&segmentError];
+        }
+    }
+    
+    // the error must outlive the autorelease pool
+    if (!success) {
+        if (error)
+            *error = segmentError;
+        return NO;
+    }
+    
+    // nothing may follow the final segment
+    uint8_t extra;
+    if ([input read:&extra maxLength:1] != 0) {
+        if (error)
+            *error = [self errorWithDescription:@"unexpected data after the final segment"];
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (NSData *)decryptSegment:(NSUInteger)index ofFile:(NSFileHandle *)file error:(NSError **)error {
+    [file seekToFileOffset:0];
+    
+    NSData *header = [file readDataOfLength:kStreamHeaderLength];
+    
+    if (![self isValidHeader:header error:error])
+        return nil;
+    
+    // all the segments but the final one have the same size, so
+    // the size of the first one tells where the requested one starts
+    NSData *segmentHeader = [file readDataOfLength:kSegmentHeaderLength];
+    
+    if ([segmentHeader length] < kSegmentHeaderLength) {
+        if (error)
+            *error = [self errorWithDescription:@"encrypted stream is truncated"];
+        return nil;
+    }
+    
+    unsigned long long segmentLength = kSegmentHeaderLength + [self lengthOfSegmentWithHeader:segmentHeader] + kSegmentTagLength;
+    
+    [file seekToFileOffset:kStreamHeaderLength + index * segmentLength];
+    
+    segmentHeader = [file readDataOfLength:kSegmentHeaderLength];
+    
+    if ([segmentHeader length] < kSegmentHeaderLength) {
+        if (error)
+            *error = [self errorWithDescription:@"segment index out of range"];
+        return nil;
+    }
+    
+    NSUInteger length = [self lengthOfSegmentWithHeader:segmentHeader] + kSegmentTagLength;
+    NSData *ciphertext = [file readDataOfLength:length];
+    
+    if ([ciphertext length] < length) {
+        if (error)
+            *error = [self errorWithDescription:@"encrypted stream is truncated"];
+        return nil;
+    }
+    
+    BOOL final = ((const uint8_t *)[segmentHeader bytes])[0] != 0;
+    
+    return [self openSegment:ciphertext index:index final:final header:header error:error];
+}
+
+#pragma mark - private helper methods
+
+- (void)setUpCipher {
+    _gcm = (_cipherSuite == AGCipherSuiteAES256GCM && _key) ?
+            [[AGAESGCM alloc] initWithKey:[self keyForPurpose:kAESGCMPurpose]] : nil;
+}
+
+// a fresh nonce is generated for each record, and stored in front of its ciphertext
+- (NSData *)sealWithRandomNonce:(NSData *)data cipher:(AGAESGCM *)cipher {
+    return [self seal:data nonce:[AGRandomGenerator randomBytes:AGAESGCMNonceLength] cipher:cipher];
+}
+
+- (NSData *)seal:(NSData *)data nonce:(NSData *)nonce cipher:(AGAESGCM *)cipher {
+    NSData *ciphertext = [cipher encrypt:data IV:nonce];
+    
+    if (!ciphertext)
+        return nil;
+    
+    NSMutableData *sealed = [NSMutableData dataWithCapacity:[nonce length] + [ciphertext length]];
+    [sealed appendData:nonce];
+    [sealed appendData:ciphertext];
+    
+    return sealed;
+}
+
+- (NSData *)openWithRandomNonce:(NSData *)data cipher:(AGAESGCM *)cipher {
+    if ([data length] < AGAESGCMNonceLength + AGAESGCMTagLength)
+        return nil;
+    
+    NSData *nonce = [data subdataWithRange:NSMakeRange(0, AGAESGCMNonceLength)];
+    NSData *ciphertext = [data subdataWithRange:NSMakeRange(AGAESGCMNonceLength, [data length] - AGAESGCMNonceLength)];
+    
+    return [cipher decrypt:ciphertext IV:nonce];
+}
+
+- (BOOL)writeSegment:(NSData *)segment index:(uint64_t)index final:(BOOL)final
+              header:(NSData *)header toStream:(NSOutputStream *)output error:(NSError **)error {
+    
+    NSData *ciphertext = [self encrypt:segment IV:[self IVForSegment:index header:header]];
+    
+    if (!ciphertext) {
+        if (error)
+            *error = [self errorWithDescription:@"unable to encrypt segment"];
+        return NO;
+    }
+    
+    NSMutableData *frame = [NSMutableData dataWithCapacity:kSegmentHeaderLength + [ciphertext length] + kSegmentTagLength];
+    
+    uint8_t flag = final ? 1 : 0;
+    uint32_t length = CFSwapInt32HostToBig((uint32_t)[ciphertext length]);
+    [frame appendBytes:&flag length:sizeof(flag)];
+    [frame appendBytes:&length length:sizeof(length)];
+    [frame appendData:ciphertext];
+    [frame appendData:[self tagForSegment:ciphertext index:index final:final header:header]];
+    
+    return [output writeAllData:frame error:error];
+}
+
+// returns the ciphertext of the segment followed by its tag
+- (NSData *)readSegmentWithHeader:(NSData *)segmentHeader fromStream:(NSInputStream *)input
+                            final:(BOOL *)final error:(NSError **)error {
+    
+    *final = ((const uint8_t *)[segmentHeader bytes])[0] != 0;
+    
+    NSUInteger length = [self lengthOfSegmentWithHeader:segmentHeader];
+    
+    // a corrupted length must not lead to a huge allocation
+    if (length > kMaxSegmentLength) {
+        if (error)
+            *error = [self errorWithDescription:@"invalid segment length"];
+        return nil;
+    }
+    
+    NSData *data = [input readDataOfLength:length + kSegmentTagLength error:error];
+    
+    if ([data length] == 0) {
+        if (data && error)
+            *error = [self errorWithDescription:@"encrypted stream is truncated"];
+        return nil;
+    }
+    
+    return data;
+}
+
+// verifies the tag, and decrypts the ciphertext preceding it
+- (NSData *)openSegment:(NSData *)data index:(uint64_t)index final:(BOOL)final
+                 header:(NSData *)header error:(NSError **)error {
+    
+    if (!data)
+        return nil;
+    
+    NSUInteger length = [data length] - kSegmentTagLength;
+    NSData *ciphertext = [data subdataWithRange:NSMakeRange(0, length)];
+    NSData *tag = [data subdataWithRange:NSMakeRange(length, kSegmentTagLength)];
+    
+    if (![self isEqualTag:tag toTag:[self tagForSegment:ciphertext index:index final:final header:header]]) {
+        if (error)
+            *error = [self errorWithDescription:@"segment authentication failed"];
+        return nil;
+    }
+    
+    NSData *plaintext = [self decrypt:ciphertext IV:[self IVForSegment:index header:header]];
+    
+    if (!plaintext) {
+        if (error)
+            *error = [self errorWithDescription:@"unable to decrypt segment"];
+        return nil;
+    }
+    
+    return plaintext;
+}
+
+- (NSData *)readHeaderFromStream:(NSInputStream *)input error:(NSError **)error {
+    NSData *header = [input readDataOfLength:kStreamHeaderLength error:error];
+    
+    if (!header)
+        return nil;
+    
+    return [self isValidHeader:header error:error] ? header : nil;
+}
+
+- (BOOL)isValidHeader:(NSData *)header error:(NSError **)error {
+    if (!_streamKey) {
+        if (error)
+            *error = [self errorWithDescription:@"no key available for decryption"];
+        return NO;
+    }
+    
+    if ([header length] < kStreamHeaderLength || memcmp([header bytes], kStreamMagic, sizeof(kStreamMagic)) != 0) {
+        if (error)
+            *error = [self errorWithDescription:@"not an encrypted stream"];
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (NSUInteger)lengthOfSegmentWithHeader:(NSData *)segmentHeader {
+    uint32_t length;
+    [segmentHeader getBytes:&length range:NSMakeRange(1, sizeof(length))];
+    
+    return CFSwapInt32BigToHost(length);
+}
+
+- (NSData *)IVForSegment:(uint64_t)index header:(NSData *)header {
+    NSMutableData *IV = [[header subdataWithRange:NSMakeRange(kStreamHeaderLength - kStreamNonceLength, kStreamNonceLength)] mutableCopy];
+    uint8_t *bytes = [IV mutableBytes];
+    
+    for (int i = 0; i < 8; i++)
+        bytes[kStreamNonceLength - 1 - i] ^= (uint8_t)(index >> (8 * i));
+    
+    return IV;
+}
+
+- (NSData *)tagForSegment:(NSData *)ciphertext index:(uint64_t)index final:(BOOL)final header:(NSData *)header {
+    CCHmacContext context;
+    CCHmacInit(&context, kCCHmacAlgSHA256, [_streamKey bytes], [_streamKey length]);
+    
+    uint64_t bigIndex = CFSwapInt64HostToBig(index);
+    uint8_t flag = final ? 1 : 0;
+    
+    CCHmacUpdate(&context, [header bytes], [header length]);
+    CCHmacUpdate(&context, &bigIndex, sizeof(bigIndex));
+    CCHmacUpdate(&context, &flag, sizeof(flag));
+    CCHmacUpdate(&context, [ciphertext bytes], [ciphertext length]);
+    
+    NSMutableData *tag = [NSMutableData dataWithLength:kSegmentTagLength];
+    CCHmacFinal(&context, [tag mutableBytes]);
+    
+    return tag;
+}
+
+// compares in constant time, not to leak how much of a forged tag is right
+- (BOOL)isEqualTag:(NSData *)tag toTag:(NSData *)other {
+    if ([tag length] != [other length])
+        return NO;
+    
+    const uint8_t *a = [tag bytes];
+    const uint8_t *b = [other bytes];
+    uint8_t diff = 0;
+    
+    for (NSUInteger i = 0; i < [tag length]; i++)
+        diff |= a[i] ^ b[i];
+    
+    return diff == 0;
+}
+
+- (NSError *)errorWithDescription:(NSString *)description {
+    return [NSError errorWithDomain:AGEncryptionErrorDomain
+                               code:0
+                           userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+- (NSData *)HMAC:(NSData *)data key:(NSData *)key {
+    NSMutableData *hmac = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    
+    CCHmac(kCCHmacAlgSHA256, [key bytes], [key length], [data bytes], [data length], [hmac mutableBytes]);
+    
+    return hmac;
+}
+
 @end
 
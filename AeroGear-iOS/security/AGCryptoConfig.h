@@ -19,10 +19,35 @@
 
 #import "AGConfig.h"
 
+/**
+ * The ciphers the encryption services can encrypt data with.
+ */
+typedef NS_ENUM(NSInteger, AGCipherSuite) {
+    /**
+     * XSalsa20 and Poly1305, through AGSecretBox. The default.
+     */
+    AGCipherSuiteSecretBox = 0,
+    /**
+     * AES-256 in Galois/Counter Mode, through AGAESGCM, which uses the AES and carry-less
+     * multiply instructions of the CPU. Each encrypted record carries its own random nonce.
+     */
+    AGCipherSuiteAES256GCM
+};
+
 /**
   Marker class for the different Crypto configuration objects. See AGKeyStoreCryptoConfig and
   AGPassphraseCryptoConfig class documentation for concrete implementations.
  */
 @protocol AGCryptoConfig <AGConfig>
 
+@optional
+
+/**
+ * The cipher the encryption service encrypts data with. Defaults to AGCipherSuiteSecretBox,
+ * which is also used when the configuration doesn't implement it.
+ *
+ * *NOTE:* Data encrypted with one cipher suite can't be decrypted with another.
+ */
+@property (nonatomic, assign) AGCipherSuite cipherSuite;
+
 @end
@@ -17,6 +17,9 @@
 
 #import <Foundation/Foundation.h>
 
+// error domain for encryption services
+extern NSString * const AGEncryptionErrorDomain;
+
 /**
   An AGEncryptionService represents an abstraction layer for a encryption provider.
  */
@@ -60,4 +63,102 @@
  */
 - (NSData *)decrypt:(NSData *)data IV:(NSData *)IV;
 
+@optional
+
+/**
+ * Encrypts each of the data objects passed in, as encrypt: would, in a single call.
+ * Meant for many small buffers (e.g. records of a store), where the cost of a call
+ * outweighs that of encrypting the data.
+ *
+ * @param data An array of the data objects to encrypt.
+ *
+ * *NOTE:* Optional, the data objects are otherwise passed to encrypt: one at a time.
+ *
+ * @return An NSArray holding the encrypted(cipher) data objects, in the same order,
+ *         or nil if any of them couldn't be encrypted.
+ */
+- (NSArray *)encryptAll:(NSArray *)data;
+
+/**
+ * Decrypts each of the data objects(cipher) passed in, as decrypt: would, in a single call.
+ *
+ * @param data An array of the data objects(cipher) to decrypt.
+ *
+ * *NOTE:* Optional, the data objects are otherwise passed to decrypt: one at a time.
+ *
+ * @return An NSArray holding the decrypted data objects, in the same order,
+ *         or nil if any of them couldn't be decrypted.
+ */
+- (NSArray *)decryptAll:(NSArray *)data;
+
+/**
+ * Computes a blind index token of the data object passed in: a keyed hash (HMAC) that
+ * is the same for equal data, but reveals nothing about the data without the key.
+ * Used to look up encrypted records by field value without decrypting them.
+ *
+ * *NOTE:* Optional, the fields of encrypted stores are otherwise not indexed (see
+ * AGStoreConfig indexedFields), and filtering decrypts every record.
+ *
+ * @param data The data object to compute the token of.
+ *
+ * @return An NSData object that holds the token.
+ */
+- (NSData *)blindIndex:(NSData *)data;
+
+/**
+ * Derives a key for the given purpose from the key of the service, so that other
+ * ciphers (e.g. the page encryption of the SQLite store) never share a key with it.
+ * The same purpose always yields the same key.
+ *
+ * *NOTE:* Optional, but required by the page encryption of the SQLite store.
+ *
+ * @param purpose A name identifying the use of the key.
+ *
+ * @return An NSData object that holds a 32-byte key, or nil if the service has no key.
+ */
+- (NSData *)keyForPurpose:(NSString *)purpose;
+
+/**
+ * Encrypts the contents of an input stream to an output stream, using constant memory.
+ * The contents are split into fixed-size segments, each encrypted with its own nonce and
+ * authenticated with its own tag, so that reordered, truncated or tampered segments are
+ * detected on decrypt.
+ *
+ * *NOTE:* Optional, like the other stream methods below.
+ *
+ * @param input The (opened) stream to read the plain data from.
+ * @param output The (opened) stream to write the encrypted data to.
+ * @param error An error object containing details of why the encryption failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)encryptStream:(NSInputStream *)input toStream:(NSOutputStream *)output error:(NSError **)error;
+
+/**
+ * Decrypts the contents of an input stream written by encryptStream:toStream:error: to an
+ * output stream, using constant memory.
+ *
+ * *NOTE:* On failure, the output stream may already contain (authenticated) segments
+ * preceding the one that failed.
+ *
+ * @param input The (opened) stream to read the encrypted data from.
+ * @param output The (opened) stream to write the plain data to.
+ * @param error An error object containing details of why the decryption failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)decryptStream:(NSInputStream *)input toStream:(NSOutputStream *)output error:(NSError **)error;
+
+/**
+ * Decrypts a single segment of a file written by encryptStream:toStream:error:, without
+ * reading the rest of the file.
+ *
+ * @param index The index of the segment.
+ * @param file The file to read the segment from.
+ * @param error An error object containing details of why the decryption failed.
+ *
+ * @return An NSData object that holds the decrypted segment, or nil if it failed.
+ */
+- (NSData *)decryptSegment:(NSUInteger)index ofFile:(NSFileHandle *)file error:(NSError **)error;
+
 @end
@@ -70,6 +70,14 @@
  
  In [9] we attempt to read data from the store. If that fails, then user supplied wrong crypto parameters
  (either passphrase or salt).
+
+ ## Key derivation
+
+ Deriving a key from a passphrase is deliberately slow. The keys derived are therefore kept for the
+ lifetime of the application, so that asking again for the same passphrase and salt (e.g. when unlocking
+ several stores) returns at once. Use keyService:completion: to derive the key off the main thread, and
+ clearDerivedKeys to forget the cached keys (e.g. when the user logs out). The cached keys are also
+ forgotten when the application receives a memory warning.
 */
 @interface AGKeyManager : NSObject
 
@@ -90,6 +98,21 @@
  */
 - (id<AGEncryptionService>)keyService:(id<AGCryptoConfig>)config;
 
+/**
+ * Asynchronously return an implementation of an AGEncryptionService based on the AGCryptoConfig
+ * configuration object passed in. The key is derived on a background queue.
+ *
+ * @param config The CryptoConfig object. See AGKeyStoreCryptoConfig and AGPassphraseCryptoConfig configuration objects.
+ * @param completion A block object to be executed on the main queue once the AGEncryptionService object
+ *        is created. Its argument is nil if the configuration is not supported.
+ */
+- (void)keyService:(id<AGCryptoConfig>)config completion:(void (^)(id<AGEncryptionService> keyService))completion;
+
+/**
+ * Forgets the keys derived from passphrases so far, by all AGKeyManager objects.
+ */
++ (void)clearDerivedKeys;
+
 /**
  * Removes am AGEncryptionService from the AGKeyManager object.
  *
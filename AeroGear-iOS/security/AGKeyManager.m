@@ -20,6 +20,17 @@
 #import "AGPasswordEncryptionServices.h"
 #import "AGPassphraseEncryptionServices.h"
 
+#import <UIKit/UIKit.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <CommonCrypto/CommonHMAC.h>
+#import <AGRandomGenerator.h>
+
+// the keys derived from passphrases, shared by all managers
+static NSMutableDictionary *AGDerivedKeys;
+// the secret the cache keys are computed with, so that they can't be matched
+// against guessed passphrases without it
+static NSData *AGCacheSecret;
+
 @implementation AGKeyManager {
     NSMutableDictionary *_keyServices;
 }
@@ -36,16 +47,21 @@
     return [[[self class] alloc] init];
 }
 
-- (id<AGEncryptionService>)keyService:(id<AGCryptoConfig>)config {
-    id<AGEncryptionService> keyService;
-    
-    if ([config isKindOfClass:[AGKeyStoreCryptoConfig class]]) {
-        keyService = [[AGPasswordEncryptionServices alloc] initWithConfig:config];
-    } else if ([config isKindOfClass:[AGPassphraseCryptoConfig class]]) {
-        keyService = [[AGPassphraseEncryptionServices alloc] initWithConfig:config];
-    } else { // unsupported type
-        return nil;
++ (void)initialize {
+    if (self == [AGKeyManager class]) {
+        AGDerivedKeys = [[NSMutableDictionary alloc] init];
+        AGCacheSecret = [AGRandomGenerator randomBytes:32];
+
+        // the keys can be derived again, unlike the memory they hold
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(clearDerivedKeys)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
     }
+}
+
+- (id<AGEncryptionService>)keyService:(id<AGCryptoConfig>)config {
+    id<AGEncryptionService> keyService = [[self class] encryptionServiceWithConfig:config];
     
     if (keyService)
         _keyServices[config.name] = keyService;
@@ -53,6 +69,26 @@
     return keyService;
 }
 
+- (void)keyService:(id<AGCryptoConfig>)config completion:(void (^)(id<AGEncryptionService> keyService))completion {
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        id<AGEncryptionService> keyService = [[self class] encryptionServiceWithConfig:config];
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (keyService)
+                _keyServices[config.name] = keyService;
+            
+            if (completion)
+                completion(keyService);
+        });
+    });
+}
+
++ (void)clearDerivedKeys {
+    @synchronized(AGDerivedKeys) {
+        [AGDerivedKeys removeAllObjects];
+    }
+}
+
 - (id<AGEncryptionService>)remove:(NSString*) name {
     id<AGEncryptionService> service = [self keyServiceWithName:name];
     [_keyServices removeObjectForKey:name];
@@ -64,4 +100,67 @@
     return _keyServices[name];
 }
 
+// =====================================================
+// =========== private utility methods  ================
+// =====================================================
+
++ (id<AGEncryptionService>)encryptionServiceWithConfig:(id<AGCryptoConfig>)config {
+    if ([config isKindOfClass:[AGKeyStoreCryptoConfig class]]) {
+        return [[AGPasswordEncryptionServices alloc] initWithConfig:config];
+    } else if ([config isKindOfClass:[AGPassphraseCryptoConfig class]]) {
+        AGPassphraseEncryptionServices *service = [[AGPassphraseEncryptionServices alloc] initWithKey:[self derivedKeyWithConfig:config]];
+        
+        if ([config respondsToSelector:@selector(cipherSuite)])
+            service.cipherSuite = config.cipherSuite;
+        
+        return service;
+    }
+    
+    // unsupported type
+    return nil;
+}
+
++ (NSData *)derivedKeyWithConfig:(AGPassphraseCryptoConfig *)config {
+    // the passphrase itself is not kept around
+    NSData *cacheKey = [self cacheKeyWithConfig:config];
+    NSData *key;
+    
+    @synchronized(AGDerivedKeys) {
+        key = AGDerivedKeys[cacheKey];
+    }
+    
+    if (!key) {
+        // derive key
+        key = [AGPassphraseEncryptionServices deriveKeyWithConfig:config];
+        
+        if (key) {
+            @synchronized(AGDerivedKeys) {
+                AGDerivedKeys[cacheKey] = key;
+            }
+        }
+    }
+    
+    return key;
+}
+
++ (NSData *)cacheKeyWithConfig:(AGPassphraseCryptoConfig *)config {
+    NSData *passphrase = [config.passphrase dataUsingEncoding:NSUTF8StringEncoding];
+    uint32_t length = CFSwapInt32HostToBig((uint32_t)[passphrase length]);
+    
+    CCHmacContext context;
+    CCHmacInit(&context, kCCHmacAlgSHA256, [AGCacheSecret bytes], [AGCacheSecret length]);
+    CCHmacUpdate(&context, &length, sizeof(length));
+    CCHmacUpdate(&context, [passphrase bytes], [passphrase length]);
+    CCHmacUpdate(&context, [config.salt bytes], [config.salt length]);
+    
+    // keys derived with different iterations differ
+    uint64_t iterations = CFSwapInt64HostToBig(config.iterations);
+    CCHmacUpdate(&context, &iterations, sizeof(iterations));
+    
+    NSMutableData *digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CCHmacFinal(&context, [digest mutableBytes]);
+    
+    return digest;
+}
+
 @end
@@ -21,6 +21,7 @@
 
 @synthesize name = _name;
 @synthesize type = _type;
+@synthesize cipherSuite = _cipherSuite;
 
 @synthesize alias = _alias;
 @synthesize password = _password;
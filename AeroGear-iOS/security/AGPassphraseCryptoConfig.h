@@ -34,4 +34,21 @@
  */
 @property (nonatomic, copy) NSString *passphrase;
 
+/**
+ * The number of PBKDF2 iterations the key is derived with, or 0 (the default) for the
+ * fixed count of AGPBKDF2. Use AGPassphraseEncryptionServices iterationsForDuration: to
+ * pick a count that takes a predictable time on the device.
+ *
+ * *NOTE:* Keys derived with different counts differ, so the count must be stored along with
+ * the salt (see derivationParameters) and reused.
+ */
+@property (nonatomic, assign) NSUInteger iterations;
+
+/**
+ * The parameters the key is derived with, other than the passphrase (i.e. the salt and the
+ * iterations), as a property list to store in place of the salt alone. Setting it applies
+ * the parameters of a stored property list to the configuration.
+ */
+@property (nonatomic, copy) NSDictionary *derivationParameters;
+
 @end
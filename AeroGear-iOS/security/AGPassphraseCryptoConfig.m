@@ -17,13 +17,19 @@
 
 #import "AGPassphraseCryptoConfig.h"
 
+// the keys of the derivation parameters
+static NSString *const kSaltKey = @"salt";
+static NSString *const kIterationsKey = @"iterations";
+
 @implementation AGPassphraseCryptoConfig
 
 @synthesize name = _name;
 @synthesize type = _type;
+@synthesize cipherSuite = _cipherSuite;
 
 @synthesize passphrase = _passphrase;
 @synthesize salt = _salt;
+@synthesize iterations = _iterations;
 
 - (instancetype)init {
     self = [super init];
@@ -39,4 +45,21 @@
     return self;
 }
 
+- (NSDictionary *)derivationParameters {
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+    
+    if (_salt)
+        parameters[kSaltKey] = _salt;
+    
+    if (_iterations > 0)
+        parameters[kIterationsKey] = @(_iterations);
+    
+    return parameters;
+}
+
+- (void)setDerivationParameters:(NSDictionary *)derivationParameters {
+    _salt = derivationParameters[kSaltKey];
+    _iterations = [derivationParameters[kIterationsKey] unsignedIntegerValue];
+}
+
 @end
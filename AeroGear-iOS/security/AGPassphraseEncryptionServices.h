@@ -32,4 +32,35 @@
  */
 - (instancetype)initWithConfig:(AGPassphraseCryptoConfig *)config;
 
+/**
+ * Derives the key for the given config with AGPBKDF2, using the iterations of the config.
+ *
+ * @param config An AGPassphraseCryptoConfig configuration object.
+ *
+ * @return the derived key.
+ */
++ (NSData *)deriveKeyWithConfig:(AGPassphraseCryptoConfig *)config;
+
+/**
+ * Measures the key derivation on this device, and returns the number of iterations that
+ * takes the given duration, but never fewer than AGPBKDF2 accepts. The measurement itself
+ * takes about the given duration as well, so it is best done off the main thread, once,
+ * and the result stored along with the salt (see AGPassphraseCryptoConfig derivationParameters).
+ *
+ * @param duration The time, in seconds, the key derivation should take (e.g. 0.1).
+ *
+ * @return the number of iterations to apply to AGPassphraseCryptoConfig iterations.
+ */
++ (NSUInteger)iterationsForDuration:(NSTimeInterval)duration;
+
+/**
+ * Initialize the provider with a key already derived from a passphrase,
+ * skipping the (costly) key derivation.
+ *
+ * @param key The derived key.
+ *
+ * @return the newly created AGPassphraseEncryptionServices object.
+ */
+- (instancetype)initWithKey:(NSData *)key;
+
 @end
@@ -18,7 +18,15 @@
 #import "AGPassphraseEncryptionServices.h"
 
 #import <AGPBKDF2.h>
-#import <AGSecretBox.h>
+#import <AGRandomGenerator.h>
+#import <mach/mach_time.h>
+
+// the fewest iterations AGPBKDF2 accepts
+static const NSUInteger kMinimumIterations = 10000;
+
+// the shortest measurement the calibration relies on, as
+// shorter ones are dominated by the timer resolution and noise
+static const NSTimeInterval kMinimumMeasurement = 0.025;
 
 @implementation AGPassphraseEncryptionServices
 
@@ -26,16 +34,72 @@
     self = [super init];
     
     if (self) {
-        AGPBKDF2 *keyGenerator = [[AGPBKDF2 alloc] init];
-        
         // derive key
-        NSData *key = [keyGenerator deriveKey:config.passphrase salt:config.salt];
+        NSData *key = [[self class] deriveKeyWithConfig:config];
         
         // initialize cryptobox
-        _secretBox = [[AGSecretBox alloc] initWithKey:key];
+        self.cipherSuite = config.cipherSuite;
+        [self applyKey:key];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithKey:(NSData *)key {
+    self = [super init];
+    
+    if (self) {
+        // initialize cryptobox
+        [self applyKey:key];
     }
     
     return self;
 }
 
++ (NSData *)deriveKeyWithConfig:(AGPassphraseCryptoConfig *)config {
+    AGPBKDF2 *keyGenerator = [[AGPBKDF2 alloc] init];
+    
+    // keys derived before the iterations could be set remain the same
+    if (config.iterations == 0)
+        return [keyGenerator deriveKey:config.passphrase salt:config.salt];
+    
+    return [keyGenerator deriveKey:config.passphrase salt:config.salt
+                        iterations:MAX(config.iterations, kMinimumIterations)];
+}
+
+// the current time of a monotonic clock, in seconds; unlike the wall clock it isn't
+// adjusted (e.g. by NTP) while a measurement is under way
+static NSTimeInterval AGMonotonicTime(void) {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+
+    return (double) mach_absolute_time() * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
++ (NSUInteger)iterationsForDuration:(NSTimeInterval)duration {
+    AGPBKDF2 *keyGenerator = [[AGPBKDF2 alloc] init];
+    NSData *salt = [AGRandomGenerator randomBytes:16];
+    
+    NSUInteger iterations = kMinimumIterations;
+    NSTimeInterval elapsed;
+    
+    // the time grows linearly with the iterations, double them until it can be measured
+    for (;;) {
+        NSTimeInterval start = AGMonotonicTime();
+        [keyGenerator deriveKey:@"calibration" salt:salt iterations:iterations];
+        elapsed = AGMonotonicTime() - start;
+        
+        if (elapsed >= MIN(duration, kMinimumMeasurement) && elapsed > 0)
+            break;
+        
+        iterations *= 2;
+    }
+    
+    return MAX((NSUInteger)(iterations * (duration / elapsed)), kMinimumIterations);
+}
+
 @end
@@ -18,7 +18,6 @@
 #import "AGPasswordEncryptionServices.h"
 
 #import <AGRandomGenerator.h>
-#import <AGSecretBox.h>
 
 @implementation AGPasswordEncryptionServices {
     NSString *_passKeyTag;
@@ -111,7 +110,8 @@
         }
         
         // initialize cryptobox
-        _secretBox = [[AGSecretBox alloc] initWithKey:key];
+        self.cipherSuite = config.cipherSuite;
+        [self applyKey:key];
     }
     
     return self;
@@ -0,0 +1,81 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+extern NSString * const AGJsonArrayParserErrorDomain;
+
+/**
+ * An incremental parser for JSON documents whose top-level value is an array.
+ *
+ * Data is pushed to the parser as it becomes available (e.g. chunks read from a file or
+ * received from the network) and each element of the top-level array is handed to the
+ * record block as soon as it is complete, so that neither the complete serialized form nor
+ * the complete object graph have to be held in memory at once. Documents whose top-level value
+ * is not an array are buffered and delivered as a single record when finish: is called.
+ *
+ * Malformed input is reported with an AGJsonArrayParserErrorDomain error, holding the error of
+ * NSJSONSerialization (if any) under NSUnderlyingErrorKey.
+ */
+@interface AGJsonArrayParser : NSObject
+
+/**
+ * Initialize a parser.
+ *
+ * @param options The NSJSONReadingOptions used to parse each record.
+ * @param block   The block invoked for each decoded record. Setting stop to YES stops parsing.
+ *
+ * @return the newly created AGJsonArrayParser object.
+ */
+- (instancetype)initWithOptions:(NSJSONReadingOptions)options
+                    recordBlock:(void (^)(id record, BOOL *stop))block;
+
+/**
+ * Appends data to the parser, decoding any records that are complete.
+ *
+ * @param data The data to append.
+ * @param error An error object containing details of why parsing failed.
+ *
+ * @return YES if the data was parsed successfully, otherwise NO.
+ */
+- (BOOL)appendData:(NSData *)data error:(NSError **)error;
+
+/**
+ * Signals the end of the input, delivering any buffered (non-array) document.
+ *
+ * @param error An error object containing details of why parsing failed.
+ *
+ * @return YES if the input formed a complete document, otherwise NO.
+ */
+- (BOOL)finish:(NSError **)error;
+
+/**
+ * Convenience method that reads the given (opened) stream to its end, feeding the parser.
+ *
+ * @param stream The NSInputStream to read from.
+ * @param error An error object containing details of why parsing failed.
+ *
+ * @return YES if the stream was parsed successfully, otherwise NO.
+ */
+- (BOOL)parseStream:(NSInputStream *)stream error:(NSError **)error;
+
+/**
+ * Whether the block asked for parsing to stop.
+ */
+@property (nonatomic, readonly, getter=isStopped) BOOL stopped;
+
+@end
@@ -0,0 +1,282 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGJsonArrayParser.h"
+
+NSString * const AGJsonArrayParserErrorDomain = @"AGJsonArrayParserErrorDomain";
+
+static NSUInteger const kParserChunkSize = 32768;
+
+typedef NS_ENUM(NSInteger, AGJsonParserState) {
+    AGJsonParserStateStart,        // nothing but whitespace seen so far
+    AGJsonParserStateValue,        // inside the array, expecting a value (or the closing bracket)
+    AGJsonParserStateRecord,       // scanning the bytes of a record
+    AGJsonParserStateSeparator,    // after a record, expecting ',' or the closing bracket
+    AGJsonParserStateDocument,     // top-level value is not an array, buffering until finish
+    AGJsonParserStateDone          // closing bracket seen
+};
+
+@implementation AGJsonArrayParser {
+    NSJSONReadingOptions _options;
+    void (^_block)(id record, BOOL *stop);
+
+    NSMutableData *_buffer;
+    NSUInteger _position;
+
+    AGJsonParserState _state;
+    NSUInteger _recordStart;
+    NSUInteger _depth;
+    BOOL _inString;
+    BOOL _escaped;
+    BOOL _hasRecords;
+}
+
+- (instancetype)initWithOptions:(NSJSONReadingOptions)options
+                    recordBlock:(void (^)(id record, BOOL *stop))block {
+    self = [super init];
+    if (self) {
+        _options = options | NSJSONReadingAllowFragments;
+        _block = [block copy];
+        _buffer = [[NSMutableData alloc] init];
+        _state = AGJsonParserStateStart;
+    }
+
+    return self;
+}
+
+- (BOOL)appendData:(NSData *)data error:(NSError **)error {
+    if (_stopped)
+        return YES;
+
+    [_buffer appendData:data];
+
+    const uint8_t *bytes = [_buffer bytes];
+    NSUInteger length = [_buffer length];
+
+    while (_position < length && !_stopped) {
+        uint8_t c = bytes[_position];
+
+        switch (_state) {
+            case AGJsonParserStateStart:
+                if ([self isWhitespace:c]) {
+                    _position++;
+                } else if (c == '[') {
+                    _state = AGJsonParserStateValue;
+                    _position++;
+                } else {
+                    // not an array, it will be parsed in one go
+                    _state = AGJsonParserStateDocument;
+                    _position = length;
+                }
+                break;
+
+            case AGJsonParserStateValue:
+                if ([self isWhitespace:c]) {
+                    _position++;
+                } else if (c == ']' && !_hasRecords) { // empty array
+                    _state = AGJsonParserStateDone;
+                    _position++;
+                } else {
+                    _state = AGJsonParserStateRecord;
+                    _recordStart = _position;
+                    _depth = 0;
+                    _inString = NO;
+                    _escaped = NO;
+                }
+                break;
+
+            case AGJsonParserStateRecord:
+                if (_inString) {
+                    if (_escaped)
+                        _escaped = NO;
+                    else if (c == '\\')
+                        _escaped = YES;
+                    else if (c == '"')
+                        _inString = NO;
+
+                    _position++;
+
+                } else if (c == '"') {
+                    _inString = YES;
+                    _position++;
+
+                } else if (c == '{' || c == '[') {
+                    _depth++;
+                    _position++;
+
+                } else if ((c == '}' || c == ']') && _depth > 0) {
+                    _depth--;
+                    _position++;
+
+                    // a structured record is complete
+                    if (_depth == 0 && ![self emitRecordWithBytes:bytes error:error])
+                        return NO;
+
+                } else if (_depth == 0 && (c == ',' || c == ']' || [self isWhitespace:c])) {
+                    // a scalar record is complete, the separator is handled by the next state
+                    if (![self emitRecordWithBytes:bytes error:error])
+                        return NO;
+
+                } else {
+                    _position++;
+                }
+                break;
+
+            case AGJsonParserStateSeparator:
+                if ([self isWhitespace:c]) {
+                    _position++;
+                } else if (c == ',') {
+                    _state = AGJsonParserStateValue;
+                    _position++;
+                } else if (c == ']') {
+                    _state = AGJsonParserStateDone;
+                    _position++;
+                } else {
+                    return [self failWithReason:@"expected ',' or ']' after record" error:error];
+                }
+                break;
+
+            case AGJsonParserStateDocument:
+                _position = length;
+                break;
+
+            case AGJsonParserStateDone:
+                if (![self isWhitespace:c])
+                    return [self failWithReason:@"garbage at end of JSON data" error:error];
+
+                _position++;
+                break;
+        }
+    }
+
+    [self compact];
+
+    return YES;
+}
+
+- (BOOL)finish:(NSError **)error {
+    if (_stopped)
+        return YES;
+
+    switch (_state) {
+        case AGJsonParserStateStart:
+        case AGJsonParserStateDone:
+            return YES;
+
+        case AGJsonParserStateDocument: {
+            NSError *parseError;
+            id object = [NSJSONSerialization JSONObjectWithData:_buffer options:_options error:&parseError];
+
+            if (!object)
+                return [self failWithReason:@"malformed JSON document" underlyingError:parseError error:error];
+
+            BOOL stop = NO;
+            _block(object, &stop);
+            _stopped = stop;
+
+            return YES;
+        }
+
+        default:
+            return [self failWithReason:@"unexpected end of JSON data" error:error];
+    }
+}
+
+- (BOOL)parseStream:(NSInputStream *)stream error:(NSError **)error {
+    uint8_t buffer[kParserChunkSize];
+
+    NSInteger result;
+    while (!_stopped && (result = [stream read:buffer maxLength:kParserChunkSize]) != 0) {
+        if (result < 0) {
+            if (error)
+                *error = [stream streamError];
+            return NO;
+        }
+
+        if (![self appendData:[NSData dataWithBytesNoCopy:buffer length:result freeWhenDone:NO] error:error])
+            return NO;
+    }
+
+    return [self finish:error];
+}
+
+#pragma mark - private helper methods
+
+- (BOOL)emitRecordWithBytes:(const uint8_t *)bytes error:(NSError **)error {
+    NSData *record = [NSData dataWithBytesNoCopy:(void *)(bytes + _recordStart)
+                                          length:_position - _recordStart
+                                    freeWhenDone:NO];
+
+    NSError *parseError;
+    id object = [NSJSONSerialization JSONObjectWithData:record options:_options error:&parseError];
+
+    if (!object)
+        return [self failWithReason:@"malformed JSON record" underlyingError:parseError error:error];
+
+    _state = AGJsonParserStateSeparator;
+    _hasRecords = YES;
+
+    BOOL stop = NO;
+    _block(object, &stop);
+    _stopped = stop;
+
+    return YES;
+}
+
+// drop the bytes that have already been consumed
+- (void)compact {
+    NSUInteger consumed;
+
+    if (_state == AGJsonParserStateDocument)
+        return;
+    else if (_state == AGJsonParserStateRecord)
+        consumed = _recordStart;
+    else
+        consumed = _position;
+
+    if (consumed == 0)
+        return;
+
+    [_buffer replaceBytesInRange:NSMakeRange(0, consumed) withBytes:NULL length:0];
+    _position -= consumed;
+
+    if (_state == AGJsonParserStateRecord)
+        _recordStart = 0;
+}
+
+- (BOOL)isWhitespace:(uint8_t)c {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+- (BOOL)failWithReason:(NSString *)reason error:(NSError **)error {
+    return [self failWithReason:reason underlyingError:nil error:error];
+}
+
+- (BOOL)failWithReason:(NSString *)reason underlyingError:(NSError *)underlyingError error:(NSError **)error {
+    if (error) {
+        NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:reason forKey:NSLocalizedDescriptionKey];
+
+        if (underlyingError)
+            userInfo[NSUnderlyingErrorKey] = underlyingError;
+
+        *error = [NSError errorWithDomain:AGJsonArrayParserErrorDomain code:0 userInfo:userInfo];
+    }
+
+    return NO;
+}
+
+@end
@@ -0,0 +1,58 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Computes and applies JSON Merge Patches (RFC 7396): a patch is a JSON object holding the members
+ * that changed, NSNull for the removed ones, and nested patches for the changed nested objects.
+ * Arrays (and values of different types) are replaced as a whole.
+ */
+@interface AGJsonMergePatch : NSObject
+
+/**
+ * Returns the merge patch that turns an object into another.
+ *
+ * @param source The original version of the object.
+ * @param target The new version of the object.
+ *
+ * @return the NSDictionary of the patch, empty if the objects are equal, or nil if the target sets
+ *         a member to null, which a merge patch can't express (it would remove the member instead).
+ */
++ (NSDictionary *)patchFromObject:(NSDictionary *)source toObject:(NSDictionary *)target;
+
+/**
+ * Applies a merge patch to an object.
+ *
+ * @param patch The patch.
+ * @param object The object to patch.
+ *
+ * @return the patched object.
+ */
++ (id)applyPatch:(id)patch toObject:(id)object;
+
+/**
+ * Returns a deep, immutable copy of a JSON object, e.g. to keep a version of it that later changes
+ * to its nested mutable containers don't alter.
+ *
+ * @param object The JSON object.
+ *
+ * @return the copy.
+ */
++ (id)copyOfObject:(id)object;
+
+@end
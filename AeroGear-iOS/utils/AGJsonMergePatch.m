@@ -0,0 +1,118 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGJsonMergePatch.h"
+
+@implementation AGJsonMergePatch
+
++ (NSDictionary *)patchFromObject:(NSDictionary *)source toObject:(NSDictionary *)target {
+    NSMutableDictionary *patch = [NSMutableDictionary dictionary];
+    __block BOOL expressible = YES;
+
+    [target enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL *stop) {
+        id previous = source[key];
+
+        if ([previous isEqual:value])
+            return;
+
+        // only the changes of nested objects
+        if ([previous isKindOfClass:[NSDictionary class]] && [value isKindOfClass:[NSDictionary class]]) {
+            patch[key] = [self patchFromObject:previous toObject:value];
+        } else if (![self containsNullMember:value]) {
+            patch[key] = [self copyOfObject:value];
+        } else {
+            patch[key] = nil;
+        }
+
+        // a null member would remove it rather than set it to null
+        if (!patch[key]) {
+            expressible = NO;
+            *stop = YES;
+        }
+    }];
+
+    if (!expressible)
+        return nil;
+
+    // removed members are nulled
+    for (id key in source) {
+        if (!target[key])
+            patch[key] = [NSNull null];
+    }
+
+    return [patch copy];
+}
+
++ (id)applyPatch:(id)patch toObject:(id)object {
+    // a patch that is not an object replaces the target
+    if (![patch isKindOfClass:[NSDictionary class]])
+        return [self copyOfObject:patch];
+
+    NSMutableDictionary *patched = [object isKindOfClass:[NSDictionary class]] ? [object mutableCopy] : [NSMutableDictionary dictionary];
+
+    [patch enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL *stop) {
+        if ([value isKindOfClass:[NSNull class]]) {
+            [patched removeObjectForKey:key];
+        } else {
+            patched[key] = [self applyPatch:value toObject:patched[key]];
+        }
+    }];
+
+    return [patched copy];
+}
+
+// whether the value is null, or an object holding a null member at any depth; arrays
+// are replaced as a whole, so the nulls they hold are kept
++ (BOOL)containsNullMember:(id)value {
+    if ([value isKindOfClass:[NSNull class]])
+        return YES;
+
+    if (![value isKindOfClass:[NSDictionary class]])
+        return NO;
+
+    for (id member in [value allValues]) {
+        if ([self containsNullMember:member])
+            return YES;
+    }
+
+    return NO;
+}
+
++ (id)copyOfObject:(id)object {
+    if ([object isKindOfClass:[NSDictionary class]]) {
+        NSMutableDictionary *copy = [NSMutableDictionary dictionaryWithCapacity:[object count]];
+
+        [object enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL *stop) {
+            copy[key] = [self copyOfObject:value];
+        }];
+
+        return [copy copy];
+    }
+
+    if ([object isKindOfClass:[NSArray class]]) {
+        NSMutableArray *copy = [NSMutableArray arrayWithCapacity:[object count]];
+
+        for (id value in object)
+            [copy addObject:[self copyOfObject:value]];
+
+        return [copy copy];
+    }
+
+    return [object copy];
+}
+
+@end
@@ -0,0 +1,89 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Utility methods to write to an NSOutputStream without having to deal with
+ * partial writes.
+ */
+@interface NSOutputStream (AGIO)
+
+/**
+ * Writes the entire contents of the data object to the stream, blocking until
+ * all bytes have been written.
+ *
+ * @param data The data to write.
+ * @param error An error object containing details of why the write failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)writeAllData:(NSData *)data error:(NSError **)error;
+
+/**
+ * Writes the given buffer to the stream, blocking until all bytes have been written.
+ *
+ * @param bytes The buffer to write.
+ * @param length The number of bytes to write.
+ * @param error An error object containing details of why the write failed.
+ *
+ * @return YES if the operation succeeds, otherwise NO.
+ */
+- (BOOL)writeAllBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError **)error;
+
+@end
+
+/**
+ * Utility methods to read from an NSInputStream without having to deal with
+ * partial reads.
+ */
+@interface NSInputStream (AGIO)
+
+/**
+ * Reads exactly length bytes from the stream, blocking until they are available.
+ *
+ * @param length The number of bytes to read.
+ * @param error An error object containing details of why the read failed.
+ *
+ * @return An NSData object with the bytes read. An empty data object is returned
+ *         if the stream was already at its end, and nil if an error occurred or the
+ *         stream ended before length bytes could be read.
+ */
+- (NSData *)readDataOfLength:(NSUInteger)length error:(NSError **)error;
+
+/**
+ * Reads up to length bytes from the stream, blocking until they are available or
+ * the stream ends.
+ *
+ * @param length The maximum number of bytes to read.
+ * @param error An error object containing details of why the read failed.
+ *
+ * @return An NSData object with the bytes read, which is shorter than length only
+ *         at the end of the stream, or nil if an error occurred.
+ */
+- (NSData *)readDataUpToLength:(NSUInteger)length error:(NSError **)error;
+
+/**
+ * Reads the remaining contents of the stream.
+ *
+ * @param error An error object containing details of why the read failed.
+ *
+ * @return An NSData object with the bytes read or nil if an error occurred.
+ */
+- (NSData *)readAllData:(NSError **)error;
+
+@end
@@ -0,0 +1,120 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AGNSStream+IO.h"
+
+static NSUInteger const kReadBufferSize = 32768;
+
+// constructs an error object in case the stream didn't provide one
+static NSError *AGStreamError(NSStream *stream, NSString *description) {
+    NSError *error = [stream streamError];
+
+    if (!error) {
+        error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                    code:EIO
+                                userInfo:@{NSLocalizedDescriptionKey: description}];
+    }
+
+    return error;
+}
+
+@implementation NSOutputStream (AGIO)
+
+- (BOOL)writeAllData:(NSData *)data error:(NSError **)error {
+    return [self writeAllBytes:[data bytes] length:[data length] error:error];
+}
+
+- (BOOL)writeAllBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError **)error {
+    NSUInteger written = 0;
+
+    while (written < length) {
+        NSInteger result = [self write:bytes + written maxLength:length - written];
+
+        if (result <= 0) {
+            if (error)
+                *error = AGStreamError(self, @"unable to write to stream");
+            return NO;
+        }
+
+        written += result;
+    }
+
+    return YES;
+}
+
+@end
+
+@implementation NSInputStream (AGIO)
+
+- (NSData *)readDataOfLength:(NSUInteger)length error:(NSError **)error {
+    NSData *data = [self readDataUpToLength:length error:error];
+
+    // stream ended in the middle of a read
+    if ([data length] > 0 && [data length] < length) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                         code:EIO
+                                     userInfo:@{NSLocalizedDescriptionKey: @"unexpected end of stream"}];
+        return nil;
+    }
+
+    return data;
+}
+
+- (NSData *)readDataUpToLength:(NSUInteger)length error:(NSError **)error {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    NSUInteger total = 0;
+
+    while (total < length) {
+        NSInteger result = [self read:(uint8_t *)[data mutableBytes] + total maxLength:length - total];
+
+        if (result < 0) {
+            if (error)
+                *error = AGStreamError(self, @"unable to read from stream");
+            return nil;
+        }
+
+        if (result == 0) // end of stream
+            break;
+
+        total += result;
+    }
+
+    [data setLength:total];
+
+    return data;
+}
+
+- (NSData *)readAllData:(NSError **)error {
+    NSMutableData *data = [NSMutableData data];
+    uint8_t buffer[kReadBufferSize];
+
+    NSInteger result;
+    while ((result = [self read:buffer maxLength:kReadBufferSize]) > 0) {
+        [data appendBytes:buffer length:result];
+    }
+
+    if (result < 0) {
+        if (error)
+            *error = AGStreamError(self, @"unable to read from stream");
+        return nil;
+    }
+
+    return data;
+}
+
+@end
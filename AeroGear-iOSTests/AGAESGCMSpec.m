@@ -0,0 +1,191 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGAESGCM.h"
+
+SPEC_BEGIN(AGAESGCMSpec)
+
+describe(@"AGAESGCM", ^{
+
+    NSData *(^dataWithHex)(NSString *) = ^NSData *(NSString *hex) {
+        NSMutableData *data = [NSMutableData dataWithCapacity:[hex length] / 2];
+
+        for (NSUInteger i = 0; i + 1 < [hex length]; i += 2) {
+            uint8_t byte = (uint8_t)strtoul([[hex substringWithRange:NSMakeRange(i, 2)] UTF8String], NULL, 16);
+            [data appendBytes:&byte length:1];
+        }
+
+        return data;
+    };
+
+    context(@"when encrypting the test vectors of the GCM specification", ^{
+
+        it(@"should encrypt an empty message (test case 13)", ^{
+            AGAESGCM *cipher = [[AGAESGCM alloc] initWithKey:[NSMutableData dataWithLength:32]];
+
+            NSData *ciphertext = [cipher encrypt:[NSData data] IV:[NSMutableData dataWithLength:12]];
+
+            [[ciphertext should] equal:dataWithHex(@"530f8afbc74536b9a963b4f1c4cb738b")];
+        });
+
+        it(@"should encrypt a single block (test case 14)", ^{
+            AGAESGCM *cipher = [[AGAESGCM alloc] initWithKey:[NSMutableData dataWithLength:32]];
+
+            NSData *ciphertext = [cipher encrypt:[NSMutableData dataWithLength:16] IV:[NSMutableData dataWithLength:12]];
+
+            [[ciphertext should] equal:dataWithHex(@"cea7403d4d606b6e074ec5d3baf39d18"
+                                                   "d0d1c8a799996bf0265b98b5d48ab919")];
+        });
+
+        it(@"should encrypt and decrypt several blocks (test case 15)", ^{
+            AGAESGCM *cipher = [[AGAESGCM alloc] initWithKey:dataWithHex(@"feffe9928665731c6d6a8f9467308308"
+                                                                         "feffe9928665731c6d6a8f9467308308")];
+            NSData *IV = dataWithHex(@"cafebabefacedbaddecaf888");
+            NSData *plaintext = dataWithHex(@"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255");
+
+            NSData *ciphertext = [cipher encrypt:plaintext IV:IV];
+
+            [[ciphertext should] equal:dataWithHex(@"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+                                                   "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad"
+                                                   "b094dac5d93471bdec1a502270e3cc6c")];
+            [[[cipher decrypt:ciphertext IV:IV] should] equal:plaintext];
+        });
+
+        it(@"should authenticate additional data and a partial block (test case 16)", ^{
+            AGAESGCM *cipher = [[AGAESGCM alloc] initWithKey:dataWithHex(@"feffe9928665731c6d6a8f9467308308"
+                                                                         "feffe9928665731c6d6a8f9467308308")];
+            NSData *IV = dataWithHex(@"cafebabefacedbaddecaf888");
+            NSData *additionalData = dataWithHex(@"feedfacedeadbeeffeedfacedeadbeefabaddad2");
+            NSData *plaintext = dataWithHex(@"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39");
+
+            NSData *ciphertext = [cipher encrypt:plaintext IV:IV additionalData:additionalData];
+
+            [[ciphertext should] equal:dataWithHex(@"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+                                                   "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662"
+                                                   "76fc6ece0f4e1768cddf8853bb2d551b")];
+            [[[cipher decrypt:ciphertext IV:IV additionalData:additionalData] should] equal:plaintext];
+            [[cipher decrypt:ciphertext IV:IV] shouldBeNil];
+        });
+
+        it(@"should hash an IV other than 96 bits long (test case 18)", ^{
+            AGAESGCM *cipher = [[AGAESGCM alloc] initWithKey:dataWithHex(@"feffe9928665731c6d6a8f9467308308"
+                                                                         "feffe9928665731c6d6a8f9467308308")];
+            NSData *IV = dataWithHex(@"9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728"
+                                     "c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b");
+            NSData *additionalData = dataWithHex(@"feedfacedeadbeeffeedfacedeadbeefabaddad2");
+            NSData *plaintext = dataWithHex(@"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39");
+
+            NSData *ciphertext = [cipher encrypt:plaintext IV:IV additionalData:additionalData];
+
+            [[ciphertext should] equal:dataWithHex(@"5a8def2f0c9e53f1f75d7853659e2a20eeb2b22aafde6419a058ab4f6f746bf4"
+                                                   "0fc0c3b780f244452da3ebf1c5d82cdea2418997200ef82e44ae7e3f"
+                                                   "a44a8266ee1c8eb0c8b5d4cf5ae9f19a")];
+            [[[cipher decrypt:ciphertext IV:IV additionalData:additionalData] should] equal:plaintext];
+        });
+    });
+
+    // the GHASH absorbs the blocks four at a time where carry-less multiplication is available;
+    // the expected values were computed with OpenSSL
+    context(@"when encrypting more blocks than hashed at a time", ^{
+
+        __block AGAESGCM *cipher = nil;
+
+        NSData *(^dataWithLength)(NSUInteger, uint8_t, int) = ^NSData *(NSUInteger length, uint8_t first, int step) {
+            NSMutableData *data = [NSMutableData dataWithLength:length];
+            uint8_t *bytes = [data mutableBytes];
+
+            for (NSUInteger i = 0; i < length; i++)
+                bytes[i] = (uint8_t)(first + step * (int)i);
+
+            return data;
+        };
+
+        beforeEach(^{
+            cipher = [[AGAESGCM alloc] initWithKey:dataWithLength(32, 0, 1)];
+        });
+
+        it(@"should hash several groups, leftover blocks and a partial block, with a 16-byte IV", ^{
+            NSData *IV = dataWithLength(16, 0, 1);
+            NSData *plaintext = dataWithLength(181, 0, 1);
+
+            NSData *ciphertext = [cipher encrypt:plaintext IV:IV];
+
+            [[ciphertext should] equal:dataWithHex(@"676da2753de14c2f95f6d12259a922bc44a279b27398c5545c2757ce92e4d2d5"
+                                                   "485eabd75965f6e9ca001c7dcd1bcb5d67417869b82176b698849c20dd167cb9"
+                                                   "53aa39e78421c1d87718ea7d3e321bfb8bd254ffba6819d5de3778a68be3574b"
+                                                   "3884ba2f2c6b7a2b568fd6b3320116d1bd5f97d477077f28ed79c46b49323cbe"
+                                                   "3caddf685a9a1b17352bcb55798826360ffaf03a0c883d1d6b29906ea7c652ff"
+                                                   "902f77d5b81a07ab44979d90b0926f4b2d1834ae11"
+                                                   "a7be4fcb74d595413b1b7a1108c7c71c")];
+            [[[cipher decrypt:ciphertext IV:IV] should] equal:plaintext];
+        });
+
+        it(@"should hash additional data spanning a group and a leftover block", ^{
+            NSData *IV = dataWithLength(12, 0, 1);
+            NSData *additionalData = dataWithLength(80, 0xff, -1);
+            NSData *plaintext = dataWithLength(64, 0, 1);
+
+            NSData *ciphertext = [cipher encrypt:plaintext IV:IV additionalData:additionalData];
+
+            [[ciphertext should] equal:dataWithHex(@"4703d418c1e0c41c85489d80bde4766293c79527e46e496b207eff9e01741ead"
+                                                   "21318cdf8be434bf5c8d55c6a4aa0617de6852be6ee395ed07ae102224decbd1"
+                                                   "6cf0c9bf96abb95953be3df625ae1cf2")];
+            [[[cipher decrypt:ciphertext IV:IV additionalData:additionalData] should] equal:plaintext];
+        });
+    });
+
+    context(@"when decrypting", ^{
+
+        __block AGAESGCM *cipher = nil;
+        __block NSData *IV = nil;
+        __block NSData *ciphertext = nil;
+
+        beforeEach(^{
+            cipher = [[AGAESGCM alloc] initWithKey:[NSMutableData dataWithLength:32]];
+            IV = [NSMutableData dataWithLength:AGAESGCMNonceLength];
+            ciphertext = [cipher encrypt:[@"Lorem ipsum dolor sit amet" dataUsingEncoding:NSUTF8StringEncoding] IV:IV];
+        });
+
+        it(@"should reject tampered data", ^{
+            NSMutableData *tampered = [ciphertext mutableCopy];
+            ((uint8_t *)[tampered mutableBytes])[3] ^= 1;
+
+            [[cipher decrypt:tampered IV:IV] shouldBeNil];
+        });
+
+        it(@"should reject a different IV", ^{
+            NSMutableData *otherIV = [IV mutableCopy];
+            ((uint8_t *)[otherIV mutableBytes])[0] ^= 1;
+
+            [[cipher decrypt:ciphertext IV:otherIV] shouldBeNil];
+        });
+
+        it(@"should reject data shorter than the tag", ^{
+            [[cipher decrypt:[ciphertext subdataWithRange:NSMakeRange(0, AGAESGCMTagLength - 1)] IV:IV] shouldBeNil];
+        });
+    });
+
+    it(@"should not accept keys of the wrong length", ^{
+        [[[AGAESGCM alloc] initWithKey:[NSMutableData dataWithLength:16]] shouldBeNil];
+    });
+});
+
+SPEC_END
@@ -37,6 +37,87 @@ describe(@"AGBaseStorage", ^{
             [path shouldBeNil];
         });
     });
+
+    context(@"when processing objects concurrently", ^{
+
+        __block NSMutableArray *numbers = nil;
+
+        beforeEach(^{
+            numbers = [NSMutableArray array];
+
+            for (NSUInteger i = 0; i < 1000; i++)
+                [numbers addObject:@(i)];
+        });
+
+        it(@"should preserve the order of the objects", ^{
+            NSArray *results = [AGBaseStorage concurrentlyMapObjects:numbers usingBlock:^id(NSNumber *number) {
+                return [number stringValue];
+            }];
+
+            [[results should] haveCountOf:1000];
+
+            [results enumerateObjectsUsingBlock:^(NSString *result, NSUInteger idx, BOOL *stop) {
+                [[result should] equal:[NSString stringWithFormat:@"%lu", (unsigned long)idx]];
+            }];
+        });
+
+        it(@"should fail if the block fails for one of the objects", ^{
+            NSArray *results = [AGBaseStorage concurrentlyMapObjects:numbers usingBlock:^id(NSNumber *number) {
+                return [number isEqualToNumber:@500]? nil : number;
+            }];
+
+            [results shouldBeNil];
+        });
+
+        it(@"should return an empty array if there are no objects", ^{
+            [[[AGBaseStorage concurrentlyMapObjects:@[] usingBlock:^id(id object) {
+                return object;
+            }] should] beEmpty];
+        });
+
+        it(@"should preserve the order of the objects processed in batches", ^{
+            NSArray *results = [AGBaseStorage concurrentlyMapBatchesOfObjects:numbers usingBlock:^NSArray *(NSArray *batch) {
+                return [batch valueForKey:@"stringValue"];
+            }];
+
+            [[results should] haveCountOf:1000];
+
+            [results enumerateObjectsUsingBlock:^(NSString *result, NSUInteger idx, BOOL *stop) {
+                [[result should] equal:[NSString stringWithFormat:@"%lu", (unsigned long)idx]];
+            }];
+        });
+
+        it(@"should fail if the block fails for one of the batches", ^{
+            NSArray *results = [AGBaseStorage concurrentlyMapBatchesOfObjects:numbers usingBlock:^NSArray *(NSArray *batch) {
+                return [batch containsObject:@500]? nil : batch;
+            }];
+
+            [results shouldBeNil];
+        });
+    });
+
+    context(@"when inspecting predicates", ^{
+
+        it(@"should return the fields of compound predicates", ^{
+            NSPredicate *predicate = [NSPredicate predicateWithFormat:@"name == 'Robert' AND (age > 30 OR address.city IN {'Boston', 'Raleigh'})"];
+
+            [[[AGBaseStorage fieldsOfPredicate:predicate] should] equal:[NSSet setWithArray:@[@"name", @"age", @"address"]]];
+        });
+
+        it(@"should return the fields of predicates with variables", ^{
+            NSPredicate *predicate = [[NSPredicate predicateWithFormat:@"name == $NAME"] predicateWithSubstitutionVariables:@{@"NAME": @"Robert"}];
+
+            [[[AGBaseStorage fieldsOfPredicate:predicate] should] equal:[NSSet setWithObject:@"name"]];
+        });
+
+        it(@"should not return the fields of predicates on the whole record", ^{
+            [[AGBaseStorage fieldsOfPredicate:[NSPredicate predicateWithFormat:@"SELF.name == 'Robert'"]] shouldBeNil];
+            [[AGBaseStorage fieldsOfPredicate:[NSPredicate predicateWithFormat:@"SUBQUERY(friends, $f, $f.name == 'Robert').@count > 0"]] shouldBeNil];
+            [[AGBaseStorage fieldsOfPredicate:[NSPredicate predicateWithBlock:^BOOL(id record, NSDictionary *bindings) {
+                return YES;
+            }]] shouldBeNil];
+        });
+    });
 });
 
 SPEC_END
\ No newline at end of file
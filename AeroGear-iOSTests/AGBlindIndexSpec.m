@@ -0,0 +1,120 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGBlindIndex.h"
+#import "AGPassphraseEncryptionServices.h"
+
+SPEC_BEGIN(AGBlindIndexSpec)
+
+describe(@"AGBlindIndex", ^{
+
+    __block AGBlindIndex *blindIndex = nil;
+    __block NSDictionary *index = nil;
+
+    NSSet *(^lookup)(NSString *, NSData *) = ^NSSet *(NSString *field, NSData *token) {
+        return index[field][token];
+    };
+
+    beforeEach(^{
+        AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+        cryptoConfig.passphrase = @"PASSPHRASE";
+        cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+        AGPassphraseEncryptionServices *encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+        blindIndex = [[AGBlindIndex alloc] initWithEncryptionService:encryptService fields:@[@"name", @"age"]];
+
+        index = @{@"name" : @{[blindIndex tokenForValue:@"Robert"] : [NSSet setWithObject:@"1"],
+                              [blindIndex tokenForValue:@"David"] : [NSSet setWithObject:@"2"]},
+                  @"age" : @{[blindIndex tokenForValue:@30] : [NSSet setWithObjects:@"1", @"2", nil]}};
+    });
+
+    context(@"when computing tokens", ^{
+
+        it(@"should compute the same token for equal values", ^{
+            [[[blindIndex tokenForValue:@"Robert"] should] equal:[blindIndex tokenForValue:@"Robert"]];
+            [[[blindIndex tokenForValue:@30] should] equal:[blindIndex tokenForValue:@30.0]];
+        });
+
+        it(@"should compute different tokens for different values", ^{
+            [[[blindIndex tokenForValue:@"Robert"] shouldNot] equal:[blindIndex tokenForValue:@"robert"]];
+            [[[blindIndex tokenForValue:@"1"] shouldNot] equal:[blindIndex tokenForValue:@1]];
+        });
+
+        it(@"should not reveal the value", ^{
+            NSData *token = [blindIndex tokenForValue:@"Robert"];
+
+            [[token shouldNot] equal:[@"Robert" dataUsingEncoding:NSUTF8StringEncoding]];
+            [[theValue([token length]) should] equal:theValue(16)];
+        });
+
+        it(@"should compute an empty token for missing fields", ^{
+            NSDictionary *tokens = [blindIndex tokensForRecord:@{@"name" : @"Robert"}];
+
+            [[tokens[@"name"] should] equal:[blindIndex tokenForValue:@"Robert"]];
+            [[theValue([tokens[@"age"] length]) should] equal:theValue(0)];
+            [[theValue([blindIndex isComplete:tokens]) should] beYes];
+            [[theValue([blindIndex isComplete:@{@"name" : tokens[@"name"]}]) should] beNo];
+        });
+    });
+
+    context(@"when looking up candidates", ^{
+
+        it(@"should look up equality predicates on indexed fields", ^{
+            NSSet *candidates = [blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"name == 'Robert'"] lookup:lookup];
+
+            [[candidates should] equal:[NSSet setWithObject:@"1"]];
+        });
+
+        it(@"should look up IN predicates on indexed fields", ^{
+            NSSet *candidates = [blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"name IN %@", @[@"Robert", @"David"]] lookup:lookup];
+
+            [[candidates should] equal:[NSSet setWithObjects:@"1", @"2", nil]];
+        });
+
+        it(@"should intersect AND predicates, ignoring the non-indexed ones", ^{
+            NSSet *candidates = [blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"age == 30 AND name == 'David' AND city == 'Boston'"] lookup:lookup];
+
+            [[candidates should] equal:[NSSet setWithObject:@"2"]];
+        });
+
+        it(@"should unite OR predicates", ^{
+            NSSet *candidates = [blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"name == 'Robert' OR name == 'David'"] lookup:lookup];
+
+            [[candidates should] equal:[NSSet setWithObjects:@"1", @"2", nil]];
+        });
+
+        it(@"should not be used for an OR predicate with a non-indexed field", ^{
+            [[blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"name == 'Robert' OR city == 'Boston'"] lookup:lookup] shouldBeNil];
+        });
+
+        it(@"should not be used for non-equality or case insensitive comparisons", ^{
+            [[blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"age > 30"] lookup:lookup] shouldBeNil];
+            [[blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"name ==[c] 'robert'"] lookup:lookup] shouldBeNil];
+            [[blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"NOT name == 'Robert'"] lookup:lookup] shouldBeNil];
+        });
+
+        it(@"should find no candidates for an unknown value", ^{
+            NSSet *candidates = [blindIndex candidatesForPredicate:[NSPredicate predicateWithFormat:@"name == 'Corinne'"] lookup:lookup];
+
+            [[candidates should] beEmpty];
+        });
+    });
+});
+
+SPEC_END
@@ -0,0 +1,547 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGEncryptedMemoryStorage.h"
+#import "AGPassphraseEncryptionServices.h"
+#import "AGLazyRecord.h"
+
+// an encryption service implementing the required methods only
+@interface AGMinimalEncryptionService : NSObject <AGEncryptionService>
+- (instancetype)initWithEncryptionService:(id<AGEncryptionService>)encryptionService;
+@end
+
+@implementation AGMinimalEncryptionService {
+    id<AGEncryptionService> _encryptionService;
+}
+
+- (instancetype)initWithEncryptionService:(id<AGEncryptionService>)encryptionService {
+    self = [super init];
+    if (self) {
+        _encryptionService = encryptionService;
+    }
+    return self;
+}
+
+- (NSData *)encrypt:(NSData *)data {
+    return [_encryptionService encrypt:data];
+}
+
+- (NSData *)encrypt:(NSData *)data IV:(NSData *)IV {
+    return [_encryptionService encrypt:data IV:IV];
+}
+
+- (NSData *)decrypt:(NSData *)data {
+    return [_encryptionService decrypt:data];
+}
+
+- (NSData *)decrypt:(NSData *)data IV:(NSData *)IV {
+    return [_encryptionService decrypt:data IV:IV];
+}
+
+@end
+
+// a dictionary counting the values read from it, as a file would
+@interface AGCountingDictionary : NSMutableDictionary
+@property (nonatomic, readonly) NSUInteger reads;
+@end
+
+@implementation AGCountingDictionary {
+    NSMutableDictionary *_dictionary;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _dictionary = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (NSUInteger)count {
+    return [_dictionary count];
+}
+
+- (id)objectForKey:(id)key {
+    _reads++;
+    return [_dictionary objectForKey:key];
+}
+
+- (NSEnumerator *)keyEnumerator {
+    return [_dictionary keyEnumerator];
+}
+
+- (void)setObject:(id)object forKey:(id<NSCopying>)key {
+    [_dictionary setObject:object forKey:key];
+}
+
+- (void)removeObjectForKey:(id)key {
+    [_dictionary removeObjectForKey:key];
+}
+
+@end
+
+SPEC_BEGIN(AGEncryptedMemoryStorageSpec)
+
+describe(@"AGEncryptedMemoryStorage", ^{
+
+    __block AGPassphraseEncryptionServices *encryptService = nil;
+
+    beforeAll(^{
+        AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+        cryptoConfig.passphrase = @"PASSPHRASE";
+        cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+        encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+    });
+
+    context(@"when the encryption service implements the required methods only", ^{
+
+        __block AGEncryptedMemoryStorage *encStorage = nil;
+
+        beforeEach(^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:[[AGMinimalEncryptionService alloc] initWithEncryptionService:encryptService]];
+            [config setEncryptedFields:@[@"name"]];
+            [config setIndexedFields:@[@"name"]];
+
+            encStorage = [AGEncryptedMemoryStorage storeWithConfig:config];
+        });
+
+        it(@"should save, read and filter records", ^{
+            BOOL success = [encStorage save:@[[@{@"id" : @"1", @"name" : @"Robert"} mutableCopy],
+                                              [@{@"id" : @"2", @"name" : @"David"} mutableCopy],
+                                              [@{@"id" : @"3", @"name" : @"Corinne"} mutableCopy]] error:nil];
+
+            [[theValue(success) should] beYes];
+            [[[encStorage readAll] should] haveCountOf:3];
+            [[[encStorage read:@"2"][@"name"] should] equal:@"David"];
+            [[[encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:1];
+        });
+    });
+
+    context(@"when created with a record cache", ^{
+
+        __block AGEncryptedMemoryStorage *encStorage = nil;
+
+        beforeEach(^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setCacheSize:1024];
+
+            encStorage = [AGEncryptedMemoryStorage storeWithConfig:config];
+        });
+
+        it(@"should serve repeated reads from the cache", ^{
+            NSMutableDictionary *user = [@{@"id" : @"1", @"name" : @"Robert"} mutableCopy];
+            [encStorage save:user error:nil];
+
+            [[[encStorage read:@"1"] should] equal:user];
+            [[[encStorage read:@"1"] should] equal:user];
+
+            [[theValue(encStorage.cache.hits) should] equal:theValue(1)];
+            [[theValue(encStorage.cache.misses) should] equal:theValue(1)];
+        });
+
+        it(@"should not return a stale record after a save", ^{
+            NSMutableDictionary *user = [@{@"id" : @"1", @"name" : @"Robert"} mutableCopy];
+            [encStorage save:user error:nil];
+            [encStorage read:@"1"];
+
+            user[@"name"] = @"David";
+            [encStorage save:@[user] error:nil];
+
+            [[[encStorage read:@"1"][@"name"] should] equal:@"David"];
+        });
+
+        it(@"should not return a removed record", ^{
+            NSMutableDictionary *user = [@{@"id" : @"1", @"name" : @"Robert"} mutableCopy];
+            [encStorage save:user error:nil];
+            [encStorage read:@"1"];
+
+            [encStorage remove:user error:nil];
+
+            [[encStorage read:@"1"] shouldBeNil];
+            [[theValue(encStorage.cache.count) should] equal:theValue(0)];
+        });
+
+        it(@"should empty the cache on reset", ^{
+            [encStorage save:[@{@"id" : @"1", @"name" : @"Robert"} mutableCopy] error:nil];
+            [encStorage read:@"1"];
+
+            [encStorage reset:nil];
+
+            [[theValue(encStorage.cache.count) should] equal:theValue(0)];
+        });
+    });
+
+    context(@"when created with indexed fields", ^{
+
+        __block AGEncryptedMemoryStorage *encStorage = nil;
+
+        beforeEach(^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setIndexedFields:@[@"name"]];
+
+            encStorage = [AGEncryptedMemoryStorage storeWithConfig:config];
+
+            [encStorage save:@[[@{@"id" : @"1", @"name" : @"Robert", @"city" : @"Boston"} mutableCopy],
+                               [@{@"id" : @"2", @"name" : @"David", @"city" : @"Boston"} mutableCopy],
+                               [@{@"id" : @"3", @"name" : @"Robert", @"city" : @"New York"} mutableCopy]] error:nil];
+        });
+
+        it(@"should keep the tokens of the indexed fields only", ^{
+            NSDictionary *tokens = [encStorage tokensForKey:@"1"];
+
+            [[tokens should] haveCountOf:1];
+            [tokens[@"name"] shouldNotBeNil];
+        });
+
+        it(@"should filter on indexed fields", ^{
+            NSArray *users = [encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]];
+            [[users should] haveCountOf:2];
+
+            users = [encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert' AND city == 'Boston'"]];
+            [[users should] haveCountOf:1];
+            [[users[0][@"id"] should] equal:@"1"];
+        });
+
+        it(@"should filter on non-indexed fields", ^{
+            NSArray *users = [encStorage filter:[NSPredicate predicateWithFormat:@"city == 'Boston'"]];
+
+            [[users should] haveCountOf:2];
+        });
+
+        it(@"should update the index on save and remove", ^{
+            NSMutableDictionary *user = [[encStorage read:@"2"] mutableCopy];
+            user[@"name"] = @"Robert";
+            [encStorage save:user error:nil];
+
+            [[[encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:3];
+            [[[encStorage filter:[NSPredicate predicateWithFormat:@"name == 'David'"]] should] beEmpty];
+
+            [encStorage remove:user error:nil];
+
+            [[[encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:2];
+        });
+
+        it(@"should not rule out records saved without tokens", ^{
+            NSMutableDictionary *user = [@{@"id" : @"4", @"name" : @"Robert"} mutableCopy];
+
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            AGEncryptedMemoryStorage *unindexedStorage = [AGEncryptedMemoryStorage storeWithConfig:config];
+            [unindexedStorage save:user error:nil];
+
+            [unindexedStorage enumerateEncryptedDataUsingBlock:^(NSString *key, NSData *encryptedData, BOOL *stop) {
+                [encStorage save:encryptedData forKey:key tokens:nil];
+            }];
+
+            [[[encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:3];
+            // indexed once decrypted
+            [[encStorage tokensForKey:@"4"] shouldNotBeNil];
+        });
+
+        it(@"should only read the persisted tokens when created", ^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setIndexedFields:@[@"name"]];
+
+            NSMutableDictionary *data = [NSMutableDictionary dictionary];
+            AGCountingDictionary *tokens = [[AGCountingDictionary alloc] init];
+
+            [[[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:tokens]
+                    save:@[[@{@"id" : @"1", @"name" : @"Robert"} mutableCopy],
+                           [@{@"id" : @"2", @"name" : @"David"} mutableCopy]] error:nil];
+
+            AGEncryptedMemoryStorage *reopened = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:tokens];
+            NSUInteger reads = tokens.reads;
+
+            NSMutableDictionary *user = [[reopened read:@"2"] mutableCopy];
+            user[@"name"] = @"Robert";
+            [reopened save:user error:nil];
+
+            [[[reopened filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:2];
+            [[theValue(tokens.reads) should] equal:theValue(reads)];
+        });
+
+        it(@"should not read the records to load the tokens", ^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setIndexedFields:@[@"name"]];
+
+            AGCountingDictionary *data = [[AGCountingDictionary alloc] init];
+            NSMutableDictionary *tokens = [NSMutableDictionary dictionary];
+
+            [[[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:tokens]
+                    save:[@{@"id" : @"1", @"name" : @"Robert"} mutableCopy] error:nil];
+
+            NSUInteger reads = data.reads;
+            AGEncryptedMemoryStorage *reopened = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:tokens];
+
+            [[theValue(data.reads) should] equal:theValue(reads)];
+            [[reopened tokensForKey:@"1"] shouldNotBeNil];
+        });
+
+        it(@"should drop the tokens computed with a previous key", ^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setIndexedFields:@[@"name"]];
+            [config setKeyVersion:1];
+
+            NSMutableDictionary *data = [NSMutableDictionary dictionary];
+            NSMutableDictionary *tokens = [NSMutableDictionary dictionary];
+
+            [[[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:tokens]
+                    save:[@{@"id" : @"1", @"name" : @"Robert"} mutableCopy] error:nil];
+
+            [config setKeyVersion:2];
+            [config setPreviousEncryptionServices:@{@1: encryptService}];
+
+            AGEncryptedMemoryStorage *reopened = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:tokens];
+
+            [[reopened tokensForKey:@"1"] shouldBeNil];
+            [[[reopened filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:1];
+        });
+    });
+
+    context(@"when a record can't be read", ^{
+
+        __block AGStoreConfiguration *config = nil;
+        __block AGCountingDictionary *data = nil;
+
+        beforeEach(^{
+            config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+
+            data = [[AGCountingDictionary alloc] init];
+
+            [[[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil]
+                    save:@[[@{@"id" : @"1", @"name" : @"Robert"} mutableCopy],
+                           [@{@"id" : @"2", @"name" : @"David"} mutableCopy]] error:nil];
+
+            // as a file whose read fails
+            [data stub:@selector(objectForKey:) andReturn:nil withArguments:@"2"];
+        });
+
+        it(@"should fail to read them all", ^{
+            AGEncryptedMemoryStorage *encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+
+            [[encStorage readAll] shouldBeNil];
+            [[encStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] shouldBeNil];
+        });
+
+        it(@"should fail to read them all lazily", ^{
+            [config setLazyDecoding:YES];
+            AGEncryptedMemoryStorage *encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+
+            [[encStorage readAll] shouldBeNil];
+        });
+    });
+
+    context(@"when created without a record cache", ^{
+
+        it(@"should not have a cache", ^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+
+            AGEncryptedMemoryStorage *encStorage = [AGEncryptedMemoryStorage storeWithConfig:config];
+
+            [encStorage.cache shouldBeNil];
+        });
+    });
+
+    context(@"when created with compression", ^{
+
+        __block AGStoreConfiguration *config = nil;
+        __block NSMutableDictionary *data = nil;
+        __block NSMutableDictionary *user = nil;
+
+        NSUInteger (^encryptedLength)(AGEncryptedMemoryStorage *) = ^NSUInteger(AGEncryptedMemoryStorage *store) {
+            __block NSUInteger length = 0;
+
+            [store enumerateEncryptedDataUsingBlock:^(NSString *key, NSData *encryptedData, BOOL *stop) {
+                length += [encryptedData length];
+            }];
+
+            return length;
+        };
+
+        beforeEach(^{
+            config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setCompressionThreshold:256];
+
+            data = [NSMutableDictionary dictionary];
+
+            NSMutableString *bio = [NSMutableString string];
+            for (NSUInteger i = 0; i < 100; i++)
+                [bio appendString:@"Robert likes long walks on the beach. "];
+
+            user = [@{@"id" : @"1", @"name" : @"Robert", @"bio" : bio} mutableCopy];
+        });
+
+        it(@"should store text-heavy records in less space", ^{
+            AGEncryptedMemoryStorage *encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:nil tokens:nil];
+            [encStorage save:user error:nil];
+
+            [config setCompressionThreshold:0];
+            AGEncryptedMemoryStorage *plainStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:nil tokens:nil];
+            [plainStorage save:user error:nil];
+
+            [[theValue(encryptedLength(encStorage)) should] beLessThan:theValue(encryptedLength(plainStorage) / 4)];
+            [[[encStorage read:@"1"] should] equal:user];
+        });
+
+        it(@"should read records in batches", ^{
+            AGEncryptedMemoryStorage *encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:nil tokens:nil];
+
+            NSMutableArray *users = [NSMutableArray array];
+            for (NSUInteger i = 0; i < 200; i++) {
+                NSMutableDictionary *other = [user mutableCopy];
+                other[@"id"] = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+                [users addObject:other];
+            }
+
+            [[theValue([encStorage save:users error:nil]) should] beYes];
+            [[[encStorage readAll] should] haveCountOf:200];
+        });
+
+        it(@"should read records saved without compression", ^{
+            [config setCompressionThreshold:0];
+            AGEncryptedMemoryStorage *plainStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+            [plainStorage save:user error:nil];
+
+            [config setCompressionThreshold:256];
+            AGEncryptedMemoryStorage *encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+
+            [[[encStorage read:@"1"] should] equal:user];
+        });
+    });
+
+    context(@"when created with encrypted fields", ^{
+
+        __block AGStoreConfiguration *config = nil;
+        __block AGEncryptedMemoryStorage *encStorage = nil;
+        __block NSMutableDictionary *data = nil;
+
+        BOOL (^contains)(NSData *, NSString *) = ^BOOL(NSData *encryptedData, NSString *string) {
+            return [encryptedData rangeOfData:[string dataUsingEncoding:NSUTF8StringEncoding]
+                                      options:0 range:NSMakeRange(0, [encryptedData length])].location != NSNotFound;
+        };
+
+        beforeEach(^{
+            config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+            [config setEncryptedFields:@[@"password", @"notes"]];
+
+            data = [NSMutableDictionary dictionary];
+            encStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+
+            NSArray *accounts = @[[@{@"id" : @"1", @"title" : @"bank", @"password" : @"s3cr3t", @"notes" : @[@"pin 1234"]} mutableCopy],
+                                  [@{@"id" : @"2", @"title" : @"mail", @"password" : @"hunter2"} mutableCopy],
+                                  [@{@"id" : @"3", @"title" : @"shop"} mutableCopy]];
+
+            [encStorage save:accounts error:nil];
+        });
+
+        it(@"should only encrypt the listed fields", ^{
+            NSData *encryptedData = data[@"1"];
+
+            [[theValue(contains(encryptedData, @"bank")) should] beYes];
+            [[theValue(contains(encryptedData, @"s3cr3t")) should] beNo];
+            [[theValue(contains(encryptedData, @"pin 1234")) should] beNo];
+        });
+
+        it(@"should not encrypt equal values to equal ciphertexts", ^{
+            NSData *encryptedData = data[@"1"];
+
+            [encStorage save:[[encStorage read:@"1"] mutableCopy] error:nil];
+
+            [[data[@"1"] shouldNot] equal:encryptedData];
+            [[[encStorage read:@"1"][@"password"] should] equal:@"s3cr3t"];
+        });
+
+        it(@"should read the records", ^{
+            [[[encStorage read:@"1"] should] equal:@{@"id" : @"1", @"title" : @"bank", @"password" : @"s3cr3t", @"notes" : @[@"pin 1234"]}];
+            [[[encStorage read:@"3"] should] equal:@{@"id" : @"3", @"title" : @"shop"}];
+            [[[encStorage readAll] should] haveCountOf:3];
+        });
+
+        it(@"should filter on encrypted fields", ^{
+            NSArray *results = [encStorage filter:[NSPredicate predicateWithFormat:@"password == 'hunter2'"]];
+
+            [[results should] haveCountOf:1];
+            [[results[0][@"title"] should] equal:@"mail"];
+        });
+
+        it(@"should only decrypt the matching records when filtering on plaintext fields", ^{
+            // a record the store can't decrypt
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"OTHER PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+            AGStoreConfiguration *otherConfig = [[AGStoreConfiguration alloc] init];
+            [otherConfig setEncryptionService:[[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig]];
+            [otherConfig setEncryptedFields:@[@"password"]];
+
+            NSMutableDictionary *otherData = [NSMutableDictionary dictionary];
+            AGEncryptedMemoryStorage *otherStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:otherConfig data:otherData tokens:nil];
+            [otherStorage save:[@{@"id" : @"4", @"title" : @"work", @"password" : @"letmein"} mutableCopy] error:nil];
+
+            [encStorage save:otherData[@"4"] forKey:@"4"];
+
+            NSArray *results = [encStorage filter:[NSPredicate predicateWithFormat:@"title IN {'bank', 'shop'}"]];
+
+            [[results should] haveCountOf:2];
+            [[[results valueForKey:@"id"] should] containObjects:@"1", @"3", nil];
+
+            // the predicate depends on an encrypted field
+            [[encStorage filter:[NSPredicate predicateWithFormat:@"title == 'bank' OR password == 'letmein'"]] shouldBeNil];
+        });
+
+        it(@"should read plaintext fields of lazy records without decrypting them", ^{
+            [config setLazyDecoding:YES];
+            AGEncryptedMemoryStorage *lazyStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+
+            AGLazyRecord *record = [lazyStorage read:@"1"];
+
+            [[record[@"title"] should] equal:@"bank"];
+            [[theValue(record.isDecoded) should] beNo];
+
+            [[record[@"password"] should] equal:@"s3cr3t"];
+            [[theValue(record.isDecoded) should] beYes];
+        });
+
+        it(@"should read and filter records encrypted as a whole", ^{
+            [config setEncryptedFields:nil];
+            AGEncryptedMemoryStorage *wholeStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+            [wholeStorage save:[@{@"id" : @"4", @"title" : @"bank", @"password" : @"letmein"} mutableCopy] error:nil];
+
+            [[theValue(contains(data[@"4"], @"bank")) should] beNo];
+
+            NSArray *results = [encStorage filter:[NSPredicate predicateWithFormat:@"title == 'bank'"]];
+
+            [[results should] haveCountOf:2];
+            [[[results valueForKey:@"password"] should] containObjects:@"s3cr3t", @"letmein", nil];
+            [[[wholeStorage read:@"1"][@"password"] should] equal:@"s3cr3t"];
+        });
+    });
+});
+
+SPEC_END
@@ -19,6 +19,7 @@
 #import "AGEncryptedSQLiteStorage.h"
 #import "AGPassphraseEncryptionServices.h"
 #import "AGRandomGenerator.h"
+#import "AGBaseStorage.h"
 
 SPEC_BEGIN(AGEncryptedSQLiteStorageSpec)
 
@@ -112,6 +113,18 @@ describe(@"AGEncryptedSQLiteStorage", ^{
             [[theValue(success) should] equal:theValue(NO)];
         });
 
+        it(@"should report an error when the object can't be encrypted", ^{
+            [encryptService stub:@selector(encrypt:) andReturn:nil];
+
+            NSMutableDictionary* user = [NSMutableDictionary dictionaryWithObjectsAndKeys:@"Corinne", @"name", nil];
+            NSError *error;
+
+            BOOL success = [sqliteStorage save:user error:&error];
+            [[theValue(success) should] equal:theValue(NO)];
+            [error shouldNotBeNil];
+            [[[sqliteStorage readAll] should] beEmpty];
+        });
+
         it(@"should save a single object with id set", ^{
             NSMutableDictionary* user = [NSMutableDictionary dictionaryWithObjectsAndKeys:@"Matthias", @"name", nil];
 
@@ -703,6 +716,172 @@ describe(@"AGEncryptedSQLiteStorage", ^{
             });
         });
     });
+
+    context(@"when created with indexed fields", ^{
+
+        __block AGEncryptedSQLiteStorage* sqliteStorage = nil;
+
+        beforeEach(^{
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setName:@"IndexedUsers"];
+            [config setEncryptionService:[[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig]];
+            [config setIndexedFields:@[@"name"]];
+
+            sqliteStorage = [AGEncryptedSQLiteStorage storeWithConfig:config];
+
+            [sqliteStorage save:@[[@{@"name" : @"Robert", @"city" : @"Boston"} mutableCopy],
+                                  [@{@"name" : @"David", @"city" : @"Boston"} mutableCopy],
+                                  [@{@"name" : @"Robert", @"city" : @"New York"} mutableCopy]] error:nil];
+        });
+
+        afterEach(^{
+            [sqliteStorage reset:nil];
+        });
+
+        it(@"should filter on indexed fields", ^{
+            NSArray *users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]];
+            [[users should] haveCountOf:2];
+
+            users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert' AND city == 'New York'"]];
+            [[users should] haveCountOf:1];
+        });
+
+        it(@"should filter on non-indexed fields", ^{
+            NSArray *users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"city == 'Boston'"]];
+
+            [[users should] haveCountOf:2];
+        });
+
+        it(@"should update the index on save and remove", ^{
+            NSMutableDictionary *user = [[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'David'"]][0] mutableCopy];
+            user[@"name"] = @"Robert";
+            [sqliteStorage save:user error:nil];
+
+            [[[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:3];
+            [[[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'David'"]] should] beEmpty];
+
+            [sqliteStorage remove:user error:nil];
+
+            [[[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:2];
+        });
+    });
+
+    context(@"when created with encrypted fields", ^{
+
+        __block AGEncryptedSQLiteStorage* sqliteStorage = nil;
+
+        beforeEach(^{
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setName:@"FieldEncryptedUsers"];
+            [config setEncryptionService:[[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig]];
+            [config setEncryptedFields:@[@"ssn"]];
+
+            sqliteStorage = [AGEncryptedSQLiteStorage storeWithConfig:config];
+
+            [sqliteStorage save:@[[@{@"name" : @"Robert", @"city" : @"Boston", @"ssn" : @"078-05-1120"} mutableCopy],
+                                  [@{@"name" : @"David", @"city" : @"Boston", @"ssn" : @"219-09-9999"} mutableCopy],
+                                  [@{@"name" : @"Robert", @"city" : @"New York", @"ssn" : @"457-55-5462"} mutableCopy]] error:nil];
+        });
+
+        afterEach(^{
+            [sqliteStorage reset:nil];
+        });
+
+        it(@"should read the records", ^{
+            NSArray *users = [sqliteStorage readAll];
+
+            [[users should] haveCountOf:3];
+            [[[users valueForKey:@"ssn"] should] containObjects:@"078-05-1120", @"219-09-9999", @"457-55-5462", nil];
+        });
+
+        it(@"should filter on plaintext fields", ^{
+            NSArray *users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert' AND city == 'New York'"]];
+
+            [[users should] haveCountOf:1];
+            [[users[0][@"ssn"] should] equal:@"457-55-5462"];
+        });
+
+        it(@"should filter on the record id", ^{
+            NSString *recordId = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'David'"]][0][@"id"];
+
+            NSArray *users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"id == %@", recordId]];
+
+            [[users should] haveCountOf:1];
+            [[users[0][@"ssn"] should] equal:@"219-09-9999"];
+        });
+
+        it(@"should filter on encrypted fields", ^{
+            NSArray *users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"ssn == '078-05-1120'"]];
+
+            [[users should] haveCountOf:1];
+            [[users[0][@"city"] should] equal:@"Boston"];
+        });
+    });
+
+    context(@"when created with page encryption", ^{
+
+        __block AGStoreConfiguration *config = nil;
+        __block AGEncryptedSQLiteStorage *sqliteStorage = nil;
+
+        beforeEach(^{
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+            config = [[AGStoreConfiguration alloc] init];
+            [config setName:@"PagedUsers"];
+            [config setEncryptionService:[[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig]];
+            [config setPageEncryption:YES];
+
+            sqliteStorage = [AGEncryptedSQLiteStorage storeWithConfig:config];
+
+            [sqliteStorage save:@[[@{@"id" : @"1", @"name" : @"Robert", @"city" : @"Boston"} mutableCopy],
+                                  [@{@"id" : @"2", @"name" : @"David", @"city" : @"Boston"} mutableCopy],
+                                  [@{@"id" : @"3", @"name" : @"Robert", @"city" : @"New York"} mutableCopy]] error:nil];
+        });
+
+        afterEach(^{
+            [sqliteStorage reset:nil];
+        });
+
+        it(@"should read, filter and remove records", ^{
+            [[[sqliteStorage readAll] should] haveCountOf:3];
+            [[[sqliteStorage read:@"2"][@"name"] should] equal:@"David"];
+
+            NSArray *users = [sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]];
+            [[users should] haveCountOf:2];
+
+            [[theValue([sqliteStorage remove:@{@"id" : @"2"} error:nil]) should] beYes];
+            [[sqliteStorage read:@"2"] shouldBeNil];
+        });
+
+        it(@"should read the records after reopening the store", ^{
+            AGEncryptedSQLiteStorage *reopened = [AGEncryptedSQLiteStorage storeWithConfig:config];
+
+            [[[reopened readAll] should] haveCountOf:3];
+        });
+
+        it(@"should not leave plain data on disk", ^{
+            NSURL *file = [AGBaseStorage storeURLWithName:@"PagedUsers%@.sqlite3"];
+            NSData *contents = [NSData dataWithContentsOfURL:file];
+
+            [contents shouldNotBeNil];
+
+            NSData *name = [@"Robert" dataUsingEncoding:NSUTF8StringEncoding];
+            NSData *header = [@"SQLite format" dataUsingEncoding:NSUTF8StringEncoding];
+
+            [[theValue([contents rangeOfData:name options:0 range:NSMakeRange(0, [contents length])].location) should] equal:theValue(NSNotFound)];
+            [[theValue([contents rangeOfData:header options:0 range:NSMakeRange(0, [contents length])].location) should] equal:theValue(NSNotFound)];
+        });
+    });
 });
 
 SPEC_END
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGEncryptedMemoryStorage.h"
+#import "AGEncryptedSQLiteStorage.h"
+#import "AGPassphraseEncryptionServices.h"
+
+// Measures the bulk save and read paths of the encrypted stores. As they take
+// a while to run, they are only run when the AG_BENCHMARK environment
+// variable is set in the test scheme.
+SPEC_BEGIN(AGEncryptedStorageBenchmarkSpec)
+
+describe(@"Encrypted storage benchmarks", ^{
+
+    if (![[NSProcessInfo processInfo] environment][@"AG_BENCHMARK"])
+        return;
+
+    __block AGPassphraseEncryptionServices *encryptService = nil;
+
+    NSArray * const kRecordCounts = @[@1000, @10000, @100000];
+
+    NSArray *(^recordsWithCount)(NSUInteger) = ^NSArray *(NSUInteger count) {
+        NSMutableArray *records = [NSMutableArray arrayWithCapacity:count];
+
+        for (NSUInteger i = 0; i < count; i++) {
+            [records addObject:[@{@"name" : [NSString stringWithFormat:@"user %lu", (unsigned long)i],
+                                  @"city" : @"Boston"} mutableCopy]];
+        }
+
+        return records;
+    };
+
+    void (^benchmark)(id<AGStore>, NSArray *) = ^(id<AGStore> store, NSArray *records) {
+        NSDate *start = [NSDate date];
+        BOOL success = [store save:records error:nil];
+        NSTimeInterval saveTime = -[start timeIntervalSinceNow];
+
+        [[theValue(success) should] beYes];
+
+        start = [NSDate date];
+        NSArray *results = [store readAll];
+        NSTimeInterval readTime = -[start timeIntervalSinceNow];
+
+        [[results should] haveCountOf:[records count]];
+
+        NSLog(@"%@ with %lu records: save %.3fs, readAll %.3fs",
+              [store type], (unsigned long)[records count], saveTime, readTime);
+    };
+
+    beforeAll(^{
+        AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+        cryptoConfig.passphrase = @"PASSPHRASE";
+        cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+        encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+    });
+
+    it(@"should compare the throughput of the cipher suites", ^{
+        NSMutableArray *buffers = [NSMutableArray array];
+        for (NSUInteger i = 0; i < 1024; i++)
+            [buffers addObject:[NSMutableData dataWithLength:64 * 1024]];
+
+        for (NSNumber *cipherSuite in @[@(AGCipherSuiteSecretBox), @(AGCipherSuiteAES256GCM)]) {
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+            cryptoConfig.cipherSuite = [cipherSuite integerValue];
+
+            AGPassphraseEncryptionServices *service = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+            NSDate *start = [NSDate date];
+            NSArray *encrypted = [service encryptAll:buffers];
+            NSTimeInterval encryptTime = -[start timeIntervalSinceNow];
+
+            start = [NSDate date];
+            NSArray *decrypted = [service decryptAll:encrypted];
+            NSTimeInterval decryptTime = -[start timeIntervalSinceNow];
+
+            [[decrypted should] haveCountOf:[buffers count]];
+
+            NSLog(@"cipher suite %@ with 64 MiB: encrypt %.0f MiB/s, decrypt %.0f MiB/s",
+                  cipherSuite, 64 / encryptTime, 64 / decryptTime);
+        }
+    });
+
+    for (NSNumber *count in kRecordCounts) {
+
+        it([NSString stringWithFormat:@"should measure the encrypted memory store with %@ records", count], ^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:encryptService];
+
+            benchmark([AGEncryptedMemoryStorage storeWithConfig:config], recordsWithCount([count unsignedIntegerValue]));
+        });
+
+        it([NSString stringWithFormat:@"should measure the encrypted SQLite store with %@ records", count], ^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setName:@"BenchmarkUsers"];
+            [config setEncryptionService:encryptService];
+
+            AGEncryptedSQLiteStorage *store = [AGEncryptedSQLiteStorage storeWithConfig:config];
+            [store reset:nil];
+
+            benchmark(store, recordsWithCount([count unsignedIntegerValue]));
+
+            [store reset:nil];
+        });
+    }
+});
+
+SPEC_END
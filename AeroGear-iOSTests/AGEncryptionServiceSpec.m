@@ -0,0 +1,238 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGPassphraseEncryptionServices.h"
+
+SPEC_BEGIN(AGEncryptionServiceSpec)
+
+describe(@"AGEncryptionService", ^{
+
+    context(@"when encrypting streams", ^{
+
+        __block AGPassphraseEncryptionServices *encryptService = nil;
+        __block NSData *plaintext = nil;
+
+        NSData *(^encrypt)(NSData *) = ^NSData *(NSData *data) {
+            NSInputStream *input = [NSInputStream inputStreamWithData:data];
+            NSOutputStream *output = [NSOutputStream outputStreamToMemory];
+            [input open];
+            [output open];
+
+            BOOL success = [encryptService encryptStream:input toStream:output error:nil];
+
+            [input close];
+            [output close];
+
+            return success ? [output propertyForKey:NSStreamDataWrittenToMemoryStreamKey] : nil;
+        };
+
+        NSData *(^decrypt)(NSData *, NSError **) = ^NSData *(NSData *data, NSError **error) {
+            NSInputStream *input = [NSInputStream inputStreamWithData:data];
+            NSOutputStream *output = [NSOutputStream outputStreamToMemory];
+            [input open];
+            [output open];
+
+            BOOL success = [encryptService decryptStream:input toStream:output error:error];
+
+            [input close];
+            [output close];
+
+            return success ? [output propertyForKey:NSStreamDataWrittenToMemoryStreamKey] : nil;
+        };
+
+        beforeEach(^{
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+            encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+            // use small segments so that the tests span several of them
+            encryptService.segmentSize = 32;
+
+            NSMutableData *data = [NSMutableData data];
+            for (uint8_t i = 0; i < 100; i++)
+                [data appendBytes:&i length:1];
+
+            plaintext = data;
+        });
+
+        it(@"should round-trip the contents", ^{
+            NSData *encrypted = encrypt(plaintext);
+
+            [[encrypted shouldNot] equal:plaintext];
+            [[decrypt(encrypted, nil) should] equal:plaintext];
+        });
+
+        it(@"should round-trip contents that fill the last segment", ^{
+            NSData *data = [plaintext subdataWithRange:NSMakeRange(0, 64)];
+
+            [[decrypt(encrypt(data), nil) should] equal:data];
+        });
+
+        it(@"should round-trip empty contents", ^{
+            [[decrypt(encrypt([NSData data]), nil) should] equal:[NSData data]];
+        });
+
+        it(@"should detect tampered segments", ^{
+            NSMutableData *encrypted = [encrypt(plaintext) mutableCopy];
+            ((uint8_t *)[encrypted mutableBytes])[40] ^= 1;
+
+            NSError *error;
+            [decrypt(encrypted, &error) shouldBeNil];
+            [[error.domain should] equal:AGEncryptionErrorDomain];
+        });
+
+        it(@"should detect truncated streams", ^{
+            NSData *encrypted = encrypt(plaintext);
+            NSData *truncated = [encrypted subdataWithRange:NSMakeRange(0, [encrypted length] / 2)];
+
+            NSError *error;
+            [decrypt(truncated, &error) shouldBeNil];
+            [error shouldNotBeNil];
+        });
+
+        it(@"should fail to decrypt with a different key", ^{
+            NSData *encrypted = encrypt(plaintext);
+
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"OTHER PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+            encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+            [decrypt(encrypted, nil) shouldBeNil];
+        });
+
+        it(@"should decrypt a single segment of a file", ^{
+            NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"segments.enc"];
+            [encrypt(plaintext) writeToFile:path atomically:YES];
+
+            NSFileHandle *file = [NSFileHandle fileHandleForReadingAtPath:path];
+
+            [[[encryptService decryptSegment:1 ofFile:file error:nil] should] equal:[plaintext subdataWithRange:NSMakeRange(32, 32)]];
+            [[[encryptService decryptSegment:3 ofFile:file error:nil] should] equal:[plaintext subdataWithRange:NSMakeRange(96, 4)]];
+            [[encryptService decryptSegment:4 ofFile:file error:nil] shouldBeNil];
+
+            [file closeFile];
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        });
+    });
+
+    context(@"when encrypting in batches", ^{
+
+        __block AGPassphraseEncryptionServices *encryptService = nil;
+        __block NSMutableArray *buffers = nil;
+
+        beforeEach(^{
+            AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+
+            encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+            buffers = [NSMutableArray array];
+            for (NSUInteger i = 0; i < 100; i++)
+                [buffers addObject:[[NSString stringWithFormat:@"record %lu", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding]];
+        });
+
+        it(@"should match encrypting one buffer at a time", ^{
+            NSArray *encrypted = [encryptService encryptAll:buffers];
+
+            [[encrypted should] haveCountOf:100];
+
+            [encrypted enumerateObjectsUsingBlock:^(NSData *data, NSUInteger idx, BOOL *stop) {
+                [[data should] equal:[encryptService encrypt:buffers[idx]]];
+            }];
+        });
+
+        it(@"should decrypt what was encrypted", ^{
+            [[[encryptService decryptAll:[encryptService encryptAll:buffers]] should] equal:buffers];
+        });
+
+        it(@"should return an empty array if there are no buffers", ^{
+            [[[encryptService encryptAll:@[]] should] beEmpty];
+        });
+    });
+
+    context(@"when using the AES-256-GCM cipher suite", ^{
+
+        __block AGPassphraseCryptoConfig *cryptoConfig = nil;
+        __block AGPassphraseEncryptionServices *encryptService = nil;
+        __block NSData *plaintext = nil;
+
+        beforeEach(^{
+            cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+            cryptoConfig.passphrase = @"PASSPHRASE";
+            cryptoConfig.salt = [@"e5ecbaaf33bd751a1ac728d45e6" dataUsingEncoding:NSUTF8StringEncoding];
+            cryptoConfig.cipherSuite = AGCipherSuiteAES256GCM;
+
+            encryptService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+            plaintext = [@"Lorem ipsum dolor sit amet" dataUsingEncoding:NSUTF8StringEncoding];
+        });
+
+        it(@"should decrypt what was encrypted", ^{
+            [[[encryptService decrypt:[encryptService encrypt:plaintext]] should] equal:plaintext];
+        });
+
+        it(@"should use a fresh nonce for each encryption", ^{
+            [[[encryptService encrypt:plaintext] shouldNot] equal:[encryptService encrypt:plaintext]];
+        });
+
+        it(@"should detect tampered data", ^{
+            NSMutableData *encrypted = [[encryptService encrypt:plaintext] mutableCopy];
+            ((uint8_t *)[encrypted mutableBytes])[[encrypted length] / 2] ^= 1;
+
+            [[encryptService decrypt:encrypted] shouldBeNil];
+        });
+
+        it(@"should not decrypt data encrypted with another cipher suite", ^{
+            cryptoConfig.cipherSuite = AGCipherSuiteSecretBox;
+            AGPassphraseEncryptionServices *secretBoxService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+            [[encryptService decrypt:[secretBoxService encrypt:plaintext]] shouldBeNil];
+        });
+
+        it(@"should decrypt what was encrypted in batches", ^{
+            NSArray *buffers = @[plaintext, [NSData data], [plaintext subdataWithRange:NSMakeRange(0, 5)]];
+
+            [[[encryptService decryptAll:[encryptService encryptAll:buffers]] should] equal:buffers];
+        });
+
+        it(@"should round-trip streams", ^{
+            NSOutputStream *encrypted = [NSOutputStream outputStreamToMemory];
+            NSOutputStream *decrypted = [NSOutputStream outputStreamToMemory];
+            NSInputStream *input = [NSInputStream inputStreamWithData:plaintext];
+
+            [input open];
+            [encrypted open];
+            [[theValue([encryptService encryptStream:input toStream:encrypted error:nil]) should] beYes];
+            [encrypted close];
+
+            input = [NSInputStream inputStreamWithData:[encrypted propertyForKey:NSStreamDataWrittenToMemoryStreamKey]];
+
+            [input open];
+            [decrypted open];
+            [[theValue([encryptService decryptStream:input toStream:decrypted error:nil]) should] beYes];
+            [decrypted close];
+
+            [[[decrypted propertyForKey:NSStreamDataWrittenToMemoryStreamKey] should] equal:plaintext];
+        });
+    });
+});
+
+SPEC_END
@@ -18,6 +18,7 @@
 #import <Kiwi/Kiwi.h>
 #import <objc/message.h>
 #import "AGHttpClient.h"
+#import "AGCircuitBreaker.h"
 #import "AGMultipart.h"
 #import "AGHTTPMockHelper.h"
 #import "AGRestAuthentication.h"
@@ -79,6 +80,150 @@ SPEC_BEGIN(AGHttpClientSpec)
                 [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
             });
 
+            it(@"should share a single GET between simultaneous callers", ^{
+                __block NSUInteger requestCount = 0;
+
+                [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                    return YES;
+                } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                    requestCount++;
+
+                    return [[OHHTTPStubsResponse responseWithData:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]
+                                                       statusCode:200
+                                                          headers:@{@"Content-Type": @"application/json"}] requestTime:0.5 responseTime:0.5];
+                }];
+
+                __block id firstResponse = nil;
+                __block id secondResponse = nil;
+
+                NSURLSessionDataTask *firstTask = [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    firstResponse = responseObject;
+                } failure:nil];
+
+                NSURLSessionDataTask *secondTask = [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    secondResponse = responseObject;
+                } failure:nil];
+
+                [[secondTask should] beIdenticalTo:firstTask];
+
+                [[expectFutureValue(secondResponse) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+                [[firstResponse should] beIdenticalTo:secondResponse];
+                [[theValue(requestCount) should] equal:theValue(1)];
+
+                // the request is over, a new one goes out
+                [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    finishedFlag = YES;
+                } failure:nil];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+                [[theValue(requestCount) should] equal:theValue(2)];
+            });
+
+            it(@"should serve the cached response when not modified", ^{
+                _restClient.responseCache = [AGResponseCache cache];
+
+                __block NSUInteger requestCount = 0;
+                __block NSString *ifNoneMatch = nil;
+
+                [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                    return YES;
+                } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                    ifNoneMatch = [request valueForHTTPHeaderField:@"If-None-Match"];
+
+                    if (requestCount++ > 0)
+                        return [OHHTTPStubsResponse responseWithData:[NSData data] statusCode:304 headers:@{@"ETag": @"\"v1\""}];
+
+                    return [OHHTTPStubsResponse responseWithData:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]
+                                                      statusCode:200
+                                                         headers:@{@"Content-Type": @"application/json", @"ETag": @"\"v1\""}];
+                }];
+
+                __block id firstResponse = nil;
+                __block id secondResponse = nil;
+
+                [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    firstResponse = responseObject;
+                } failure:nil];
+
+                [[expectFutureValue(firstResponse) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+                [ifNoneMatch shouldBeNil];
+
+                [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    secondResponse = responseObject;
+                } failure:nil];
+
+                [[expectFutureValue(secondResponse) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+                [[ifNoneMatch should] equal:@"\"v1\""];
+                [[secondResponse should] equal:firstResponse];
+            });
+
+            it(@"should repeat the request if the cached response is gone", ^{
+                AGResponseCache *cache = [AGResponseCache cache];
+                _restClient.responseCache = cache;
+
+                __block NSUInteger requestCount = 0;
+                __block NSString *ifNoneMatch = nil;
+
+                [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                    return YES;
+                } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                    requestCount++;
+                    ifNoneMatch = [request valueForHTTPHeaderField:@"If-None-Match"];
+
+                    if (ifNoneMatch) {
+                        // evicted while the request is under way
+                        [cache removeAllResponses];
+                        return [OHHTTPStubsResponse responseWithData:[NSData data] statusCode:304 headers:@{@"ETag": @"\"v1\""}];
+                    }
+
+                    return [OHHTTPStubsResponse responseWithData:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]
+                                                      statusCode:200
+                                                         headers:@{@"Content-Type": @"application/json", @"ETag": @"\"v1\""}];
+                }];
+
+                [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    finishedFlag = YES;
+                } failure:nil];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+                finishedFlag = NO;
+
+                __block id response = nil;
+
+                [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    response = responseObject;
+                } failure:nil];
+
+                [[expectFutureValue(response) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+                [[theValue([response count]) should] equal:theValue(2)];
+                [[theValue(requestCount) should] equal:theValue(3)];
+                [ifNoneMatch shouldBeNil];
+            });
+
+            it(@"should not share GETs with different parameters", ^{
+                __block NSUInteger requestCount = 0;
+                __block NSUInteger responseCount = 0;
+
+                [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                    return YES;
+                } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                    requestCount++;
+
+                    return [[OHHTTPStubsResponse responseWithData:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]
+                                                       statusCode:200
+                                                          headers:@{@"Content-Type": @"application/json"}] requestTime:0.5 responseTime:0.5];
+                }];
+
+                for (NSString *page in @[@"1", @"2"]) {
+                    [_restClient GET:@"projects" parameters:@{@"page": page} success:^(NSURLSessionDataTask *task, id responseObject) {
+                        responseCount++;
+                    } failure:nil];
+                }
+
+                [[expectFutureValue(theValue(responseCount)) shouldEventuallyBeforeTimingOutAfter(5)] equal:theValue(2)];
+                [[theValue(requestCount) should] equal:theValue(2)];
+            });
+
             it(@"should successfully create multipart request with a combined multipart and params", ^{
                 // create dummy NSData to send
                 NSData *data = [@"Lorem ipsum dolor sit amet," dataUsingEncoding:NSUTF8StringEncoding];
@@ -308,6 +453,261 @@ SPEC_BEGIN(AGHttpClientSpec)
             });
         });
 
+        context(@"when retrying failed requests", ^{
+
+            __block AGRetryPolicy *_retryPolicy = nil;
+
+            // answers with the given status codes in turn, then 200
+            __block void (^stubStatusCodes)(NSArray *) = nil;
+            __block NSUInteger requestCount = 0;
+
+            beforeEach(^{
+                _retryPolicy = [AGRetryPolicy policy];
+                _retryPolicy.baseDelay = 0.05;
+
+                requestCount = 0;
+
+                stubStatusCodes = ^(NSArray *statusCodes) {
+                    [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                        return YES;
+                    } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                        int status = requestCount < [statusCodes count] ? [statusCodes[requestCount] intValue] : 200;
+                        requestCount++;
+
+                        return [OHHTTPStubsResponse responseWithData:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]
+                                                          statusCode:status
+                                                             headers:@{@"Content-Type": @"application/json"}];
+                    }];
+                };
+            });
+
+            afterEach(^{
+                // remove all handlers installed by test methods
+                // to avoid any interference
+                [AGHTTPMockHelper clearAllMockedRequests];
+
+                finishedFlag = NO;
+            });
+
+            it(@"should retry idempotent requests until they succeed", ^{
+                AGHttpClient *restClient = [AGHttpClient clientFor:[NSURL URLWithString:@"http://retry.server.com/context/"]];
+                restClient.retryPolicy = _retryPolicy;
+
+                stubStatusCodes(@[@503, @502]);
+
+                [restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    [responseObject shouldNotBeNil];
+                    finishedFlag = YES;
+                } failure:nil];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+                [[theValue(requestCount) should] equal:theValue(3)];
+            });
+
+            it(@"should give up after maxRetries", ^{
+                AGHttpClient *restClient = [AGHttpClient clientFor:[NSURL URLWithString:@"http://giveup.server.com/context/"]];
+                restClient.retryPolicy = _retryPolicy;
+                _retryPolicy.maxRetries = 1;
+
+                stubStatusCodes(@[@503, @503, @503]);
+
+                [restClient PUT:@"projects/1" parameters:@{@"title": @"First Project"} success:nil failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    finishedFlag = YES;
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+                [[theValue(requestCount) should] equal:theValue(2)];
+            });
+
+            it(@"should not retry non idempotent requests", ^{
+                AGHttpClient *restClient = [AGHttpClient clientFor:[NSURL URLWithString:@"http://post.server.com/context/"]];
+                restClient.retryPolicy = _retryPolicy;
+
+                stubStatusCodes(@[@503]);
+
+                [restClient POST:@"projects" parameters:@{@"title": @"First Project"} success:nil failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    finishedFlag = YES;
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+                [[theValue(requestCount) should] equal:theValue(1)];
+            });
+
+            it(@"should fail fast while the circuit breaker of the host is open", ^{
+                AGHttpClient *restClient = [AGHttpClient clientFor:[NSURL URLWithString:@"http://breaker.server.com/context/"]];
+                restClient.retryPolicy = _retryPolicy;
+                _retryPolicy.maxRetries = 0;
+                _retryPolicy.circuitBreakerThreshold = 1;
+
+                stubStatusCodes(@[@500]);
+
+                [restClient GET:@"projects" parameters:nil success:nil failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    finishedFlag = YES;
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+
+                __block NSError *fastError = nil;
+
+                [restClient GET:@"projects" parameters:nil success:nil failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    fastError = error;
+                }];
+
+                [[expectFutureValue(fastError) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+                [[fastError.domain should] equal:AGCircuitBreakerErrorDomain];
+                [[theValue(requestCount) should] equal:theValue(1)];
+            });
+        });
+
+        context(@"when compressing request bodies", ^{
+
+            __block AGHttpClient* _restClient = nil;
+
+            beforeEach(^{
+                NSURL* baseURL = [NSURL URLWithString:@"http://server.com/context/"];
+
+                _restClient = [AGHttpClient clientFor:baseURL];
+                _restClient.requestCompressionThreshold = 1024;
+
+                [AGHTTPMockHelper mockResponse:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]];
+            });
+
+            afterEach(^{
+                // remove all handlers installed by test methods
+                // to avoid any interference
+                [AGHTTPMockHelper clearAllMockedRequests];
+
+                finishedFlag = NO;
+            });
+
+            it(@"should compress large bodies", ^{
+                NSString *description = [@"" stringByPaddingToLength:4096 withString:@"lorem ipsum " startingAtIndex:0];
+                NSDictionary *project = @{@"title": @"First Project", @"description": description};
+
+                [_restClient POST:@"projects" parameters:project success:^(NSURLSessionDataTask *task, id responseObject) {
+                    NSData *body = task.originalRequest.HTTPBody;
+                    const uint8_t *bytes = [body bytes];
+
+                    [[task.originalRequest.allHTTPHeaderFields[@"Content-Encoding"] should] equal:@"gzip"];
+                    [[theValue([body length]) should] beLessThan:theValue(4096)];
+                    // the gzip magic number
+                    [[theValue(bytes[0] == 0x1f && bytes[1] == 0x8b) should] beYes];
+
+                    finishedFlag = YES;
+                } failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    // nope
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            });
+
+            it(@"should not compress small bodies", ^{
+                [_restClient POST:@"projects" parameters:@{@"title": @"First Project"} success:^(NSURLSessionDataTask *task, id responseObject) {
+                    [task.originalRequest.allHTTPHeaderFields[@"Content-Encoding"] shouldBeNil];
+
+                    finishedFlag = YES;
+                } failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    // nope
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            });
+
+            it(@"should stream the compression of large multipart uploads", ^{
+                NSData *data = [[@"" stringByPaddingToLength:4096 withString:@"lorem ipsum " startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+                AGFileDataPart *part = [[AGFileDataPart alloc] initWithFileData:data name:@"file" fileName:@"file.txt" mimeType:@"text/plain"];
+
+                [_restClient POST:@"projects" parameters:@{@"file": part} success:^(NSURLSessionDataTask *task, id responseObject) {
+                    [[task.originalRequest.allHTTPHeaderFields[@"Content-Encoding"] should] equal:@"gzip"];
+                    // the compressed length is unknown upfront
+                    [task.originalRequest.allHTTPHeaderFields[@"Content-Length"] shouldBeNil];
+
+                    finishedFlag = YES;
+                } failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    // nope
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            });
+        });
+
+        context(@"when exchanging a binary format", ^{
+
+            __block AGHttpClient* _restClient = nil;
+
+            NSDictionary * const PROJECT = @{@"id": @1, @"title": @"First Project"};
+
+            beforeEach(^{
+                NSURL* baseURL = [NSURL URLWithString:@"http://server.com/context/"];
+
+                _restClient = [AGHttpClient clientFor:baseURL];
+                _restClient.serializer = [AGMessagePackSerializer serializer];
+            });
+
+            afterEach(^{
+                // remove all handlers installed by test methods
+                // to avoid any interference
+                [AGHTTPMockHelper clearAllMockedRequests];
+
+                finishedFlag = NO;
+            });
+
+            it(@"should serialize the bodies and prefer the format for the responses", ^{
+                [AGHTTPMockHelper mockResponse:[[AGMessagePackSerializer serializer] dataWithObject:PROJECT error:nil]
+                                       headers:@{@"Content-Type": @"application/x-msgpack"}];
+
+                [_restClient POST:@"projects" parameters:PROJECT success:^(NSURLSessionDataTask *task, id responseObject) {
+                    NSDictionary *headers = task.originalRequest.allHTTPHeaderFields;
+
+                    [[headers[@"Content-Type"] should] equal:@"application/x-msgpack"];
+                    [[headers[@"Accept"] should] startWithString:@"application/x-msgpack"];
+                    [[task.originalRequest.HTTPBody should] equal:[[AGMessagePackSerializer serializer] dataWithObject:PROJECT error:nil]];
+                    [[responseObject should] equal:PROJECT];
+
+                    finishedFlag = YES;
+                } failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    // nope
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            });
+
+            it(@"should fall back to JSON responses", ^{
+                [AGHTTPMockHelper mockResponse:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]
+                                       headers:@{@"Content-Type": @"application/json"}];
+
+                [_restClient GET:@"projects" parameters:nil success:^(NSURLSessionDataTask *task, id responseObject) {
+                    [[theValue([responseObject count]) should] equal:theValue(2)];
+
+                    finishedFlag = YES;
+                } failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    // nope
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            });
+
+            it(@"should deliver the records of streamed reads in the format", ^{
+                NSArray *projects = @[PROJECT, PROJECT, PROJECT];
+                NSMutableArray *records = [NSMutableArray array];
+
+                [AGHTTPMockHelper mockResponse:[[AGMessagePackSerializer serializer] dataWithObject:projects error:nil]
+                                       headers:@{@"Content-Type": @"application/x-msgpack"}];
+
+                [_restClient GET:@"projects" parameters:nil batchSize:2 records:^(NSArray *batch) {
+                    [records addObjectsFromArray:batch];
+                } success:^(NSURLSessionDataTask *task) {
+                    [[records should] equal:projects];
+
+                    finishedFlag = YES;
+                } failure:^(NSURLSessionDataTask *task, NSError *error) {
+                    // nope
+                }];
+
+                [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            });
+        });
+
         context(@"should honour authentication headers", ^{
 
             __block AGHttpClient* _restClient = nil;
@@ -0,0 +1,149 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGJsonArrayParser.h"
+
+SPEC_BEGIN(AGJsonArrayParserSpec)
+
+describe(@"AGJsonArrayParser", ^{
+
+    // records with strings holding structural characters and escapes, and nested values
+    NSString * const DOCUMENT = @"[ {\"title\": \"a ] , { [ \\\" } string\", \"path\": \"C:\\\\\", \"tags\": [\"x\", [1, 2], {\"y\": []}]},"
+                                 "\n  \"\\u00e9t\\u00e9\", 42 , true,null, [[], {}]\n]";
+
+    NSArray * const RECORDS = @[@{@"title": @"a ] , { [ \" } string", @"path": @"C:\\", @"tags": @[@"x", @[@1, @2], @{@"y": @[]}]},
+                                @"\u00e9t\u00e9", @42, @YES, [NSNull null], @[@[], @{}]];
+
+    // parses the document, pushed in chunks of the given size
+    NSArray *(^parse)(NSString *, NSUInteger, NSError **) = ^NSArray *(NSString *document, NSUInteger chunkSize, NSError **error) {
+        NSMutableArray *records = [NSMutableArray array];
+
+        AGJsonArrayParser *parser = [[AGJsonArrayParser alloc] initWithOptions:0 recordBlock:^(id record, BOOL *stop) {
+            [records addObject:record];
+        }];
+
+        NSData *data = [document dataUsingEncoding:NSUTF8StringEncoding];
+
+        for (NSUInteger offset = 0; offset < [data length]; offset += chunkSize) {
+            NSData *chunk = [data subdataWithRange:NSMakeRange(offset, MIN(chunkSize, [data length] - offset))];
+
+            if (![parser appendData:chunk error:error])
+                return nil;
+        }
+
+        return [parser finish:error] ? records : nil;
+    };
+
+    context(@"when parsing an array", ^{
+
+        it(@"should deliver each record", ^{
+            NSError *error;
+
+            [[parse(DOCUMENT, 4096, &error) should] equal:RECORDS];
+            [error shouldBeNil];
+        });
+
+        it(@"should deliver each record whatever the chunk boundaries", ^{
+            NSUInteger length = [[DOCUMENT dataUsingEncoding:NSUTF8StringEncoding] length];
+
+            // boundaries fall inside strings, escapes and nested values
+            for (NSUInteger chunkSize = 1; chunkSize <= length; chunkSize++) {
+                NSError *error;
+
+                [[parse(DOCUMENT, chunkSize, &error) should] equal:RECORDS];
+                [error shouldBeNil];
+            }
+        });
+
+        it(@"should deliver no record for an empty array", ^{
+            [[parse(@" [ ] ", 1, NULL) should] beEmpty];
+        });
+
+        it(@"should stop when asked to", ^{
+            NSMutableArray *records = [NSMutableArray array];
+
+            AGJsonArrayParser *parser = [[AGJsonArrayParser alloc] initWithOptions:0 recordBlock:^(id record, BOOL *stop) {
+                [records addObject:record];
+                *stop = [records count] == 2;
+            }];
+
+            [[theValue([parser appendData:[DOCUMENT dataUsingEncoding:NSUTF8StringEncoding] error:nil]) should] beYes];
+            [[theValue([parser finish:nil]) should] beYes];
+
+            [[theValue(parser.isStopped) should] beYes];
+            [[records should] equal:[RECORDS subarrayWithRange:NSMakeRange(0, 2)]];
+        });
+    });
+
+    context(@"when parsing a document that is not an array", ^{
+
+        it(@"should deliver it as a single record once finished", ^{
+            [[parse(@"{\"id\": [1, 2]}", 3, NULL) should] equal:@[@{@"id": @[@1, @2]}]];
+        });
+    });
+
+    context(@"when parsing malformed input", ^{
+
+        // asserts that the document fails to parse, with an error of the parser
+        void (^shouldFail)(NSString *) = ^(NSString *document) {
+            for (NSUInteger chunkSize = 1; chunkSize <= 2; chunkSize++) {
+                NSError *error;
+
+                [parse(document, chunkSize, &error) shouldBeNil];
+                [[error.domain should] equal:AGJsonArrayParserErrorDomain];
+                [[theValue(error.code) should] equal:theValue(0)];
+            }
+        };
+
+        it(@"should fail on a missing separator", ^{
+            shouldFail(@"[1 2]");
+        });
+
+        it(@"should fail on a malformed record", ^{
+            shouldFail(@"[{\"id\": }]");
+            shouldFail(@"[{\"id\": 1]}");
+        });
+
+        it(@"should fail on a missing record", ^{
+            shouldFail(@"[1, ]");
+            shouldFail(@"[, 1]");
+        });
+
+        it(@"should fail on a truncated array", ^{
+            shouldFail(@"[1, {\"tags\": [\"x\"");
+            shouldFail(@"[\"unterminated");
+        });
+
+        it(@"should fail on garbage after the array", ^{
+            shouldFail(@"[1] 2");
+        });
+
+        it(@"should fail on a malformed document", ^{
+            shouldFail(@"{\"id\": ");
+        });
+
+        it(@"should hold the error of the JSON parser", ^{
+            NSError *error;
+
+            [parse(@"[{\"id\": }]", 64, &error) shouldBeNil];
+            [[error.userInfo[NSUnderlyingErrorKey] shouldNot] beNil];
+        });
+    });
+});
+
+SPEC_END
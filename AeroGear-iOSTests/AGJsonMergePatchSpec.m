@@ -0,0 +1,98 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGJsonMergePatch.h"
+
+SPEC_BEGIN(AGJsonMergePatchSpec)
+
+describe(@"AGJsonMergePatch", ^{
+
+    NSDictionary * const PROJECT = @{@"id": @1,
+                                     @"title": @"First Project",
+                                     @"style": @"project-161-58-58",
+                                     @"owner": @{@"name": @"John", @"email": @"john@doe.com"}};
+
+    context(@"when computing a patch", ^{
+
+        it(@"should be empty for equal objects", ^{
+            NSDictionary *patch = [AGJsonMergePatch patchFromObject:PROJECT toObject:[PROJECT copy]];
+
+            [[theValue([patch count]) should] equal:theValue(0)];
+        });
+
+        it(@"should only hold the changed members", ^{
+            NSMutableDictionary *project = [PROJECT mutableCopy];
+            project[@"title"] = @"Renamed Project";
+
+            NSDictionary *patch = [AGJsonMergePatch patchFromObject:PROJECT toObject:project];
+
+            [[patch should] equal:@{@"title": @"Renamed Project"}];
+        });
+
+        it(@"should null the removed members", ^{
+            NSMutableDictionary *project = [PROJECT mutableCopy];
+            [project removeObjectForKey:@"style"];
+
+            NSDictionary *patch = [AGJsonMergePatch patchFromObject:PROJECT toObject:project];
+
+            [[patch should] equal:@{@"style": [NSNull null]}];
+        });
+
+        it(@"should only hold the changes of nested objects", ^{
+            NSMutableDictionary *project = [PROJECT mutableCopy];
+            project[@"owner"] = @{@"name": @"Jane", @"email": @"john@doe.com"};
+
+            NSDictionary *patch = [AGJsonMergePatch patchFromObject:PROJECT toObject:project];
+
+            [[patch should] equal:@{@"owner": @{@"name": @"Jane"}}];
+        });
+
+        it(@"should not express members set to null", ^{
+            NSMutableDictionary *project = [PROJECT mutableCopy];
+            project[@"title"] = [NSNull null];
+
+            [[AGJsonMergePatch patchFromObject:PROJECT toObject:project] shouldBeNil];
+        });
+
+        it(@"should not express nested members set to null", ^{
+            NSMutableDictionary *project = [PROJECT mutableCopy];
+            project[@"owner"] = @{@"name": [NSNull null], @"email": @"john@doe.com"};
+
+            [[AGJsonMergePatch patchFromObject:PROJECT toObject:project] shouldBeNil];
+        });
+    });
+
+    context(@"when applying a patch", ^{
+
+        it(@"should turn the object into the patched one", ^{
+            NSDictionary *project = @{@"id": @1,
+                                      @"title": @"Renamed Project",
+                                      @"owner": @{@"name": @"Jane", @"email": @"jane@doe.com"}};
+
+            NSDictionary *patch = [AGJsonMergePatch patchFromObject:PROJECT toObject:project];
+
+            [[[AGJsonMergePatch applyPatch:patch toObject:PROJECT] should] equal:project];
+        });
+
+        it(@"should replace the object with a patch that is not an object", ^{
+            [[[AGJsonMergePatch applyPatch:@[@1, @2] toObject:PROJECT] should] equal:@[@1, @2]];
+        });
+    });
+});
+
+SPEC_END
@@ -16,8 +16,12 @@
  */
 
 #import <Kiwi/Kiwi.h>
+#import <UIKit/UIKit.h>
 #import "AGKeyManager.h"
 #import "AGKeyStoreCryptoConfig.h"
+#import "AGPassphraseCryptoConfig.h"
+#import "AGPassphraseEncryptionServices.h"
+#import <AGRandomGenerator.h>
 
 SPEC_BEGIN(AGKeyManagerSpec)
 
@@ -88,6 +92,124 @@ describe(@"AGKeyManagerSpec", ^{
             [(id)service shouldNotBeNil];
         });
     });
+    
+    context(@"when deriving keys from a passphrase", ^{
+        
+        __block AGKeyManager *keyServices = nil;
+        __block AGPassphraseCryptoConfig *config = nil;
+        
+        beforeEach(^{
+            keyServices = [AGKeyManager manager];
+            
+            config = [[AGPassphraseCryptoConfig alloc] init];
+            [config setSalt:[AGRandomGenerator randomBytes]];
+            [config setPassphrase:@"passphrase"];
+        });
+        
+        afterEach(^{
+            [AGKeyManager clearDerivedKeys];
+        });
+        
+        it(@"should return services sharing the same key for the same config", ^{
+            id<AGEncryptionService> service = [keyServices keyService:config];
+            id<AGEncryptionService> other = [[AGKeyManager manager] keyService:config];
+            
+            NSData *data = [@"secret" dataUsingEncoding:NSUTF8StringEncoding];
+            
+            [[[other decrypt:[service encrypt:data]] should] equal:data];
+        });
+        
+        it(@"should return services with different keys for a different salt", ^{
+            id<AGEncryptionService> service = [keyServices keyService:config];
+            
+            [config setSalt:[AGRandomGenerator randomBytes]];
+            id<AGEncryptionService> other = [keyServices keyService:config];
+            
+            NSData *data = [@"secret" dataUsingEncoding:NSUTF8StringEncoding];
+            
+            [[[other decrypt:[service encrypt:data]] shouldNot] equal:data];
+        });
+        
+        it(@"should derive the key asynchronously", ^{
+            __block id<AGEncryptionService> service = nil;
+            __block BOOL onMainThread = NO;
+            
+            [keyServices keyService:config completion:^(id<AGEncryptionService> keyService) {
+                onMainThread = [NSThread isMainThread];
+                service = keyService;
+            }];
+            
+            [[expectFutureValue(service) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+            [[theValue(onMainThread) should] beYes];
+            [(id)[keyServices keyServiceWithName:config.name] shouldNotBeNil];
+        });
+        
+        it(@"should return services with different keys for different iterations", ^{
+            id<AGEncryptionService> service = [keyServices keyService:config];
+            
+            [config setIterations:20000];
+            id<AGEncryptionService> other = [keyServices keyService:config];
+            
+            NSData *data = [@"secret" dataUsingEncoding:NSUTF8StringEncoding];
+            
+            [[[other decrypt:[service encrypt:data]] shouldNot] equal:data];
+        });
+        
+        it(@"should derive the key again after a memory warning", ^{
+            [keyServices keyService:config];
+            
+            [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidReceiveMemoryWarningNotification
+                                                                object:nil];
+            
+            [[AGPassphraseEncryptionServices should] receive:@selector(deriveKeyWithConfig:)
+                                                   andReturn:[AGRandomGenerator randomBytes:32]];
+            
+            [keyServices keyService:config];
+        });
+    });
+    
+    context(@"when calibrating the key derivation", ^{
+        
+        afterEach(^{
+            [AGKeyManager clearDerivedKeys];
+        });
+        
+        it(@"should never return fewer iterations than the minimum", ^{
+            NSUInteger iterations = [AGPassphraseEncryptionServices iterationsForDuration:0];
+            
+            [[theValue(iterations) should] beGreaterThanOrEqualTo:theValue(10000)];
+        });
+        
+        it(@"should return more iterations for a longer duration", ^{
+            NSUInteger shorter = [AGPassphraseEncryptionServices iterationsForDuration:0.05];
+            NSUInteger longer = [AGPassphraseEncryptionServices iterationsForDuration:0.2];
+            
+            [[theValue(longer) should] beGreaterThan:theValue(shorter)];
+        });
+        
+        it(@"should restore the same key from the stored derivation parameters", ^{
+            AGPassphraseCryptoConfig *config = [[AGPassphraseCryptoConfig alloc] init];
+            [config setSalt:[AGRandomGenerator randomBytes]];
+            [config setPassphrase:@"passphrase"];
+            [config setIterations:[AGPassphraseEncryptionServices iterationsForDuration:0.05]];
+            
+            NSDictionary *parameters = config.derivationParameters;
+            
+            AGPassphraseCryptoConfig *restored = [[AGPassphraseCryptoConfig alloc] init];
+            [restored setPassphrase:@"passphrase"];
+            [restored setDerivationParameters:parameters];
+            
+            [[restored.salt should] equal:config.salt];
+            [[theValue(restored.iterations) should] equal:theValue(config.iterations)];
+            
+            id<AGEncryptionService> service = [[AGPassphraseEncryptionServices alloc] initWithConfig:config];
+            id<AGEncryptionService> other = [[AGPassphraseEncryptionServices alloc] initWithConfig:restored];
+            
+            NSData *data = [@"secret" dataUsingEncoding:NSUTF8StringEncoding];
+            
+            [[[other decrypt:[service encrypt:data]] should] equal:data];
+        });
+    });
 });
 
 SPEC_END
\ No newline at end of file
@@ -0,0 +1,199 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGKeyRotation.h"
+#import "AGEncryptedSQLiteStorage.h"
+#import "AGEncryptedMemoryStorage.h"
+#import "AGPassphraseEncryptionServices.h"
+#import "AGRandomGenerator.h"
+
+SPEC_BEGIN(AGKeyRotationSpec)
+
+describe(@"AGKeyRotation", ^{
+
+    __block AGPassphraseEncryptionServices *oldService = nil;
+    __block AGPassphraseEncryptionServices *newService = nil;
+
+    beforeEach(^{
+        AGPassphraseCryptoConfig *cryptoConfig = [[AGPassphraseCryptoConfig alloc] init];
+        cryptoConfig.passphrase = @"PASSPHRASE";
+        cryptoConfig.salt = [AGRandomGenerator randomBytes];
+        oldService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+
+        cryptoConfig.salt = [AGRandomGenerator randomBytes];
+        newService = [[AGPassphraseEncryptionServices alloc] initWithConfig:cryptoConfig];
+    });
+
+    context(@"when rotating the key of an encrypted SQLite store", ^{
+
+        __block AGStoreConfiguration *config = nil;
+        __block AGEncryptedSQLiteStorage *sqliteStorage = nil;
+
+        beforeEach(^{
+            config = [[AGStoreConfiguration alloc] init];
+            [config setName:@"RotatedUsers"];
+            [config setEncryptionService:oldService];
+            [config setIndexedFields:@[@"name"]];
+
+            // saved before keys were versioned
+            [[AGEncryptedSQLiteStorage storeWithConfig:config] save:@[[@{@"name" : @"Robert", @"city" : @"Boston"} mutableCopy],
+                                                                      [@{@"name" : @"David", @"city" : @"Boston"} mutableCopy],
+                                                                      [@{@"name" : @"Robert", @"city" : @"New York"} mutableCopy]] error:nil];
+
+            [config setEncryptionService:newService];
+            [config setKeyVersion:1];
+            [config setPreviousEncryptionServices:@{@0: oldService}];
+
+            sqliteStorage = [AGEncryptedSQLiteStorage storeWithConfig:config];
+        });
+
+        afterEach(^{
+            [sqliteStorage reset:nil];
+        });
+
+        it(@"should read and filter the records of both keys", ^{
+            [sqliteStorage save:[@{@"name" : @"Robert", @"city" : @"Chicago"} mutableCopy] error:nil];
+
+            [[[sqliteStorage readAll] should] haveCountOf:4];
+            [[[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:3];
+            [[[sqliteStorage recordsEncryptedWithPreviousKeys:10 cursor:NULL] should] haveCountOf:3];
+        });
+
+        it(@"should re-encrypt the records with the current key", ^{
+            AGKeyRotation *rotation = [[AGKeyRotation alloc] initWithStore:sqliteStorage];
+            rotation.batchSize = 2;
+
+            __block BOOL finished = NO;
+            __block NSError *rotationError = nil;
+
+            [rotation start:^(NSError *error) {
+                rotationError = error;
+                finished = YES;
+            }];
+
+            [[expectFutureValue(theValue(finished)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            [rotationError shouldBeNil];
+            [[theValue(rotation.rotatedCount) should] equal:theValue(3)];
+            [[[sqliteStorage recordsEncryptedWithPreviousKeys:10 cursor:NULL] should] beEmpty];
+
+            // the previous key is no longer needed
+            [config setPreviousEncryptionServices:nil];
+            sqliteStorage = [AGEncryptedSQLiteStorage storeWithConfig:config];
+
+            [[[sqliteStorage readAll] should] haveCountOf:3];
+            [[[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'Robert'"]] should] haveCountOf:2];
+        });
+
+        it(@"should leave the records saved in the meantime alone", ^{
+            NSDictionary *records = [sqliteStorage recordsEncryptedWithPreviousKeys:10 cursor:NULL];
+            NSDictionary *reencryptedRecords = [sqliteStorage reencryptRecords:records tokens:nil error:nil];
+
+            NSMutableDictionary *user = [[sqliteStorage filter:[NSPredicate predicateWithFormat:@"name == 'David'"]][0] mutableCopy];
+            user[@"city"] = @"Seattle";
+            [sqliteStorage save:user error:nil];
+
+            BOOL success = [sqliteStorage replaceRecords:records withReencryptedRecords:reencryptedRecords tokens:nil error:nil];
+
+            [[theValue(success) should] beYes];
+            [[[sqliteStorage read:user[@"id"]][@"city"] should] equal:@"Seattle"];
+            [[[sqliteStorage recordsEncryptedWithPreviousKeys:10 cursor:NULL] should] beEmpty];
+        });
+    });
+
+    context(@"when rotating the key of an encrypted memory store", ^{
+
+        __block AGEncryptedMemoryStorage *memoryStorage = nil;
+        __block NSMutableDictionary *data = nil;
+
+        beforeEach(^{
+            AGStoreConfiguration *config = [[AGStoreConfiguration alloc] init];
+            [config setEncryptionService:oldService];
+            [config setKeyVersion:1];
+
+            // the encrypted records of the previous key
+            data = [NSMutableDictionary dictionary];
+            AGEncryptedMemoryStorage *previousStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+
+            for (NSUInteger i = 0; i < 5; i++)
+                [previousStorage save:[@{@"name" : [NSString stringWithFormat:@"user%lu", (unsigned long)i]} mutableCopy] error:nil];
+
+            [config setEncryptionService:newService];
+            [config setKeyVersion:2];
+            [config setPreviousEncryptionServices:@{@1: oldService}];
+
+            memoryStorage = [[AGEncryptedMemoryStorage alloc] initWithConfig:config data:data tokens:nil];
+        });
+
+        it(@"should re-encrypt the records in batches", ^{
+            AGKeyRotation *rotation = [[AGKeyRotation alloc] initWithStore:memoryStorage];
+            rotation.batchSize = 1;
+
+            __block BOOL finished = NO;
+
+            [rotation start:^(NSError *error) {
+                finished = (error == nil);
+            }];
+
+            [[theValue(rotation.isRunning) should] beYes];
+            [[expectFutureValue(theValue(finished)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            [[theValue(rotation.isRunning) should] beNo];
+            [[theValue(rotation.rotatedCount) should] equal:theValue(5)];
+            [[[memoryStorage readAll] should] haveCountOf:5];
+        });
+
+        it(@"should skip and report the records that can't be decrypted", ^{
+            NSString *recordId = [[data allKeys] firstObject];
+
+            NSMutableData *corrupted = [data[recordId] mutableCopy];
+            ((uint8_t *)[corrupted mutableBytes])[[corrupted length] - 1] ^= 1;
+            data[recordId] = corrupted;
+
+            AGKeyRotation *rotation = [[AGKeyRotation alloc] initWithStore:memoryStorage];
+            rotation.batchSize = 2;
+
+            __block NSError *rotationError = nil;
+
+            [rotation start:^(NSError *error) {
+                rotationError = error;
+            }];
+
+            [[expectFutureValue(rotationError) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+            [[rotationError.userInfo[AGKeyRotationFailedRecordIdsKey] should] equal:@[recordId]];
+            [[rotation.failedRecordIds should] equal:@[recordId]];
+            [[theValue(rotation.rotatedCount) should] equal:theValue(4)];
+            [[[memoryStorage recordsEncryptedWithPreviousKeys:10 cursor:NULL] should] haveCountOf:1];
+        });
+
+        it(@"should stop when cancelled", ^{
+            AGKeyRotation *rotation = [[AGKeyRotation alloc] initWithStore:memoryStorage];
+            rotation.batchSize = 1;
+
+            __block NSError *rotationError = nil;
+
+            [rotation start:^(NSError *error) {
+                rotationError = error;
+            }];
+            [rotation cancel];
+
+            [[expectFutureValue(rotationError) shouldEventuallyBeforeTimingOutAfter(5)] beNonNil];
+            [[theValue(rotation.rotatedCount) should] beLessThan:theValue(5)];
+        });
+    });
+});
+
+SPEC_END
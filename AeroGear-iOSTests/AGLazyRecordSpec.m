@@ -0,0 +1,84 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGLazyRecord.h"
+#import "AGEncoder.h"
+
+SPEC_BEGIN(AGLazyRecordSpec)
+
+describe(@"AGLazyRecord", ^{
+
+    context(@"when created from an encoded record", ^{
+
+        __block AGPListEncoder *encoder = nil;
+        __block AGLazyRecord *record = nil;
+
+        beforeEach(^{
+            encoder = [[AGPListEncoder alloc] initWithFormat:NSPropertyListBinaryFormat_v1_0];
+
+            NSData *data = [encoder encode:@{@"id" : @"1", @"name" : @"Robert", @"city" : @"Boston"} error:nil];
+
+            record = [[AGLazyRecord alloc] initWithData:data encoder:encoder recordId:@"1" identifier:@"id"];
+        });
+
+        it(@"should not decode when only the id is accessed", ^{
+            [[record[@"id"] should] equal:@"1"];
+            [[theValue(record.isDecoded) should] beNo];
+        });
+
+        it(@"should decode when a field is accessed", ^{
+            [[record[@"name"] should] equal:@"Robert"];
+            [[theValue(record.isDecoded) should] beYes];
+
+            [[theValue([record count]) should] equal:theValue(3)];
+        });
+
+        it(@"should be equal to the decoded dictionary", ^{
+            [[record should] equal:@{@"id" : @"1", @"name" : @"Robert", @"city" : @"Boston"}];
+        });
+
+        it(@"should allow mutation", ^{
+            record[@"name"] = @"David";
+            [record removeObjectForKey:@"city"];
+
+            [[record[@"name"] should] equal:@"David"];
+            [record[@"city"] shouldBeNil];
+            [[theValue([record count]) should] equal:theValue(2)];
+        });
+
+        it(@"should be encodable again", ^{
+            NSData *data = [encoder encode:record error:nil];
+
+            [[[encoder decode:data error:nil] should] equal:record];
+        });
+    });
+
+    context(@"when the id is not part of the encoded record", ^{
+
+        it(@"should add the id to the decoded fields", ^{
+            AGPListEncoder *encoder = [[AGPListEncoder alloc] init];
+            NSData *data = [encoder encode:@{@"name" : @"Robert"} error:nil];
+
+            AGLazyRecord *record = [[AGLazyRecord alloc] initWithData:data encoder:encoder recordId:@"7" identifier:@"id"];
+
+            [[record should] equal:@{@"id" : @"7", @"name" : @"Robert"}];
+        });
+    });
+});
+
+SPEC_END
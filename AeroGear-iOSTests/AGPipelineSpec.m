@@ -19,6 +19,7 @@
 #import "AGPipeline.h"
 #import "AGPipe.h"
 #import "AGAuthenticator.h"
+#import "AGHTTPMockHelper.h"
 
 SPEC_BEGIN(AGPipelineSpec)
 
@@ -35,6 +36,19 @@ describe(@"AGPipeline", ^{
             [pipeline shouldNotBeNil];
         });
 
+        it(@"should have a scheduler shared by its pipes", ^{
+            [pipeline.scheduler shouldNotBeNil];
+
+            __block AGRequestScheduler *scheduler = nil;
+
+            [pipeline pipe:^(id<AGPipeConfig> config) {
+                [config setName:@"tests"];
+                scheduler = config.scheduler;
+            }];
+
+            [[scheduler should] beIdenticalTo:pipeline.scheduler];
+        });
+
         it(@"AGPipe should have an expected URL", ^{
 
             [pipeline pipe:^(id<AGPipeConfig> config) {
@@ -190,6 +204,138 @@ describe(@"AGPipeline", ^{
             [(id)pipe shouldNotBeNil];
         });
     });
+
+    context(@"when batching operations", ^{
+
+        __block AGPipeline *pipeline = nil;
+        __block BOOL finishedFlag = NO;
+
+        beforeEach(^{
+            pipeline = [AGPipeline pipelineWithBaseURL:[NSURL URLWithString:@"http://server.com/"]];
+
+            [pipeline pipe:^(id<AGPipeConfig> config) {
+                [config setName:@"projects"];
+            }];
+
+            [pipeline pipe:^(id<AGPipeConfig> config) {
+                [config setName:@"tasks"];
+            }];
+        });
+
+        afterEach(^{
+            // remove all handlers installed by test methods
+            // to avoid any interference
+            [AGHTTPMockHelper clearAllMockedRequests];
+
+            finishedFlag = NO;
+        });
+
+        it(@"should hand the responses back to the operations", ^{
+            __block NSUInteger requestCount = 0;
+            __block NSString *path = nil;
+
+            NSString *responses = @"{\"responses\": [{\"id\": \"1\", \"status\": 400, \"body\": null},"
+                                   "{\"id\": \"0\", \"status\": 200, \"body\": [{\"id\": 1, \"title\": \"First Project\"}]}]}";
+
+            [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                return YES;
+            } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                requestCount++;
+                path = request.URL.path;
+
+                return [OHHTTPStubsResponse responseWithData:[responses dataUsingEncoding:NSUTF8StringEncoding]
+                                                  statusCode:200
+                                                     headers:@{@"Content-Type": @"application/json"}];
+            }];
+
+            AGBatchRequest *batch = [pipeline batch];
+
+            __block id projects = nil;
+            __block NSError *saveError = nil;
+            __block NSError *removeError = nil;
+
+            [batch readWithParams:nil pipe:@"projects" success:^(id responseObject) {
+                projects = responseObject;
+            } failure:nil];
+
+            [batch save:@{@"id": @3, @"title": @"Task"} pipe:@"tasks" success:nil failure:^(NSError *error) {
+                saveError = error;
+            }];
+
+            [batch remove:@{@"id": @4} pipe:@"tasks" success:nil failure:^(NSError *error) {
+                removeError = error;
+            }];
+
+            [[theValue(batch.count) should] equal:theValue(3)];
+
+            [batch send:^(NSError *error) {
+                [error shouldBeNil];
+                finishedFlag = YES;
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+
+            [[theValue(requestCount) should] equal:theValue(1)];
+            [[path should] equal:@"/batch"];
+
+            [[theValue([projects count]) should] equal:theValue(1)];
+            [[saveError.userInfo[AGBatchStatusCodeKey] should] equal:@400];
+            // no response for it
+            [removeError shouldNotBeNil];
+        });
+
+        it(@"should fail all operations when the batch request fails", ^{
+            [AGHTTPMockHelper mockResponseStatus:500];
+
+            AGBatchRequest *batch = [pipeline batch];
+
+            __block NSUInteger failures = 0;
+
+            [batch read:@1 pipe:@"projects" success:nil failure:^(NSError *error) {
+                failures++;
+            }];
+
+            [batch read:@2 pipe:@"tasks" success:nil failure:^(NSError *error) {
+                failures++;
+            }];
+
+            [batch send:^(NSError *error) {
+                [error shouldNotBeNil];
+                finishedFlag = YES;
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+            [[theValue(failures) should] equal:theValue(2)];
+        });
+
+        it(@"should reject operations on unknown pipes", ^{
+            __block NSError *readError = nil;
+
+            [[pipeline batch] read:@1 pipe:@"unknown" success:nil failure:^(NSError *error) {
+                readError = error;
+            }];
+
+            [readError shouldNotBeNil];
+        });
+
+        it(@"should reject operations on pipes of another server", ^{
+            [pipeline pipe:^(id<AGPipeConfig> config) {
+                [config setName:@"elsewhere"];
+                [config setBaseURL:[NSURL URLWithString:@"https://other.com/"]];
+            }];
+
+            AGBatchRequest *batch = [pipeline batch];
+            __block NSError *readError = nil;
+
+            [batch read:@1 pipe:@"elsewhere" success:nil failure:^(NSError *error) {
+                readError = error;
+            }];
+
+            [readError shouldNotBeNil];
+            [[theValue(batch.count) should] equal:theValue(0)];
+        });
+    });
+
 });
 
 SPEC_END
\ No newline at end of file
@@ -424,6 +424,38 @@ describe(@"AGPropertyListStorage", ^{
             [[objects should] haveCountOf:1];
         });
         
+        it(@"should reload objects streamed to the file", ^{
+            NSArray *users = @[[@{@"id" : @"0", @"name" : @"Robert"} mutableCopy],
+                               [@{@"id" : @"1", @"name" : @"David"} mutableCopy],
+                               [@{@"id" : @"2", @"name" : @"Peter"} mutableCopy]];
+
+            BOOL success = [plistStore save:users error:nil];
+            [[theValue(success) should] equal:theValue(YES)];
+
+            // reload store
+            plistStore = [AGPropertyListStorage storeWithConfig:config];
+
+            [[[plistStore readAll] should] haveCountOf:3];
+            [[[plistStore read:@"1"][@"name"] should] equal:@"David"];
+        });
+
+        it(@"should load a file encoded as a single property list", ^{
+            NSArray *users = @[@{@"id" : @"0", @"name" : @"Robert"},
+                               @{@"id" : @"1", @"name" : @"David"}];
+
+            // write the file the way previous versions did
+            NSData *plist = [NSPropertyListSerialization dataWithPropertyList:users
+                                                                       format:NSPropertyListXMLFormat_v1_0
+                                                                      options:0 error:nil];
+            [plist writeToURL:[AGBaseStorage storeURLWithName:@"pliststore"] atomically:YES];
+
+            // reload store
+            plistStore = [AGPropertyListStorage storeWithConfig:config];
+
+            [[[plistStore readAll] should] haveCountOf:2];
+            [[[plistStore read:@"0"][@"name"] should] equal:@"Robert"];
+        });
+
         it(@"should perform filtering using an NSPredicate", ^{
             NSMutableDictionary *user1 = [@{@"id" : @"0",
                     @"name" : @"Robert",
@@ -0,0 +1,110 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGRecordCache.h"
+
+SPEC_BEGIN(AGRecordCacheSpec)
+
+describe(@"AGRecordCache", ^{
+
+    context(@"when newly created", ^{
+
+        __block AGRecordCache *cache = nil;
+
+        beforeEach(^{
+            cache = [[AGRecordCache alloc] initWithCapacity:100];
+        });
+
+        it(@"should be empty", ^{
+            [[theValue(cache.count) should] equal:theValue(0)];
+            [[theValue(cache.totalCost) should] equal:theValue(0)];
+            [[theValue(cache.hitRate) should] equal:theValue(0)];
+        });
+
+        it(@"should return a cached record", ^{
+            [cache setObject:@{@"name" : @"Robert"} forKey:@"1" cost:10];
+
+            [[[cache objectForKey:@"1"] should] equal:@{@"name" : @"Robert"}];
+            [[theValue(cache.totalCost) should] equal:theValue(10)];
+        });
+
+        it(@"should count hits and misses", ^{
+            [cache setObject:@{@"name" : @"Robert"} forKey:@"1" cost:10];
+
+            [cache objectForKey:@"1"];
+            [cache objectForKey:@"1"];
+            [cache objectForKey:@"1"];
+            [cache objectForKey:@"2"];
+
+            [[theValue(cache.hits) should] equal:theValue(3)];
+            [[theValue(cache.misses) should] equal:theValue(1)];
+            [[theValue(cache.hitRate) should] equal:theValue(0.75)];
+
+            [cache resetStatistics];
+
+            [[theValue(cache.hits) should] equal:theValue(0)];
+            [[theValue(cache.misses) should] equal:theValue(0)];
+        });
+
+        it(@"should evict the least recently used records when over budget", ^{
+            [cache setObject:@"first" forKey:@"1" cost:40];
+            [cache setObject:@"second" forKey:@"2" cost:40];
+
+            // make the first record the most recently used
+            [cache objectForKey:@"1"];
+
+            [cache setObject:@"third" forKey:@"3" cost:40];
+
+            [[[cache objectForKey:@"1"] should] equal:@"first"];
+            [[cache objectForKey:@"2"] shouldBeNil];
+            [[[cache objectForKey:@"3"] should] equal:@"third"];
+            [[theValue(cache.totalCost) should] equal:theValue(80)];
+        });
+
+        it(@"should not cache records larger than the capacity", ^{
+            [cache setObject:@"huge" forKey:@"1" cost:101];
+
+            [[cache objectForKey:@"1"] shouldBeNil];
+            [[theValue(cache.totalCost) should] equal:theValue(0)];
+        });
+
+        it(@"should replace a record cached under the same key", ^{
+            [cache setObject:@"first" forKey:@"1" cost:40];
+            [cache setObject:@"second" forKey:@"1" cost:20];
+
+            [[[cache objectForKey:@"1"] should] equal:@"second"];
+            [[theValue(cache.count) should] equal:theValue(1)];
+            [[theValue(cache.totalCost) should] equal:theValue(20)];
+        });
+
+        it(@"should remove records", ^{
+            [cache setObject:@"first" forKey:@"1" cost:40];
+            [cache setObject:@"second" forKey:@"2" cost:40];
+
+            [cache removeObjectForKey:@"1"];
+            [[cache objectForKey:@"1"] shouldBeNil];
+            [[theValue(cache.totalCost) should] equal:theValue(40)];
+
+            [cache removeAllObjects];
+            [[cache objectForKey:@"2"] shouldBeNil];
+            [[theValue(cache.totalCost) should] equal:theValue(0)];
+        });
+    });
+});
+
+SPEC_END
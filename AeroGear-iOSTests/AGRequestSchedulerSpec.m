@@ -0,0 +1,158 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGRequestScheduler.h"
+#import "AGHTTPMockHelper.h"
+
+SPEC_BEGIN(AGRequestSchedulerSpec)
+
+describe(@"AGRequestScheduler", ^{
+
+    context(@"when newly created", ^{
+
+        __block AGRequestScheduler *scheduler = nil;
+        __block NSMutableArray *tasks = nil;
+
+        // a suspended task, to the given host
+        NSURLSessionTask *(^taskTo)(NSString *) = ^(NSString *host) {
+            NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://%@/projects", host]];
+            NSURLSessionTask *task = [[NSURLSession sharedSession] dataTaskWithURL:url];
+
+            [tasks addObject:task];
+
+            return task;
+        };
+
+        BOOL (^isStarted)(NSURLSessionTask *) = ^BOOL(NSURLSessionTask *task) {
+            return task.state != NSURLSessionTaskStateSuspended;
+        };
+
+        beforeEach(^{
+            // keep the started requests running
+            [AGHTTPMockHelper mockResponse:[NSData data] status:200 requestTime:10];
+
+            scheduler = [AGRequestScheduler scheduler];
+            tasks = [NSMutableArray array];
+        });
+
+        afterEach(^{
+            for (NSURLSessionTask *task in tasks)
+                [task cancel];
+
+            // remove all handlers installed by test methods
+            // to avoid any interference
+            [AGHTTPMockHelper clearAllMockedRequests];
+        });
+
+        it(@"should start requests up to the concurrency limit", ^{
+            scheduler.maxConcurrentRequests = 2;
+
+            NSURLSessionTask *first = taskTo(@"server.com");
+            NSURLSessionTask *second = taskTo(@"other.com");
+            NSURLSessionTask *third = taskTo(@"another.com");
+
+            [scheduler scheduleTask:first priority:AGRequestPriorityDefault owner:self];
+            [scheduler scheduleTask:second priority:AGRequestPriorityDefault owner:self];
+            [scheduler scheduleTask:third priority:AGRequestPriorityDefault owner:self];
+
+            [[theValue(isStarted(first)) should] beYes];
+            [[theValue(isStarted(second)) should] beYes];
+            [[theValue(isStarted(third)) should] beNo];
+            [[theValue(scheduler.queuedCount) should] equal:theValue(1)];
+
+            [scheduler taskDidComplete:first];
+
+            [[theValue(isStarted(third)) should] beYes];
+            [[theValue(scheduler.runningCount) should] equal:theValue(2)];
+        });
+
+        it(@"should honour the per host limit", ^{
+            scheduler.maxConcurrentRequestsPerHost = 1;
+
+            NSURLSessionTask *first = taskTo(@"server.com");
+            NSURLSessionTask *second = taskTo(@"server.com");
+            NSURLSessionTask *other = taskTo(@"other.com");
+
+            [scheduler scheduleTask:first priority:AGRequestPriorityDefault owner:self];
+            [scheduler scheduleTask:second priority:AGRequestPriorityDefault owner:self];
+            [scheduler scheduleTask:other priority:AGRequestPriorityDefault owner:self];
+
+            [[theValue(isStarted(first)) should] beYes];
+            [[theValue(isStarted(second)) should] beNo];
+            [[theValue(isStarted(other)) should] beYes];
+        });
+
+        it(@"should start interactive requests ahead of background ones", ^{
+            scheduler.maxConcurrentRequests = 1;
+
+            NSURLSessionTask *sync = taskTo(@"server.com");
+            NSURLSessionTask *queuedSync = taskTo(@"server.com");
+            NSURLSessionTask *read = taskTo(@"server.com");
+
+            [scheduler scheduleTask:sync priority:AGRequestPriorityBackground owner:@"sync"];
+            [scheduler scheduleTask:queuedSync priority:AGRequestPriorityBackground owner:@"sync"];
+            [scheduler scheduleTask:read priority:AGRequestPriorityUserInteractive owner:@"read"];
+
+            [scheduler taskDidComplete:sync];
+
+            [[theValue(isStarted(read)) should] beYes];
+            [[theValue(isStarted(queuedSync)) should] beNo];
+        });
+
+        it(@"should let the owners take turns", ^{
+            scheduler.maxConcurrentRequests = 1;
+
+            NSString *bulk = @"bulk";
+            NSString *other = @"other";
+
+            NSURLSessionTask *running = taskTo(@"server.com");
+            NSURLSessionTask *bulk1 = taskTo(@"server.com");
+            NSURLSessionTask *bulk2 = taskTo(@"server.com");
+            NSURLSessionTask *other1 = taskTo(@"server.com");
+
+            [scheduler scheduleTask:running priority:AGRequestPriorityDefault owner:bulk];
+            [scheduler scheduleTask:bulk1 priority:AGRequestPriorityDefault owner:bulk];
+            [scheduler scheduleTask:bulk2 priority:AGRequestPriorityDefault owner:bulk];
+            [scheduler scheduleTask:other1 priority:AGRequestPriorityDefault owner:other];
+
+            [scheduler taskDidComplete:running];
+            [[theValue(isStarted(other1)) should] beYes];
+
+            [scheduler taskDidComplete:other1];
+            [[theValue(isStarted(bulk1)) should] beYes];
+            [[theValue(isStarted(bulk2)) should] beNo];
+        });
+
+        it(@"should forget the requests cancelled before they start", ^{
+            scheduler.maxConcurrentRequests = 1;
+
+            NSURLSessionTask *first = taskTo(@"server.com");
+            NSURLSessionTask *second = taskTo(@"server.com");
+
+            [scheduler scheduleTask:first priority:AGRequestPriorityDefault owner:self];
+            [scheduler scheduleTask:second priority:AGRequestPriorityDefault owner:self];
+
+            [scheduler taskDidComplete:second];
+
+            [[theValue(scheduler.queuedCount) should] equal:theValue(0)];
+            [[theValue(scheduler.runningCount) should] equal:theValue(1)];
+        });
+    });
+});
+
+SPEC_END
@@ -0,0 +1,120 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGResponseCache.h"
+#import "AGMemoryStorage.h"
+
+SPEC_BEGIN(AGResponseCacheSpec)
+
+describe(@"AGResponseCache", ^{
+
+    NSString * const kKey = @"GET http://server.com/context/projects";
+
+    context(@"when newly created", ^{
+
+        __block AGResponseCache *cache = nil;
+
+        beforeEach(^{
+            cache = [AGResponseCache cache];
+        });
+
+        it(@"should have no validators for an unknown request", ^{
+            [[cache validatorsForKey:kKey] shouldBeNil];
+            [[cache responseForKey:kKey headers:nil] shouldBeNil];
+        });
+
+        it(@"should return the validators of a cached response", ^{
+            [cache cacheResponse:@[@"project"] headers:@{@"Etag": @"\"v1\"", @"Last-Modified": @"Wed, 21 Oct 2015 07:28:00 GMT"} forKey:kKey];
+
+            NSDictionary *validators = [cache validatorsForKey:kKey];
+
+            [[validators[@"If-None-Match"] should] equal:@"\"v1\""];
+            [[validators[@"If-Modified-Since"] should] equal:@"Wed, 21 Oct 2015 07:28:00 GMT"];
+
+            NSDictionary *headers;
+            [[[cache responseForKey:kKey headers:&headers] should] equal:@[@"project"]];
+            [[headers[@"Etag"] should] equal:@"\"v1\""];
+        });
+
+        it(@"should not cache responses without validators", ^{
+            [cache cacheResponse:@[@"project"] headers:@{@"ETag": @"\"v1\""} forKey:kKey];
+            [cache cacheResponse:@[@"other"] headers:@{} forKey:kKey];
+
+            [[cache responseForKey:kKey headers:nil] shouldBeNil];
+        });
+
+        it(@"should not cache responses marked no-store", ^{
+            [cache cacheResponse:@[@"project"] headers:@{@"ETag": @"\"v1\"", @"Cache-Control": @"private, no-store"} forKey:kKey];
+
+            [[cache validatorsForKey:kKey] shouldBeNil];
+        });
+
+        it(@"should forget the least recently used responses over the limit", ^{
+            cache.maxEntries = 2;
+
+            [cache cacheResponse:@[@"first"] headers:@{@"ETag": @"\"v1\""} forKey:@"first"];
+            [cache cacheResponse:@[@"second"] headers:@{@"ETag": @"\"v1\""} forKey:@"second"];
+            // used since
+            [cache responseForKey:@"first" headers:nil];
+            [cache cacheResponse:@[@"third"] headers:@{@"ETag": @"\"v1\""} forKey:@"third"];
+
+            [[cache responseForKey:@"first" headers:nil] shouldNotBeNil];
+            [[cache responseForKey:@"second" headers:nil] shouldBeNil];
+            [[cache responseForKey:@"third" headers:nil] shouldNotBeNil];
+        });
+    });
+
+    context(@"when backed by a store", ^{
+
+        __block AGMemoryStorage *store = nil;
+
+        beforeEach(^{
+            store = [AGMemoryStorage storeWithConfig:[[AGStoreConfiguration alloc] init]];
+        });
+
+        it(@"should read the responses back from the store", ^{
+            [[AGResponseCache cacheWithStore:store] cacheResponse:@[@"project"] headers:@{@"ETag": @"\"v1\""} forKey:kKey];
+
+            AGResponseCache *cache = [AGResponseCache cacheWithStore:store];
+
+            [[[cache validatorsForKey:kKey][@"If-None-Match"] should] equal:@"\"v1\""];
+            [[[cache responseForKey:kKey headers:nil] should] equal:@[@"project"]];
+        });
+
+        it(@"should not save the keys of the requests", ^{
+            [[AGResponseCache cacheWithStore:store] cacheResponse:@[@"project"] headers:@{@"ETag": @"\"v1\""} forKey:kKey];
+
+            NSString *identifier = [store readAll][0][@"id"];
+
+            [[theValue([identifier length]) should] equal:theValue(64)];
+            [[theValue([identifier rangeOfString:@"server.com"].location) should] equal:theValue(NSNotFound)];
+        });
+
+        it(@"should forget the responses", ^{
+            AGResponseCache *cache = [AGResponseCache cacheWithStore:store];
+            [cache cacheResponse:@[@"project"] headers:@{@"ETag": @"\"v1\""} forKey:kKey];
+
+            [cache removeAllResponses];
+
+            [[cache responseForKey:kKey headers:nil] shouldBeNil];
+            [[theValue([store isEmpty]) should] beYes];
+        });
+    });
+});
+
+SPEC_END
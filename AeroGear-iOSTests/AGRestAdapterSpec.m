@@ -77,6 +77,45 @@ describe(@"AGRestAdapter", ^{
             [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
         });
 
+        it(@"should successfully read in batches", ^{
+            // install the mock:
+            [AGHTTPMockHelper mockResponse:[PROJECTS dataUsingEncoding:NSUTF8StringEncoding]];
+
+            NSMutableArray *batches = [NSMutableArray array];
+
+            [restPipe readWithParams:nil batchSize:1 records:^(NSArray *records) {
+                [batches addObject:records];
+            } success:^(id responseObject) {
+                // the records were delivered before
+                [[theValue([batches count]) should] equal:theValue(2)];
+                [[batches[0][0][@"title"] should] equal:@"First Project"];
+                [[batches[1][0][@"title"] should] equal:@"Second Project"];
+
+                finishedFlag = YES;
+
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should fail to read in batches a malformed response", ^{
+            // install the mock:
+            [AGHTTPMockHelper mockResponse:[@"[{\"id\":1}, {\"id\"" dataUsingEncoding:NSUTF8StringEncoding]];
+
+            [restPipe readWithParams:nil batchSize:0 records:^(NSArray *records) {
+                // nope
+            } success:^(id responseObject) {
+                // nope
+            } failure:^(NSError *error) {
+                [error shouldNotBeNil];
+                finishedFlag = YES;
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
         it(@"should successfully save (POST)", ^{
             [AGHTTPMockHelper mockResponse:[PROJECT dataUsingEncoding:NSUTF8StringEncoding]];
 
@@ -186,6 +225,301 @@ describe(@"AGRestAdapter", ^{
         });
     });
 
+    context(@"when saving and removing collections", ^{
+
+        NSArray * const OBJECTS = @[@{@"id": @1, @"title": @"First Project"},
+                                    @{@"id": @2, @"title": @"Second Project"},
+                                    @{@"id": @3, @"title": @"Third Project"}];
+
+        __block NSMutableArray *requests = nil;
+
+        // records the requests, answering with the status the block returns
+        __block void (^stubStatus)(int (^)(NSURLRequest *)) = nil;
+
+        AGRESTPipe *(^pipeWithBulkEndpoint)(NSString *) = ^(NSString *bulkEndpoint) {
+            AGPipeConfiguration* config = [[AGPipeConfiguration alloc] init];
+            [config setBaseURL:[NSURL URLWithString:@"http://server.com"]];
+            [config setName:@"projects"];
+            [config setBulkEndpoint:bulkEndpoint];
+            [config setBulkConcurrency:2];
+
+            return [AGRESTPipe pipeWithConfig:config];
+        };
+
+        beforeEach(^{
+            requests = [NSMutableArray array];
+
+            stubStatus = ^(int (^status)(NSURLRequest *)) {
+                [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                    return YES;
+                } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                    @synchronized(requests) {
+                        [requests addObject:request];
+                    }
+
+                    return [OHHTTPStubsResponse responseWithData:[PROJECT dataUsingEncoding:NSUTF8StringEncoding]
+                                                      statusCode:status(request)
+                                                         headers:@{@"Content-Type": @"application/json"}];
+                }];
+            };
+        });
+
+        afterEach(^{
+            // remove all handlers installed by test methods
+            // to avoid any interference
+            [AGHTTPMockHelper clearAllMockedRequests];
+
+            finishedFlag = NO;
+        });
+
+        it(@"should save the objects one by one without a bulk endpoint", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            [pipeWithBulkEndpoint(nil) saveAll:OBJECTS success:^(NSArray *responseObjects) {
+                [[theValue([responseObjects count]) should] equal:theValue(3)];
+                [[theValue([requests count]) should] equal:theValue(3)];
+                finishedFlag = YES;
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should save the objects in a single request with a bulk endpoint", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            [pipeWithBulkEndpoint(@"bulk") saveAll:OBJECTS success:^(NSArray *responseObjects) {
+                [[theValue([requests count]) should] equal:theValue(1)];
+
+                NSURLRequest *request = requests[0];
+                [[request.HTTPMethod should] equal:@"POST"];
+                [[request.URL.path should] equal:@"/projects/bulk"];
+                finishedFlag = YES;
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should remove the objects one by one if the bulk endpoint is not supported", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                // the bulk request lists the ids in the query
+                return [request.URL.query length] > 0 ? 405 : 200;
+            });
+
+            [pipeWithBulkEndpoint(@"") removeAll:OBJECTS success:^(NSArray *responseObjects) {
+                [[theValue([requests count]) should] equal:theValue(4)];
+                [[[requests[0] URL].query should] equal:@"id=1%2C2%2C3"];
+                finishedFlag = YES;
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should report the result of each object", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return [request.URL.path hasSuffix:@"/2"] ? 500 : 200;
+            });
+
+            [pipeWithBulkEndpoint(nil) saveAll:OBJECTS success:^(NSArray *responseObjects) {
+                // nope
+            } failure:^(NSError *error) {
+                NSArray *results = error.userInfo[AGPipeBulkResultsKey];
+
+                [[theValue([results count]) should] equal:theValue(3)];
+                [[results[0] shouldNot] beKindOfClass:[NSError class]];
+                [[results[1] should] beKindOfClass:[NSError class]];
+                [[results[2] shouldNot] beKindOfClass:[NSError class]];
+                finishedFlag = YES;
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+    });
+
+    context(@"when sending delta updates", ^{
+
+        __block AGRESTPipe *restPipe = nil;
+        __block NSMutableArray *methods = nil;
+
+        // records the methods of the requests, answering with the status the block returns
+        __block void (^stubStatus)(int (^)(NSURLRequest *)) = nil;
+
+        beforeEach(^{
+            AGPipeConfiguration* config = [[AGPipeConfiguration alloc] init];
+            [config setBaseURL:[NSURL URLWithString:@"http://server.com"]];
+            [config setName:@"projects"];
+            [config setPatchUpdates:YES];
+
+            restPipe = [AGRESTPipe pipeWithConfig:config];
+            methods = [NSMutableArray array];
+
+            stubStatus = ^(int (^status)(NSURLRequest *)) {
+                [OHHTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+                    return YES;
+                } withStubResponse:^OHHTTPStubsResponse*(NSURLRequest *request) {
+                    @synchronized(methods) {
+                        [methods addObject:request.HTTPMethod];
+                    }
+
+                    return [OHHTTPStubsResponse responseWithData:[PROJECT dataUsingEncoding:NSUTF8StringEncoding]
+                                                      statusCode:status(request)
+                                                         headers:@{@"Content-Type": @"application/json"}];
+                }];
+            };
+        });
+
+        afterEach(^{
+            // remove all handlers installed by test methods
+            // to avoid any interference
+            [AGHTTPMockHelper clearAllMockedRequests];
+
+            finishedFlag = NO;
+        });
+
+        it(@"should PATCH an object once its version is acknowledged", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            [restPipe read:@1 success:^(id responseObject) {
+                NSMutableDictionary *project = [responseObject mutableCopy];
+                project[@"title"] = @"Renamed Project";
+
+                [restPipe save:project success:^(id responseObject) {
+                    [[methods should] equal:@[@"GET", @"PATCH"]];
+                    finishedFlag = YES;
+                } failure:^(NSError *error) {
+                    // nope
+                }];
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should not send an unchanged object", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            [restPipe read:@1 success:^(id responseObject) {
+                [restPipe save:responseObject success:^(id responseObject) {
+                    [[methods should] equal:@[@"GET"]];
+                    finishedFlag = YES;
+                } failure:^(NSError *error) {
+                    // nope
+                }];
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should fall back to PUT if PATCH is not supported", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return [request.HTTPMethod isEqualToString:@"PATCH"] ? 405 : 200;
+            });
+
+            [restPipe read:@1 success:^(id responseObject) {
+                NSMutableDictionary *project = [responseObject mutableCopy];
+                project[@"title"] = @"Renamed Project";
+
+                [restPipe save:project success:^(id responseObject) {
+                    [[methods should] equal:@[@"GET", @"PATCH", @"PUT"]];
+                    finishedFlag = YES;
+                } failure:^(NSError *error) {
+                    // nope
+                }];
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should PUT an object whose changes set a member to null", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            [restPipe read:@1 success:^(id responseObject) {
+                NSMutableDictionary *project = [responseObject mutableCopy];
+                project[@"style"] = [NSNull null];
+
+                [restPipe save:project success:^(id responseObject) {
+                    [[methods should] equal:@[@"GET", @"PUT"]];
+                    finishedFlag = YES;
+                } failure:^(NSError *error) {
+                    // nope
+                }];
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should acknowledge the versions of the objects saved in bulk", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            NSMutableDictionary *project = [@{@"id": @1, @"title": @"First Project"} mutableCopy];
+
+            [restPipe saveAll:@[project] success:^(NSArray *responseObjects) {
+                project[@"title"] = @"Renamed Project";
+
+                [restPipe save:project success:^(id responseObject) {
+                    [[methods should] equal:@[@"POST", @"PATCH"]];
+                    finishedFlag = YES;
+                } failure:^(NSError *error) {
+                    // nope
+                }];
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+
+        it(@"should forget the versions of the objects removed in bulk", ^{
+            stubStatus(^int(NSURLRequest *request) {
+                return 200;
+            });
+
+            [restPipe read:@1 success:^(id responseObject) {
+                [restPipe removeAll:@[responseObject] success:^(NSArray *responseObjects) {
+                    NSMutableDictionary *project = [responseObject mutableCopy];
+                    project[@"title"] = @"Renamed Project";
+
+                    [restPipe save:project success:^(id responseObject) {
+                        [[methods should] equal:@[@"GET", @"DELETE", @"PUT"]];
+                        finishedFlag = YES;
+                    } failure:^(NSError *error) {
+                        // nope
+                    }];
+                } failure:^(NSError *error) {
+                    // nope
+                }];
+            } failure:^(NSError *error) {
+                // nope
+            }];
+
+            [[expectFutureValue(theValue(finishedFlag)) shouldEventuallyBeforeTimingOutAfter(5)] beYes];
+        });
+    });
+
     context(@"cancel should be honoured", ^{
 
         __block AGRESTPipe* restPipe = nil;
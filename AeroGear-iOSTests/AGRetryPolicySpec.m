@@ -0,0 +1,188 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGRetryPolicy.h"
+#import "AGCircuitBreaker.h"
+
+SPEC_BEGIN(AGRetryPolicySpec)
+
+describe(@"AGRetryPolicy", ^{
+
+    NSURL * const kURL = [NSURL URLWithString:@"http://server.com/context/projects"];
+
+    NSMutableURLRequest *(^requestWithMethod)(NSString *) = ^(NSString *method) {
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:kURL];
+        request.HTTPMethod = method;
+
+        return request;
+    };
+
+    NSHTTPURLResponse *(^responseWithStatus)(NSInteger, NSDictionary *) = ^(NSInteger status, NSDictionary *headers) {
+        return [[NSHTTPURLResponse alloc] initWithURL:kURL statusCode:status HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    };
+
+    context(@"when newly created", ^{
+
+        __block AGRetryPolicy *policy = nil;
+
+        beforeEach(^{
+            policy = [AGRetryPolicy policy];
+        });
+
+        it(@"should retry idempotent requests on retryable status codes", ^{
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"GET") response:responseWithStatus(503, nil) error:nil]) should] beYes];
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"PUT") response:responseWithStatus(429, nil) error:nil]) should] beYes];
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"DELETE") response:responseWithStatus(500, nil) error:nil]) should] beYes];
+        });
+
+        it(@"should not retry on client errors", ^{
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"GET") response:responseWithStatus(404, nil) error:nil]) should] beNo];
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"GET") response:responseWithStatus(501, nil) error:nil]) should] beNo];
+        });
+
+        it(@"should retry on transient transport errors only", ^{
+            NSError *timeout = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil];
+            NSError *cancelled = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"GET") response:nil error:timeout]) should] beYes];
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"GET") response:nil error:cancelled]) should] beNo];
+        });
+
+        it(@"should only retry non idempotent requests with an idempotency key", ^{
+            NSMutableURLRequest *request = requestWithMethod(@"POST");
+
+            [[theValue([policy shouldRetryRequest:request response:responseWithStatus(503, nil) error:nil]) should] beNo];
+
+            [request setValue:@"4f5a2c" forHTTPHeaderField:@"Idempotency-Key"];
+            [[theValue([policy shouldRetryRequest:request response:responseWithStatus(503, nil) error:nil]) should] beYes];
+        });
+
+        it(@"should retry non idempotent requests if asked to", ^{
+            policy.retryNonIdempotentRequests = YES;
+
+            [[theValue([policy shouldRetryRequest:requestWithMethod(@"POST") response:responseWithStatus(503, nil) error:nil]) should] beYes];
+        });
+
+        it(@"should back off exponentially, with jitter", ^{
+            policy.baseDelay = 1;
+            policy.maxDelay = 5;
+
+            for (int i = 0; i < 20; i++) {
+                [[theValue([policy delayForRetry:1 response:nil]) should] beLessThanOrEqualTo:theValue(1)];
+                [[theValue([policy delayForRetry:3 response:nil]) should] beLessThanOrEqualTo:theValue(4)];
+                [[theValue([policy delayForRetry:10 response:nil]) should] beLessThanOrEqualTo:theValue(5)];
+            }
+        });
+
+        it(@"should honour Retry-After headers", ^{
+            policy.maxDelay = 300;
+
+            [[theValue([policy delayForRetry:1 response:responseWithStatus(503, @{@"Retry-After": @"120"})]) should] equal:theValue(120)];
+
+            NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+            formatter.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
+            formatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"GMT"];
+            formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss 'GMT'";
+
+            NSString *date = [formatter stringFromDate:[NSDate dateWithTimeIntervalSinceNow:60]];
+            NSTimeInterval delay = [policy delayForRetry:1 response:responseWithStatus(503, @{@"Retry-After": date})];
+
+            [[theValue(delay) should] beBetween:theValue(58) and:theValue(60)];
+        });
+
+        it(@"should cap Retry-After headers at the maximum delay", ^{
+            policy.maxDelay = 10;
+
+            [[theValue([policy delayForRetry:1 response:responseWithStatus(503, @{@"Retry-After": @"3600"})]) should] equal:theValue(10)];
+        });
+    });
+});
+
+describe(@"AGCircuitBreaker", ^{
+
+    context(@"when newly created", ^{
+
+        __block AGCircuitBreaker *breaker = nil;
+
+        beforeEach(^{
+            breaker = [[AGCircuitBreaker alloc] initWithFailureThreshold:2 resetTimeout:0.2];
+        });
+
+        it(@"should open after consecutive failures", ^{
+            [breaker recordFailure];
+            [[theValue([breaker allowRequest]) should] beYes];
+
+            [breaker recordFailure];
+            [[theValue(breaker.state) should] equal:theValue(AGCircuitBreakerStateOpen)];
+            [[theValue([breaker allowRequest]) should] beNo];
+        });
+
+        it(@"should not count failures interrupted by a success", ^{
+            [breaker recordFailure];
+            [breaker recordSuccess];
+            [breaker recordFailure];
+
+            [[theValue([breaker allowRequest]) should] beYes];
+        });
+
+        it(@"should let a single trial request through after the timeout", ^{
+            [breaker recordFailure];
+            [breaker recordFailure];
+
+            [NSThread sleepForTimeInterval:0.25];
+
+            [[theValue([breaker allowRequest]) should] beYes];
+            [[theValue([breaker allowRequest]) should] beNo];
+
+            // the trial fails, the breaker opens again
+            [breaker recordFailure];
+            [[theValue(breaker.state) should] equal:theValue(AGCircuitBreakerStateOpen)];
+        });
+
+        it(@"should close when the trial request succeeds", ^{
+            [breaker recordFailure];
+            [breaker recordFailure];
+
+            [NSThread sleepForTimeInterval:0.25];
+
+            [[theValue([breaker allowRequest]) should] beYes];
+            [breaker recordSuccess];
+
+            [[theValue(breaker.state) should] equal:theValue(AGCircuitBreakerStateClosed)];
+            [[theValue([breaker allowRequest]) should] beYes];
+        });
+
+        it(@"should be shared per host and settings", ^{
+            AGCircuitBreaker *shared = [AGCircuitBreaker breakerForHost:@"breaker.server.com" failureThreshold:2 resetTimeout:1];
+
+            [[[AGCircuitBreaker breakerForHost:@"BREAKER.server.com" failureThreshold:2 resetTimeout:1] should] beIdenticalTo:shared];
+            [[[AGCircuitBreaker breakerForHost:@"other.server.com" failureThreshold:2 resetTimeout:1] shouldNot] beIdenticalTo:shared];
+        });
+
+        it(@"should honour the settings of each policy", ^{
+            AGCircuitBreaker *strict = [AGCircuitBreaker breakerForHost:@"settings.server.com" failureThreshold:1 resetTimeout:60];
+            AGCircuitBreaker *lenient = [AGCircuitBreaker breakerForHost:@"settings.server.com" failureThreshold:10 resetTimeout:5];
+
+            [[lenient shouldNot] beIdenticalTo:strict];
+            [[theValue(lenient.failureThreshold) should] equal:theValue(10)];
+            [[theValue(lenient.resetTimeout) should] equal:theValue(5)];
+        });
+    });
+});
+
+SPEC_END
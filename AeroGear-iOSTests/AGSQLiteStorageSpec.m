@@ -635,6 +635,53 @@ describe(@"AGSQLiteStorage", ^{
             }
         });
     });
+
+    context(@"when created with lazy decoding", ^{
+
+        __block AGStoreConfiguration* config = nil;
+        __block AGSQLiteStorage* sqliteStorage = nil;
+
+        beforeEach(^{
+            config = [[AGStoreConfiguration alloc] init];
+            [config setName:@"LazyUsers"];
+            [config setLazyDecoding:YES];
+
+            sqliteStorage = [AGSQLiteStorage storeWithConfig:config];
+        });
+
+        afterEach(^{
+            [sqliteStorage reset:nil];
+        });
+
+        it(@"should read objects _after_ storing them", ^{
+            NSMutableDictionary* user1 = [@{@"name" : @"Robert", @"city" : @"Boston"} mutableCopy];
+            NSMutableDictionary* user2 = [@{@"name" : @"David", @"city" : @"Boston"} mutableCopy];
+
+            BOOL success = [sqliteStorage save:@[user1, user2] error:nil];
+            [[theValue(success) should] equal:theValue(YES)];
+
+            NSArray *users = [sqliteStorage readAll];
+            [[users should] haveCountOf:2];
+
+            NSMutableDictionary *user = [sqliteStorage read:user1[@"id"]];
+            [[user[@"id"] should] equal:user1[@"id"]];
+            [[user[@"name"] should] equal:@"Robert"];
+        });
+
+        it(@"should save a modified object read from the store", ^{
+            NSMutableDictionary* user1 = [@{@"name" : @"Robert", @"city" : @"Boston"} mutableCopy];
+
+            [sqliteStorage save:user1 error:nil];
+
+            NSMutableDictionary *user = [sqliteStorage read:user1[@"id"]];
+            user[@"city"] = @"New York";
+
+            BOOL success = [sqliteStorage save:user error:nil];
+            [[theValue(success) should] equal:theValue(YES)];
+
+            [[[sqliteStorage read:user1[@"id"]][@"city"] should] equal:@"New York"];
+        });
+    });
 });
 
 SPEC_END
\ No newline at end of file
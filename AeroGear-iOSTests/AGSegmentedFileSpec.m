@@ -0,0 +1,177 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGSegmentedFile.h"
+
+SPEC_BEGIN(AGSegmentedFileSpec)
+
+describe(@"AGSegmentedFile", ^{
+    context(@"when newly created", ^{
+
+        __block NSURL *url = nil;
+        __block AGSegmentedFile *file = nil;
+
+        NSData *(^dataWithString)(NSString *) = ^(NSString *string) {
+            return [string dataUsingEncoding:NSUTF8StringEncoding];
+        };
+
+        beforeEach(^{
+            url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"segmented"]];
+
+            file = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+        });
+
+        afterEach(^{
+            file = nil;
+
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            [fileManager removeItemAtURL:url error:nil];
+            [fileManager removeItemAtURL:[url URLByAppendingPathExtension:@"idx"] error:nil];
+        });
+
+        it(@"should not be nil", ^{
+            [file shouldNotBeNil];
+        });
+
+        it(@"should be recognized as a segmented file", ^{
+            [[theValue([AGSegmentedFile isSegmentedFileAtURL:url]) should] beYes];
+        });
+
+        it(@"should persist values across reopening", ^{
+            file[@"0"] = dataWithString(@"Matthias");
+            file[@1] = dataWithString(@"Corinne");
+
+            [[theValue([file flush:nil]) should] beYes];
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(2)];
+            [[reopened[@"0"] should] equal:dataWithString(@"Matthias")];
+            [[reopened[@1] should] equal:dataWithString(@"Corinne")];
+        });
+
+        it(@"should persist overwritten and removed values", ^{
+            file[@"0"] = dataWithString(@"Matthias");
+            file[@"1"] = dataWithString(@"Corinne");
+
+            file[@"0"] = dataWithString(@"Matt");
+            [file removeObjectForKey:@"1"];
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(1)];
+            [[reopened[@"0"] should] equal:dataWithString(@"Matt")];
+            [reopened[@"1"] shouldBeNil];
+        });
+
+        it(@"should persist the removal of all values", ^{
+            file[@"0"] = dataWithString(@"Matthias");
+            [file removeAllObjects];
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(0)];
+        });
+
+        it(@"should shrink the file when compacted", ^{
+            for (NSUInteger i = 0; i < 100; i++) {
+                file[@"0"] = dataWithString([NSString stringWithFormat:@"Matthias %lu", (unsigned long)i]);
+            }
+
+            unsigned long long size = file.fileSize;
+
+            [[theValue([file compact:nil]) should] beYes];
+            [[theValue(file.fileSize) should] beLessThan:theValue(size)];
+            [[file[@"0"] should] equal:dataWithString(@"Matthias 99")];
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(1)];
+            [[reopened[@"0"] should] equal:dataWithString(@"Matthias 99")];
+        });
+
+        it(@"should checkpoint the records appended since the last checkpoint when closed", ^{
+            for (NSUInteger i = 0; i < 300; i++) {
+                file[@(i)] = dataWithString([NSString stringWithFormat:@"Matthias %lu", (unsigned long)i]);
+            }
+
+            file = nil;
+
+            NSData *data = [NSData dataWithContentsOfURL:[url URLByAppendingPathExtension:@"idx"]];
+            NSDictionary *checkpoint = [NSPropertyListSerialization propertyListWithData:data options:0 format:NULL error:nil];
+
+            [[theValue([checkpoint[@"keys"] count]) should] equal:theValue(300)];
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(300)];
+            [[reopened[@299] should] equal:dataWithString(@"Matthias 299")];
+        });
+
+        it(@"should read the whole file when the offset table is missing", ^{
+            file[@"0"] = dataWithString(@"Matthias");
+            [file checkpoint:nil];
+            file[@"1"] = dataWithString(@"Corinne");
+
+            [[NSFileManager defaultManager] removeItemAtURL:[url URLByAppendingPathExtension:@"idx"] error:nil];
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(2)];
+            [[reopened[@"1"] should] equal:dataWithString(@"Corinne")];
+        });
+
+        it(@"should drop a partially written record", ^{
+            file[@"0"] = dataWithString(@"Matthias");
+            [file checkpoint:nil];
+            file[@"1"] = dataWithString(@"Corinne");
+
+            unsigned long long size = file.fileSize;
+            file = nil;
+
+            NSFileHandle *handle = [NSFileHandle fileHandleForWritingToURL:url error:nil];
+            [handle truncateFileAtOffset:size - 3];
+            [handle closeFile];
+
+            file = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([file count]) should] equal:theValue(1)];
+            [[file[@"0"] should] equal:dataWithString(@"Matthias")];
+
+            // appends after the recovered records
+            file[@"1"] = dataWithString(@"Corinne");
+
+            AGSegmentedFile *reopened = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:nil];
+
+            [[theValue([reopened count]) should] equal:theValue(2)];
+        });
+
+        it(@"should refuse to open a file that isn't a segmented file", ^{
+            file = nil;
+            [dataWithString(@"not a segmented file") writeToURL:url atomically:YES];
+
+            NSError *error;
+            AGSegmentedFile *other = [[AGSegmentedFile alloc] initWithURL:url encoder:nil error:&error];
+
+            [other shouldBeNil];
+            [error shouldNotBeNil];
+        });
+    });
+});
+
+SPEC_END
@@ -0,0 +1,102 @@
+/*
+ * JBoss, Home of Professional Open Source.
+ * Copyright Red Hat, Inc., and individual contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Kiwi/Kiwi.h>
+#import "AGSerializer.h"
+
+SPEC_BEGIN(AGSerializerSpec)
+
+describe(@"AGMessagePackSerializer", ^{
+
+    __block AGMessagePackSerializer *serializer = nil;
+
+    NSData *(^bytes)(NSString *) = ^(NSString *hex) {
+        NSMutableData *data = [NSMutableData data];
+
+        for (NSUInteger i = 0; i + 1 < [hex length]; i += 2) {
+            uint8_t byte = (uint8_t) strtoul([[hex substringWithRange:NSMakeRange(i, 2)] UTF8String], NULL, 16);
+            [data appendBytes:&byte length:1];
+        }
+
+        return data;
+    };
+
+    beforeEach(^{
+        serializer = [AGMessagePackSerializer serializer];
+    });
+
+    context(@"when serializing", ^{
+
+        it(@"should use the compact forms", ^{
+            [[[serializer dataWithObject:@{@"a": @1} error:nil] should] equal:bytes(@"81a16101")];
+            [[[serializer dataWithObject:@[@-1, @YES, [NSNull null]] error:nil] should] equal:bytes(@"93ffc3c0")];
+        });
+
+        it(@"should use the sized forms of large values", ^{
+            [[[serializer dataWithObject:@[@256, @-129] error:nil] should] equal:bytes(@"92cd0100d1ff7f")];
+            [[[serializer dataWithObject:@[@1.5] error:nil] should] equal:bytes(@"91cb3ff8000000000000")];
+        });
+
+        it(@"should fail with the objects it can't serialize", ^{
+            NSError *error;
+
+            [[serializer dataWithObject:@{@"date": [NSDate date]} error:&error] shouldBeNil];
+            [[error.domain should] equal:AGSerializerErrorDomain];
+        });
+    });
+
+    context(@"when parsing", ^{
+
+        it(@"should parse back what it serialized", ^{
+            NSString *description = [@"" stringByPaddingToLength:300 withString:@"lorem ipsum " startingAtIndex:0];
+            NSDictionary *project = @{@"id": @4294967296,
+                                      @"title": @"First Project",
+                                      @"description": description,
+                                      @"tasks": @[@1, @-70000, @0.25],
+                                      @"done": @NO,
+                                      @"owner": [NSNull null],
+                                      @"logo": [@"logo" dataUsingEncoding:NSUTF8StringEncoding]};
+
+            NSData *data = [serializer dataWithObject:project error:nil];
+
+            [[[serializer objectWithData:data error:nil] should] equal:project];
+        });
+
+        it(@"should fail with truncated data", ^{
+            NSError *error;
+
+            [[serializer objectWithData:bytes(@"92cd01") error:&error] shouldBeNil];
+            [[error.domain should] equal:AGSerializerErrorDomain];
+        });
+
+        it(@"should fail with trailing data", ^{
+            NSError *error;
+
+            [[serializer objectWithData:bytes(@"01c0") error:&error] shouldBeNil];
+            [[error.domain should] equal:AGSerializerErrorDomain];
+        });
+
+        it(@"should fail with extension types", ^{
+            NSError *error;
+
+            [[serializer objectWithData:bytes(@"d40101") error:&error] shouldBeNil];
+            [[error.domain should] equal:AGSerializerErrorDomain];
+        });
+    });
+});
+
+SPEC_END